@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+# Local stand-in for the episode server, receives the batches of FHttpEpisodeTransport and writes the files to a folder.
+# Failures and latency can be injected to exercise the retries and the backoff of the uploader.
+#
+# Usage: Scripts/MockUploadServer.py [--port 8080] [--out Saved/MockUploads] [--fail-rate 0.3] [--delay 0.5]
+# then run the game with -UploadEndpoint=http://localhost:8080/episodes
+
+import argparse
+import os
+import random
+import struct
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+def parse_batch(body):
+	"""Splits a batch body into (name, data) pairs: uint32 name length, UTF-8 name, uint64 data length, data."""
+	files = []
+	offset = 0
+	while offset < len(body):
+		(name_length,) = struct.unpack_from("<I", body, offset)
+		offset += 4
+		name = body[offset:offset + name_length].decode("utf-8")
+		offset += name_length
+		(data_length,) = struct.unpack_from("<Q", body, offset)
+		offset += 8
+		if offset + data_length > len(body):
+			raise ValueError("truncated batch")
+		files.append((name, body[offset:offset + data_length]))
+		offset += data_length
+	return files
+
+
+class UploadHandler(BaseHTTPRequestHandler):
+	def do_POST(self):
+		body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+		if self.server.delay:
+			time.sleep(self.server.delay)
+		if random.random() < self.server.fail_rate:
+			self.send_response(503)
+			self.end_headers()
+			return
+
+		try:
+			files = parse_batch(body)
+		except (ValueError, struct.error, UnicodeDecodeError) as error:
+			self.send_response(400)
+			self.end_headers()
+			self.wfile.write(str(error).encode())
+			return
+
+		for name, data in files:
+			# Names are <episode>/<file>, nothing may escape the output folder
+			path = os.path.normpath(os.path.join(self.server.out, name))
+			if not path.startswith(os.path.abspath(self.server.out) + os.sep):
+				self.send_response(400)
+				self.end_headers()
+				return
+			os.makedirs(os.path.dirname(path), exist_ok=True)
+			with open(path + ".tmp", "wb") as file:
+				file.write(data)
+			os.replace(path + ".tmp", path)
+
+		self.server.batches += 1
+		self.server.bytes += len(body)
+		print("batch %d: %d files, %d bytes (%d bytes in total)" % (self.server.batches, len(files), len(body), self.server.bytes))
+		self.send_response(200)
+		self.end_headers()
+
+	def log_message(self, format, *args):
+		pass
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__)
+	parser.add_argument("--port", type=int, default=8080)
+	parser.add_argument("--out", default="Saved/MockUploads")
+	parser.add_argument("--fail-rate", type=float, default=0.0, help="fraction of the batches answered with 503")
+	parser.add_argument("--delay", type=float, default=0.0, help="seconds before each answer")
+	args = parser.parse_args()
+
+	server = ThreadingHTTPServer(("localhost", args.port), UploadHandler)
+	server.out = os.path.abspath(args.out)
+	server.fail_rate = args.fail_rate
+	server.delay = args.delay
+	server.batches = 0
+	server.bytes = 0
+	print("Receiving episodes on http://localhost:%d into %s" % (args.port, server.out))
+	server.serve_forever()
+
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,52 @@
+#!/bin/bash
+# Post-processes the recorded episodes with a coordinator and local worker processes (see UProcessEpisodesCommandlet).
+# With a kill delay, one worker is killed after that many seconds, to check that a crashed worker loses and doubles nothing:
+# every episode has to end in Done exactly once and Metrics.csv has to hold one row per episode.
+#
+# Usage: Scripts/ProcessEpisodes.sh <path to UE4Editor-Cmd> [workers] [kill delay in s]
+
+EDITOR="$1"
+WORKERS="${2:-4}"
+KILL_DELAY="$3"
+PROJECT_DIR="$(cd "$(dirname "$0")/.." && pwd)"
+PROJECT="$PROJECT_DIR/RobCogWeb.uproject"
+OUTPUT="$PROJECT_DIR/Saved/Processed"
+QUEUE="$OUTPUT/Queue"
+
+if [ -z "$EDITOR" ]; then
+	echo "Usage: $0 <path to UE4Editor-Cmd> [workers] [kill delay in s]"
+	exit 2
+fi
+
+"$EDITOR" "$PROJECT" -run=ProcessEpisodes -Workers="$WORKERS" -Output="$OUTPUT" -unattended -nullrhi -nosound > /dev/null &
+COORDINATOR=$!
+
+if [ -n "$KILL_DELAY" ]; then
+	sleep "$KILL_DELAY"
+	VICTIM=$(pgrep -f -- "-WorkerId=" | head -n 1)
+	if [ -n "$VICTIM" ]; then
+		echo "Killing worker process $VICTIM"
+		kill -9 "$VICTIM"
+	fi
+fi
+wait $COORDINATOR
+RESULT=$?
+
+# A complete event log is a series of segments with an index (see FEpisodeBatchProcessor::FindEpisodes)
+EPISODES=$(find "$PROJECT_DIR/Saved/Episodes" -name Events.bin.index 2> /dev/null | wc -l)
+DONE=$(ls "$QUEUE/Done" 2> /dev/null | wc -l)
+FAILED=$(ls "$QUEUE/Failed" 2> /dev/null | wc -l)
+ROWS=$(tail -n +2 "$OUTPUT/Metrics.csv" 2> /dev/null | cut -d, -f1 | sort | uniq | wc -l)
+ALL_ROWS=$(tail -n +2 "$OUTPUT/Metrics.csv" 2> /dev/null | wc -l)
+echo "$EPISODES episodes: $DONE done, $FAILED failed, $ALL_ROWS metric rows ($ROWS distinct)"
+
+if [ "$EPISODES" -eq 0 ]; then
+	echo "No episode found, nothing was checked"
+	exit 1
+fi
+
+if [ "$((DONE + FAILED))" -ne "$EPISODES" ] || [ "$ROWS" -ne "$ALL_ROWS" ] || [ "$ROWS" -ne "$DONE" ]; then
+	echo "Episodes were lost or doubled"
+	exit 1
+fi
+exit $RESULT
@@ -0,0 +1,55 @@
+#!/bin/bash
+# Launches the gameplay levels of the project headless (NullRHI) with -StartupBenchmark.
+# Each run appends a row to Saved/Benchmarks/StartupBenchmark.csv and quits on its first interactive frame.
+# Only levels with the character reach that frame: the menu (BeginPlay) and the SeparatedAreas maps are left out.
+# A run which does not finish within the timeout is killed and counts as a failure.
+# The script fails if any level is above the time-to-interactive threshold.
+#
+# Usage: Scripts/StartupBenchmark.sh <path to UE4Editor> [threshold in ms] [timeout in s]
+# STARTUP_BENCHMARK_MAPS overrides the levels measured (eg: "/Game/Maps/KitchenSemLog /Game/Maps/Other")
+
+EDITOR="$1"
+THRESHOLD="$2"
+TIMEOUT="${3:-300}"
+PROJECT_DIR="$(cd "$(dirname "$0")/.." && pwd)"
+PROJECT="$PROJECT_DIR/RobCogWeb.uproject"
+CSV="$PROJECT_DIR/Saved/Benchmarks/StartupBenchmark.csv"
+MAPS="${STARTUP_BENCHMARK_MAPS:-/Game/Maps/KitchenSemLog}"
+
+if [ -z "$EDITOR" ]; then
+	echo "Usage: $0 <path to UE4Editor> [threshold in ms] [timeout in s]"
+	exit 2
+fi
+
+EXTRA_ARGS=""
+if [ -n "$THRESHOLD" ]; then
+	EXTRA_ARGS="-StartupThreshold=$THRESHOLD"
+fi
+
+FAILED=0
+for MAP in $MAPS; do
+	echo "Benchmarking $MAP"
+	ROWS_BEFORE=$(cat "$CSV" 2> /dev/null | wc -l)
+	timeout --kill-after=10 "$TIMEOUT" "$EDITOR" "$PROJECT" "$MAP" -game -nullrhi -nosound -unattended -StartupBenchmark $EXTRA_ARGS > /dev/null
+	STATUS=$?
+	if [ $STATUS -eq 124 ] || [ $STATUS -eq 137 ]; then
+		echo "  timed out after $TIMEOUT s"
+		FAILED=1
+		continue
+	fi
+
+	# No new row means the map never became interactive
+	if [ "$(cat "$CSV" 2> /dev/null | wc -l)" -eq "$ROWS_BEFORE" ]; then
+		echo "  no result"
+		FAILED=1
+		continue
+	fi
+
+	RESULT=$(tail -n 1 "$CSV" | cut -d, -f9)
+	echo "  $(tail -n 1 "$CSV" | cut -d, -f7) ms to interactive: $RESULT"
+	if [ "$RESULT" != "PASS" ]; then
+		FAILED=1
+	fi
+done
+
+exit $FAILED
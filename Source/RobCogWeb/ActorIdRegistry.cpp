@@ -0,0 +1,206 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "ActorIdRegistry.h"
+#include "NameTable.h"
+#include "LogEncoding.h"
+
+const TCHAR* FActorIdRegistry::TagPrefix = TEXT("SemLogId:");
+
+uint32 FActorIdRegistry::GetAssignedId(const AActor* Actor)
+{
+	for (const FName& Tag : Actor->Tags)
+	{
+		const FString TagString = Tag.ToString();
+		if (TagString.StartsWith(TagPrefix))
+		{
+			return FCString::Strtoui64(*TagString + FCString::Strlen(TagPrefix), nullptr, 10) & ~FallbackBit;
+		}
+	}
+	return 0;
+}
+
+bool FActorIdRegistry::IsIdTag(FName Tag)
+{
+	return Tag.ToString().StartsWith(TagPrefix);
+}
+
+bool FActorIdRegistry::HaveSameTags(const AActor* A, const AActor* B)
+{
+	int32 IndexA = 0;
+	int32 IndexB = 0;
+	while (true)
+	{
+		while (IndexA < A->Tags.Num() && IsIdTag(A->Tags[IndexA]))
+		{
+			IndexA++;
+		}
+		while (IndexB < B->Tags.Num() && IsIdTag(B->Tags[IndexB]))
+		{
+			IndexB++;
+		}
+		if (IndexA == A->Tags.Num() || IndexB == B->Tags.Num())
+		{
+			return IndexA == A->Tags.Num() && IndexB == B->Tags.Num();
+		}
+		if (A->Tags[IndexA++] != B->Tags[IndexB++])
+		{
+			return false;
+		}
+	}
+}
+
+uint32 FActorIdRegistry::Register(AActor* Actor)
+{
+	if (!Actor)
+	{
+		return 0;
+	}
+
+	const uint32* Known = Ids.Find(Actor);
+	if (Known)
+	{
+		return *Known;
+	}
+
+	uint32 Id = GetAssignedId(Actor);
+	if (!Id)
+	{
+		//Names of placed actors are stable between runs, and so are the ones of actors spawned in a fixed order
+		Id = FCrc::StrCrc32(*Actor->GetName()) | FallbackBit;
+	}
+
+	AActor* const* Other = Actors.Find(Id);
+	if (Other)
+	{
+		UE_LOG(LogRobCogWeb, Warning, TEXT("%s and %s share the id %u, run the AssignActorIds commandlet on the map"), *Actor->GetName(), *(*Other)->GetName(), Id);
+		while (Actors.Contains(Id))
+		{
+			Id = (Id + 1) | (Id & FallbackBit);
+		}
+	}
+
+	Actors.Add(Id, Actor);
+	Ids.Add(Actor, Id);
+	return Id;
+}
+
+void FActorIdRegistry::GetNames(TMap<uint32, FString>& OutNames) const
+{
+	OutNames.Empty(Actors.Num());
+	for (const auto& Entry : Actors)
+	{
+		OutNames.Add(Entry.Key, Entry.Value->GetName());
+	}
+}
+
+bool FActorIdRegistry::Save(const FString& FilePath, const FNameTable& NameTable) const
+{
+	TArray<uint8> Bytes;
+	FMemoryWriter Writer(Bytes);
+	uint32 FileMagic = Magic;
+	uint16 FileVersion = Version;
+	Writer << FileMagic;
+	Writer << FileVersion;
+	LogEncoding::WriteVarint(Writer, Actors.Num());
+	TArray<uint32> TagIds;
+	for (const auto& Entry : Actors)
+	{
+		//The id tag itself is not in the name table, the id already stands for it
+		TagIds.Reset();
+		for (const FName& Tag : Entry.Value->Tags)
+		{
+			const uint32 TagId = NameTable.Find(Tag);
+			if (TagId)
+			{
+				TagIds.Add(TagId);
+			}
+		}
+
+		FString ActorName = Entry.Value->GetName();
+		LogEncoding::WriteVarint(Writer, Entry.Key);
+		Writer << ActorName;
+		LogEncoding::WriteVarint(Writer, TagIds.Num());
+		for (const uint32 TagId : TagIds)
+		{
+			LogEncoding::WriteVarint(Writer, TagId);
+		}
+	}
+	return FFileHelper::SaveArrayToFile(Bytes, *FilePath);
+}
+
+bool FActorIdRegistry::LoadNames(const FString& FilePath, TMap<uint32, FString>& OutNames)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *FilePath, FILEREAD_Silent))
+	{
+		return false;
+	}
+
+	FMemoryReader Reader(Bytes);
+	uint32 FileMagic;
+	uint16 FileVersion;
+	Reader << FileMagic;
+	Reader << FileVersion;
+	if (FileMagic != Magic || FileVersion != Version)
+	{
+		return false;
+	}
+
+	OutNames.Reset();
+	const uint64 NumActors = LogEncoding::ReadVarint(Reader);
+	for (uint64 i = 0; i < NumActors && !Reader.IsError(); i++)
+	{
+		const uint32 Id = (uint32)LogEncoding::ReadVarint(Reader);
+		FString ActorName;
+		Reader << ActorName;
+		OutNames.Add(Id, ActorName);
+
+		//The tags are not needed for the names
+		const uint64 NumTags = LogEncoding::ReadVarint(Reader);
+		for (uint64 Tag = 0; Tag < NumTags && !Reader.IsError(); Tag++)
+		{
+			LogEncoding::ReadVarint(Reader);
+		}
+	}
+	return !Reader.IsError();
+}
+
+bool FActorIdRegistry::LoadTagged(const FString& FilePath, const FNameTable& NameTable, FName Tag, TSet<uint32>& OutIds)
+{
+	OutIds.Reset();
+	const uint32 TagId = NameTable.Find(Tag);
+	TArray<uint8> Bytes;
+	if (!TagId || !FFileHelper::LoadFileToArray(Bytes, *FilePath, FILEREAD_Silent))
+	{
+		return false;
+	}
+
+	FMemoryReader Reader(Bytes);
+	uint32 FileMagic;
+	uint16 FileVersion;
+	Reader << FileMagic;
+	Reader << FileVersion;
+	if (FileMagic != Magic || FileVersion != Version)
+	{
+		return false;
+	}
+
+	const uint64 NumActors = LogEncoding::ReadVarint(Reader);
+	for (uint64 i = 0; i < NumActors && !Reader.IsError(); i++)
+	{
+		const uint32 Id = (uint32)LogEncoding::ReadVarint(Reader);
+		FString ActorName;
+		Reader << ActorName;
+
+		const uint64 NumTags = LogEncoding::ReadVarint(Reader);
+		for (uint64 TagIndex = 0; TagIndex < NumTags && !Reader.IsError(); TagIndex++)
+		{
+			if ((uint32)LogEncoding::ReadVarint(Reader) == TagId)
+			{
+				OutIds.Add(Id);
+			}
+		}
+	}
+	return !Reader.IsError();
+}
@@ -0,0 +1,66 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+class FNameTable;
+
+/*Stable identifiers of the actors, shared by the snapshots, the replays and the episode logs.
+Interactive actors carry their id in a 'SemLogId:<id>' tag, assigned in the editor by the AssignActorIds commandlet,
+so it survives cooks, reloads and renames. Other actors get a fallback id derived from their name, with the high bit set.
+The tags are parsed once at registration; afterwards both directions are plain map lookups.
+*/
+class FActorIdRegistry
+{
+public:
+	//Prefix of the tag carrying the id
+	static const TCHAR* TagPrefix;
+
+	//Fallback ids have this bit set, the assigned ones never do
+	static const uint32 FallbackBit = 0x80000000;
+
+	//Id assigned in the editor, 0 if the actor has no id tag
+	static uint32 GetAssignedId(const AActor* Actor);
+
+	//Whether the tag is an id tag
+	static bool IsIdTag(FName Tag);
+
+	//Whether two actors carry the same tags besides their id tags, in the same order (eg: items of the same kind, which stack)
+	static bool HaveSameTags(const AActor* A, const AActor* B);
+
+	//Registers an actor under its assigned or fallback id, returns the id
+	uint32 Register(AActor* Actor);
+
+	//Id of a registered actor, 0 for null or unregistered actors
+	FORCEINLINE uint32 GetId(const AActor* Actor) const
+	{
+		const uint32* Id = Ids.Find(Actor);
+		return Id ? *Id : 0;
+	}
+
+	//Actor registered under an id, null if there is none
+	FORCEINLINE AActor* Resolve(uint32 Id) const
+	{
+		AActor* const* Actor = Actors.Find(Id);
+		return Actor ? *Actor : nullptr;
+	}
+
+	//Copies the name of every registered actor, for consumers which run on other threads
+	void GetNames(TMap<uint32, FString>& OutNames) const;
+
+	//Writes the directory of the episode (id, actor name and tag ids from the name table)
+	bool Save(const FString& FilePath, const FNameTable& NameTable) const;
+
+	//Reads the actor names of a directory written by Save(), for the tools working on recorded episodes
+	static bool LoadNames(const FString& FilePath, TMap<uint32, FString>& OutNames);
+
+	//Reads the ids of the actors of a directory which carry the tag, the tag ids are those of the name table of the episode
+	static bool LoadTagged(const FString& FilePath, const FNameTable& NameTable, FName Tag, TSet<uint32>& OutIds);
+
+	//Identifies the directory file format
+	static const uint32 Magic = 0x41574352; // 'RCWA'
+	static const uint16 Version = 1;
+
+private:
+	TMap<uint32, AActor*> Actors;
+	TMap<const AActor*, uint32> Ids;
+};
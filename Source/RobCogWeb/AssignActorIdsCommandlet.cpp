@@ -0,0 +1,99 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "AssignActorIdsCommandlet.h"
+#include "ActorIdRegistry.h"
+
+UAssignActorIdsCommandlet::UAssignActorIdsCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 UAssignActorIdsCommandlet::Main(const FString& Params)
+{
+	TArray<FString> Maps;
+	FString Map;
+	if (FParse::Value(*Params, TEXT("Map="), Map))
+	{
+		Maps.Add(Map);
+	}
+	else
+	{
+		TArray<FString> MapFiles;
+		IFileManager::Get().FindFilesRecursive(MapFiles, *FPaths::Combine(*FPaths::GameContentDir(), TEXT("Maps")), *(FString(TEXT("*")) + FPackageName::GetMapPackageExtension()), true, false);
+		for (const FString& MapFile : MapFiles)
+		{
+			Maps.Add(FPackageName::FilenameToLongPackageName(MapFile));
+		}
+	}
+
+	int32 Assigned = 0;
+	for (const FString& MapPackageName : Maps)
+	{
+		Assigned += AssignIds(MapPackageName);
+	}
+	UE_LOG(LogRobCogWeb, Display, TEXT("Assigned %d actor ids in %d maps"), Assigned, Maps.Num());
+	return 0;
+}
+
+/*Same rules as AMyCharacter::BeginPlay(): the drawers and doors are the parents of the 'Handle' actors,
+the items are the actors tagged 'Item'.
+@param const FString& MapPackageName  -->  Long package name of the map*/
+int32 UAssignActorIdsCommandlet::AssignIds(const FString& MapPackageName)
+{
+	UPackage* Package = LoadPackage(nullptr, *MapPackageName, LOAD_None);
+	UWorld* World = Package ? UWorld::FindWorldInPackage(Package) : nullptr;
+	if (!World || !World->PersistentLevel)
+	{
+		UE_LOG(LogRobCogWeb, Warning, TEXT("Could not load the map %s"), *MapPackageName);
+		return 0;
+	}
+
+	TArray<AActor*> Interactive;
+	uint32 MaxId = 0;
+	for (AActor* Actor : World->PersistentLevel->Actors)
+	{
+		if (!Actor)
+		{
+			continue;
+		}
+		MaxId = FMath::Max(MaxId, FActorIdRegistry::GetAssignedId(Actor));
+
+		if (Actor->GetName().Contains(TEXT("Handle")) && Actor->GetAttachParentActor())
+		{
+			Interactive.AddUnique(Actor->GetAttachParentActor());
+		}
+		else if (Actor->ActorHasTag(FName(TEXT("Item"))))
+		{
+			Interactive.AddUnique(Actor);
+		}
+	}
+
+	int32 Assigned = 0;
+	for (AActor* Actor : Interactive)
+	{
+		if (!FActorIdRegistry::GetAssignedId(Actor))
+		{
+			Actor->Modify();
+			Actor->Tags.Add(FName(*FString::Printf(TEXT("%s%u"), FActorIdRegistry::TagPrefix, ++MaxId)));
+			Assigned++;
+		}
+	}
+
+	if (Assigned)
+	{
+#if WITH_EDITOR
+		const FString Filename = FPackageName::LongPackageNameToFilename(MapPackageName, FPackageName::GetMapPackageExtension());
+		if (!UPackage::SavePackage(Package, World, RF_NoFlags, *Filename))
+		{
+			UE_LOG(LogRobCogWeb, Error, TEXT("Could not save the map %s"), *MapPackageName);
+			return 0;
+		}
+#endif
+	}
+	UE_LOG(LogRobCogWeb, Display, TEXT("%s: %d interactive actors, %d new ids"), *MapPackageName, Interactive.Num(), Assigned);
+	return Assigned;
+}
@@ -0,0 +1,27 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+#include "AssignActorIdsCommandlet.generated.h"
+
+/*Gives every interactive actor of the maps (items, drawers and doors) a stable 'SemLogId:<id>' tag and saves the maps.
+Actors which already have an id keep it, new ones get the next free id of their map.
+Usage: UE4Editor-Cmd RobCogWeb.uproject -run=AssignActorIds [-Map=/Game/Maps/KitchenSemLog]
+Without -Map every map in /Game/Maps is processed.
+*/
+UCLASS()
+class ROBCOGWEB_API UAssignActorIdsCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UAssignActorIdsCommandlet();
+
+	//UCommandlet interface
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	//Tags the interactive actors of one map, returns the number of ids assigned
+	int32 AssignIds(const FString& MapPackageName);
+};
@@ -0,0 +1,323 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "BenchmarkCommandlet.h"
+#include "SemanticMapExporter.h"
+#include "EpisodeReader.h"
+#include "SegmentedFileReader.h"
+#include "KitchenRandomizer.h"
+
+UBenchmarkCommandlet::UBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 UBenchmarkCommandlet::Main(const FString& Params)
+{
+	FString Map;
+	if (!FParse::Value(*Params, TEXT("Map="), Map))
+	{
+		UE_LOG(LogRobCogWeb, Error, TEXT("Usage: -run=Benchmark -Map=<map> [-SemanticMap] [-EventIndex=<hours>] [-Layouts[=<n>]] [-Runs=<n>]"));
+		return 1;
+	}
+	float Hours = 1.f;
+	int32 Runs = 10;
+	int32 LayoutCount = 10000;
+	bool bSemanticMap = FParse::Param(*Params, TEXT("SemanticMap"));
+	bool bEventIndex = FParse::Value(*Params, TEXT("EventIndex="), Hours);
+	const bool bLayouts = FParse::Value(*Params, TEXT("Layouts="), LayoutCount) || FParse::Param(*Params, TEXT("Layouts"));
+	FParse::Value(*Params, TEXT("Runs="), Runs);
+	if (!bSemanticMap && !bEventIndex && !bLayouts)
+	{
+		bSemanticMap = true;
+		bEventIndex = true;
+	}
+
+	UWorld* World = LoadWorld(Map);
+	if (!World)
+	{
+		return 1;
+	}
+	FindKitchen(World);
+
+	bool bSucceeded = true;
+	if (bSemanticMap)
+	{
+		BenchmarkSemanticMap(Runs);
+	}
+	if (bEventIndex)
+	{
+		bSucceeded = BenchmarkEventIndex(Hours, Runs);
+	}
+	if (bLayouts)
+	{
+		bSucceeded = BenchmarkLayouts(World, LayoutCount) && bSucceeded;
+	}
+
+	World->CleanupWorld();
+	World->RemoveFromRoot();
+	return bSucceeded ? 0 : 1;
+}
+
+/*The world of a loaded package is not initialized: without it the components are not registered
+and the actors have neither their world transform nor their bounds
+@param const FString& MapPackageName  -->  Long package name of the map*/
+UWorld* UBenchmarkCommandlet::LoadWorld(const FString& MapPackageName)
+{
+	UPackage* Package = LoadPackage(nullptr, *MapPackageName, LOAD_None);
+	UWorld* World = Package ? UWorld::FindWorldInPackage(Package) : nullptr;
+	if (!World || !World->PersistentLevel)
+	{
+		UE_LOG(LogRobCogWeb, Error, TEXT("Could not load the map %s"), *MapPackageName);
+		return nullptr;
+	}
+
+	World->AddToRoot();
+	if (!World->bIsWorldInitialized)
+	{
+		World->InitWorld(UWorld::InitializationValues()
+			.AllowAudioPlayback(false)
+			.RequiresHitProxies(false)
+			.CreatePhysicsScene(false)
+			.CreateNavigation(false)
+			.CreateAISystem(false)
+			.ShouldSimulatePhysics(false)
+			.SetTransactional(false));
+	}
+	World->UpdateWorldComponents(true, false);
+	LevelName = FPackageName::GetShortName(MapPackageName);
+	return World;
+}
+
+void UBenchmarkCommandlet::FindKitchen(UWorld* World)
+{
+	AssetStateMap.Reset();
+	ItemMap.Reset();
+	Surfaces.Reset();
+	for (AActor* Actor : World->PersistentLevel->Actors)
+	{
+		if (!Actor)
+		{
+			continue;
+		}
+		ActorIds.Register(Actor);
+
+		if (Actor->GetName().Contains(TEXT("Handle")) && Actor->GetAttachParentActor())
+		{
+			if (Actor->GetName().Contains(TEXT("Door")))
+			{
+				Actor->GetAttachParentActor()->Tags.AddUnique(FName(TEXT("Door")));
+			}
+			AssetStateMap.Add(Actor->GetAttachParentActor(), EAssetState::Closed);
+		}
+		else if (Actor->ActorHasTag(FName(TEXT("Item"))))
+		{
+			ItemMap.FindOrAdd(Actor);
+		}
+		else if (FSemanticMapCapture::IsSurface(Actor))
+		{
+			Surfaces.Add(Actor);
+		}
+	}
+	UE_LOG(LogRobCogWeb, Display, TEXT("%s: %d drawers and doors, %d items, %d surfaces"), *LevelName, AssetStateMap.Num(), ItemMap.Num(), Surfaces.Num());
+}
+
+void UBenchmarkCommandlet::BenchmarkSemanticMap(int32 Count)
+{
+	if (Count <= 0)
+	{
+		return;
+	}
+
+	FSemanticMapCapture Capture;
+	std::string Buffer;
+	double CaptureTime = 0.0;
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 i = 0; i < Count; i++)
+	{
+		Capture.Capture(AssetStateMap, ItemMap, Surfaces, ActorIds);
+		CaptureTime += Capture.CaptureTime;
+		FSemanticMapExporter::Export(Capture, TEXT("SemanticMap_Benchmark"), Buffer);
+	}
+	const double Duration = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	UE_LOG(LogRobCogWeb, Display, TEXT("Semantic map of %s: %d objects, %u bytes, capture %.3f ms, export %.2f ms (average of %d runs)"),
+		*LevelName, Capture.Objects.Num(), (uint32)Buffer.size(), CaptureTime / Count, (Duration - CaptureTime) / Count, Count);
+}
+
+/*The log is written through the event logger, with the items of the level picked and dropped every half second
+and the doors and drawers opened and closed now and then, at a pace the writer thread keeps up with.
+Each query is answered by reading the whole log and filtering it, then through the index: the time to load the index
+is reported apart, since it is paid once per episode.
+@param float Hours  -->  Length of the log, in hours of play
+@param int32 Count  -->  Runs of each query*/
+bool UBenchmarkCommandlet::BenchmarkEventIndex(float Hours, int32 Count)
+{
+	if (!ItemMap.Num() || Hours <= 0.f || Count <= 0)
+	{
+		UE_LOG(LogRobCogWeb, Error, TEXT("No event to log: %d items, %.1f h, %d runs"), ItemMap.Num(), Hours, Count);
+		return false;
+	}
+
+	const FString BenchmarkDir = FPaths::Combine(*FPaths::GameSavedDir(), TEXT("Benchmarks"), TEXT("EventIndex"));
+	IFileManager::Get().DeleteDirectory(*BenchmarkDir, false, true);
+	IFileManager::Get().MakeDirectory(*BenchmarkDir, true);
+	const FString LogPath = FPaths::Combine(*BenchmarkDir, TEXT("Events.bin"));
+
+	TArray<AActor*> Items;
+	TArray<AActor*> Assets;
+	ItemMap.GetKeys(Items);
+	AssetStateMap.GetKeys(Assets);
+
+	FRandomStream Random(1);
+	const int32 NumEvents = (int32)(Hours * 3600.f * 2.f);
+	FSemanticEventLogger* Logger = new FSemanticEventLogger(LogPath, LevelName, 0);
+	for (int32 i = 0; i < NumEvents; i++)
+	{
+		const double Timestamp = i * 0.5;
+		if (Assets.Num() && Random.FRand() < 0.2f)
+		{
+			AActor* Asset = Assets[Random.RandHelper(Assets.Num())];
+			Logger->Log(Random.FRand() < 0.5f ? ESemanticEventKind::Open : ESemanticEventKind::Close, EEventHand::Right, Asset, ActorIds.GetId(Asset), 0, Timestamp);
+		}
+		else
+		{
+			AActor* Item = Items[Random.RandHelper(Items.Num())];
+			const bool bPick = (i & 1) == 0;
+			Logger->Log(bPick ? ESemanticEventKind::Pick : ESemanticEventKind::Drop, EEventHand::Right, Item, ActorIds.GetId(Item),
+				bPick || !Assets.Num() ? 0 : ActorIds.GetId(Assets[Random.RandHelper(Assets.Num())]), Timestamp);
+		}
+
+		//The ring buffer holds 4096 events, give the writer thread time to drain it rather than dropping events
+		if ((i & 1023) == 1023)
+		{
+			FPlatformProcess::Sleep(0.02f);
+		}
+	}
+	delete Logger;
+
+	const uint32 TargetId = ActorIds.GetId(Items[0]);
+	const double WindowStart = NumEvents * 0.25;
+	const double WindowEnd = WindowStart + 30.0;
+
+	//Queries answered by scanning the log
+	int32 ScanMatches[3] = { 0, 0, 0 };
+	double ScanTime = 0.0;
+	for (int32 Run = 0; Run < Count; Run++)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		FEpisodeEventLog Log;
+		FEpisodeReader::ReadEvents(LogPath, Log);
+		FMemory::Memzero(ScanMatches);
+		for (const FSemanticEvent& Event : Log.Events)
+		{
+			ScanMatches[0] += Event.ActorId == TargetId || Event.SurfaceId == TargetId;
+			ScanMatches[1] += Event.Kind == ESemanticEventKind::Open;
+			ScanMatches[2] += Event.Timestamp >= WindowStart - 0.0005 && Event.Timestamp <= WindowEnd + 0.0005;
+		}
+		ScanTime += FPlatformTime::Seconds() - StartTime;
+	}
+
+	//The same queries through the index
+	double LoadTime = 0.0;
+	double QueryTimes[3] = { 0.0, 0.0, 0.0 };
+	int32 IndexMatches[3] = { 0, 0, 0 };
+	int32 SegmentsLoaded = 0;
+	int64 LogSize = 0;
+	for (int32 Run = 0; Run < Count; Run++)
+	{
+		double StartTime = FPlatformTime::Seconds();
+		FEventLogIndex Index;
+		FSegmentedFileReader Reader(LogPath);
+		if (!FEpisodeReader::ReadEventIndex(LogPath, Index) || !Reader.Open())
+		{
+			UE_LOG(LogRobCogWeb, Error, TEXT("Could not read the event index of %s"), *LogPath);
+			return false;
+		}
+		LoadTime += FPlatformTime::Seconds() - StartTime;
+
+		TArray<FSemanticEvent> Events;
+		TArray<int32> Records;
+		for (int32 Query = 0; Query < 3; Query++)
+		{
+			StartTime = FPlatformTime::Seconds();
+			if (Query == 0)
+			{
+				FEpisodeReader::ReadEvents(Reader, Index, Index.FindByActor(TargetId), Events);
+			}
+			else if (Query == 1)
+			{
+				FEpisodeReader::ReadEvents(Reader, Index, Index.FindByKind(ESemanticEventKind::Open), Events);
+			}
+			else
+			{
+				Index.FindInTimeRange(WindowStart, WindowEnd, Records);
+				FEpisodeReader::ReadEvents(Reader, Index, Records, Events);
+			}
+			QueryTimes[Query] += FPlatformTime::Seconds() - StartTime;
+			IndexMatches[Query] = Events.Num();
+		}
+		SegmentsLoaded = Reader.GetSegmentsLoaded();
+		LogSize = Reader.TotalSize();
+	}
+
+	const int64 IndexSize = IFileManager::Get().FileSize(*FPaths::ChangeExtension(LogPath, TEXT("idx")));
+	UE_LOG(LogRobCogWeb, Display, TEXT("Event index: %d events over %.1f h, log %lld bytes, index %lld bytes, loaded in %.3f ms"),
+		NumEvents, Hours, LogSize, IndexSize, LoadTime * 1000.0 / Count);
+	UE_LOG(LogRobCogWeb, Display, TEXT("Event index: full scan %.3f ms; by actor %.3f ms (%d/%d events), by kind %.3f ms (%d/%d), 30 s window %.3f ms (%d/%d); %d segments read per run (average of %d runs)"),
+		ScanTime * 1000.0 / Count,
+		QueryTimes[0] * 1000.0 / Count, IndexMatches[0], ScanMatches[0],
+		QueryTimes[1] * 1000.0 / Count, IndexMatches[1], ScanMatches[1],
+		QueryTimes[2] * 1000.0 / Count, IndexMatches[2], ScanMatches[2],
+		SegmentsLoaded, Count);
+
+	//The index is only worth its speed if it answers what the scan answers
+	static const TCHAR* QueryNames[3] = { TEXT("by actor"), TEXT("by kind"), TEXT("30 s window") };
+	bool bMatched = true;
+	for (int32 Query = 0; Query < 3; Query++)
+	{
+		if (IndexMatches[Query] != ScanMatches[Query])
+		{
+			UE_LOG(LogRobCogWeb, Error, TEXT("Event index: the query %s found %d events through the index and %d by a full scan"), QueryNames[Query], IndexMatches[Query], ScanMatches[Query]);
+			bMatched = false;
+		}
+	}
+	return bMatched;
+}
+
+/*The generator is the one the randomizer applies its layouts with, obstacles of the level included;
+the seeds are the ones the game mode would pick from, 1 to Count
+@param UWorld* World  -->  World holding the randomizer
+@param int32 Count  -->  Layouts to generate*/
+bool UBenchmarkCommandlet::BenchmarkLayouts(UWorld* World, int32 Count)
+{
+	FLayoutGenerator* LayoutGenerator = nullptr;
+	for (TActorIterator<AKitchenRandomizer> It(World); It && !LayoutGenerator; ++It)
+	{
+		LayoutGenerator = It->GetGenerator();
+	}
+	if (!LayoutGenerator || Count <= 0)
+	{
+		UE_LOG(LogRobCogWeb, Error, TEXT("No layout to generate in %s: no randomizer with a pool, or %d layouts"), *LevelName, Count);
+		return false;
+	}
+
+	FKitchenLayout Layout;
+	int32 ValidCount = 0;
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 i = 0; i < Count; i++)
+	{
+		if (LayoutGenerator->Generate(i + 1, Layout))
+		{
+			ValidCount++;
+		}
+	}
+	const double Duration = FPlatformTime::Seconds() - StartTime;
+
+	UE_LOG(LogRobCogWeb, Display, TEXT("Layouts of %s: %d generated in %.2f ms (%.0f layouts/s), %d valid"),
+		*LevelName, Count, Duration * 1000.0, Duration > 0.0 ? Count / Duration : 0.0, ValidCount);
+	return true;
+}
@@ -0,0 +1,51 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "MyCharacter.h"
+#include "Commandlets/Commandlet.h"
+#include "BenchmarkCommandlet.generated.h"
+
+/*Measures the episode tools on the kitchen of a map, outside of any game session.
+Usage: UE4Editor-Cmd RobCogWeb.uproject -run=Benchmark -Map=/Game/Maps/KitchenSemLog [-SemanticMap] [-EventIndex=<hours>] [-Layouts[=<n>]] [-Runs=<n>]
+-SemanticMap captures and exports the semantic map of the kitchen.
+-EventIndex writes an event log of that many hours of play and compares the queries answered by a full scan and through its index.
+-Layouts generates that many item layouts (10000 by default) with the randomizer of the map, without applying them.
+Without any of them the first two run, the logs are written to Saved/Benchmarks and the results are logged.
+Returns 1 if the map or a log could not be read, the index and the full scan of the event log disagree, or the map has no randomizer to generate layouts with.
+*/
+UCLASS()
+class ROBCOGWEB_API UBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UBenchmarkCommandlet();
+
+	//UCommandlet interface
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	//Loads the map and registers the components of its world, so that the actors have their poses and bounds
+	UWorld* LoadWorld(const FString& MapPackageName);
+
+	//Finds the drawers, doors, items and surfaces of the world, with the rules of AMyCharacter::BeginPlay()
+	void FindKitchen(UWorld* World);
+
+	//Captures and exports the semantic map synchronously and logs the average times and size
+	void BenchmarkSemanticMap(int32 Count);
+
+	//Writes an event log of the given length, then logs the latency of the same queries answered by a full scan and through the index
+	bool BenchmarkEventIndex(float Hours, int32 Count);
+
+	//Generates layouts with the randomizer of the world and logs the throughput and the share of valid layouts
+	bool BenchmarkLayouts(UWorld* World, int32 Count);
+
+	FString LevelName;
+
+	//Same content as the maps of the character
+	TMap<AActor*, EAssetState> AssetStateMap;
+	TMap<AActor*, EItemType> ItemMap;
+	TSet<AActor*> Surfaces;
+	FActorIdRegistry ActorIds;
+};
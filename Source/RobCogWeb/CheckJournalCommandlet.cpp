@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "CheckJournalCommandlet.h"
+#include "SegmentedFileWriter.h"
+
+UCheckJournalCommandlet::UCheckJournalCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+/*Each kill stops a log after a random number of records and copies its files as a crash would leave them: the segments
+in place and the journal as far as it was pushed, torn at a random byte with garbage after it half of the time.
+The copy is recovered and read back; it has to be the written stream up to a record end, and all of it when the journal
+was pushed and not torn. Small segments and a few records larger than a segment make the kills fall around rollovers.
+@param const FString& Params  -->  -Kills=<crashes to simulate> -Seed=<seed of the records and kill points>*/
+int32 UCheckJournalCommandlet::Main(const FString& Params)
+{
+	int32 Kills = 1000;
+	int32 Seed = 1;
+	FParse::Value(*Params, TEXT("Kills="), Kills);
+	FParse::Value(*Params, TEXT("Seed="), Seed);
+	if (Kills <= 0)
+	{
+		UE_LOG(LogRobCogWeb, Error, TEXT("Nothing to check, -Kills must be above 0"));
+		return 1;
+	}
+
+	const FString CheckDir = FPaths::Combine(*FPaths::GameSavedDir(), TEXT("Benchmarks"), TEXT("Journal"));
+	const FString CrashDir = FPaths::Combine(*CheckDir, TEXT("Crash"));
+	const FString LogPath = FPaths::Combine(*CheckDir, TEXT("Log.bin"));
+	const FString CrashPath = FPaths::Combine(*CrashDir, TEXT("Log.bin"));
+
+	FRandomStream Random(Seed);
+	TArray<uint8> Written;
+	TArray<int32> WrittenEnds;
+	TArray<uint8> Record;
+	TArray<uint8> Recovered;
+	TArray<uint8> JournalBytes;
+	int32 NumFailed = 0;
+	int64 NumLost = 0;
+	for (int32 Kill = 0; Kill < Kills; Kill++)
+	{
+		IFileManager::Get().DeleteDirectory(*CheckDir, false, true);
+		IFileManager::Get().MakeDirectory(*CrashDir, true);
+
+		//The journal is only pushed to the disk when asked
+		FSegmentedFileWriter* Writer = new FSegmentedFileWriter(LogPath, 4096, 1000.f, 1000.f);
+		Written.Reset();
+		WrittenEnds.Reset();
+		const int32 NumRecords = Random.RandRange(1, 200);
+		for (int32 i = 0; i < NumRecords; i++)
+		{
+			Record.SetNumUninitialized(Random.FRand() < 0.05f ? Random.RandRange(4096, 10000) : Random.RandRange(1, 600));
+			for (uint8& Byte : Record)
+			{
+				Byte = (uint8)Random.RandHelper(256);
+			}
+			Writer->Serialize(Record.GetData(), Record.Num());
+			Writer->Flush();
+			Written.Append(Record);
+			WrittenEnds.Add(Written.Num());
+		}
+		const bool bSynced = Random.FRand() < 0.5f;
+		if (bSynced)
+		{
+			Writer->SyncJournal();
+		}
+
+		//What is on the disk at this point is what a crash leaves
+		TArray<FString> Files;
+		IFileManager::Get().FindFiles(Files, *FPaths::Combine(*CheckDir, TEXT("Log.bin.*")), true, false);
+		for (const FString& File : Files)
+		{
+			if (!File.EndsWith(TEXT(".tmp")))
+			{
+				IFileManager::Get().Copy(*FPaths::Combine(*CrashDir, *File), *FPaths::Combine(*CheckDir, *File));
+			}
+		}
+		delete Writer;
+
+		const bool bTorn = Random.FRand() < 0.5f;
+		const FString CrashJournal = FSegmentedFileWriter::GetJournalPath(CrashPath);
+		if (bTorn && FFileHelper::LoadFileToArray(JournalBytes, *CrashJournal, FILEREAD_Silent) && JournalBytes.Num())
+		{
+			JournalBytes.SetNum(Random.RandHelper(JournalBytes.Num()), false);
+			for (int32 i = Random.RandRange(0, 16); i > 0; i--)
+			{
+				JournalBytes.Add((uint8)Random.RandHelper(256));
+			}
+			FFileHelper::SaveArrayToFile(JournalBytes, *CrashJournal);
+		}
+
+		const int32 NumRecovered = FSegmentedFileWriter::RecoverJournal(CrashPath);
+		FSegmentedFileWriter::ReadStream(CrashPath, Recovered);
+
+		//Segments only roll over between records, so both the segments and the journal end on one
+		const bool bPrefix = Recovered.Num() <= Written.Num() && (!Recovered.Num() || FMemory::Memcmp(Recovered.GetData(), Written.GetData(), Recovered.Num()) == 0);
+		const bool bOnRecord = !Recovered.Num() || WrittenEnds.Contains(Recovered.Num());
+		const bool bWhole = !bSynced || bTorn || Recovered.Num() == Written.Num();
+		if (NumRecovered < 0 || !bPrefix || !bOnRecord || !bWhole || IFileManager::Get().FileExists(*CrashJournal))
+		{
+			UE_LOG(LogRobCogWeb, Error, TEXT("Journal recovery failed at kill %d: %d of %d bytes recovered, synced %d, torn %d"),
+				Kill, Recovered.Num(), Written.Num(), bSynced, bTorn);
+			NumFailed++;
+		}
+
+		int32 NumKept = 0;
+		while (NumKept < WrittenEnds.Num() && WrittenEnds[NumKept] <= Recovered.Num())
+		{
+			NumKept++;
+		}
+		NumLost += NumRecords - NumKept;
+	}
+	IFileManager::Get().DeleteDirectory(*CheckDir, false, true);
+
+	UE_LOG(LogRobCogWeb, Display, TEXT("Journal recovery: %d kills, %d failed, %.1f records lost per kill"), Kills, NumFailed, (double)NumLost / Kills);
+	return NumFailed ? 1 : 0;
+}
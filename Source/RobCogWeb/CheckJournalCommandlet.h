@@ -0,0 +1,23 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+#include "CheckJournalCommandlet.generated.h"
+
+/*Kills a journaled log (see FSegmentedFileWriter) at random points and checks that the recovery gives back what was written before each kill:
+a prefix of the records which ends on a record, the whole log when the journal was synced and left intact, and no journal left behind.
+Usage: UE4Editor-Cmd RobCogWeb.uproject -run=CheckJournal [-Kills=<n>] [-Seed=<n>]
+The logs are written to Saved/Benchmarks/Journal and deleted at the end. Returns 1 if any kill was not recovered.
+*/
+UCLASS()
+class ROBCOGWEB_API UCheckJournalCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UCheckJournalCommandlet();
+
+	//UCommandlet interface
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,289 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "EpisodeBatchProcessor.h"
+#include "ActorIdRegistry.h"
+#include "OwlEpisodeWriter.h"
+#include "SegmentedFileWriter.h"
+
+FEpisodeBatchProcessor::FEpisodeBatchProcessor(const FString& InOutputDir, int32 InNumThreads, bool bInExportOwl)
+	: OutputDir(InOutputDir)
+	, NumThreads(InNumThreads > 0 ? InNumThreads : FPlatformMisc::NumberOfCoresIncludingHyperthreads())
+	, bExportOwl(bInExportOwl)
+	, Elapsed(0.0)
+{
+}
+
+FEpisodeBatchProcessor::~FEpisodeBatchProcessor()
+{
+	for (FWorker* Worker : Workers)
+	{
+		delete Worker;
+	}
+}
+
+/*A log is a series of segments (see FSegmentedFileWriter), its index is written when it is closed or recovered after a crash:
+the episodes still recording, or left by a crash and not recovered yet, are not listed*/
+void FEpisodeBatchProcessor::FindEpisodes(const FString& RootDir, TArray<FString>& OutEpisodeDirs)
+{
+	TArray<FString> EventIndices;
+	IFileManager::Get().FindFilesRecursive(EventIndices, *RootDir, TEXT("Events.bin.index"), true, false);
+	for (const FString& EventIndex : EventIndices)
+	{
+		OutEpisodeDirs.Add(FPaths::GetPath(EventIndex));
+	}
+	OutEpisodeDirs.Sort();
+}
+
+int64 FEpisodeBatchProcessor::GetEventLogSize(const FString& EpisodeDir)
+{
+	const FString BasePath = FPaths::Combine(*EpisodeDir, TEXT("Events.bin"));
+	int64 Size = 0;
+	for (int32 SegmentIndex = 0; ; SegmentIndex++)
+	{
+		const int64 SegmentSize = IFileManager::Get().FileSize(*FSegmentedFileWriter::GetSegmentPath(BasePath, SegmentIndex));
+		if (SegmentSize < 0)
+		{
+			break;
+		}
+		Size += SegmentSize;
+	}
+	return Size;
+}
+
+/*The largest episodes are dealt first, round robin, so that the queues start balanced and what is left to steal
+at the end are the small ones.
+@param const TArray<FString>& InEpisodeDirs  -->  Episode folders to process*/
+int32 FEpisodeBatchProcessor::Run(const TArray<FString>& InEpisodeDirs)
+{
+	EpisodeDirs = InEpisodeDirs;
+	Metrics.Reset();
+	Metrics.AddZeroed(EpisodeDirs.Num());
+	NumDone.Reset();
+	IFileManager::Get().MakeDirectory(*OutputDir, true);
+
+	TArray<int64> Sizes;
+	TArray<int32> Order;
+	for (int32 Episode = 0; Episode < EpisodeDirs.Num(); Episode++)
+	{
+		Sizes.Add(GetEventLogSize(EpisodeDirs[Episode]));
+		Order.Add(Episode);
+	}
+	Order.Sort([&Sizes](int32 A, int32 B) { return Sizes[A] > Sizes[B]; });
+
+	for (FWorker* Worker : Workers)
+	{
+		delete Worker;
+	}
+	Workers.Reset();
+	const int32 NumWorkers = FMath::Max(1, FMath::Min(NumThreads, EpisodeDirs.Num()));
+	for (int32 WorkerIndex = 0; WorkerIndex < NumWorkers; WorkerIndex++)
+	{
+		Workers.Add(new FWorker(*this, WorkerIndex));
+	}
+	for (int32 i = 0; i < Order.Num(); i++)
+	{
+		Workers[i % NumWorkers]->Queue.Add(Order[i]);
+	}
+
+	//Every queue is filled before the first worker starts, no episode is added afterwards
+	const double StartTime = FPlatformTime::Seconds();
+	for (FWorker* Worker : Workers)
+	{
+		Worker->Thread = FRunnableThread::Create(Worker, *FString::Printf(TEXT("EpisodeWorker%d"), Worker->WorkerIndex), 0, TPri_Normal);
+	}
+	int32 NumStolen = 0;
+	for (FWorker* Worker : Workers)
+	{
+		if (Worker->Thread)
+		{
+			Worker->Thread->WaitForCompletion();
+			delete Worker->Thread;
+			Worker->Thread = nullptr;
+		}
+		else
+		{
+			//Thread creation failed, the episodes are processed here
+			Worker->Run();
+		}
+		NumStolen += Worker->NumStolen;
+	}
+	Elapsed = FPlatformTime::Seconds() - StartTime;
+
+	int32 NumProcessed = 0;
+	for (const FEpisodeMetrics& Episode : Metrics)
+	{
+		NumProcessed += Episode.bProcessed ? 1 : 0;
+	}
+	UE_LOG(LogRobCogWeb, Display, TEXT("Processed %d of %d episodes in %.2f s on %d threads: %.1f episodes/s, %d stolen"),
+		NumProcessed, EpisodeDirs.Num(), Elapsed, NumWorkers, Elapsed > 0.0 ? NumProcessed / Elapsed : 0.0, NumStolen);
+	return NumProcessed;
+}
+
+bool FEpisodeBatchProcessor::Steal(int32 Thief, int32& OutEpisode)
+{
+	for (int32 i = 1; i < Workers.Num(); i++)
+	{
+		if (Workers[(Thief + i) % Workers.Num()]->PopBack(OutEpisode))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FEpisodeBatchProcessor::SaveMetrics(const FString& FilePath) const
+{
+	FString Csv = TEXT("Episode,Processed,Duration,Events,Picks,Drops,Opens,Closes,ItemsMoved,HeldTime,OpenTime,CameraPath,HandsPath,ProcessingMs\n");
+	for (const FEpisodeMetrics& Episode : Metrics)
+	{
+		Csv += FString::Printf(TEXT("%s,%d,%.3f,%d,%d,%d,%d,%d,%d,%.3f,%.3f,%.1f,%.1f,%.2f\n"),
+			*Episode.EpisodeName, Episode.bProcessed ? 1 : 0, Episode.Duration,
+			Episode.NumEvents, Episode.NumPicks, Episode.NumDrops, Episode.NumOpens, Episode.NumCloses,
+			Episode.NumItemsMoved, Episode.HeldTime, Episode.OpenTime, Episode.CameraPath, Episode.HandsPath, Episode.ProcessingMs);
+	}
+	return FFileHelper::SaveStringToFile(Csv, *FilePath);
+}
+
+FEpisodeBatchProcessor::FWorker::FWorker(FEpisodeBatchProcessor& InProcessor, int32 InWorkerIndex)
+	: Processor(InProcessor)
+	, WorkerIndex(InWorkerIndex)
+	, Thread(nullptr)
+	, Head(0)
+	, NumStolen(0)
+{
+}
+
+uint32 FEpisodeBatchProcessor::FWorker::Run()
+{
+	int32 Episode;
+	while (true)
+	{
+		if (PopFront(Episode))
+		{
+			Process(Episode);
+		}
+		else if (Processor.Steal(WorkerIndex, Episode))
+		{
+			NumStolen++;
+			Process(Episode);
+		}
+		else
+		{
+			//All queues are empty, and they never refill
+			break;
+		}
+	}
+	return 0;
+}
+
+bool FEpisodeBatchProcessor::FWorker::PopFront(int32& OutEpisode)
+{
+	FScopeLock Lock(&QueueLock);
+	if (Head >= Queue.Num())
+	{
+		return false;
+	}
+	OutEpisode = Queue[Head++];
+	return true;
+}
+
+bool FEpisodeBatchProcessor::FWorker::PopBack(int32& OutEpisode)
+{
+	FScopeLock Lock(&QueueLock);
+	if (Head >= Queue.Num())
+	{
+		return false;
+	}
+	OutEpisode = Queue.Pop(false);
+	return true;
+}
+
+/*Parse, derive the intervals, export the OWL, compute the metrics; a missing trajectory log, start capture or actor directory
+only leaves the matching metrics, first states and names empty.
+@param int32 Episode  -->  Index of the episode in the run*/
+void FEpisodeBatchProcessor::FWorker::Process(int32 Episode)
+{
+	const double StartTime = FPlatformTime::Seconds();
+	const FString& EpisodeDir = Processor.EpisodeDirs[Episode];
+	FEpisodeMetrics& Result = Processor.Metrics[Episode];
+	Result.EpisodeName = FPaths::GetCleanFilename(EpisodeDir);
+
+	//Parse
+	if (!FEpisodeReader::ReadEvents(FPaths::Combine(*EpisodeDir, TEXT("Events.bin")), EventLog))
+	{
+		UE_LOG(LogRobCogWeb, Warning, TEXT("Could not read the events of %s"), *EpisodeDir);
+		return;
+	}
+	const bool bTrajectories = FEpisodeReader::ReadTrajectories(FPaths::Combine(*EpisodeDir, TEXT("Trajectories.bin")), TrajectoryLog);
+	const bool bStart = FSemanticMapCapture::LoadFromFile(FPaths::Combine(*EpisodeDir, TEXT("SemanticMap_Start.bin")), StartCapture);
+
+	//Derive the intervals, from the start state when it was saved
+	Memory.Build(EventLog, bTrajectories ? &TrajectoryLog : nullptr, bStart ? &StartCapture : nullptr);
+
+	//Export the OWL
+	if (Processor.bExportOwl)
+	{
+		ActorNames.Reset();
+		DoorIds.Reset();
+		FActorIdRegistry::LoadNames(FPaths::Combine(*EpisodeDir, TEXT("Actors.bin")), ActorNames);
+		if (FNameTable::Load(FPaths::Combine(*EpisodeDir, TEXT("Names.bin")), NameTable))
+		{
+			FActorIdRegistry::LoadTagged(FPaths::Combine(*EpisodeDir, TEXT("Actors.bin")), NameTable, FName(TEXT("Door")), DoorIds);
+		}
+		FOwlEpisodeWriter Writer(FPaths::Combine(*Processor.OutputDir, *(Result.EpisodeName + TEXT(".owl"))), Result.EpisodeName, ActorNames, DoorIds, &Pool);
+		for (const FSemanticEvent& Event : EventLog.Events)
+		{
+			Writer.Consume(Event);
+		}
+		Writer.Close();
+	}
+
+	//Compute the metrics
+	const double FirstTime = EventLog.Events.Num() ? EventLog.Events[0].Timestamp :
+		(bTrajectories && TrajectoryLog.Samples.Num() ? TrajectoryLog.Samples[0].Timestamp : 0.0);
+	Result.Duration = Memory.GetEndTime() - FirstTime;
+	Result.NumEvents = EventLog.Events.Num();
+	for (const FSemanticEvent& Event : EventLog.Events)
+	{
+		Result.NumPicks += Event.Kind == ESemanticEventKind::Pick ? 1 : 0;
+		Result.NumDrops += Event.Kind == ESemanticEventKind::Drop ? 1 : 0;
+		Result.NumOpens += Event.Kind == ESemanticEventKind::Open ? 1 : 0;
+		Result.NumCloses += Event.Kind == ESemanticEventKind::Close ? 1 : 0;
+	}
+
+	for (const auto& Tree : Memory.GetActorTrees())
+	{
+		bool bMoved = false;
+		for (const FStateInterval& Interval : Tree.Value.GetIntervals())
+		{
+			if (Interval.IsHeld())
+			{
+				Result.HeldTime += Interval.End - Interval.Start;
+				bMoved = true;
+			}
+			else if (Interval.State == EItemState::Open)
+			{
+				Result.OpenTime += Interval.End - Interval.Start;
+			}
+		}
+		Result.NumItemsMoved += bMoved ? 1 : 0;
+	}
+
+	if (bTrajectories)
+	{
+		for (int32 i = 1; i < TrajectoryLog.Samples.Num(); i++)
+		{
+			const FTrajectorySample& Previous = TrajectoryLog.Samples[i - 1];
+			const FTrajectorySample& Sample = TrajectoryLog.Samples[i];
+			Result.CameraPath += FVector::Dist(Previous.Bodies[FTrajectorySample::Camera].Location, Sample.Bodies[FTrajectorySample::Camera].Location);
+			Result.HandsPath += FVector::Dist(Previous.Bodies[FTrajectorySample::RightHand].Location, Sample.Bodies[FTrajectorySample::RightHand].Location) +
+				FVector::Dist(Previous.Bodies[FTrajectorySample::LeftHand].Location, Sample.Bodies[FTrajectorySample::LeftHand].Location);
+		}
+	}
+
+	Result.bProcessed = true;
+	Result.ProcessingMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+	UE_LOG(LogRobCogWeb, Log, TEXT("[%d/%d] %s processed in %.1f ms on worker %d"),
+		Processor.NumDone.Increment(), Processor.EpisodeDirs.Num(), *Result.EpisodeName, Result.ProcessingMs, WorkerIndex);
+}
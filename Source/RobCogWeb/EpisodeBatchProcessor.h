@@ -0,0 +1,128 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "EpisodeMemory.h"
+#include "SemanticMapExporter.h"
+#include "NameTable.h"
+#include "RapidXmlHelpers.h"
+
+//Statistics and training features of one processed episode, one row of Metrics.csv
+struct FEpisodeMetrics
+{
+	FString EpisodeName;
+	bool bProcessed;
+
+	//From the first to the last event or sample, in seconds
+	double Duration;
+
+	int32 NumEvents;
+	int32 NumPicks;
+	int32 NumDrops;
+	int32 NumOpens;
+	int32 NumCloses;
+
+	//Items picked at least once, and the time they spent in hand
+	int32 NumItemsMoved;
+	double HeldTime;
+
+	//Time the drawers and doors spent open
+	double OpenTime;
+
+	//Distance travelled by the camera and by both hands, in cm
+	double CameraPath;
+	double HandsPath;
+
+	//Time spent on the episode by its worker, in ms
+	double ProcessingMs;
+};
+
+/*Post-processes recorded episodes on a pool of worker threads: each episode is parsed, its state intervals are derived,
+its OWL is exported and its metrics are computed.
+The episodes are dealt to the workers upfront, largest first; a worker which runs out of episodes steals the smallest
+remaining one from the end of another worker's queue. Each queue has its own lock, taken only for a pop,
+and each worker builds its OWL in its own rapidxml pool, so the workers never wait on a shared lock.
+*/
+class FEpisodeBatchProcessor
+{
+public:
+	//0 threads uses every core
+	FEpisodeBatchProcessor(const FString& InOutputDir, int32 InNumThreads = 0, bool bInExportOwl = true);
+	~FEpisodeBatchProcessor();
+
+	//Episode folders (the ones holding a complete event log, with its Events.bin.index) found under the directory
+	static void FindEpisodes(const FString& RootDir, TArray<FString>& OutEpisodeDirs);
+
+	//Bytes of the segments of the event log of an episode
+	static int64 GetEventLogSize(const FString& EpisodeDir);
+
+	//Processes the episodes and blocks until all are done, returns the number processed successfully
+	int32 Run(const TArray<FString>& InEpisodeDirs);
+
+	//Writes the metrics of the last run as CSV
+	bool SaveMetrics(const FString& FilePath) const;
+
+	const TArray<FEpisodeMetrics>& GetMetrics() const { return Metrics; }
+
+	//Wall time of the last run, in seconds
+	double GetElapsed() const { return Elapsed; }
+
+	int32 GetNumThreads() const { return NumThreads; }
+
+private:
+	class FWorker : public FRunnable
+	{
+	public:
+		FWorker(FEpisodeBatchProcessor& InProcessor, int32 InWorkerIndex);
+
+		//FRunnable interface
+		virtual uint32 Run() override;
+
+		//Next episode of the own queue, from the front
+		bool PopFront(int32& OutEpisode);
+
+		//Last episode of the queue, for the other workers
+		bool PopBack(int32& OutEpisode);
+
+		//Runs the steps on one episode, fills its metrics
+		void Process(int32 Episode);
+
+		FEpisodeBatchProcessor& Processor;
+		int32 WorkerIndex;
+		FRunnableThread* Thread;
+
+		FCriticalSection QueueLock;
+		TArray<int32> Queue;
+		int32 Head;
+
+		//Episodes taken from other queues
+		int32 NumStolen;
+
+		//Reused from one episode to the next
+		FEpisodeEventLog EventLog;
+		FEpisodeTrajectoryLog TrajectoryLog;
+		FSemanticMapCapture StartCapture;
+		FEpisodeMemory Memory;
+		TMap<uint32, FString> ActorNames;
+		TSet<uint32> DoorIds;
+		FNameTable NameTable;
+
+		//Pool the OWL individuals of the episodes are built in
+		FXmlDocument Pool;
+	};
+
+	//Steals an episode from the other workers, starting with the next one
+	bool Steal(int32 Thief, int32& OutEpisode);
+
+	FString OutputDir;
+	int32 NumThreads;
+	bool bExportOwl;
+
+	//Inputs and outputs of the run, the workers write only the metrics of their own episodes
+	TArray<FString> EpisodeDirs;
+	TArray<FEpisodeMetrics> Metrics;
+
+	TArray<FWorker*> Workers;
+	FThreadSafeCounter NumDone;
+	double Elapsed;
+};
@@ -0,0 +1,397 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "EpisodeMemory.h"
+#include "SemanticMapExporter.h"
+
+void FStateIntervalTree::Build(TArray<FStateInterval>& InIntervals)
+{
+	Intervals = MoveTemp(InIntervals);
+	Intervals.Sort([](const FStateInterval& A, const FStateInterval& B) { return A.Start < B.Start; });
+	MaxEnds.SetNumUninitialized(Intervals.Num());
+	BuildMaxEnds(0, Intervals.Num());
+}
+
+double FStateIntervalTree::BuildMaxEnds(int32 Low, int32 High)
+{
+	if (Low >= High)
+	{
+		return -DBL_MAX;
+	}
+	const int32 Middle = (Low + High) / 2;
+	const double LeftEnd = BuildMaxEnds(Low, Middle);
+	const double RightEnd = BuildMaxEnds(Middle + 1, High);
+	MaxEnds[Middle] = FMath::Max(Intervals[Middle].End, FMath::Max(LeftEnd, RightEnd));
+	return MaxEnds[Middle];
+}
+
+void FStateIntervalTree::FindAt(double Time, TArray<const FStateInterval*>& OutIntervals) const
+{
+	OutIntervals.Reset();
+	FindOverlapping(0, Intervals.Num(), Time, Time, OutIntervals);
+}
+
+void FStateIntervalTree::FindOverlapping(double Start, double End, TArray<const FStateInterval*>& OutIntervals) const
+{
+	OutIntervals.Reset();
+	FindOverlapping(0, Intervals.Num(), Start, End, OutIntervals);
+}
+
+/*A subtree ending before the query is skipped whole, and so is everything right of a node starting after it
+@param int32 Low  -->  First interval of the subtree
+@param int32 High  -->  Interval after the last one of the subtree*/
+void FStateIntervalTree::FindOverlapping(int32 Low, int32 High, double Start, double End, TArray<const FStateInterval*>& OutIntervals) const
+{
+	if (Low >= High)
+	{
+		return;
+	}
+	const int32 Middle = (Low + High) / 2;
+	if (MaxEnds[Middle] < Start)
+	{
+		return;
+	}
+
+	FindOverlapping(Low, Middle, Start, End, OutIntervals);
+	if (Intervals[Middle].Start > End)
+	{
+		return;
+	}
+	if (Intervals[Middle].End >= Start)
+	{
+		OutIntervals.Add(&Intervals[Middle]);
+	}
+	FindOverlapping(Middle + 1, High, Start, End, OutIntervals);
+}
+
+/*Each pick or drop closes the current state of the item and starts the next one; a drop on an openable actor
+which is open at that time puts the item inside it, on any other surface the item rests on top of it.
+The first states come from the start capture: the items rest on or in what FSpatialRelationSearch finds for them,
+and the drawers and doors open in it are open from its time on.
+@param const FEpisodeEventLog& EventLog  -->  Events of the episode
+@param const FEpisodeTrajectoryLog* TrajectoryLog  -->  Trajectories of the episode, null if there are none
+@param const FSemanticMapCapture* Start  -->  Kitchen when the episode started, null if it was not saved*/
+void FEpisodeMemory::Build(const FEpisodeEventLog& EventLog, const FEpisodeTrajectoryLog* TrajectoryLog, const FSemanticMapCapture* Start)
+{
+	ActorTrees.Reset();
+	SupportTrees.Reset();
+	HeldLocations.Reset();
+
+	EndTime = EventLog.Events.Num() ? EventLog.Events.Last().Timestamp : 0.0;
+	if (TrajectoryLog && TrajectoryLog->Samples.Num())
+	{
+		EndTime = FMath::Max(EndTime, TrajectoryLog->Samples.Last().Timestamp);
+	}
+	if (Start)
+	{
+		EndTime = FMath::Max(EndTime, Start->Timestamp);
+	}
+
+	TMap<uint32, TArray<FStateInterval>> ActorIntervals;
+	TMap<uint32, TArray<FStateInterval>> SupportIntervals;
+	auto AddInterval = [&ActorIntervals, &SupportIntervals](const FStateInterval& Interval)
+	{
+		ActorIntervals.FindOrAdd(Interval.ActorId).Add(Interval);
+		if ((Interval.State == EItemState::OnTopOf || Interval.State == EItemState::Inside) && Interval.OtherId)
+		{
+			SupportIntervals.FindOrAdd(Interval.OtherId).Add(Interval);
+		}
+	};
+
+	//State going on for each item, and the time each openable actor was opened at
+	TMap<uint32, FStateInterval> Current;
+	TMap<uint32, double> OpenSince;
+
+	if (Start)
+	{
+		for (const FSemanticMapObject& Object : Start->Objects)
+		{
+			if (!Object.ActorId)
+			{
+				continue;
+			}
+			if (Object.Kind == ESemanticMapObjectKind::Articulated)
+			{
+				if (Object.State == EAssetState::Open)
+				{
+					OpenSince.Add(Object.ActorId, Start->Timestamp);
+				}
+				continue;
+			}
+			if (Object.Kind != ESemanticMapObjectKind::Item)
+			{
+				continue;
+			}
+
+			FSpatialRelationSearch Search(Object);
+			for (const FSemanticMapObject& Other : Start->Objects)
+			{
+				Search.Consider(Other);
+			}
+
+			FStateInterval Interval;
+			Interval.Start = Start->Timestamp;
+			Interval.End = EndTime;
+			Interval.ActorId = Object.ActorId;
+			Interval.Location = Object.Location;
+			if (Search.Container && Search.Container->Kind == ESemanticMapObjectKind::Articulated)
+			{
+				Interval.OtherId = Search.Container->ActorId;
+				Interval.State = EItemState::Inside;
+			}
+			else
+			{
+				Interval.OtherId = Search.Support ? Search.Support->ActorId : 0;
+				Interval.State = EItemState::OnTopOf;
+			}
+			Current.Add(Object.ActorId, Interval);
+		}
+	}
+
+	for (const FSemanticEvent& Event : EventLog.Events)
+	{
+		if (!Event.ActorId)
+		{
+			continue;
+		}
+
+		switch (Event.Kind)
+		{
+		case ESemanticEventKind::Pick:
+		case ESemanticEventKind::Drop:
+		{
+			FStateInterval* Previous = Current.Find(Event.ActorId);
+			if (Previous)
+			{
+				Previous->End = Event.Timestamp;
+				AddInterval(*Previous);
+			}
+
+			FStateInterval Interval;
+			Interval.Start = Event.Timestamp;
+			Interval.End = EndTime;
+			Interval.ActorId = Event.ActorId;
+			Interval.OtherId = 0;
+			Interval.Location = Event.Location;
+			if (Event.Kind == ESemanticEventKind::Pick)
+			{
+				Interval.State = Event.Hand == EEventHand::Both ? EItemState::InBothHands :
+					(Event.Hand == EEventHand::Left ? EItemState::InLeftHand : EItemState::InRightHand);
+			}
+			else
+			{
+				Interval.OtherId = Event.SurfaceId;
+				Interval.State = OpenSince.Contains(Event.SurfaceId) ? EItemState::Inside : EItemState::OnTopOf;
+			}
+			Current.Add(Event.ActorId, Interval);
+			break;
+		}
+
+		case ESemanticEventKind::Open:
+			if (!OpenSince.Contains(Event.ActorId))
+			{
+				OpenSince.Add(Event.ActorId, Event.Timestamp);
+			}
+			break;
+
+		case ESemanticEventKind::Close:
+		{
+			double Since;
+			if (OpenSince.RemoveAndCopyValue(Event.ActorId, Since))
+			{
+				FStateInterval Interval;
+				Interval.Start = Since;
+				Interval.End = Event.Timestamp;
+				Interval.ActorId = Event.ActorId;
+				Interval.OtherId = 0;
+				Interval.State = EItemState::Open;
+				Interval.Location = Event.Location;
+				AddInterval(Interval);
+			}
+			break;
+		}
+
+		default:
+			break;
+		}
+	}
+
+	//What was still going on lasts until the end of the episode
+	for (auto& Ongoing : Current)
+	{
+		AddInterval(Ongoing.Value);
+	}
+	for (const auto& Open : OpenSince)
+	{
+		FStateInterval Interval;
+		Interval.Start = Open.Value;
+		Interval.End = EndTime;
+		Interval.ActorId = Open.Key;
+		Interval.OtherId = 0;
+		Interval.State = EItemState::Open;
+		Interval.Location = FVector::ZeroVector;
+		AddInterval(Interval);
+	}
+
+	for (auto& Intervals : ActorIntervals)
+	{
+		ActorTrees.Add(Intervals.Key).Build(Intervals.Value);
+	}
+	for (auto& Intervals : SupportIntervals)
+	{
+		SupportTrees.Add(Intervals.Key).Build(Intervals.Value);
+	}
+
+	if (TrajectoryLog)
+	{
+		for (const FTrajectorySample& Sample : TrajectoryLog->Samples)
+		{
+			for (int32 Item = 0; Item < Sample.NumItems; Item++)
+			{
+				TArray<FHeldSample>& Samples = HeldLocations.FindOrAdd(Sample.ItemIds[Item]);
+				FHeldSample& Held = Samples[Samples.AddUninitialized()];
+				Held.Timestamp = Sample.Timestamp;
+				Held.Location = Sample.Items[Item].Location;
+			}
+		}
+	}
+}
+
+bool FEpisodeMemory::Load(const FString& EpisodeDir, FEpisodeMemory& OutMemory)
+{
+	FEpisodeEventLog EventLog;
+	if (!FEpisodeReader::ReadEvents(FPaths::Combine(*EpisodeDir, TEXT("Events.bin")), EventLog))
+	{
+		return false;
+	}
+
+	FEpisodeTrajectoryLog TrajectoryLog;
+	const bool bTrajectories = FEpisodeReader::ReadTrajectories(FPaths::Combine(*EpisodeDir, TEXT("Trajectories.bin")), TrajectoryLog);
+	FSemanticMapCapture Start;
+	const bool bStart = FSemanticMapCapture::LoadFromFile(FPaths::Combine(*EpisodeDir, TEXT("SemanticMap_Start.bin")), Start);
+	OutMemory.Build(EventLog, bTrajectories ? &TrajectoryLog : nullptr, bStart ? &Start : nullptr);
+	return true;
+}
+
+/*An item is in a single state at a time, except at the time it changes where the state starting then is given
+@param uint32 ActorId  -->  Id of the actor
+@param double Time  -->  World time of the episode*/
+const FStateInterval* FEpisodeMemory::FindState(uint32 ActorId, double Time) const
+{
+	const FStateIntervalTree* Tree = ActorTrees.Find(ActorId);
+	if (!Tree)
+	{
+		return nullptr;
+	}
+
+	TArray<const FStateInterval*> Found;
+	Tree->FindAt(Time, Found);
+	const FStateInterval* Latest = nullptr;
+	for (const FStateInterval* Interval : Found)
+	{
+		if (!Latest || Interval->Start > Latest->Start)
+		{
+			Latest = Interval;
+		}
+	}
+	return Latest;
+}
+
+bool FEpisodeMemory::FindLocation(uint32 ActorId, double Time, FVector& OutLocation) const
+{
+	const FStateInterval* State = FindState(ActorId, Time);
+	if (!State)
+	{
+		return false;
+	}
+	OutLocation = State->Location;
+
+	//Last sample at or before the time, within the held interval
+	const TArray<FHeldSample>* Samples = State->IsHeld() ? HeldLocations.Find(ActorId) : nullptr;
+	if (Samples)
+	{
+		int32 Low = 0;
+		int32 High = Samples->Num();
+		while (Low < High)
+		{
+			const int32 Middle = (Low + High) / 2;
+			if ((*Samples)[Middle].Timestamp <= Time)
+			{
+				Low = Middle + 1;
+			}
+			else
+			{
+				High = Middle;
+			}
+		}
+		if (Low > 0 && (*Samples)[Low - 1].Timestamp >= State->Start)
+		{
+			OutLocation = (*Samples)[Low - 1].Location;
+		}
+	}
+	return true;
+}
+
+bool FEpisodeMemory::IsOpen(uint32 ActorId, double Time) const
+{
+	const FStateInterval* State = FindState(ActorId, Time);
+	return State && State->State == EItemState::Open;
+}
+
+void FEpisodeMemory::FindSupported(uint32 SurfaceId, double Start, double End, TArray<FStateInterval>& OutIntervals, bool bOnlyInside) const
+{
+	OutIntervals.Reset();
+	FindSupported(SurfaceId, Start, End, OutIntervals, bOnlyInside, 0);
+}
+
+/*@param uint32 SurfaceId  -->  Actor the items rest on or in
+@param double Start  -->  Start of the query, in seconds
+@param double End  -->  End of the query, in seconds
+@param TArray<FStateInterval>& OutIntervals  -->  Resting intervals found, clipped to the query
+@param bool bOnlyInside  -->  Keep only the items placed inside the actor (stacked items are kept at any depth)
+@param int32 Depth  -->  Depth in the stack*/
+void FEpisodeMemory::FindSupported(uint32 SurfaceId, double Start, double End, TArray<FStateInterval>& OutIntervals, bool bOnlyInside, int32 Depth) const
+{
+	const FStateIntervalTree* Tree = SupportTrees.Find(SurfaceId);
+	if (!Tree || Depth >= MaxStackDepth)
+	{
+		return;
+	}
+
+	TArray<const FStateInterval*> Found;
+	Tree->FindOverlapping(Start, End, Found);
+	for (const FStateInterval* Interval : Found)
+	{
+		if (bOnlyInside && Interval->State != EItemState::Inside)
+		{
+			continue;
+		}
+		FStateInterval Clipped = *Interval;
+		Clipped.Start = FMath::Max(Interval->Start, Start);
+		Clipped.End = FMath::Min(Interval->End, End);
+		OutIntervals.Add(Clipped);
+
+		//Whatever rests on this item shares its place for as long as both stay put
+		FindSupported(Interval->ActorId, Clipped.Start, Clipped.End, OutIntervals, false, Depth + 1);
+	}
+}
+
+void FEpisodeMemory::FindInsideWhileOpen(uint32 ContainerId, TArray<FStateInterval>& OutIntervals) const
+{
+	OutIntervals.Reset();
+	const FStateIntervalTree* Tree = ActorTrees.Find(ContainerId);
+	if (!Tree)
+	{
+		return;
+	}
+
+	TArray<const FStateInterval*> States;
+	Tree->FindOverlapping(-DBL_MAX, DBL_MAX, States);
+	for (const FStateInterval* State : States)
+	{
+		if (State->State == EItemState::Open)
+		{
+			FindSupported(ContainerId, State->Start, State->End, OutIntervals, true, 0);
+		}
+	}
+}
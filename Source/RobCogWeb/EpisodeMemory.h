@@ -0,0 +1,136 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "EpisodeReader.h"
+
+struct FSemanticMapCapture;
+
+//What an actor was doing during an interval of the episode
+enum class EItemState : uint8
+{
+	InRightHand,
+	InLeftHand,
+	InBothHands,
+	//Resting on the surface (a table, another item, a closed drawer)
+	OnTopOf,
+	//Placed in an openable actor (drawer, fridge, cupboard) while it was open
+	Inside,
+	//Openable actor open
+	Open
+};
+
+//State of an actor between two events, the other actor is the surface or container when there is one
+struct FStateInterval
+{
+	double Start;
+	double End;
+
+	uint32 ActorId;
+	uint32 OtherId;
+
+	EItemState State;
+
+	//Pose at the start of the interval (where the item was dropped, or picked from)
+	FVector Location;
+
+	bool IsHeld() const
+	{
+		return State == EItemState::InRightHand || State == EItemState::InLeftHand || State == EItemState::InBothHands;
+	}
+};
+
+//Location of a held item, as sampled by the trajectory logger
+struct FHeldSample
+{
+	double Timestamp;
+	FVector Location;
+};
+
+/*Static interval tree: the intervals sorted by start form an implicit balanced tree (the middle of each range is its root),
+each node keeping the latest end of its subtree. Overlap queries take O(log n + k) for k results.
+Intervals are closed, an interval ending at t and the next one starting at t both hold at t.
+*/
+class FStateIntervalTree
+{
+public:
+	//Takes the intervals and builds the tree over them
+	void Build(TArray<FStateInterval>& InIntervals);
+
+	//Intervals holding at the time
+	void FindAt(double Time, TArray<const FStateInterval*>& OutIntervals) const;
+
+	//Intervals overlapping [Start, End]
+	void FindOverlapping(double Start, double End, TArray<const FStateInterval*>& OutIntervals) const;
+
+	int32 Num() const { return Intervals.Num(); }
+
+	//Intervals sorted by start
+	const TArray<FStateInterval>& GetIntervals() const { return Intervals; }
+
+private:
+	//Fills the latest ends of the subtree of [Low, High), returns it
+	double BuildMaxEnds(int32 Low, int32 High);
+
+	void FindOverlapping(int32 Low, int32 High, double Start, double End, TArray<const FStateInterval*>& OutIntervals) const;
+
+	TArray<FStateInterval> Intervals;
+	TArray<double> MaxEnds;
+};
+
+/*Episodic memory of an episode: the state of every actor over time, rebuilt from the event log
+(picks and drops give the hand and support intervals of the items, opens and closes the open intervals of the drawers and doors)
+and from the trajectory log for where the held items were.
+Every actor has its own tree of states, and every surface or container the tree of the items resting on or in it, so that
+"where was the cup at time t" and "which items were in the fridge while it was open" are answered in O(log n) per tree.
+Before its first event an item is where the start capture of the episode has it (SemanticMap_Start.bin), resting on or in
+what the semantic map relates it to; without the capture the items are only known from their first event on.
+*/
+class FEpisodeMemory
+{
+public:
+	//Builds the trees of the logs, the trajectories and the start state are optional
+	void Build(const FEpisodeEventLog& EventLog, const FEpisodeTrajectoryLog* TrajectoryLog = nullptr, const FSemanticMapCapture* Start = nullptr);
+
+	//Reads the logs and the start capture of an episode folder and builds the trees, returns false if the event log is missing or unreadable
+	static bool Load(const FString& EpisodeDir, FEpisodeMemory& OutMemory);
+
+	//State of the actor at the time, null if it had no event yet and was not in the start capture
+	const FStateInterval* FindState(uint32 ActorId, double Time) const;
+
+	//Where the item was at the time: the hand pose sampled closest before it while held, the drop location otherwise
+	bool FindLocation(uint32 ActorId, double Time, FVector& OutLocation) const;
+
+	//True if the drawer or door was open at the time
+	bool IsOpen(uint32 ActorId, double Time) const;
+
+	/*Items resting on or in the actor during [Start, End], clipped to the time they spent there.
+	Stacked items are followed: an item on a plate which is in the drawer is reported too, for the time both held.*/
+	void FindSupported(uint32 SurfaceId, double Start, double End, TArray<FStateInterval>& OutIntervals, bool bOnlyInside = false) const;
+
+	//Items inside the container while it was open, once per open interval
+	void FindInsideWhileOpen(uint32 ContainerId, TArray<FStateInterval>& OutIntervals) const;
+
+	//States of every actor, by actor id
+	const TMap<uint32, FStateIntervalTree>& GetActorTrees() const { return ActorTrees; }
+
+	//Time of the last event or sample, at which the intervals still going on end
+	double GetEndTime() const { return EndTime; }
+
+	//Stacks deeper than this are not followed
+	static const int32 MaxStackDepth = 8;
+
+private:
+	void FindSupported(uint32 SurfaceId, double Start, double End, TArray<FStateInterval>& OutIntervals, bool bOnlyInside, int32 Depth) const;
+
+	//States of each actor
+	TMap<uint32, FStateIntervalTree> ActorTrees;
+
+	//Resting states of the items, by the actor they rest on or in
+	TMap<uint32, FStateIntervalTree> SupportTrees;
+
+	//Sampled locations of each item while held, in time order
+	TMap<uint32, TArray<FHeldSample>> HeldLocations;
+
+	double EndTime;
+};
@@ -0,0 +1,412 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "EpisodeReader.h"
+#include "SegmentedFileWriter.h"
+#include "LogEncoding.h"
+#include "SegmentedFileReader.h"
+
+const float FEpisodeReader::JournalIdleTime = 60.f;
+
+//Claims are named after the process which made them, ".<pid>.claim" after the name of the journal
+static const TCHAR* ClaimExtension = TEXT(".claim");
+
+static bool IsOwnerRunning(const FString& EpisodeDir, bool& bOutHasOwner)
+{
+	FString Owner;
+	bOutHasOwner = FFileHelper::LoadFileToString(Owner, *FEpisodeReader::GetOwnerPath(EpisodeDir));
+	return bOutHasOwner && FPlatformProcess::IsApplicationRunning((uint32)FCString::Atoi64(*Owner));
+}
+
+FString FEpisodeReader::GetOwnerPath(const FString& EpisodeDir)
+{
+	return FPaths::Combine(*EpisodeDir, TEXT("Owner.pid"));
+}
+
+void FEpisodeReader::RecoverCrashedEpisodes(const FString& RootDir, TArray<FString>& OutEpisodeDirs)
+{
+	//A process which died while recovering leaves its claims behind, they are given back
+	TArray<FString> Claims;
+	IFileManager::Get().FindFilesRecursive(Claims, *RootDir, *(FString(TEXT("*")) + ClaimExtension), true, false);
+	for (const FString& Claim : Claims)
+	{
+		//<journal>.<pid>.claim
+		const FString ClaimedPid = FPaths::GetBaseFilename(Claim, false);
+		const FString Journal = FPaths::GetBaseFilename(ClaimedPid, false);
+		if (Journal.EndsWith(TEXT(".journal")) && !FPlatformProcess::IsApplicationRunning((uint32)FCString::Atoi64(*FPaths::GetExtension(ClaimedPid))))
+		{
+			IFileManager::Get().Move(*Journal, *Claim, false, false, false, true);
+		}
+	}
+
+	TArray<FString> Journals;
+	IFileManager::Get().FindFilesRecursive(Journals, *RootDir, TEXT("*.journal"), true, false);
+	Journals.Sort();
+
+	const FString ClaimSuffix = FString::Printf(TEXT(".%u"), FPlatformProcess::GetCurrentProcessId()) + ClaimExtension;
+	const FDateTime Now = FDateTime::UtcNow();
+	for (const FString& Journal : Journals)
+	{
+		const FString EpisodeDir = FPaths::GetPath(Journal);
+		bool bHasOwner = false;
+		if (IsOwnerRunning(EpisodeDir, bHasOwner))
+		{
+			continue;
+		}
+		if (!bHasOwner && (Now - IFileManager::Get().GetTimeStamp(*Journal)).GetTotalSeconds() < JournalIdleTime)
+		{
+			continue;
+		}
+
+		//The rename is atomic, only one process gets the journal; the others no longer find it
+		const FString Claim = Journal + ClaimSuffix;
+		if (!IFileManager::Get().Move(*Claim, *Journal, false, false, false, true))
+		{
+			continue;
+		}
+
+		const int32 NumRecords = FSegmentedFileWriter::RecoverJournal(FPaths::Combine(*EpisodeDir, *FPaths::GetBaseFilename(Journal)), Claim);
+		if (NumRecords < 0)
+		{
+			IFileManager::Get().Move(*Journal, *Claim, false, false, false, true);
+			UE_LOG(LogRobCogWeb, Warning, TEXT("Could not recover %s, it is tried again at the next start"), *Journal);
+			continue;
+		}
+		if (!OutEpisodeDirs.Contains(EpisodeDir))
+		{
+			OutEpisodeDirs.Add(EpisodeDir);
+			UE_LOG(LogRobCogWeb, Log, TEXT("Recovered the crashed episode %s"), *FPaths::GetCleanFilename(EpisodeDir));
+		}
+	}
+}
+
+/*Mirror of FSemanticEventLogger::Drain()
+@param const FString& FilePath  -->  Base path of the log, without the segment number
+@param FEpisodeEventLog& OutLog  -->  Log to fill*/
+bool FEpisodeReader::ReadEvents(const FString& FilePath, FEpisodeEventLog& OutLog)
+{
+	TArray<uint8> Stream;
+	if (!FSegmentedFileWriter::ReadStream(FilePath, Stream))
+	{
+		return false;
+	}
+
+	FMemoryReader Reader(Stream);
+	uint32 FileMagic;
+	uint16 FileVersion;
+	Reader << FileMagic;
+	Reader << FileVersion;
+	if (FileMagic != FSemanticEventLogger::Magic || FileVersion != FSemanticEventLogger::Version)
+	{
+		UE_LOG(LogRobCogWeb, Warning, TEXT("%s is not a log of version %d (version %d)"), *FilePath, FSemanticEventLogger::Version, FileVersion);
+		return false;
+	}
+	Reader << OutLog.LevelName;
+	Reader << OutLog.LayoutSeed;
+
+	TMap<uint32, FIntVector> LastLocations;
+	auto PreviousLocation = [&LastLocations](uint32 ActorId) -> FIntVector& { return LastLocations.FindOrAdd(ActorId); };
+	double PreviousTimestamp = 0.0;
+	OutLog.Events.Reset();
+	while (!Reader.AtEnd() && !Reader.IsError())
+	{
+		if (!DecodeEvent(Reader, PreviousTimestamp, PreviousLocation, OutLog.Events[OutLog.Events.AddZeroed()]))
+		{
+			return false;
+		}
+	}
+	return !Reader.IsError();
+}
+
+bool FEpisodeReader::DecodeEvent(FArchive& Reader, double& PreviousTimestamp, TFunctionRef<FIntVector&(uint32)> PreviousLocation, FSemanticEvent& OutEvent)
+{
+	uint8 Tag;
+	Reader << Tag;
+	if (Tag != FSemanticEventLogger::EventTag)
+	{
+		return false;
+	}
+
+	uint8 KindAndHand;
+	OutEvent.Timestamp = LogEncoding::ReadTimeDelta(Reader, PreviousTimestamp);
+	Reader << KindAndHand;
+	OutEvent.Kind = (ESemanticEventKind)(KindAndHand & 0x0F);
+	OutEvent.Hand = (EEventHand)(KindAndHand >> 4);
+	OutEvent.ActorId = (uint32)LogEncoding::ReadVarint(Reader);
+	OutEvent.SurfaceId = (uint32)LogEncoding::ReadVarint(Reader);
+	OutEvent.Location = FVector::ZeroVector;
+	OutEvent.Rotation = FQuat::Identity;
+	if (OutEvent.ActorId)
+	{
+		OutEvent.Location = LogEncoding::DequantizeLocation(LogEncoding::ReadLocationDelta(Reader, PreviousLocation(OutEvent.ActorId)));
+		OutEvent.Rotation = LogEncoding::ReadQuat(Reader);
+	}
+	return !Reader.IsError();
+}
+
+/*The rebuild decodes the whole log once, like ReadEvents(), and saves the index for the next queries
+@param const FString& FilePath  -->  Base path of the event log, without the segment number
+@param FEventLogIndex& OutIndex  -->  Index to fill*/
+bool FEpisodeReader::ReadEventIndex(const FString& FilePath, FEventLogIndex& OutIndex)
+{
+	const FString IndexPath = FPaths::ChangeExtension(FilePath, TEXT("idx"));
+	if (OutIndex.Load(IndexPath))
+	{
+		return true;
+	}
+
+	FSegmentedFileReader Reader(FilePath);
+	if (!Reader.Open())
+	{
+		return false;
+	}
+
+	uint32 FileMagic;
+	uint16 FileVersion;
+	FString LevelName;
+	int32 LayoutSeed;
+	Reader << FileMagic;
+	Reader << FileVersion;
+	if (FileMagic != FSemanticEventLogger::Magic || FileVersion != FSemanticEventLogger::Version)
+	{
+		UE_LOG(LogRobCogWeb, Warning, TEXT("%s is not a log of version %d (version %d)"), *FilePath, FSemanticEventLogger::Version, FileVersion);
+		return false;
+	}
+	Reader << LevelName;
+	Reader << LayoutSeed;
+
+	OutIndex = FEventLogIndex(OutIndex.GetKeyframeInterval());
+	TMap<uint32, FIntVector> LastLocations;
+	FIntVector Previous = FIntVector::ZeroValue;
+	auto PreviousLocation = [&LastLocations, &Previous](uint32 ActorId) -> FIntVector&
+	{
+		FIntVector& Location = LastLocations.FindOrAdd(ActorId);
+		Previous = Location;
+		return Location;
+	};
+	double PreviousTimestamp = 0.0;
+	FSemanticEvent Event;
+	while (Reader.Tell() < Reader.TotalSize() && !Reader.IsError())
+	{
+		const int64 Offset = Reader.Tell();
+		Previous = FIntVector::ZeroValue;
+		if (!DecodeEvent(Reader, PreviousTimestamp, PreviousLocation, Event))
+		{
+			return false;
+		}
+		OutIndex.Add(Offset, (int64)FMath::RoundToDouble(PreviousTimestamp * 1000.0), Event, Previous);
+	}
+
+	OutIndex.Save(IndexPath);
+	return true;
+}
+
+/*Each record is decoded on its own from the state kept in its index entry
+@param FSegmentedFileReader& Log  -->  Opened event log
+@param const FEventLogIndex& Index  -->  Index of the log
+@param const TArray<int32>& Records  -->  Records to decode, as returned by the queries of the index
+@param TArray<FSemanticEvent>& OutEvents  -->  Events of the records, in the same order*/
+bool FEpisodeReader::ReadEvents(FSegmentedFileReader& Log, const FEventLogIndex& Index, const TArray<int32>& Records, TArray<FSemanticEvent>& OutEvents)
+{
+	OutEvents.Reset(Records.Num());
+	for (int32 Record : Records)
+	{
+		const FEventIndexEntry& Entry = Index.GetEntry(Record);
+		FIntVector PreviousLocation = Entry.PreviousLocation;
+		double PreviousTimestamp = Record ? Index.GetEntry(Record - 1).TimeMs / 1000.0 : 0.0;
+
+		Log.Seek(Entry.Offset);
+		if (!DecodeEvent(Log, PreviousTimestamp, [&PreviousLocation](uint32) -> FIntVector& { return PreviousLocation; }, OutEvents[OutEvents.AddZeroed()]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/*Mirror of FTrajectoryLogger::EncodeChunk()
+@param const FString& FilePath  -->  Base path of the log, without the segment number
+@param FEpisodeTrajectoryLog& OutLog  -->  Log to fill*/
+bool FEpisodeReader::ReadTrajectories(const FString& FilePath, FEpisodeTrajectoryLog& OutLog)
+{
+	TArray<uint8> Stream;
+	if (!FSegmentedFileWriter::ReadStream(FilePath, Stream))
+	{
+		return false;
+	}
+
+	FMemoryReader Reader(Stream);
+	uint32 FileMagic;
+	uint16 FileVersion;
+	float PositionUnit;
+	Reader << FileMagic;
+	Reader << FileVersion;
+	if (FileMagic != FTrajectoryLogger::Magic || FileVersion != FTrajectoryLogger::Version)
+	{
+		UE_LOG(LogRobCogWeb, Warning, TEXT("%s is not a log of version %d (version %d)"), *FilePath, FTrajectoryLogger::Version, FileVersion);
+		return false;
+	}
+	Reader << OutLog.LevelName;
+	Reader << OutLog.SampleInterval;
+	Reader << PositionUnit;
+
+	const int32 MaxSlots = FTrajectorySample::NumBodies + FTrajectorySample::MaxItems;
+	OutLog.Samples.Reset();
+	while (!Reader.AtEnd() && !Reader.IsError())
+	{
+		uint8 Tag;
+		uint16 NumSamples;
+		double PreviousTime;
+		Reader << Tag;
+		if (Tag != FTrajectoryLogger::ChunkTag)
+		{
+			return false;
+		}
+		Reader << NumSamples;
+		Reader << PreviousTime;
+
+		FIntVector Previous[MaxSlots];
+		uint32 PreviousIds[MaxSlots];
+		FMemory::Memzero(Previous);
+		FMemory::Memzero(PreviousIds);
+
+		for (int32 SampleIndex = 0; SampleIndex < NumSamples && !Reader.IsError(); SampleIndex++)
+		{
+			FTrajectorySample& Sample = OutLog.Samples[OutLog.Samples.AddUninitialized()];
+			uint8 ItemCount;
+			Sample.Timestamp = LogEncoding::ReadTimeDelta(Reader, PreviousTime);
+			Reader << ItemCount;
+			Sample.NumItems = FMath::Min((int32)ItemCount, (int32)FTrajectorySample::MaxItems);
+			for (int32 Item = 0; Item < Sample.NumItems; Item++)
+			{
+				Sample.ItemIds[Item] = (uint32)LogEncoding::ReadVarint(Reader);
+			}
+
+			for (int32 Slot = 0; Slot < FTrajectorySample::NumBodies + Sample.NumItems; Slot++)
+			{
+				const uint32 Id = Slot < FTrajectorySample::NumBodies ? 0 : Sample.ItemIds[Slot - FTrajectorySample::NumBodies];
+				if (Id != PreviousIds[Slot])
+				{
+					Previous[Slot] = FIntVector::ZeroValue;
+					PreviousIds[Slot] = Id;
+				}
+				FTrajectoryPose& Pose = Slot < FTrajectorySample::NumBodies ? Sample.Bodies[Slot] : Sample.Items[Slot - FTrajectorySample::NumBodies];
+				Pose.Location = FVector(LogEncoding::ReadLocationDelta(Reader, Previous[Slot])) * PositionUnit;
+				Pose.Rotation = LogEncoding::ReadQuat(Reader);
+			}
+		}
+	}
+	return !Reader.IsError();
+}
+
+/*Mirror of FInputRecorder::EncodeChunk()
+@param const FString& FilePath  -->  Base path of the log, without the segment number
+@param FEpisodeInputLog& OutLog  -->  Log to fill*/
+bool FEpisodeReader::ReadInputs(const FString& FilePath, FEpisodeInputLog& OutLog)
+{
+	TArray<uint8> Stream;
+	if (!FSegmentedFileWriter::ReadStream(FilePath, Stream))
+	{
+		return false;
+	}
+
+	FMemoryReader Reader(Stream);
+	uint32 FileMagic;
+	uint16 FileVersion;
+	uint8 NumAxes;
+	uint8 NumActions;
+	Reader << FileMagic;
+	Reader << FileVersion;
+	if (FileMagic != FInputRecorder::Magic || FileVersion != FInputRecorder::Version)
+	{
+		UE_LOG(LogRobCogWeb, Warning, TEXT("%s is not a log of version %d (version %d)"), *FilePath, FInputRecorder::Version, FileVersion);
+		return false;
+	}
+	Reader << OutLog.LevelName;
+	Reader << NumAxes;
+	Reader << NumActions;
+	if (NumAxes != FInputFrame::NumAxes || NumActions != (uint8)EInputAction::Num)
+	{
+		return false;
+	}
+
+	OutLog.Frames.Reset();
+	TArray<uint8> PackedActions;
+	while (!Reader.AtEnd() && !Reader.IsError())
+	{
+		uint8 Tag;
+		uint16 NumFrames;
+		double BaseTime;
+		uint8 bContiguous;
+		Reader << Tag;
+		if (Tag != FInputRecorder::ChunkTag)
+		{
+			return false;
+		}
+		Reader << NumFrames;
+		const uint64 FirstFrame = LogEncoding::ReadVarint(Reader);
+		Reader << BaseTime;
+		Reader << bContiguous;
+		if (!NumFrames)
+		{
+			return false;
+		}
+
+		const int32 First = OutLog.Frames.AddZeroed(NumFrames);
+		FInputFrame* Frames = &OutLog.Frames[First];
+		Frames[0].FrameNumber = FirstFrame;
+		for (int32 i = 1; i < NumFrames; i++)
+		{
+			Frames[i].FrameNumber = Frames[i - 1].FrameNumber + 1 + (bContiguous ? 0 : LogEncoding::ReadVarint(Reader));
+		}
+
+		int64 Microseconds = 0;
+		for (int32 i = 0; i < NumFrames; i++)
+		{
+			Microseconds += LogEncoding::ReadSignedVarint(Reader);
+			Frames[i].DeltaTime = Microseconds / 1000000.f;
+			Frames[i].Timestamp = i ? Frames[i - 1].Timestamp + Frames[i].DeltaTime : BaseTime;
+		}
+
+		for (int32 Axis = 0; Axis < FInputFrame::NumAxes; Axis++)
+		{
+			int32 Frame = 0;
+			while (Frame < NumFrames && !Reader.IsError())
+			{
+				const int32 RunLength = (int32)LogEncoding::ReadVarint(Reader);
+				float Value;
+				Reader << Value;
+				if (RunLength <= 0 || Frame + RunLength > NumFrames)
+				{
+					return false;
+				}
+				for (int32 i = 0; i < RunLength; i++)
+				{
+					Frames[Frame++].Axes[Axis] = Value;
+				}
+			}
+		}
+
+		PackedActions.SetNumUninitialized((int32)LogEncoding::ReadVarint(Reader));
+		Reader.Serialize(PackedActions.GetData(), PackedActions.Num());
+		int32 Bit = 0;
+		auto ReadBit = [&PackedActions, &Bit]()
+		{
+			const int32 Byte = Bit >> 3;
+			const uint8 Value = Byte < PackedActions.Num() ? (PackedActions[Byte] >> (Bit & 7)) & 1 : 0;
+			Bit++;
+			return Value;
+		};
+		for (int32 i = 0; i < NumFrames; i++)
+		{
+			if (ReadBit())
+			{
+				for (int32 Action = 0; Action < NumActions; Action++)
+				{
+					Frames[i].Actions |= ReadBit() << Action;
+				}
+			}
+		}
+	}
+	return !Reader.IsError();
+}
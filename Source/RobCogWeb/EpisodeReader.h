@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "SemanticEventLogger.h"
+#include "TrajectoryLogger.h"
+#include "InputRecorder.h"
+#include "EventLogIndex.h"
+
+class FSegmentedFileReader;
+
+//Content of an event log (Events.bin)
+struct FEpisodeEventLog
+{
+	FString LevelName;
+	int32 LayoutSeed;
+	TArray<FSemanticEvent> Events;
+};
+
+//Content of a trajectory log (Trajectories.bin)
+struct FEpisodeTrajectoryLog
+{
+	FString LevelName;
+	float SampleInterval;
+	TArray<FTrajectorySample> Samples;
+};
+
+//Content of an input log (Inputs.bin)
+struct FEpisodeInputLog
+{
+	FString LevelName;
+	TArray<FInputFrame> Frames;
+};
+
+/*Decodes the logs written during an episode back into the records the game thread produced.
+Positions come back quantized (0.1 mm) and timestamps rounded to the millisecond, as they were written;
+the frame durations of the input come back to the microsecond.
+*/
+class FEpisodeReader
+{
+public:
+	//Reads the segments of the event log, returns false if the log is missing, corrupted or of another version
+	static bool ReadEvents(const FString& FilePath, FEpisodeEventLog& OutLog);
+
+	//Reads the segments of the trajectory log, returns false if the log is missing, corrupted or of another version
+	static bool ReadTrajectories(const FString& FilePath, FEpisodeTrajectoryLog& OutLog);
+
+	//Reads the segments of the input log, returns false if the log is missing, corrupted or of another version
+	static bool ReadInputs(const FString& FilePath, FEpisodeInputLog& OutLog);
+
+	//Loads the index written next to an event log, or rebuilds it by scanning the log if there is none (eg: after a crash)
+	static bool ReadEventIndex(const FString& FilePath, FEventLogIndex& OutIndex);
+
+	//Decodes the records of an event log found by a query on its index, seeking to each of them
+	static bool ReadEvents(FSegmentedFileReader& Log, const FEventLogIndex& Index, const TArray<int32>& Records, TArray<FSemanticEvent>& OutEvents);
+
+	/*Rebuilds the last segments of the episodes cut short by a crash from the journals of their logs (see FSegmentedFileWriter::RecoverJournal),
+	so that they can be read, replayed and processed like the others. Called in the background once a game process has started.
+	Episodes whose owner file names a running process are still recording and left alone; without an owner file, the journals
+	written to in the last JournalIdleTime seconds are. Each journal is claimed by renaming it before it is read, so that
+	several processes recovering the same folder never recover it twice. Returns the episode folders recovered.*/
+	static void RecoverCrashedEpisodes(const FString& RootDir, TArray<FString>& OutEpisodeDirs);
+
+	//Path of the file naming the process which records an episode, written when the episode starts and deleted when it ends
+	static FString GetOwnerPath(const FString& EpisodeDir);
+
+	static const float JournalIdleTime;
+
+private:
+	//Decodes the event record at the position of the reader, PreviousLocation gives the last location of an actor id
+	static bool DecodeEvent(FArchive& Reader, double& PreviousTimestamp, TFunctionRef<FIntVector&(uint32)> PreviousLocation, FSemanticEvent& OutEvent);
+};
@@ -0,0 +1,434 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "EpisodeReplayer.h"
+#include "MyCharacter.h"
+
+const double FEpisodeReplayer::TimeTolerance = 0.0005;
+const TCHAR* FEpisodeReplayer::SnapshotFilename = TEXT("Snapshot.bin");
+
+//Labels of the event kinds, in the order of ESemanticEventKind
+static const TCHAR* EventKindNames[] = { TEXT("Pick"), TEXT("Drop"), TEXT("Open"), TEXT("Close"), TEXT("Finish"), TEXT("Resume"), TEXT("Exit") };
+
+FEpisodeReplayer::FEpisodeReplayer(AMyCharacter* InCharacter)
+	: ReplayedEvents(0)
+	, Divergences(0)
+	, Character(InCharacter)
+	, bResumed(false)
+	, NextEvent(0)
+	, NextSample(0)
+	, NextFrame(0)
+	, bStarted(false)
+	, LastTime(0.0)
+	, StartTime(-1.0)
+{
+	DropTolerance = 1.f;
+}
+
+bool FEpisodeReplayer::Load(const FString& EpisodeDir)
+{
+	if (!FEpisodeReader::ReadEvents(FPaths::Combine(*EpisodeDir, TEXT("Events.bin")), EventLog))
+	{
+		UE_LOG(LogRobCogWeb, Error, TEXT("Could not read the events of the episode %s"), *EpisodeDir);
+		return false;
+	}
+
+	//The progress restored with the snapshot was logged before anything else, the game mode restores it again
+	bResumed = FKitchenSnapshot::LoadFromFile(FPaths::Combine(*EpisodeDir, SnapshotFilename), Snapshot);
+	if (bResumed && Snapshot.Progress != ELevelProgress::Playing && EventLog.Events.Num() &&
+		(EventLog.Events[0].Kind == ESemanticEventKind::Finish || EventLog.Events[0].Kind == ESemanticEventKind::Exit))
+	{
+		NextEvent = 1;
+	}
+
+	//The raw input replays the session exactly, the trajectories only approach it
+	if (FEpisodeReader::ReadInputs(FPaths::Combine(*EpisodeDir, TEXT("Inputs.bin")), InputLog) && InputLog.Frames.Num())
+	{
+		const FInputFrame& Last = InputLog.Frames.Last();
+		const uint64 DroppedFrames = Last.FrameNumber - InputLog.Frames[0].FrameNumber + 1 - InputLog.Frames.Num();
+		if (DroppedFrames)
+		{
+			UE_LOG(LogRobCogWeb, Warning, TEXT("%llu frames of %s were not recorded, the replay may diverge after the first gap"), DroppedFrames, *EpisodeDir);
+		}
+		UE_LOG(LogRobCogWeb, Log, TEXT("Replaying %s from its input: %d events and %d frames over %.1f s"),
+			*EpisodeDir, EventLog.Events.Num(), InputLog.Frames.Num(), Last.Timestamp);
+		return true;
+	}
+	InputLog.Frames.Reset();
+
+	//Without the camera poses there is nothing to aim the clicks with
+	if (!FEpisodeReader::ReadTrajectories(FPaths::Combine(*EpisodeDir, TEXT("Trajectories.bin")), TrajectoryLog) || !TrajectoryLog.Samples.Num())
+	{
+		UE_LOG(LogRobCogWeb, Error, TEXT("Could not read the trajectories of the episode %s"), *EpisodeDir);
+		return false;
+	}
+	if (TrajectoryLog.SampleInterval > 0.f)
+	{
+		UE_LOG(LogRobCogWeb, Warning, TEXT("The trajectories of %s were sampled every %.3f s, events may be replayed from a slightly older pose"),
+			*EpisodeDir, TrajectoryLog.SampleInterval);
+	}
+
+	UE_LOG(LogRobCogWeb, Log, TEXT("Replaying %s: %d events and %d samples over %.1f s"),
+		*EpisodeDir, EventLog.Events.Num(), TrajectoryLog.Samples.Num(), TrajectoryLog.Samples.Last().Timestamp);
+	return true;
+}
+
+void FEpisodeReplayer::Start()
+{
+	bStarted = true;
+	StartTime = FPlatformTime::Seconds();
+
+	//The duration of a frame is decided when it starts, one frame ahead of its input
+	if (IsInputReplay())
+	{
+		FApp::SetFixedDeltaTime(InputLog.Frames[0].DeltaTime);
+	}
+}
+
+/*The input of a frame is handled before the character ticks, so the player clicked on what was focused
+at the end of the previous frame: each event is replayed from the last sample recorded before it.
+With the raw input this holds by itself, the frame is fed before the controller and the character tick.
+@param double Time  -->  World time reached by the replay*/
+void FEpisodeReplayer::Step(double Time)
+{
+	if (!bStarted)
+	{
+		return;
+	}
+
+	if (IsInputReplay())
+	{
+		if (NextFrame >= InputLog.Frames.Num())
+		{
+			return;
+		}
+		const FInputFrame& Frame = InputLog.Frames[NextFrame++];
+		ApplyInput(Frame);
+		LastTime = Frame.Timestamp;
+
+		//The events of the frame were logged by the handlers it triggered, against the recorded clock
+		while (NextEvent < EventLog.Events.Num() && EventLog.Events[NextEvent].Timestamp <= Frame.Timestamp + TimeTolerance)
+		{
+			const int32 End = GroupEnd(NextEvent);
+			ReplayedEvents += End - NextEvent;
+			Check(NextEvent, End);
+			NextEvent = End;
+		}
+
+		if (NextFrame < InputLog.Frames.Num())
+		{
+			FApp::SetFixedDeltaTime(InputLog.Frames[NextFrame].DeltaTime);
+		}
+		return;
+	}
+
+	LastTime = Time;
+
+	while (NextEvent < EventLog.Events.Num() && EventLog.Events[NextEvent].Timestamp <= Time + TimeTolerance)
+	{
+		const FTrajectorySample* Before = FindSample(EventLog.Events[NextEvent].Timestamp, false);
+		if (Before)
+		{
+			ApplySample(*Before);
+		}
+		Character->UpdateFocus();
+		NextEvent = Dispatch(NextEvent);
+	}
+
+	const FTrajectorySample* Current = FindSample(Time, true);
+	if (Current)
+	{
+		ApplySample(*Current);
+	}
+}
+
+bool FEpisodeReplayer::IsFinished() const
+{
+	if (IsInputReplay())
+	{
+		return NextFrame >= InputLog.Frames.Num();
+	}
+	return NextEvent >= EventLog.Events.Num() && (!TrajectoryLog.Samples.Num() || LastTime >= TrajectoryLog.Samples.Last().Timestamp);
+}
+
+void FEpisodeReplayer::Report() const
+{
+	const double WallTime = StartTime < 0.0 ? 0.0 : FPlatformTime::Seconds() - StartTime;
+	UE_LOG(LogRobCogWeb, Log, TEXT("Replay: %.1f s of play replayed in %.1f s (%.1fx real time), %d events, %d diverged"),
+		LastTime, WallTime, WallTime > 0.0 ? LastTime / WallTime : 0.0, ReplayedEvents, Divergences);
+}
+
+/*Actions are dispatched before the axes, as the player input does; two actions pressed during the same frame
+are replayed in the order they are bound in, which may differ from the order they were pressed in.
+@param const FInputFrame& Frame  -->  Frame to feed*/
+void FEpisodeReplayer::ApplyInput(const FInputFrame& Frame)
+{
+	//Indexed by EInputAction
+	static void (AMyCharacter::* const ActionHandlers[])() =
+	{
+		&AMyCharacter::Click,
+		&AMyCharacter::SwitchSelectedHand,
+		&AMyCharacter::SwitchRotationAxis,
+		&AMyCharacter::GrabWithTwoHands,
+		&AMyCharacter::Pause,
+		&AMyCharacter::Submit,
+		&AMyCharacter::ReturnToPlay
+	};
+	static_assert(ARRAY_COUNT(ActionHandlers) == (int32)EInputAction::Num, "One handler per recorded action");
+
+	for (int32 Action = 0; Action < (int32)EInputAction::Num; Action++)
+	{
+		if (Frame.Actions & (1 << Action))
+		{
+			(Character->*ActionHandlers[Action])();
+		}
+	}
+
+	const float* Axes = Frame.Axes;
+	Character->AddControllerPitchInput(Axes[(int32)EInputAxis::LookUp]);
+	Character->AddControllerYawInput(Axes[(int32)EInputAxis::Turn]);
+	Character->MoveForward(Axes[(int32)EInputAxis::MoveForward]);
+	Character->MoveRight(Axes[(int32)EInputAxis::MoveRight]);
+	Character->RotateObject(Axes[(int32)EInputAxis::RotateObject]);
+	Character->MoveItemZ(Axes[(int32)EInputAxis::MoveItemZ]);
+	Character->MoveItemY(Axes[(int32)EInputAxis::MoveItemY]);
+}
+
+const FTrajectorySample* FEpisodeReplayer::FindSample(double Time, bool bInclusive)
+{
+	const TArray<FTrajectorySample>& Samples = TrajectoryLog.Samples;
+	while (NextSample < Samples.Num() && Samples[NextSample].Timestamp <= Time + TimeTolerance)
+	{
+		NextSample++;
+	}
+
+	//The sample written in the same frame as an event comes after the input of that frame
+	int32 Index = NextSample - 1;
+	while (!bInclusive && Index >= 0 && Samples[Index].Timestamp >= Time - TimeTolerance)
+	{
+		Index--;
+	}
+	return Index >= 0 ? &Samples[Index] : nullptr;
+}
+
+void FEpisodeReplayer::ApplySample(const FTrajectorySample& Sample)
+{
+	const FTrajectoryPose& Camera = Sample.Bodies[FTrajectorySample::Camera];
+	const FRotator View = Camera.Rotation.Rotator();
+
+	//The camera sits at a fixed offset above the capsule and follows the control rotation
+	const FVector CameraOffset = Character->MyCharacterCamera->GetComponentLocation() - Character->GetActorLocation();
+	Character->SetActorLocationAndRotation(Camera.Location - CameraOffset, FRotator(0.f, View.Yaw, 0.f), false, nullptr, ETeleportType::TeleportPhysics);
+	if (Character->Controller)
+	{
+		Character->Controller->SetControlRotation(View);
+	}
+	Character->MyCharacterCamera->SetWorldRotation(Camera.Rotation);
+
+	ApplyHand(true, Sample.Bodies[FTrajectorySample::RightHand]);
+	ApplyHand(false, Sample.Bodies[FTrajectorySample::LeftHand]);
+}
+
+/*Inverse of AMyCharacter::GetHandLocation(): the offsets are recovered from the hand pose and reached with the
+handlers bound to the arrow keys and the mouse wheel, on the hand they belong to.
+@param bool bRightHand  -->  Hand to adjust
+@param const FTrajectoryPose& Pose  -->  Recorded pose of the hand*/
+void FEpisodeReplayer::ApplyHand(bool bRightHand, const FTrajectoryPose& Pose)
+{
+	AActor* Item = bRightHand ? Character->RightHandSlot : Character->LeftHandSlot;
+	if (!Item || Character->TwoHandSlot.Num())
+	{
+		return;
+	}
+
+	//The handlers move the items by 0.35 cm and turn them by 10 degrees per unit of input
+	const float MoveStep = 0.35f;
+	const float RotateStep = 10.f;
+	const float PositionEpsilon = 0.01f;
+	const float RotationEpsilon = 0.05f;
+
+	const FVector Offset = Pose.Location - Character->GetActorLocation() - 20.f * Character->GetActorForwardVector();
+	const float Side = Offset | Character->GetActorRightVector();
+	const float ZDelta = Offset.Z - (bRightHand ? Character->RightZPos : Character->LeftZPos);
+	const float YDelta = bRightHand ? Side - Character->RightYPos : -Side - Character->LeftYPos;
+	const FRotator Target = Pose.Rotation.Rotator() - FRotator(0.f, Character->GetActorRotation().Yaw, 0.f);
+	const FRotator RotationDelta = (Target - (bRightHand ? Character->RightHandRotator : Character->LeftHandRotator)).GetNormalized();
+
+	if (FMath::Abs(ZDelta) < PositionEpsilon && FMath::Abs(YDelta) < PositionEpsilon && RotationDelta.IsNearlyZero(RotationEpsilon))
+	{
+		return;
+	}
+
+	const bool bSwitch = bRightHand != Character->bRightHandSelected;
+	const int32 RotationAxisIndex = Character->RotationAxisIndex;
+	if (bSwitch)
+	{
+		Character->SwitchSelectedHand();
+	}
+
+	if (FMath::Abs(ZDelta) >= PositionEpsilon)
+	{
+		Character->MoveItemZ(ZDelta / MoveStep);
+	}
+	if (FMath::Abs(YDelta) >= PositionEpsilon)
+	{
+		//The left hand moves the other way for the same input
+		Character->MoveItemY((bRightHand ? YDelta : -YDelta) / MoveStep);
+	}
+
+	//Same axis order as SwitchRotationAxis(): 1 - yaw, 2 - roll, 3 - pitch
+	const float AxisDeltas[] = { RotationDelta.Yaw, RotationDelta.Roll, RotationDelta.Pitch };
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		if (FMath::Abs(AxisDeltas[Axis]) >= RotationEpsilon)
+		{
+			Character->RotationAxisIndex = Axis + 1;
+			Character->RotateObject(AxisDeltas[Axis] / RotateStep);
+		}
+	}
+
+	if (bSwitch)
+	{
+		Character->SwitchSelectedHand();
+	}
+	Character->RotationAxisIndex = RotationAxisIndex;
+}
+
+void FEpisodeReplayer::SelectHand(EEventHand Hand)
+{
+	if ((Hand == EEventHand::Right && !Character->bRightHandSelected) || (Hand == EEventHand::Left && Character->bRightHandSelected))
+	{
+		Character->SwitchSelectedHand();
+	}
+}
+
+void FEpisodeReplayer::Diverge(const FSemanticEvent& Event, const TCHAR* Reason)
+{
+	Divergences++;
+	UE_LOG(LogRobCogWeb, Warning, TEXT("Replay: %s of actor %u at %.3f s diverged, %s"),
+		EventKindNames[(uint8)Event.Kind], Event.ActorId, Event.Timestamp, Reason);
+}
+
+/*Stacks are picked and dropped with a single input, which logged one event per item of the stack
+@param int32 EventIndex  -->  Index of the first event of the group*/
+int32 FEpisodeReplayer::GroupEnd(int32 EventIndex) const
+{
+	const TArray<FSemanticEvent>& Events = EventLog.Events;
+	const FSemanticEvent& Event = Events[EventIndex];
+
+	int32 Next = EventIndex + 1;
+	if (Event.Hand == EEventHand::Both)
+	{
+		while (Next < Events.Num() && Events[Next].Kind == Event.Kind && Events[Next].Hand == EEventHand::Both &&
+			FMath::Abs(Events[Next].Timestamp - Event.Timestamp) <= TimeTolerance)
+		{
+			Next++;
+		}
+	}
+	return Next;
+}
+
+/*Calls the handler which produced the event, then checks its outcome
+@param int32 EventIndex  -->  Index of the event to replay*/
+int32 FEpisodeReplayer::Dispatch(int32 EventIndex)
+{
+	const FSemanticEvent& Event = EventLog.Events[EventIndex];
+	const int32 Next = GroupEnd(EventIndex);
+	ReplayedEvents += Next - EventIndex;
+
+	switch (Event.Kind)
+	{
+	case ESemanticEventKind::Pick:
+		if (Event.Hand == EEventHand::Both)
+		{
+			Character->GrabWithTwoHands();
+		}
+		else
+		{
+			SelectHand(Event.Hand);
+			Character->Click();
+		}
+		break;
+
+	case ESemanticEventKind::Drop:
+		if (Event.Hand != EEventHand::Both)
+		{
+			SelectHand(Event.Hand);
+		}
+		Character->Click();
+		break;
+
+	case ESemanticEventKind::Open:
+	case ESemanticEventKind::Close:
+		SelectHand(Event.Hand);
+		Character->Click();
+		break;
+
+	//The first press on 'O' asks to finish and the second one exits, ReturnToPlay cancels the first one
+	case ESemanticEventKind::Finish:
+	case ESemanticEventKind::Exit:
+		Character->Submit();
+		break;
+	case ESemanticEventKind::Resume:
+		Character->ReturnToPlay();
+		break;
+	}
+
+	Check(EventIndex, Next);
+	return Next;
+}
+
+/*@param int32 First  -->  Index of the first event of the group
+@param int32 End  -->  Index after the last event of the group*/
+void FEpisodeReplayer::Check(int32 First, int32 End)
+{
+	const TArray<FSemanticEvent>& Events = EventLog.Events;
+	const FSemanticEvent& Event = Events[First];
+
+	switch (Event.Kind)
+	{
+	case ESemanticEventKind::Pick:
+		for (int32 i = First; i < End; i++)
+		{
+			AActor* Actor = Character->ActorIds.Resolve(Events[i].ActorId);
+			const bool bHeld = Event.Hand == EEventHand::Both ? Character->TwoHandSlot.Contains(Actor) :
+				(Event.Hand == EEventHand::Right ? Character->RightHandSlot : Character->LeftHandSlot) == Actor;
+			if (!Actor || !bHeld)
+			{
+				Diverge(Events[i], TEXT("the item is not held"));
+			}
+		}
+		break;
+
+	case ESemanticEventKind::Drop:
+		for (int32 i = First; i < End; i++)
+		{
+			AActor* Actor = Character->ActorIds.Resolve(Events[i].ActorId);
+			if (!Actor || Actor == Character->RightHandSlot || Actor == Character->LeftHandSlot || Character->TwoHandSlot.Contains(Actor))
+			{
+				Diverge(Events[i], TEXT("the item is still held"));
+			}
+			else if (FVector::Dist(Actor->GetActorLocation(), Events[i].Location) > DropTolerance)
+			{
+				Diverge(Events[i], *FString::Printf(TEXT("the item landed %.2f cm away"), FVector::Dist(Actor->GetActorLocation(), Events[i].Location)));
+			}
+		}
+		break;
+
+	case ESemanticEventKind::Open:
+	case ESemanticEventKind::Close:
+	{
+		AActor* Actor = Character->ActorIds.Resolve(Event.ActorId);
+		const EAssetState Expected = Event.Kind == ESemanticEventKind::Open ? EAssetState::Open : EAssetState::Closed;
+		if (!Actor || Character->AssetStateMap.FindRef(Actor) != Expected)
+		{
+			Diverge(Event, TEXT("the state did not change"));
+		}
+		break;
+	}
+
+	//Progress events have no outcome in the world
+	default:
+		break;
+	}
+}
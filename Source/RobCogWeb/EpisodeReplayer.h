@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "EpisodeReader.h"
+#include "KitchenSnapshot.h"
+
+class AMyCharacter;
+
+/*Re-runs a recorded episode on the character.
+When the episode has an input log the session is played back exactly: every step feeds the recorded axis values and
+actions of one frame to the handlers they were bound to, and the next frame gets the recorded duration.
+Otherwise it is approached from the event and trajectory logs: every step the character is moved to the recorded camera pose and the held items to the recorded hand poses
+(through MoveItemZ/MoveItemY/RotateObject); every recorded event is replayed through the input handler
+which produced it (Click, GrabWithTwoHands, SwitchSelectedHand, Submit, ReturnToPlay), after refocusing on the
+pose of the frame before, which is the one the player acted on. In both cases the outcome of each event is compared with the log.
+An episode which resumed from a snapshot keeps it in its folder, the game mode restores it on the recorded layout before the replay starts.
+Runs on the game thread; the game mode steps it with a fixed timestep so that the physics match between runs.
+*/
+class FEpisodeReplayer
+{
+public:
+	FEpisodeReplayer(AMyCharacter* InCharacter);
+
+	//Reads the logs of the episode folder, returns false if they are missing or unreadable
+	bool Load(const FString& EpisodeDir);
+
+	//Called when the recording of the episode started, nothing is replayed before
+	void Start();
+
+	//Replays the next input frame, or everything recorded up to the world time without an input log
+	void Step(double Time);
+
+	//True once every frame, or every event and the last sample, has been replayed
+	bool IsFinished() const;
+
+	//True if the episode is played back from its raw input
+	bool IsInputReplay() const
+	{
+		return InputLog.Frames.Num() > 0;
+	}
+
+	//Logs the replay duration, the speed-up over real time and the events which did not give the recorded outcome
+	void Report() const;
+
+	//Seed of the item layout the episode was recorded on
+	int32 GetLayoutSeed() const
+	{
+		return EventLog.LayoutSeed;
+	}
+
+	//Snapshot the episode resumed from, null if it started from the layout alone
+	const FKitchenSnapshot* GetSnapshot() const
+	{
+		return bResumed ? &Snapshot : nullptr;
+	}
+
+	//File of an episode folder holding the snapshot the episode resumed from
+	static const TCHAR* SnapshotFilename;
+
+	//Level the episode was recorded in
+	const FString& GetLevelName() const
+	{
+		return EventLog.LevelName;
+	}
+
+	//Distance in cm above which a dropped item is considered to have landed elsewhere than recorded
+	float DropTolerance;
+
+	//Events replayed, and events whose outcome differed from the log
+	int32 ReplayedEvents;
+	int32 Divergences;
+
+private:
+	//Calls the handlers bound to the actions and the axes with the values of the frame
+	void ApplyInput(const FInputFrame& Frame);
+
+	//Moves the character and the held items to the pose of a sample
+	void ApplySample(const FTrajectorySample& Sample);
+
+	//Brings the item of a hand to the recorded pose of the hand
+	void ApplyHand(bool bRightHand, const FTrajectoryPose& Pose);
+
+	//Last sample recorded before the time, or at the time if bInclusive is set; null before the first sample
+	const FTrajectorySample* FindSample(double Time, bool bInclusive);
+
+	//Index of the first event after the event and the ones recorded with it (eg: the picks of a stack)
+	int32 GroupEnd(int32 EventIndex) const;
+
+	//Replays the event and the events recorded with it, returns the index of the next one
+	int32 Dispatch(int32 EventIndex);
+
+	//Compares the state of the world with the outcome of the events in [First, End)
+	void Check(int32 First, int32 End);
+
+	//Makes the hand of the event the selected one
+	void SelectHand(EEventHand Hand);
+
+	//Counts and reports an event whose outcome differs from the log
+	void Diverge(const FSemanticEvent& Event, const TCHAR* Reason);
+
+	AMyCharacter* Character;
+
+	FEpisodeEventLog EventLog;
+	FEpisodeTrajectoryLog TrajectoryLog;
+	FEpisodeInputLog InputLog;
+	FKitchenSnapshot Snapshot;
+	bool bResumed;
+
+	//Next event to replay, next sample to consider and next input frame to feed
+	int32 NextEvent;
+	int32 NextSample;
+	int32 NextFrame;
+
+	bool bStarted;
+
+	//Timestamps of two logs written from the same frame may differ by up to half a millisecond
+	static const double TimeTolerance;
+
+	double LastTime;
+	double StartTime;
+};
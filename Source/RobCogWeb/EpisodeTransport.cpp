@@ -0,0 +1,168 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "EpisodeTransport.h"
+#include "Http.h"
+#include "Async/Async.h"
+
+const float FHttpEpisodeTransport::CancelWaitTime = 1.f;
+
+/*The HTTP requests are not thread-safe: the request is created, completed and cancelled on the game thread,
+the uploader thread only hands the body over and waits for the response code*/
+struct FHttpEpisodeTransport::FPendingRequest
+{
+	TArray<uint8> Body;
+
+	//Only touched on the game thread, reset once the request completes so that it does not keep this state alive
+	TSharedPtr<IHttpRequest> Request;
+
+	//Triggered on the game thread once the request completed, failed to start or was abandoned before it started
+	FEvent* DoneEvent;
+
+	//Response code, 0 if no response was received; written before DoneEvent is triggered
+	int32 ResponseCode;
+
+	//Set by the uploader thread when it stops waiting, the request is then cancelled or never started
+	FThreadSafeBool bAbandoned;
+
+	FPendingRequest()
+		: DoneEvent(FPlatformProcess::GetSynchEventFromPool(true))
+		, ResponseCode(0)
+	{
+	}
+
+	~FPendingRequest()
+	{
+		FPlatformProcess::ReturnSynchEventToPool(DoneEvent);
+	}
+};
+
+FHttpEpisodeTransport::FHttpEpisodeTransport(const FString& InUrl, float InTimeout)
+	: Url(InUrl)
+	, Timeout(InTimeout)
+{
+}
+
+/*Blocks until the game thread reports the response, the timeout or Cancel(). A request which timed out is cancelled
+and given CancelWaitTime to finish, so a response which was already on its way is not sent a second time.
+@param const FUploadBatch& Batch  -->  Files to send
+@param FString& OutError  -->  Reason of the failure*/
+bool FHttpEpisodeTransport::Send(const FUploadBatch& Batch, FString& OutError)
+{
+	if (bCancelled)
+	{
+		OutError = TEXT("cancelled");
+		return false;
+	}
+
+	TSharedRef<FPendingRequest, ESPMode::ThreadSafe> Pending = MakeShareable(new FPendingRequest());
+	FMemoryWriter Writer(Pending->Body);
+	for (const FUploadBatch::FEntry& Entry : Batch.Entries)
+	{
+		FTCHARToUTF8 Name(*Entry.Name);
+		uint32 NameLength = Name.Length();
+		uint64 DataLength = Entry.Data.Num();
+		Writer << NameLength;
+		Writer.Serialize((void*)Name.Get(), NameLength);
+		Writer << DataLength;
+		Writer.Serialize((void*)Entry.Data.GetData(), Entry.Data.Num());
+	}
+
+	const FString RequestUrl = Url;
+	const int32 NumFiles = Batch.Entries.Num();
+	AsyncTask(ENamedThreads::GameThread, [Pending, RequestUrl, NumFiles]()
+	{
+		if (Pending->bAbandoned)
+		{
+			Pending->DoneEvent->Trigger();
+			return;
+		}
+
+		TSharedRef<IHttpRequest> Request = FHttpModule::Get().CreateRequest();
+		Request->SetURL(RequestUrl);
+		Request->SetVerb(TEXT("POST"));
+		Request->SetHeader(TEXT("Content-Type"), TEXT("application/octet-stream"));
+		Request->SetHeader(TEXT("X-RobCog-Files"), FString::FromInt(NumFiles));
+		Request->SetContent(Pending->Body);
+		Pending->Body.Empty();
+		Request->OnProcessRequestComplete().BindLambda([Pending](FHttpRequestPtr, FHttpResponsePtr Response, bool bConnected)
+		{
+			Pending->ResponseCode = bConnected && Response.IsValid() ? Response->GetResponseCode() : 0;
+			Pending->Request.Reset();
+			Pending->DoneEvent->Trigger();
+		});
+		Pending->Request = Request;
+		if (!Request->ProcessRequest())
+		{
+			Pending->Request.Reset();
+			Pending->DoneEvent->Trigger();
+		}
+	});
+
+	const double Deadline = FPlatformTime::Seconds() + Timeout;
+	bool bDone = false;
+	while (!bDone && !bCancelled && FPlatformTime::Seconds() <= Deadline)
+	{
+		bDone = Pending->DoneEvent->Wait(10);
+	}
+
+	if (!bDone)
+	{
+		Pending->bAbandoned = true;
+		AsyncTask(ENamedThreads::GameThread, [Pending]()
+		{
+			if (Pending->Request.IsValid())
+			{
+				Pending->Request->CancelRequest();
+				Pending->Request.Reset();
+			}
+			Pending->DoneEvent->Trigger();
+		});
+
+		//At exit the game thread is waiting for this one, the request is dropped with the HTTP module
+		bDone = !bCancelled && Pending->DoneEvent->Wait(FMath::CeilToInt(CancelWaitTime * 1000.f));
+		if (!bDone || Pending->ResponseCode == 0)
+		{
+			OutError = bCancelled ? TEXT("cancelled") : TEXT("timed out");
+			return false;
+		}
+	}
+
+	if (Pending->ResponseCode == 0)
+	{
+		OutError = TEXT("connection failed");
+		return false;
+	}
+	if (Pending->ResponseCode < 200 || Pending->ResponseCode >= 300)
+	{
+		OutError = FString::Printf(TEXT("HTTP %d"), Pending->ResponseCode);
+		return false;
+	}
+	return true;
+}
+
+void FHttpEpisodeTransport::Cancel()
+{
+	bCancelled = true;
+}
+
+FFolderEpisodeTransport::FFolderEpisodeTransport(const FString& InDir)
+	: Dir(InDir)
+{
+}
+
+bool FFolderEpisodeTransport::Send(const FUploadBatch& Batch, FString& OutError)
+{
+	for (const FUploadBatch::FEntry& Entry : Batch.Entries)
+	{
+		//Renamed in once complete, a reader of the folder never sees half a file
+		const FString FilePath = FPaths::Combine(*Dir, *Entry.Name);
+		const FString TempPath = FilePath + TEXT(".tmp");
+		if (!FFileHelper::SaveArrayToFile(Entry.Data, *TempPath) || !IFileManager::Get().Move(*FilePath, *TempPath, true))
+		{
+			OutError = FString::Printf(TEXT("could not write %s"), *FilePath);
+			return false;
+		}
+	}
+	return true;
+}
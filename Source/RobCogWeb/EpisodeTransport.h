@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+//Files sent in one request, read from the disk by the uploader thread
+struct FUploadBatch
+{
+	struct FEntry
+	{
+		//Name on the server: <episode>/<file>
+		FString Name;
+		TArray<uint8> Data;
+	};
+
+	TArray<FEntry> Entries;
+	int64 NumBytes;
+};
+
+/*Destination of the episode uploads. Send() is called on the uploader thread only, one batch at a time,
+and may block until the batch is acknowledged; Cancel() may be called from any thread to abort it (eg: at exit).
+*/
+class IEpisodeTransport
+{
+public:
+	virtual ~IEpisodeTransport() {}
+
+	//Sends the batch, returns false with the reason if it was not acknowledged
+	virtual bool Send(const FUploadBatch& Batch, FString& OutError) = 0;
+
+	//Makes the current and next sends fail right away
+	virtual void Cancel() {}
+};
+
+/*POSTs each batch to an HTTP endpoint (see Scripts/MockUploadServer.py for a local stand-in).
+Body: for every file a uint32 name length, the UTF-8 name, a uint64 data length and the data, all little-endian;
+the batch is acknowledged by any 2xx response. The HTTP request is created and cancelled on the game thread, which ticks it.
+*/
+class FHttpEpisodeTransport : public IEpisodeTransport
+{
+public:
+	FHttpEpisodeTransport(const FString& InUrl, float InTimeout = 30.f);
+
+	//IEpisodeTransport interface
+	virtual bool Send(const FUploadBatch& Batch, FString& OutError) override;
+	virtual void Cancel() override;
+
+	//Seconds a timed out request is given to complete or be cancelled, a response in that time still acknowledges the batch
+	static const float CancelWaitTime;
+
+private:
+	//One batch in flight, shared with the game thread which owns the HTTP request
+	struct FPendingRequest;
+
+	FString Url;
+	float Timeout;
+	FThreadSafeBool bCancelled;
+};
+
+//Copies each batch into a folder, for uploads to a mounted share and for running without a server
+class FFolderEpisodeTransport : public IEpisodeTransport
+{
+public:
+	FFolderEpisodeTransport(const FString& InDir);
+
+	//IEpisodeTransport interface
+	virtual bool Send(const FUploadBatch& Batch, FString& OutError) override;
+
+private:
+	FString Dir;
+};
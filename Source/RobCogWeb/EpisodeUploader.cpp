@@ -0,0 +1,397 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "EpisodeUploader.h"
+
+FEpisodeUploaderPtr FEpisodeUploader::Instance;
+FCriticalSection FEpisodeUploader::InstanceLock;
+FSimpleMulticastDelegate FEpisodeUploader::OnShutdown;
+
+void FEpisodeUploader::Start(const FString& Endpoint)
+{
+	if (Get().IsValid() || Endpoint.IsEmpty())
+	{
+		return;
+	}
+
+	IEpisodeTransport* Transport = Endpoint.StartsWith(TEXT("http://")) || Endpoint.StartsWith(TEXT("https://")) ?
+		(IEpisodeTransport*)new FHttpEpisodeTransport(Endpoint) : (IEpisodeTransport*)new FFolderEpisodeTransport(Endpoint);
+	FEpisodeUploaderPtr Uploader = MakeShareable(new FEpisodeUploader(Transport, FPaths::Combine(*FPaths::GameSavedDir(), TEXT("Uploads"), TEXT("Queue.txt"))));
+
+	//Crashed episodes recovered at startup by this session or a previous one which did not upload
+	const FString RecoveredListPath = GetRecoveredListPath();
+	FString RecoveredList;
+	if (FFileHelper::LoadFileToString(RecoveredList, *RecoveredListPath))
+	{
+		TArray<FString> EpisodeDirs;
+		RecoveredList.ParseIntoArrayLines(EpisodeDirs);
+		for (const FString& EpisodeDir : EpisodeDirs)
+		{
+			Uploader->EnqueueEpisode(EpisodeDir);
+		}
+		IFileManager::Get().Delete(*RecoveredListPath, false, false, true);
+	}
+
+	{
+		FScopeLock Lock(&InstanceLock);
+		Instance = Uploader;
+	}
+
+	//The HTTP requests progress on the game thread, the uploader has to stop before it does
+	FCoreDelegates::OnPreExit.AddStatic(&FEpisodeUploader::Shutdown);
+	UE_LOG(LogRobCogWeb, Log, TEXT("Uploading the episodes to %s"), *Endpoint);
+}
+
+FString FEpisodeUploader::GetRecoveredListPath()
+{
+	return FPaths::Combine(*FPaths::GameSavedDir(), TEXT("Uploads"), TEXT("Recovered.txt"));
+}
+
+/*Kept in a file rather than in memory, so that they are sent by the first session which uploads;
+the recovery runs in the background, an uploader already started gets them directly*/
+void FEpisodeUploader::AddRecoveredEpisodes(const TArray<FString>& EpisodeDirs)
+{
+	if (!EpisodeDirs.Num())
+	{
+		return;
+	}
+
+	if (FEpisodeUploaderPtr Uploader = Get())
+	{
+		for (const FString& EpisodeDir : EpisodeDirs)
+		{
+			Uploader->EnqueueEpisode(EpisodeDir);
+		}
+		return;
+	}
+
+	FString Lines;
+	for (const FString& EpisodeDir : EpisodeDirs)
+	{
+		Lines += EpisodeDir + TEXT("\n");
+	}
+	FFileHelper::SaveStringToFile(Lines, *GetRecoveredListPath(), FFileHelper::EEncodingOptions::AutoDetect, &IFileManager::Get(), FILEWRITE_Append);
+}
+
+FEpisodeUploaderPtr FEpisodeUploader::Get()
+{
+	FScopeLock Lock(&InstanceLock);
+	return Instance;
+}
+
+/*Pre-exit comes before the level ends, the episode still recording is closed here so that its last segments and its manifest
+are queued (and saved to the queue file if they cannot be sent in time)*/
+void FEpisodeUploader::Shutdown()
+{
+	OnShutdown.Broadcast();
+
+	FEpisodeUploaderPtr Uploader;
+	{
+		FScopeLock Lock(&InstanceLock);
+		Uploader = Instance;
+		Instance.Reset();
+	}
+
+	//A writer thread may still hold a reference, the object is freed with the last one but its thread stops now
+	if (Uploader.IsValid())
+	{
+		Uploader->StopThread();
+	}
+}
+
+FEpisodeUploader::FEpisodeUploader(IEpisodeTransport* InTransport, const FString& InQueueFilePath)
+	: MaxBatchBytes(8 * 1024 * 1024)
+	, MaxBatchFiles(64)
+	, BatchDelay(2.f)
+	, MinBackoff(1.f)
+	, MaxBackoff(60.f)
+	, Transport(InTransport)
+	, QueueFilePath(InQueueFilePath)
+	, NextAttemptTime(0.0)
+	, Backoff(0.f)
+{
+	FMemory::Memzero(Stats);
+	Thread = FRunnableThread::Create(this, TEXT("EpisodeUploader"), 0, TPri_BelowNormal);
+}
+
+FEpisodeUploader::~FEpisodeUploader()
+{
+	StopThread();
+
+	//Queued by a thread which still held a reference after the stop
+	if (!Incoming.IsEmpty())
+	{
+		while (!Incoming.IsEmpty())
+		{
+			DrainIncoming();
+		}
+		SaveQueue();
+	}
+	delete Transport;
+}
+
+void FEpisodeUploader::StopThread()
+{
+	if (Thread)
+	{
+		Stop();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+}
+
+void FEpisodeUploader::Enqueue(const FString& FilePath, const FString& RemoteName)
+{
+	Enqueue(FilePath, RemoteName, EItemKind::File);
+}
+
+void FEpisodeUploader::EnqueueSegment(const FString& SegmentPath)
+{
+	Enqueue(SegmentPath, FPaths::GetCleanFilename(FPaths::GetPath(SegmentPath)) / FPaths::GetCleanFilename(SegmentPath), EItemKind::Segment);
+}
+
+void FEpisodeUploader::EnqueueEpisode(const FString& EpisodeDir)
+{
+	Enqueue(EpisodeDir, FPaths::GetCleanFilename(EpisodeDir), EItemKind::Episode);
+}
+
+void FEpisodeUploader::Enqueue(const FString& FilePath, const FString& RemoteName, EItemKind Kind)
+{
+	FUploadItem Item;
+	Item.FilePath = FilePath;
+	Item.RemoteName = RemoteName;
+	Item.EnqueueTime = FPlatformTime::Seconds();
+	Item.Size = -1;
+	Item.Kind = Kind;
+	Incoming.Enqueue(Item);
+	if (Kind == EItemKind::File || Kind == EItemKind::Segment)
+	{
+		NumQueued.Increment();
+	}
+}
+
+void FEpisodeUploader::Flush()
+{
+	bFlushRequested = true;
+}
+
+FUploadStats FEpisodeUploader::GetStats() const
+{
+	FScopeLock Lock(&StatsLock);
+	FUploadStats Copy = Stats;
+	Copy.QueueDepth = NumQueued.GetValue();
+	return Copy;
+}
+
+void FEpisodeUploader::Stop()
+{
+	bStopping = true;
+	Transport->Cancel();
+}
+
+uint32 FEpisodeUploader::Run()
+{
+	//What the last session left behind goes first
+	FString QueueFile;
+	TArray<FString> Lines;
+	if (FFileHelper::LoadFileToString(QueueFile, *QueueFilePath))
+	{
+		QueueFile.ParseIntoArrayLines(Lines);
+		for (const FString& Line : Lines)
+		{
+			FString FilePath;
+			FString RemoteName;
+			if (Line.Split(TEXT("\t"), &FilePath, &RemoteName))
+			{
+				Enqueue(FilePath, RemoteName);
+			}
+		}
+	}
+
+	while (!bStopping)
+	{
+		DrainIncoming();
+
+		const double Now = FPlatformTime::Seconds();
+		const bool bBatchReady = Pending.Num() && (bFlushRequested || Pending.Num() >= MaxBatchFiles ||
+			Stats.QueuedBytes >= MaxBatchBytes || Now - Pending[0].EnqueueTime >= BatchDelay);
+		if (bBatchReady && Now >= NextAttemptTime)
+		{
+			if (SendBatch())
+			{
+				Backoff = 0.f;
+			}
+			else
+			{
+				Backoff = FMath::Clamp(Backoff * 2.f, MinBackoff, MaxBackoff);
+				NextAttemptTime = FPlatformTime::Seconds() + Backoff * FMath::FRandRange(0.5f, 1.f);
+			}
+			continue;
+		}
+		if (!Pending.Num())
+		{
+			bFlushRequested = false;
+		}
+		FPlatformProcess::Sleep(0.05f);
+	}
+
+	//A finished episode queues its files again while it is drained
+	while (!Incoming.IsEmpty())
+	{
+		DrainIncoming();
+	}
+	SaveQueue();
+	return 0;
+}
+
+void FEpisodeUploader::DrainIncoming()
+{
+	FUploadItem Item;
+	while (Incoming.Dequeue(Item))
+	{
+		if (Item.Kind == EItemKind::Episode)
+		{
+			FinishEpisode(Item.FilePath, Item.RemoteName);
+			continue;
+		}
+		if (Item.Kind == EItemKind::Segment)
+		{
+			StreamedSegments.Add(Item.FilePath);
+		}
+
+		Item.Size = IFileManager::Get().FileSize(*Item.FilePath);
+		if (Item.Size < 0)
+		{
+			UE_LOG(LogRobCogWeb, Warning, TEXT("%s is not there anymore, it is not uploaded"), *Item.FilePath);
+			NumQueued.Decrement();
+			continue;
+		}
+		Pending.Add(Item);
+
+		FScopeLock Lock(&StatsLock);
+		Stats.QueuedBytes += Item.Size;
+	}
+}
+
+/*The batch takes the oldest files in order while they fit, at least one.
+@return  -->  False if the transport did not acknowledge the batch, the files stay queued*/
+bool FEpisodeUploader::SendBatch()
+{
+	Batch.Entries.Reset();
+	Batch.NumBytes = 0;
+	int32 NumItems = 0;
+	while (NumItems < Pending.Num() && NumItems < MaxBatchFiles &&
+		(NumItems == 0 || Batch.NumBytes + Pending[NumItems].Size <= MaxBatchBytes))
+	{
+		FUploadBatch::FEntry& Entry = Batch.Entries[Batch.Entries.AddDefaulted()];
+		Entry.Name = Pending[NumItems].RemoteName;
+		if (!FFileHelper::LoadFileToArray(Entry.Data, *Pending[NumItems].FilePath, FILEREAD_Silent))
+		{
+			UE_LOG(LogRobCogWeb, Warning, TEXT("Could not read %s, it is not uploaded"), *Pending[NumItems].FilePath);
+			Batch.Entries.Pop(false);
+			{
+				FScopeLock Lock(&StatsLock);
+				Stats.QueuedBytes -= Pending[NumItems].Size;
+			}
+			Pending.RemoveAt(NumItems);
+			NumQueued.Decrement();
+			continue;
+		}
+		Batch.NumBytes += Entry.Data.Num();
+		NumItems++;
+	}
+	if (!NumItems)
+	{
+		return true;
+	}
+
+	{
+		FScopeLock Lock(&StatsLock);
+		Stats.BytesInFlight = Batch.NumBytes;
+	}
+
+	FString Error;
+	const bool bSent = Transport->Send(Batch, Error);
+	const double Now = FPlatformTime::Seconds();
+
+	FScopeLock Lock(&StatsLock);
+	Stats.BytesInFlight = 0;
+	if (!bSent)
+	{
+		Stats.FailedAttempts++;
+		UE_LOG(LogRobCogWeb, Warning, TEXT("Upload of %d files failed (%s), retrying"), NumItems, *Error);
+		return false;
+	}
+
+	for (int32 i = 0; i < NumItems; i++)
+	{
+		const double LatencyMs = (Now - Pending[i].EnqueueTime) * 1000.0;
+		Stats.LastLatencyMs = LatencyMs;
+		Stats.MaxLatencyMs = FMath::Max(Stats.MaxLatencyMs, LatencyMs);
+		Stats.AverageLatencyMs += (LatencyMs - Stats.AverageLatencyMs) / (Stats.FilesSent + 1);
+		Stats.QueuedBytes -= Pending[i].Size;
+		Stats.FilesSent++;
+	}
+	Stats.BytesSent += Batch.NumBytes;
+	Stats.BatchesSent++;
+	Pending.RemoveAt(0, NumItems, false);
+	NumQueued.Subtract(NumItems);
+
+	//The data of the batch is not kept around between uploads
+	Batch.Entries.Empty();
+	return true;
+}
+
+/*The segments of the episode were all queued before it (the logs are closed first), what is left are the small files
+written at the start and the end of the episode
+@param const FString& EpisodeDir  -->  Episode folder
+@param const FString& EpisodeName  -->  Name of the folder on the server*/
+void FEpisodeUploader::FinishEpisode(const FString& EpisodeDir, const FString& EpisodeName)
+{
+	TArray<FString> Files;
+	IFileManager::Get().FindFiles(Files, *FPaths::Combine(*EpisodeDir, TEXT("*")), true, false);
+	Files.Sort();
+
+	FString Manifest;
+	for (const FString& File : Files)
+	{
+		//Leftovers of an interrupted write are not part of the episode
+		if (File.EndsWith(TEXT(".tmp")) || File == TEXT("Manifest.txt"))
+		{
+			continue;
+		}
+		const FString FilePath = FPaths::Combine(*EpisodeDir, *File);
+		Manifest += FString::Printf(TEXT("%s\t%lld\n"), *File, IFileManager::Get().FileSize(*FilePath));
+		if (!StreamedSegments.Remove(FilePath))
+		{
+			Enqueue(FilePath, EpisodeName / File, EItemKind::File);
+		}
+	}
+
+	const FString ManifestPath = FPaths::Combine(*EpisodeDir, TEXT("Manifest.txt"));
+	if (FFileHelper::SaveStringToFile(Manifest, *ManifestPath))
+	{
+		Enqueue(ManifestPath, EpisodeName / TEXT("Manifest.txt"), EItemKind::File);
+	}
+	bFlushRequested = true;
+}
+
+void FEpisodeUploader::SaveQueue()
+{
+	if (!Pending.Num())
+	{
+		IFileManager::Get().Delete(*QueueFilePath, false, false, true);
+		return;
+	}
+
+	FString Lines;
+	for (const FUploadItem& Item : Pending)
+	{
+		Lines += Item.FilePath + TEXT("\t") + Item.RemoteName + TEXT("\n");
+	}
+	if (FFileHelper::SaveStringToFile(Lines, *QueueFilePath))
+	{
+		UE_LOG(LogRobCogWeb, Log, TEXT("%d files left to upload at the next start"), Pending.Num());
+	}
+}
@@ -0,0 +1,161 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "EpisodeTransport.h"
+
+//Counters of the uploader, copied out for the HUD and the logs
+struct FUploadStats
+{
+	//Files queued and not acknowledged yet, and their size when known
+	int32 QueueDepth;
+	int64 QueuedBytes;
+
+	//Size of the batch being sent
+	int64 BytesInFlight;
+
+	int64 BytesSent;
+	int32 FilesSent;
+	int32 BatchesSent;
+	int32 FailedAttempts;
+
+	//From the enqueue to the acknowledgement of a file, in ms
+	double LastLatencyMs;
+	double AverageLatencyMs;
+	double MaxLatencyMs;
+};
+
+class FEpisodeUploader;
+
+//Reference to the uploader of the session, safe to take and release from any thread
+typedef TSharedPtr<FEpisodeUploader, ESPMode::ThreadSafe> FEpisodeUploaderPtr;
+
+/*Uploads the episodes from a background thread, so the game thread never waits on the disk or the network.
+The segments of the logs are streamed while the participant plays (EnqueueSegment() from the writer threads); when the
+episode ends, EnqueueEpisode() only adds the files not streamed yet and a manifest of the whole folder, and sends them at once.
+Enqueueing only pushes a path into a lock-free queue, the folders are listed on the uploader thread.
+The uploader thread batches the files until a batch is full or the oldest file has waited BatchDelay, reads them and
+hands the batch to the transport; a failed batch is sent again after an exponential backoff with jitter.
+Memory stays bounded: the queue holds paths only and at most one batch is read at a time.
+Files still queued at exit are written to Saved/Uploads/Queue.txt and queued again at the next start.
+Episodes cut short by a crash are recovered from the journals of their logs when the module starts, uploads or not
+(see FEpisodeReader::RecoverCrashedEpisodes); the uploader only sends them like finished episodes.
+*/
+class FEpisodeUploader : public FRunnable
+{
+public:
+	//Starts the uploader of the session if there is none: URLs go through HTTP, anything else is taken as a folder; empty disables the upload
+	static void Start(const FString& Endpoint);
+
+	//Uploader of the session, null if the upload is disabled; the reference keeps it alive while it is used
+	static FEpisodeUploaderPtr Get();
+
+	//Stops the uploader thread and saves what is still queued, called before the engine exits
+	static void Shutdown();
+
+	//Remembers episodes recovered after a crash (see FEpisodeReader::RecoverCrashedEpisodes), from any thread; they are sent now or once an uploader starts
+	static void AddRecoveredEpisodes(const TArray<FString>& EpisodeDirs);
+
+	//Broadcast on the game thread when the uploader is about to stop, so that the episode being recorded is closed and queued first
+	static FSimpleMulticastDelegate OnShutdown;
+
+	//The uploader takes ownership of the transport
+	FEpisodeUploader(IEpisodeTransport* InTransport, const FString& InQueueFilePath);
+	virtual ~FEpisodeUploader();
+
+	//Queues a file, from any thread and without blocking
+	void Enqueue(const FString& FilePath, const FString& RemoteName);
+
+	//Queues a segment of an episode log under <episode>/<file>, from any thread (the writer threads of the logs)
+	void EnqueueSegment(const FString& SegmentPath);
+
+	/*Queues the files of a finished episode folder which were not streamed as segments, then Manifest.txt
+	(name and size of every file of the episode, sent last so that the server knows the episode is complete), and flushes.
+	Called once the logs are closed: their last segments are queued before it.*/
+	void EnqueueEpisode(const FString& EpisodeDir);
+
+	//Sends what is queued without waiting for a full batch
+	void Flush();
+
+	//Stops the uploader thread and saves what is still queued, the files queued afterwards are saved when the uploader is freed
+	void StopThread();
+
+	FUploadStats GetStats() const;
+
+	//FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+	//Limits of a batch, a single larger file is sent alone
+	int64 MaxBatchBytes;
+	int32 MaxBatchFiles;
+
+	//Seconds the oldest queued file waits for others to join its batch
+	float BatchDelay;
+
+	//Backoff after a failed batch, doubled at each failure up to the maximum, in seconds
+	float MinBackoff;
+	float MaxBackoff;
+
+private:
+	enum class EItemKind : uint8
+	{
+		File,
+		Segment,
+		//Finished episode folder, listed by the uploader thread
+		Episode
+	};
+
+	struct FUploadItem
+	{
+		FString FilePath;
+		FString RemoteName;
+		double EnqueueTime;
+		int64 Size;
+		EItemKind Kind;
+	};
+
+	void Enqueue(const FString& FilePath, const FString& RemoteName, EItemKind Kind);
+
+	//List of the recovered episodes not sent yet
+	static FString GetRecoveredListPath();
+
+	//Moves the incoming items to the pending list, listing the episode folders
+	void DrainIncoming();
+
+	//Queues the files of the episode not streamed yet and writes its manifest
+	void FinishEpisode(const FString& EpisodeDir, const FString& EpisodeName);
+
+	//Reads and sends the oldest pending files, returns false if the transport failed
+	bool SendBatch();
+
+	//Writes the items not sent to the queue file, or deletes it if there are none
+	void SaveQueue();
+
+	//Taken and released under the lock, the writer threads look it up before each segment
+	static FEpisodeUploaderPtr Instance;
+	static FCriticalSection InstanceLock;
+
+	IEpisodeTransport* Transport;
+	FString QueueFilePath;
+
+	FRunnableThread* Thread;
+	FThreadSafeBool bStopping;
+	FThreadSafeBool bFlushRequested;
+
+	//Filled by any thread, drained by the uploader thread
+	TQueue<FUploadItem, EQueueMode::Mpsc> Incoming;
+	FThreadSafeCounter NumQueued;
+
+	//Uploader thread only
+	TArray<FUploadItem> Pending;
+
+	//Segments queued for the episodes not finished yet
+	TSet<FString> StreamedSegments;
+	FUploadBatch Batch;
+	double NextAttemptTime;
+	float Backoff;
+
+	mutable FCriticalSection StatsLock;
+	FUploadStats Stats;
+};
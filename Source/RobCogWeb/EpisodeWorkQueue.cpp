@@ -0,0 +1,207 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "EpisodeWorkQueue.h"
+
+FEpisodeWorkQueue::FEpisodeWorkQueue(const FString& InQueueDir)
+	: QueueDir(InQueueDir)
+{
+	IFileManager::Get().MakeDirectory(*GetStateDir(EEpisodeJobState::Pending), true);
+	IFileManager::Get().MakeDirectory(*GetStateDir(EEpisodeJobState::Leased), true);
+	IFileManager::Get().MakeDirectory(*GetStateDir(EEpisodeJobState::Done), true);
+	IFileManager::Get().MakeDirectory(*GetStateDir(EEpisodeJobState::Failed), true);
+	IFileManager::Get().MakeDirectory(*GetResultDir(), true);
+}
+
+FString FEpisodeWorkQueue::GetStateDir(EEpisodeJobState State) const
+{
+	static const TCHAR* StateDirs[] = { TEXT("Pending"), TEXT("Leased"), TEXT("Done"), TEXT("Failed") };
+	return FPaths::Combine(*QueueDir, StateDirs[(int32)State]);
+}
+
+FString FEpisodeWorkQueue::GetJobPath(EEpisodeJobState State, const FString& Key, uint32 WorkerId) const
+{
+	return FPaths::Combine(*GetStateDir(State), *(State == EEpisodeJobState::Leased ? FString::Printf(TEXT("%s@%u.job"), *Key, WorkerId) : Key + TEXT(".job")));
+}
+
+FString FEpisodeWorkQueue::GetResultDir() const
+{
+	return FPaths::Combine(*QueueDir, TEXT("Results"));
+}
+
+FString FEpisodeWorkQueue::GetResultPath(const FString& Key) const
+{
+	return FPaths::Combine(*GetResultDir(), *(Key + TEXT(".csv")));
+}
+
+bool FEpisodeWorkQueue::ParseLease(const FString& FileName, FString& OutKey, uint32& OutWorkerId)
+{
+	FString WorkerId;
+	if (!FPaths::GetBaseFilename(FileName).Split(TEXT("@"), &OutKey, &WorkerId, ESearchCase::CaseSensitive, ESearchDir::FromEnd))
+	{
+		return false;
+	}
+	OutWorkerId = (uint32)FCString::Atoi64(*WorkerId);
+	return true;
+}
+
+/*The job file holds the path of the episode folder, the job is named after the folder
+@param const TArray<FString>& EpisodeDirs  -->  Episode folders to add*/
+int32 FEpisodeWorkQueue::Enqueue(const TArray<FString>& EpisodeDirs)
+{
+	TSet<FString> Known;
+	TArray<FString> Files;
+	for (int32 State = 0; State <= (int32)EEpisodeJobState::Failed; State++)
+	{
+		Files.Reset();
+		IFileManager::Get().FindFiles(Files, *FPaths::Combine(*GetStateDir((EEpisodeJobState)State), TEXT("*.job")), true, false);
+		for (const FString& File : Files)
+		{
+			FString Key;
+			uint32 WorkerId;
+			Known.Add(ParseLease(File, Key, WorkerId) ? Key : FPaths::GetBaseFilename(File));
+		}
+	}
+
+	int32 Added = 0;
+	for (const FString& EpisodeDir : EpisodeDirs)
+	{
+		const FString Key = FPaths::GetCleanFilename(EpisodeDir);
+		if (Known.Contains(Key))
+		{
+			continue;
+		}
+		Known.Add(Key);
+
+		//Written aside then renamed in, a worker never sees a half written job
+		const FString TempPath = FPaths::Combine(*QueueDir, *(Key + TEXT(".tmp")));
+		if (FFileHelper::SaveStringToFile(EpisodeDir, *TempPath) &&
+			IFileManager::Get().Move(*GetJobPath(EEpisodeJobState::Pending, Key), *TempPath, false, false, false, true))
+		{
+			Added++;
+		}
+	}
+	return Added;
+}
+
+bool FEpisodeWorkQueue::Claim(uint32 WorkerId, FString& OutKey, FString& OutEpisodeDir)
+{
+	TArray<FString> Files;
+	IFileManager::Get().FindFiles(Files, *FPaths::Combine(*GetStateDir(EEpisodeJobState::Pending), TEXT("*.job")), true, false);
+	Files.Sort();
+
+	//Other workers may rename the same jobs, the ones which fail here were taken first
+	for (const FString& File : Files)
+	{
+		const FString Key = FPaths::GetBaseFilename(File);
+		const FString LeasePath = GetJobPath(EEpisodeJobState::Leased, Key, WorkerId);
+		if (!IFileManager::Get().Move(*LeasePath, *GetJobPath(EEpisodeJobState::Pending, Key), false, false, false, true))
+		{
+			continue;
+		}
+
+		IFileManager::Get().SetTimeStamp(*LeasePath, FDateTime::UtcNow());
+		if (!FFileHelper::LoadFileToString(OutEpisodeDir, *LeasePath))
+		{
+			//Lost between the rename and the read, taken back by the coordinator
+			continue;
+		}
+		OutKey = Key;
+		return true;
+	}
+	return false;
+}
+
+bool FEpisodeWorkQueue::Complete(const FString& Key, uint32 WorkerId, bool bSucceeded)
+{
+	const EEpisodeJobState State = bSucceeded ? EEpisodeJobState::Done : EEpisodeJobState::Failed;
+	return IFileManager::Get().Move(*GetJobPath(State, Key), *GetJobPath(EEpisodeJobState::Leased, Key, WorkerId), true, false, false, true);
+}
+
+bool FEpisodeWorkQueue::Release(const FString& Key, uint32 WorkerId)
+{
+	FirstSeen.Remove(FString::Printf(TEXT("%s@%u"), *Key, WorkerId));
+	int32& Count = Attempts.FindOrAdd(Key);
+	const bool bGiveUp = ++Count >= MaxAttempts;
+	if (bGiveUp)
+	{
+		UE_LOG(LogRobCogWeb, Warning, TEXT("Episode %s was leased %d times without completing, giving up"), *Key, Count);
+	}
+	return IFileManager::Get().Move(*GetJobPath(bGiveUp ? EEpisodeJobState::Failed : EEpisodeJobState::Pending, Key),
+		*GetJobPath(EEpisodeJobState::Leased, Key, WorkerId), false, false, false, true);
+}
+
+int32 FEpisodeWorkQueue::Requeue(uint32 WorkerId)
+{
+	TArray<FString> Files;
+	IFileManager::Get().FindFiles(Files, *FPaths::Combine(*GetStateDir(EEpisodeJobState::Leased), *FString::Printf(TEXT("*@%u.job"), WorkerId)), true, false);
+	int32 Released = 0;
+	for (const FString& File : Files)
+	{
+		FString Key;
+		uint32 LeaseWorkerId;
+		if (ParseLease(File, Key, LeaseWorkerId) && LeaseWorkerId == WorkerId && Release(Key, WorkerId))
+		{
+			Released++;
+		}
+	}
+	return Released;
+}
+
+int32 FEpisodeWorkQueue::RequeueAll()
+{
+	TArray<FString> Files;
+	IFileManager::Get().FindFiles(Files, *FPaths::Combine(*GetStateDir(EEpisodeJobState::Leased), TEXT("*.job")), true, false);
+	int32 Released = 0;
+	for (const FString& File : Files)
+	{
+		FString Key;
+		uint32 WorkerId;
+		if (ParseLease(File, Key, WorkerId) && Release(Key, WorkerId))
+		{
+			Released++;
+		}
+	}
+	return Released;
+}
+
+/*A lease counts from the later of its time stamp (set at the claim) and the first time the coordinator saw it,
+which covers a claim whose time stamp was not updated yet
+@param double LeaseTimeout  -->  Seconds a lease lasts*/
+int32 FEpisodeWorkQueue::RequeueExpired(double LeaseTimeout)
+{
+	TArray<FString> Files;
+	IFileManager::Get().FindFiles(Files, *FPaths::Combine(*GetStateDir(EEpisodeJobState::Leased), TEXT("*.job")), true, false);
+	const FDateTime Now = FDateTime::UtcNow();
+	int32 Released = 0;
+	for (const FString& File : Files)
+	{
+		FString Key;
+		uint32 WorkerId;
+		if (!ParseLease(File, Key, WorkerId))
+		{
+			continue;
+		}
+
+		const FDateTime* Found = FirstSeen.Find(FPaths::GetBaseFilename(File));
+		const FDateTime Seen = Found ? *Found : FirstSeen.Add(FPaths::GetBaseFilename(File), Now);
+		const FDateTime TimeStamp = IFileManager::Get().GetTimeStamp(*FPaths::Combine(*GetStateDir(EEpisodeJobState::Leased), *File));
+		const FDateTime LeaseStart = TimeStamp > Seen ? TimeStamp : Seen;
+		if ((Now - LeaseStart).GetTotalSeconds() > LeaseTimeout)
+		{
+			UE_LOG(LogRobCogWeb, Warning, TEXT("Lease of %s by worker %u expired"), *Key, WorkerId);
+			if (Release(Key, WorkerId))
+			{
+				Released++;
+			}
+		}
+	}
+	return Released;
+}
+
+int32 FEpisodeWorkQueue::Num(EEpisodeJobState State) const
+{
+	TArray<FString> Files;
+	IFileManager::Get().FindFiles(Files, *FPaths::Combine(*GetStateDir(State), TEXT("*.job")), true, false);
+	return Files.Num();
+}
@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+//Folder of the queue a job file is in
+enum class EEpisodeJobState : uint8
+{
+	Pending,
+	Leased,
+	Done,
+	Failed
+};
+
+/*Work queue of episodes shared by the processes of a batch run, kept as files so that it needs no server and works
+from any machine which sees the folder.
+Each episode is one job file named after the episode, in exactly one of the Pending, Leased, Done and Failed folders;
+jobs only ever move by a rename, so a crash at any point leaves every episode in one of them, never lost nor doubled.
+A worker claims a job by renaming it into Leased under its worker id (the first rename wins), and completes it
+by renaming it into Done or Failed. The coordinator puts back into Pending the leases of the workers which exited
+and the leases older than the timeout (a worker holds one episode at a time, the timeout has to exceed the longest one);
+an episode is given up after MaxAttempts leases which did not complete.
+Outputs are written under the name of the episode, so an episode processed twice writes the same files again.
+*/
+class FEpisodeWorkQueue
+{
+public:
+	FEpisodeWorkQueue(const FString& InQueueDir);
+
+	//Adds the episodes which are in none of the folders yet, returns the number added
+	int32 Enqueue(const TArray<FString>& EpisodeDirs);
+
+	//Leases the next pending job to the worker, returns false if there is none left
+	bool Claim(uint32 WorkerId, FString& OutKey, FString& OutEpisodeDir);
+
+	//Moves a leased job to Done or Failed, returns false if the lease was taken back meanwhile
+	bool Complete(const FString& Key, uint32 WorkerId, bool bSucceeded);
+
+	//Puts back the leases of a worker which exited, returns their number (coordinator only)
+	int32 Requeue(uint32 WorkerId);
+
+	//Puts back every lease, when no worker is running (eg: left by a crashed coordinator)
+	int32 RequeueAll();
+
+	//Puts back the leases claimed more than the timeout ago, in seconds (coordinator only)
+	int32 RequeueExpired(double LeaseTimeout);
+
+	int32 Num(EEpisodeJobState State) const;
+
+	//Where the worker writes the metrics of an episode
+	FString GetResultPath(const FString& Key) const;
+
+	//Folder of the per-episode results
+	FString GetResultDir() const;
+
+	//Leases of an episode before it is moved to Failed
+	static const int32 MaxAttempts = 3;
+
+private:
+	FString GetStateDir(EEpisodeJobState State) const;
+
+	//Path of a job, leased jobs carry the id of the worker
+	FString GetJobPath(EEpisodeJobState State, const FString& Key, uint32 WorkerId = 0) const;
+
+	//Key and worker id of a leased job file
+	static bool ParseLease(const FString& FileName, FString& OutKey, uint32& OutWorkerId);
+
+	//Moves a leased job back to Pending, or to Failed after too many attempts
+	bool Release(const FString& Key, uint32 WorkerId);
+
+	FString QueueDir;
+
+	//Leases given to each episode, and when the coordinator first saw each lease (the rename keeps the time stamp of the pending job)
+	TMap<FString, int32> Attempts;
+	TMap<FString, FDateTime> FirstSeen;
+};
@@ -0,0 +1,208 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "EventLogIndex.h"
+#include "LogEncoding.h"
+
+FEventLogIndex::FEventLogIndex(float InKeyframeInterval)
+	: KeyframeInterval(FMath::Max(InKeyframeInterval, 0.001f))
+{
+}
+
+/*@param int64 Offset  -->  Stream offset of the record, its tag included
+@param int64 TimeMs  -->  Timestamp as written, in ms
+@param const FSemanticEvent& Event  -->  Event of the record
+@param const FIntVector& PreviousLocation  -->  Previous quantized location of the actor, before the record updates it*/
+void FEventLogIndex::Add(int64 Offset, int64 TimeMs, const FSemanticEvent& Event, const FIntVector& PreviousLocation)
+{
+	const int32 Record = Entries.Num();
+	FEventIndexEntry& Entry = Entries[Entries.AddUninitialized()];
+	Entry.Offset = Offset;
+	Entry.TimeMs = TimeMs;
+	Entry.PreviousLocation = PreviousLocation;
+
+	KindRecords[FMath::Min((int32)Event.Kind, NumKinds - 1)].Add(Record);
+	if (Event.ActorId)
+	{
+		ActorRecords.FindOrAdd(Event.ActorId).Add(Record);
+	}
+	if (Event.SurfaceId && Event.SurfaceId != Event.ActorId)
+	{
+		ActorRecords.FindOrAdd(Event.SurfaceId).Add(Record);
+	}
+
+	const int64 IntervalMs = (int64)(KeyframeInterval * 1000.0);
+	while ((int64)Keyframes.Num() * IntervalMs <= TimeMs)
+	{
+		Keyframes.Add(Record);
+	}
+}
+
+const TArray<int32>& FEventLogIndex::FindByKind(ESemanticEventKind Kind) const
+{
+	return KindRecords[FMath::Min((int32)Kind, NumKinds - 1)];
+}
+
+const TArray<int32>& FEventLogIndex::FindByActor(uint32 ActorId) const
+{
+	const TArray<int32>* Records = ActorRecords.Find(ActorId);
+	return Records ? *Records : NoRecords;
+}
+
+/*The keyframe of the start time gives the first record to look at, the entries are scanned from there on
+@param double StartTime  -->  Start of the range, in seconds
+@param double EndTime  -->  End of the range, in seconds
+@param TArray<int32>& OutRecords  -->  Records in the range*/
+void FEventLogIndex::FindInTimeRange(double StartTime, double EndTime, TArray<int32>& OutRecords) const
+{
+	OutRecords.Reset();
+	const int64 StartMs = (int64)FMath::RoundToDouble(StartTime * 1000.0);
+	const int64 EndMs = (int64)FMath::RoundToDouble(EndTime * 1000.0);
+	const int32 Keyframe = (int32)FMath::Max(0.0, StartTime / KeyframeInterval);
+	if (Keyframe >= Keyframes.Num())
+	{
+		return;
+	}
+
+	for (int32 Record = Keyframes[Keyframe]; Record < Entries.Num() && Entries[Record].TimeMs <= EndMs; Record++)
+	{
+		if (Entries[Record].TimeMs >= StartMs)
+		{
+			OutRecords.Add(Record);
+		}
+	}
+}
+
+//Writes a list of increasing record numbers as varint deltas
+static void WriteRecords(FArchive& Ar, const TArray<int32>& Records)
+{
+	LogEncoding::WriteVarint(Ar, Records.Num());
+	int32 Previous = 0;
+	for (int32 Record : Records)
+	{
+		LogEncoding::WriteVarint(Ar, Record - Previous);
+		Previous = Record;
+	}
+}
+
+/*Every record number takes at least one byte, which bounds a corrupted count by the size of the file
+@param int32 MaxCount  -->  Size of the file
+@param int32 NumEntries  -->  Records of the log, returns false if a record number is not below it*/
+static bool ReadRecords(FArchive& Ar, TArray<int32>& OutRecords, int32 MaxCount, int32 NumEntries)
+{
+	const int32 Count = (int32)FMath::Min<uint64>(LogEncoding::ReadVarint(Ar), MaxCount);
+	OutRecords.SetNumUninitialized(Count);
+	int64 Previous = 0;
+	for (int32& Record : OutRecords)
+	{
+		Previous += LogEncoding::ReadVarint(Ar);
+		if (Previous >= NumEntries)
+		{
+			return false;
+		}
+		Record = (int32)Previous;
+	}
+	return true;
+}
+
+/*Layout: magic, version, keyframe interval, entry count, then for each entry its offset and timestamp as varint deltas
+and the previous location of its actor as zig-zag varints, then the record lists (kinds, actors, keyframes)
+as counts followed by varint deltas of the record numbers.
+@param const FString& FilePath  -->  File to write*/
+bool FEventLogIndex::Save(const FString& FilePath) const
+{
+	TArray<uint8> Bytes;
+	FMemoryWriter Writer(Bytes);
+	uint32 FileMagic = Magic;
+	uint16 FileVersion = Version;
+	float FileKeyframeInterval = KeyframeInterval;
+	Writer << FileMagic;
+	Writer << FileVersion;
+	Writer << FileKeyframeInterval;
+
+	LogEncoding::WriteVarint(Writer, Entries.Num());
+	int64 PreviousOffset = 0;
+	int64 PreviousTime = 0;
+	for (const FEventIndexEntry& Entry : Entries)
+	{
+		LogEncoding::WriteVarint(Writer, Entry.Offset - PreviousOffset);
+		LogEncoding::WriteVarint(Writer, Entry.TimeMs - PreviousTime);
+		LogEncoding::WriteSignedVarint(Writer, Entry.PreviousLocation.X);
+		LogEncoding::WriteSignedVarint(Writer, Entry.PreviousLocation.Y);
+		LogEncoding::WriteSignedVarint(Writer, Entry.PreviousLocation.Z);
+		PreviousOffset = Entry.Offset;
+		PreviousTime = Entry.TimeMs;
+	}
+
+	for (const TArray<int32>& Records : KindRecords)
+	{
+		WriteRecords(Writer, Records);
+	}
+
+	LogEncoding::WriteVarint(Writer, ActorRecords.Num());
+	for (const auto& Actor : ActorRecords)
+	{
+		LogEncoding::WriteVarint(Writer, Actor.Key);
+		WriteRecords(Writer, Actor.Value);
+	}
+
+	WriteRecords(Writer, Keyframes);
+	return FFileHelper::SaveArrayToFile(Bytes, *FilePath);
+}
+
+bool FEventLogIndex::Load(const FString& FilePath)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *FilePath, FILEREAD_Silent))
+	{
+		return false;
+	}
+
+	FMemoryReader Reader(Bytes);
+	uint32 FileMagic;
+	uint16 FileVersion;
+	Reader << FileMagic;
+	Reader << FileVersion;
+	if (FileMagic != Magic || FileVersion != Version)
+	{
+		return false;
+	}
+	Reader << KeyframeInterval;
+
+	//Counts are bounded by the size of the file, a corrupted count fails on the read instead of allocating
+	const int32 NumEntries = (int32)FMath::Min<uint64>(LogEncoding::ReadVarint(Reader), Bytes.Num());
+	Entries.SetNumUninitialized(NumEntries);
+	int64 Offset = 0;
+	int64 TimeMs = 0;
+	for (FEventIndexEntry& Entry : Entries)
+	{
+		Offset += LogEncoding::ReadVarint(Reader);
+		TimeMs += LogEncoding::ReadVarint(Reader);
+		Entry.Offset = Offset;
+		Entry.TimeMs = TimeMs;
+		Entry.PreviousLocation.X = (int32)LogEncoding::ReadSignedVarint(Reader);
+		Entry.PreviousLocation.Y = (int32)LogEncoding::ReadSignedVarint(Reader);
+		Entry.PreviousLocation.Z = (int32)LogEncoding::ReadSignedVarint(Reader);
+	}
+
+	for (TArray<int32>& Records : KindRecords)
+	{
+		if (!ReadRecords(Reader, Records, Bytes.Num(), NumEntries))
+		{
+			return false;
+		}
+	}
+
+	ActorRecords.Reset();
+	const int32 NumActors = (int32)FMath::Min<uint64>(LogEncoding::ReadVarint(Reader), Bytes.Num());
+	for (int32 i = 0; i < NumActors && !Reader.IsError(); i++)
+	{
+		const uint32 ActorId = (uint32)LogEncoding::ReadVarint(Reader);
+		if (!ReadRecords(Reader, ActorRecords.FindOrAdd(ActorId), Bytes.Num(), NumEntries))
+		{
+			return false;
+		}
+	}
+
+	return ReadRecords(Reader, Keyframes, Bytes.Num(), NumEntries) && !Reader.IsError();
+}
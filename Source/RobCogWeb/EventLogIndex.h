@@ -0,0 +1,73 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "SemanticEventLogger.h"
+
+//Where a record of the event log starts, and the decoder state it needs to be read on its own
+struct FEventIndexEntry
+{
+	//Offset of the record in the log stream
+	int64 Offset;
+
+	//Timestamp of the event in ms, as written
+	int64 TimeMs;
+
+	//Quantized location of the previous event on the same actor, which the location of the record is a delta to
+	FIntVector PreviousLocation;
+};
+
+/*Sidecar index of an event log (Events.idx), so that queries seek to the matching records instead of scanning the log:
+one entry per record, the records of each event kind and of each actor (acted on or used as surface),
+and the first record of every keyframe interval.
+Built by the writer thread of the event logger while it writes, or rebuilt from the log by FEpisodeReader.
+*/
+class FEventLogIndex
+{
+public:
+	FEventLogIndex(float InKeyframeInterval = 10.f);
+
+	//Appends a record, in log order
+	void Add(int64 Offset, int64 TimeMs, const FSemanticEvent& Event, const FIntVector& PreviousLocation);
+
+	//Writes the index in one file, returns false if the write failed
+	bool Save(const FString& FilePath) const;
+
+	//Reads an index written by Save(), returns false if it is missing, truncated or of another version
+	bool Load(const FString& FilePath);
+
+	//Records of an event kind, in log order
+	const TArray<int32>& FindByKind(ESemanticEventKind Kind) const;
+
+	//Records acting on the actor or dropping something on it, in log order
+	const TArray<int32>& FindByActor(uint32 ActorId) const;
+
+	//Records logged between the two times (in seconds, both included), in log order
+	void FindInTimeRange(double StartTime, double EndTime, TArray<int32>& OutRecords) const;
+
+	int32 Num() const { return Entries.Num(); }
+
+	const FEventIndexEntry& GetEntry(int32 Record) const { return Entries[Record]; }
+
+	//Seconds between two time keyframes
+	float GetKeyframeInterval() const { return KeyframeInterval; }
+
+	//Identifies the file format
+	static const uint32 Magic = 0x58574352; // 'RCWX'
+	static const uint16 Version = 1;
+
+	static const int32 NumKinds = (int32)ESemanticEventKind::Exit + 1;
+
+private:
+	float KeyframeInterval;
+
+	TArray<FEventIndexEntry> Entries;
+	TArray<int32> KindRecords[NumKinds];
+	TMap<uint32, TArray<int32>> ActorRecords;
+
+	//First record at or after each multiple of the keyframe interval
+	TArray<int32> Keyframes;
+
+	//Returned for actors without records
+	TArray<int32> NoRecords;
+};
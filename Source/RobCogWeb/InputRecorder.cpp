@@ -0,0 +1,258 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "InputRecorder.h"
+#include "SegmentedFileWriter.h"
+#include "LogEncoding.h"
+
+FInputRecorder::FInputRecorder(const FString& InFilePath, const FString& LevelName, const TFunction<void(const FString&)>& OnSegmentWritten)
+	: DroppedFrames(0)
+	, RecordedTime(0.0)
+	, BytesWritten(0)
+{
+	//Every chunk is allocated up front, recording never allocates afterwards
+	Chunks.SetNumUninitialized(NumChunks);
+	for (int32 i = 1; i < NumChunks; i++)
+	{
+		FreeChunks.Push(i);
+	}
+	CurrentChunk = 0;
+	Chunks[CurrentChunk].NumFrames = 0;
+
+	FSegmentedFileWriter* SegmentWriter = new FSegmentedFileWriter(InFilePath);
+	SegmentWriter->OnSegmentWritten = OnSegmentWritten;
+	File = SegmentWriter;
+	uint32 FileMagic = Magic;
+	uint16 FileVersion = Version;
+	FString FileLevelName = LevelName;
+	uint8 FileNumAxes = FInputFrame::NumAxes;
+	uint8 FileNumActions = (uint8)EInputAction::Num;
+	*File << FileMagic;
+	*File << FileVersion;
+	*File << FileLevelName;
+	*File << FileNumAxes;
+	*File << FileNumActions;
+	//The header is a record of its own, the first segment starts with it
+	File->Flush();
+
+	WriteBuffer.Reserve(FramesPerChunk * 16);
+	PackedActions.Reserve(FramesPerChunk);
+	Thread = FRunnableThread::Create(this, TEXT("InputRecorder"), 0, TPri_BelowNormal);
+}
+
+FInputRecorder::~FInputRecorder()
+{
+	//The partially filled chunk is written with the others
+	if (CurrentChunk != INDEX_NONE && Chunks[CurrentChunk].NumFrames)
+	{
+		FilledChunks.Push(CurrentChunk);
+		CurrentChunk = INDEX_NONE;
+	}
+
+	if (Thread)
+	{
+		Stop();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	if (File)
+	{
+		File->Close();
+		delete File;
+		File = nullptr;
+	}
+
+	const double Minutes = RecordedTime / 60.0;
+	UE_LOG(LogRobCogWeb, Log, TEXT("Input: %llu bytes written, %.1f KB per minute, %u frames dropped"),
+		BytesWritten, Minutes > 0.0 ? BytesWritten / 1024.0 / Minutes : 0.0, DroppedFrames);
+	Stats.Report(TEXT("Input"));
+}
+
+const FName* FInputRecorder::GetAxisNames()
+{
+	static const FName AxisNames[FInputFrame::NumAxes] =
+	{
+		FName(TEXT("LookUp")),
+		FName(TEXT("Turn")),
+		FName(TEXT("MoveForward")),
+		FName(TEXT("MoveRight")),
+		FName(TEXT("RotateObject")),
+		FName(TEXT("MoveItemZ")),
+		FName(TEXT("MoveItemY"))
+	};
+	return AxisNames;
+}
+
+FInputFrame* FInputRecorder::BeginFrame(uint64 FrameNumber, double Timestamp, float DeltaTime)
+{
+	//A full chunk is handed over once its last frame has been filled, that is at the next call
+	if (CurrentChunk != INDEX_NONE && Chunks[CurrentChunk].NumFrames == FramesPerChunk)
+	{
+		FilledChunks.Push(CurrentChunk);
+		CurrentChunk = INDEX_NONE;
+	}
+
+	if (CurrentChunk == INDEX_NONE)
+	{
+		if (!FreeChunks.Pop(CurrentChunk))
+		{
+			CurrentChunk = INDEX_NONE;
+			DroppedFrames++;
+			return nullptr;
+		}
+		Chunks[CurrentChunk].NumFrames = 0;
+	}
+
+	FChunk& Chunk = Chunks[CurrentChunk];
+	FInputFrame& Frame = Chunk.Frames[Chunk.NumFrames++];
+	Frame.FrameNumber = FrameNumber;
+	Frame.Timestamp = Timestamp;
+	Frame.DeltaTime = DeltaTime;
+	Frame.Actions = 0;
+	return &Frame;
+}
+
+uint32 FInputRecorder::Run()
+{
+	while (!bStopping)
+	{
+		if (!Drain())
+		{
+			if (File)
+			{
+				File->Flush();
+			}
+			FPlatformProcess::Sleep(0.05f);
+		}
+	}
+	Drain();
+	return 0;
+}
+
+void FInputRecorder::Stop()
+{
+	bStopping = true;
+}
+
+/*Layout of a chunk: tag, frame count, number and world time of the first frame, whether the frame numbers follow each other
+(the gaps are written otherwise), then one column after the other:
+the frame durations in microseconds, each as a varint delta to the previous one;
+for every axis, runs of identical values as (run length, value) until the chunk is covered;
+the actions as a bit stream, one bit per frame telling whether something was pressed, followed by the seven action bits if so.
+@param const FChunk& Chunk  -->  Chunk filled by the game thread
+@param FArchive& Ar  -->  Write buffer*/
+void FInputRecorder::EncodeChunk(const FChunk& Chunk, FArchive& Ar)
+{
+	const int32 NumFrames = Chunk.NumFrames;
+
+	uint8 Tag = ChunkTag;
+	uint16 FileNumFrames = NumFrames;
+	double BaseTime = Chunk.Frames[0].Timestamp;
+	Ar << Tag;
+	Ar << FileNumFrames;
+	LogEncoding::WriteVarint(Ar, Chunk.Frames[0].FrameNumber);
+	Ar << BaseTime;
+
+	uint8 bContiguous = 1;
+	for (int32 i = 1; i < NumFrames && bContiguous; i++)
+	{
+		bContiguous = Chunk.Frames[i].FrameNumber == Chunk.Frames[i - 1].FrameNumber + 1;
+	}
+	Ar << bContiguous;
+	if (!bContiguous)
+	{
+		for (int32 i = 1; i < NumFrames; i++)
+		{
+			LogEncoding::WriteVarint(Ar, Chunk.Frames[i].FrameNumber - Chunk.Frames[i - 1].FrameNumber - 1);
+		}
+	}
+
+	int64 PreviousMicroseconds = 0;
+	for (int32 i = 0; i < NumFrames; i++)
+	{
+		const int64 Microseconds = (int64)FMath::RoundToDouble(Chunk.Frames[i].DeltaTime * 1000000.0);
+		LogEncoding::WriteSignedVarint(Ar, Microseconds - PreviousMicroseconds);
+		PreviousMicroseconds = Microseconds;
+	}
+
+	for (int32 Axis = 0; Axis < FInputFrame::NumAxes; Axis++)
+	{
+		int32 RunStart = 0;
+		while (RunStart < NumFrames)
+		{
+			float Value = Chunk.Frames[RunStart].Axes[Axis];
+			int32 RunEnd = RunStart + 1;
+			while (RunEnd < NumFrames && Chunk.Frames[RunEnd].Axes[Axis] == Value)
+			{
+				RunEnd++;
+			}
+			LogEncoding::WriteVarint(Ar, RunEnd - RunStart);
+			Ar << Value;
+			RunStart = RunEnd;
+		}
+	}
+
+	//Bits are appended from the low end of the accumulator and leave it a byte at a time
+	const int32 ActionBits = (int32)EInputAction::Num;
+	PackedActions.Reset();
+	uint32 Accumulator = 0;
+	int32 NumBits = 0;
+	for (int32 i = 0; i < NumFrames; i++)
+	{
+		const uint32 Actions = Chunk.Frames[i].Actions & ((1 << ActionBits) - 1);
+		if (Actions)
+		{
+			Accumulator |= (1 | (Actions << 1)) << NumBits;
+			NumBits += 1 + ActionBits;
+		}
+		else
+		{
+			NumBits++;
+		}
+		while (NumBits >= 8)
+		{
+			PackedActions.Add((uint8)Accumulator);
+			Accumulator >>= 8;
+			NumBits -= 8;
+		}
+	}
+	if (NumBits)
+	{
+		PackedActions.Add((uint8)Accumulator);
+	}
+	LogEncoding::WriteVarint(Ar, PackedActions.Num());
+	Ar.Serialize(PackedActions.GetData(), PackedActions.Num());
+
+	Stats.RawBytes += NumFrames * (8 + 8 + 4 + FInputFrame::NumAxes * sizeof(float) + 1);
+	RecordedTime += Chunk.Frames[NumFrames - 1].Timestamp - BaseTime + Chunk.Frames[0].DeltaTime;
+}
+
+bool FInputRecorder::Drain()
+{
+	int32 ChunkIndex;
+	if (!FilledChunks.Pop(ChunkIndex))
+	{
+		return false;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	WriteBuffer.Reset();
+	FMemoryWriter Writer(WriteBuffer);
+	do
+	{
+		EncodeChunk(Chunks[ChunkIndex], Writer);
+		FreeChunks.Push(ChunkIndex);
+	} while (FilledChunks.Pop(ChunkIndex));
+	Stats.EncodedBytes += WriteBuffer.Num();
+	Stats.EncodeTime += FPlatformTime::Seconds() - StartTime;
+
+	if (File)
+	{
+		File->Serialize(WriteBuffer.GetData(), WriteBuffer.Num());
+		File->Flush();
+	}
+	BytesWritten += WriteBuffer.Num();
+	return true;
+}
@@ -0,0 +1,127 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "SpscRingBuffer.h"
+#include "LogEncoding.h"
+
+//Axes bound by the character, in the order SetupPlayerInputComponent() binds them (which is the order they are dispatched in)
+enum class EInputAxis : uint8
+{
+	LookUp,
+	Turn,
+	MoveForward,
+	MoveRight,
+	RotateObject,
+	MoveItemZ,
+	MoveItemY,
+	Num
+};
+
+//Actions bound by the character, in the order SetupPlayerInputComponent() binds them
+enum class EInputAction : uint8
+{
+	Click,
+	SwitchSelectedHand,
+	SwitchRotationAxis,
+	GrabWithTwoHands,
+	Pause,
+	Submit,
+	ReturnToPlay,
+	Num
+};
+
+//Input of one frame, as the player input dispatched it to the character
+struct FInputFrame
+{
+	static const int32 NumAxes = (int32)EInputAxis::Num;
+
+	uint64 FrameNumber;
+
+	//World time and duration of the frame
+	double Timestamp;
+	float DeltaTime;
+
+	float Axes[NumAxes];
+
+	//One bit per EInputAction pressed during the frame
+	uint8 Actions;
+};
+
+/*Records the raw input of the character every frame, so that a session can be played back exactly.
+Frames are written by the game thread into preallocated chunks; full chunks go to a background thread which
+encodes them column by column: the frame durations to the microsecond as varint deltas, every axis as runs of
+identical values (an idle axis costs a few bytes per chunk), and the actions on one bit per frame plus seven
+for the rare frames with a press. A 20 minute session takes a few hundred KB.
+Only the game thread may call BeginFrame().
+*/
+class FInputRecorder : public FRunnable
+{
+public:
+	//Opens the input file and starts the writer thread, OnSegmentWritten is called on it with each segment of the file once it is in place
+	FInputRecorder(const FString& InFilePath, const FString& LevelName, const TFunction<void(const FString&)>& OnSegmentWritten = nullptr);
+
+	//Writes the remaining frames and closes the file
+	virtual ~FInputRecorder();
+
+	//Returns the frame to fill, or null if no chunk is free
+	FInputFrame* BeginFrame(uint64 FrameNumber, double Timestamp, float DeltaTime);
+
+	//Names of the axes in the input settings, indexed by EInputAxis
+	static const FName* GetAxisNames();
+
+	//FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+	//Identifies the file format, bumped whenever the layout changes. 2 starts every segment on a record, the header being a
+	//record of its own; 1 could cut a chunk between two segments
+	static const uint32 Magic = 0x49574352; // 'RCWI'
+	static const uint16 Version = 2;
+
+	//Record tag of the chunks
+	static const uint8 ChunkTag = 'C';
+
+	//Frames per chunk and chunks allocated for the episode
+	static const int32 FramesPerChunk = 256;
+	static const int32 NumChunks = 8;
+
+private:
+	struct FChunk
+	{
+		int32 NumFrames;
+		FInputFrame Frames[FramesPerChunk];
+	};
+
+	//Encodes and appends a chunk to the write buffer
+	void EncodeChunk(const FChunk& Chunk, FArchive& Ar);
+
+	//Writes the filled chunks and gives them back to the game thread, returns false if there was nothing to write
+	bool Drain();
+
+	//Chunks allocated once, owned by the game thread while free and by the writer thread once filled
+	TArray<FChunk> Chunks;
+	TSpscRingBuffer<int32, NumChunks> FilledChunks;
+	TSpscRingBuffer<int32, NumChunks> FreeChunks;
+
+	//Chunk being filled by the game thread, INDEX_NONE if none was free
+	int32 CurrentChunk;
+
+	//Frames lost because every chunk was waiting to be written, only touched by the game thread
+	uint32 DroppedFrames;
+
+	//Recorded duration and bytes written, to report the rate at close
+	double RecordedTime;
+	uint64 BytesWritten;
+	FLogEncodingStats Stats;
+
+	FArchive* File;
+
+	//Serialization buffer and packed actions, reused between drains
+	TArray<uint8> WriteBuffer;
+	TArray<uint8> PackedActions;
+
+	FThreadSafeBool bStopping;
+
+	FRunnableThread* Thread;
+};
@@ -0,0 +1,178 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "ItemPool.h"
+#include "Engine/StaticMeshActor.h"
+
+// Sets default values
+AItemPool::AItemPool()
+{
+	//The pool only reacts to requests, it has nothing to do every frame
+	PrimaryActorTick.bCanEverTick = false;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("PoolLocation"));
+
+	ThePlayer = nullptr;
+}
+
+// Called when the game starts or when spawned
+void AItemPool::BeginPlay()
+{
+	Super::BeginPlay();
+
+	ThePlayer = Cast<AMyCharacter>(UGameplayStatics::GetPlayerPawn(this, 0));
+
+	//Warm-up: reserve the bookkeeping for every instance before spawning them, so that later requests never grow it
+	int32 TotalCount = 0;
+	for (const auto& Entry : Entries)
+	{
+		if (Entry.Mesh)
+		{
+			TArray<AStaticMeshActor*>& Free = FreeItems.FindOrAdd(Entry.Mesh);
+			Free.Reserve(Free.Max() + Entry.Count);
+			TotalCount += Entry.Count;
+		}
+	}
+	ActiveItems.Reserve(TotalCount);
+
+	for (const auto& Entry : Entries)
+	{
+		if (!Entry.Mesh)
+		{
+			continue;
+		}
+		TArray<AStaticMeshActor*>& Free = FreeItems.FindChecked(Entry.Mesh);
+		for (int32 i = 0; i < Entry.Count; i++)
+		{
+			if (AStaticMeshActor* Item = SpawnInstance(Entry))
+			{
+				Free.Add(Item);
+			}
+		}
+	}
+}
+
+/*Spawns a deactivated item and registers it as an interactive item of the character,
+exactly as if it had been placed in the level with the 'Item' tag.
+@param const FItemPoolEntry& Entry  -->  Description of the item to spawn*/
+AStaticMeshActor* AItemPool::SpawnInstance(const FItemPoolEntry& Entry)
+{
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.Owner = this;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	AStaticMeshActor* Item = GetWorld()->SpawnActor<AStaticMeshActor>(GetActorLocation(), GetActorRotation(), SpawnParams);
+	if (!Item)
+	{
+		UE_LOG(LogRobCogWeb, Error, TEXT("Item pool could not spawn an instance of %s"), *Entry.Mesh->GetName());
+		return nullptr;
+	}
+	Item->GetStaticMeshComponent()->SetMobility(EComponentMobility::Movable);
+	Item->GetStaticMeshComponent()->SetStaticMesh(Entry.Mesh);
+
+	Item->Tags.Add(FName(TEXT("Item")));
+	Item->Tags.Append(Entry.Tags);
+
+	Deactivate(Item);
+
+	if (ThePlayer)
+	{
+		ThePlayer->RegisterItem(Item, Entry.ItemType);
+	}
+	return Item;
+}
+
+void AItemPool::Deactivate(AStaticMeshActor* Item)
+{
+	UStaticMeshComponent* Mesh = Item->GetStaticMeshComponent();
+	Mesh->SetSimulatePhysics(false);
+	Mesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Mesh->SetWorldLocationAndRotation(GetActorLocation(), GetActorRotation(), false, nullptr, ETeleportType::TeleportPhysics);
+	Item->SetActorHiddenInGame(true);
+}
+
+/*Places a free instance of the mesh in the world, with the same properties as an item dropped by the character.
+@param UStaticMesh* Mesh  -->  Mesh of the item wanted
+@param const FTransform& Transform  -->  World transform of the activated item*/
+AActor* AItemPool::Acquire(UStaticMesh* Mesh, const FTransform& Transform)
+{
+	TArray<AStaticMeshActor*>* Free = FreeItems.Find(Mesh);
+	if (!Free)
+	{
+		return nullptr;
+	}
+
+	AStaticMeshActor* Item = nullptr;
+	if (Free->Num())
+	{
+		Item = Free->Pop(false);
+	}
+	else
+	{
+		//Pool too small for the layout, grow it rather than failing the request
+		for (const auto& Entry : Entries)
+		{
+			if (Entry.Mesh == Mesh)
+			{
+				UE_LOG(LogRobCogWeb, Warning, TEXT("Item pool exhausted for %s, spawning a new instance"), *Mesh->GetName());
+				Item = SpawnInstance(Entry);
+				break;
+			}
+		}
+		if (!Item)
+		{
+			return nullptr;
+		}
+	}
+
+	UStaticMeshComponent* ItemMesh = Item->GetStaticMeshComponent();
+	ItemMesh->SetWorldTransform(Transform, false, nullptr, ETeleportType::TeleportPhysics);
+	Item->SetActorHiddenInGame(false);
+	ItemMesh->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
+	ItemMesh->SetSimulatePhysics(true);
+	ItemMesh->SetEnableGravity(true);
+
+	ActiveItems.Add(Item);
+	return Item;
+}
+
+AActor* AItemPool::AcquireByType(EItemType ItemType, const FTransform& Transform)
+{
+	for (const auto& Entry : Entries)
+	{
+		if (Entry.ItemType == ItemType && Entry.Mesh)
+		{
+			return Acquire(Entry.Mesh, Transform);
+		}
+	}
+	return nullptr;
+}
+
+/*Gives an item back to the pool. Items held by the character should be dropped before.
+@param AActor* Item  -->  Item previously returned by Acquire()*/
+void AItemPool::Release(AActor* Item)
+{
+	AStaticMeshActor* PooledItem = Cast<AStaticMeshActor>(Item);
+	if (!PooledItem || ActiveItems.RemoveSingleSwap(PooledItem, false) == 0)
+	{
+		return;
+	}
+
+	Deactivate(PooledItem);
+	FreeItems.FindChecked(PooledItem->GetStaticMeshComponent()->StaticMesh).Add(PooledItem);
+}
+
+void AItemPool::ReleaseAll()
+{
+	for (AStaticMeshActor* Item : ActiveItems)
+	{
+		Deactivate(Item);
+		FreeItems.FindChecked(Item->GetStaticMeshComponent()->StaticMesh).Add(Item);
+	}
+	ActiveItems.Reset();
+}
+
+int32 AItemPool::GetActiveCount() const
+{
+	return ActiveItems.Num();
+}
@@ -0,0 +1,98 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "MyCharacter.h"
+#include "GameFramework/Actor.h"
+#include "ItemPool.generated.h"
+
+class AStaticMeshActor;
+
+//Describes how many instances of an item the pool should pre-allocate
+USTRUCT(BlueprintType)
+struct FItemPoolEntry
+{
+	GENERATED_USTRUCT_BODY()
+
+	//Type under which the instances are registered in the character's ItemMap
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	EItemType ItemType;
+
+	//Mesh of the item, also used as the key of the pool
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	UStaticMesh* Mesh;
+
+	//Number of instances spawned at warm-up
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	int32 Count;
+
+	//Tags added to the instances besides 'Item' (eg: 'Stackable' and the item type, needed for stacking)
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	TArray<FName> Tags;
+
+	FItemPoolEntry()
+		: ItemType(EItemType::GeneralItem)
+		, Mesh(nullptr)
+		, Count(0)
+	{
+	}
+};
+
+/*Pre-allocates the movable kitchen items used by randomized layouts.
+Instances are spawned once in BeginPlay() and only activated / deactivated afterwards,
+so changing the layout of the kitchen does not spawn, destroy or allocate anything.
+Inactive instances are hidden, without collision and parked at the location of the pool,
+which should therefore be placed outside of the playable area.
+*/
+UCLASS()
+class ROBCOGWEB_API AItemPool : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this actor's properties
+	AItemPool();
+
+	// Called when the game starts or when spawned
+	virtual void BeginPlay() override;
+
+	//Items and instance counts to pre-allocate
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Pool")
+	TArray<FItemPoolEntry> Entries;
+
+	//Activates a free instance of the mesh at the given transform, returns null if the mesh is not pooled or no instance could be spawned
+	UFUNCTION(BlueprintCallable, Category = "Pool")
+	AActor* Acquire(UStaticMesh* Mesh, const FTransform& Transform);
+
+	//Activates a free instance of the first entry with the given item type
+	UFUNCTION(BlueprintCallable, Category = "Pool")
+	AActor* AcquireByType(EItemType ItemType, const FTransform& Transform);
+
+	//Deactivates an instance and gives it back to the pool
+	UFUNCTION(BlueprintCallable, Category = "Pool")
+	void Release(AActor* Item);
+
+	//Deactivates every instance currently in use, eg: before applying a new layout
+	UFUNCTION(BlueprintCallable, Category = "Pool")
+	void ReleaseAll();
+
+	//Number of instances currently in use
+	UFUNCTION(BlueprintCallable, Category = "Pool")
+	int32 GetActiveCount() const;
+
+protected:
+	//Spawns a new deactivated instance for the entry and registers it with the character, null if the spawn failed
+	AStaticMeshActor* SpawnInstance(const FItemPoolEntry& Entry);
+
+	//Hide the instance, disable its collision and physics and park it at the pool location
+	void Deactivate(AStaticMeshActor* Item);
+
+	//Character whose interactable tables the instances are registered in
+	AMyCharacter* ThePlayer;
+
+	//Free instances for each pooled mesh
+	TMap<UStaticMesh*, TArray<AStaticMeshActor*>> FreeItems;
+
+	//Instances currently placed in the world
+	TArray<AStaticMeshActor*> ActiveItems;
+};
@@ -0,0 +1,106 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "KitchenRandomizer.h"
+#include "ItemPool.h"
+
+// Sets default values
+AKitchenRandomizer::AKitchenRandomizer()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	Pool = nullptr;
+	Seed = 0;
+	MaxLayoutRetries = 10;
+}
+
+FLayoutGenerator* AKitchenRandomizer::GetGenerator()
+{
+	if (!Generator.IsValid() && Pool)
+	{
+		TArray<FLayoutItemKind> Kinds;
+		KindEntries.Empty();
+
+		for (int32 i = 0; i < Pool->Entries.Num(); i++)
+		{
+			const FItemPoolEntry& Entry = Pool->Entries[i];
+			if (!Entry.Mesh)
+			{
+				continue;
+			}
+			const FBox Bounds = Entry.Mesh->GetBoundingBox();
+
+			FLayoutItemKind Kind;
+			Kind.BoundsMin = Bounds.Min;
+			Kind.BoundsMax = Bounds.Max;
+			Kind.bStackable = Entry.Tags.Contains(FName(TEXT("Stackable")));
+			Kind.Available = Entry.Count;
+			Kinds.Add(Kind);
+			KindEntries.Add(i);
+		}
+		Generator = MakeUnique<FLayoutGenerator>(Kinds, Surfaces);
+
+		//The free pool instances have no collision, what collides is the furniture and the items authored in the level
+		for (TActorIterator<AActor> It(GetWorld()); It; ++It)
+		{
+			if (*It != this && *It != Pool && !It->bHidden && !Cast<APawn>(*It))
+			{
+				Generator->AddObstacle(It->GetComponentsBoundingBox());
+			}
+		}
+	}
+	return Generator.Get();
+}
+
+/*Seed of a retry: the seeds after the first wrap around instead of overflowing, and step over 0 which stands for the authored layout
+@param int32 LayoutSeed  -->  Seed of the first try
+@param int32 Retry  -->  Number of the retry, 0 for the first try*/
+static int32 GetRetrySeed(int32 LayoutSeed, int32 Retry)
+{
+	const uint32 Seed = (uint32)LayoutSeed + (uint32)Retry;
+	return (int32)(Seed < (uint32)LayoutSeed ? Seed + 1 : Seed);
+}
+
+/*Generates the layout for the seed and moves the pool instances in place.
+Invalid layouts (a surface below its minimum) are retried with the next seeds, the seed of the applied layout is returned.
+When every retry is invalid the pool is left empty, so only the items placed in the level remain, and 0 is returned;
+the seed 0 applies that authored layout again, eg: when resuming or replaying such a trial.
+@param int32 LayoutSeed  -->  Seed of the layout*/
+int32 AKitchenRandomizer::ApplyLayout(int32 LayoutSeed)
+{
+	FLayoutGenerator* LayoutGenerator = GetGenerator();
+	if (!LayoutGenerator)
+	{
+		return LayoutSeed;
+	}
+
+	Pool->ReleaseAll();
+	if (LayoutSeed == 0)
+	{
+		UE_LOG(LogRobCogWeb, Log, TEXT("Applied the authored kitchen layout"));
+		return 0;
+	}
+
+	int32 UsedSeed = 0;
+	for (int32 Retry = 0; Retry < MaxLayoutRetries; Retry++)
+	{
+		if (LayoutGenerator->Generate(GetRetrySeed(LayoutSeed, Retry), Layout))
+		{
+			UsedSeed = Layout.Seed;
+			break;
+		}
+	}
+	if (!UsedSeed)
+	{
+		UE_LOG(LogRobCogWeb, Error, TEXT("No valid kitchen layout for seed %d after %d tries, keeping the authored layout"), LayoutSeed, MaxLayoutRetries);
+		return 0;
+	}
+
+	for (const auto& Placement : Layout.Placements)
+	{
+		Pool->Acquire(Pool->Entries[KindEntries[Placement.Kind]].Mesh, FTransform(FRotator(0.f, Placement.Yaw, 0.f), Placement.Location));
+	}
+
+	UE_LOG(LogRobCogWeb, Log, TEXT("Applied kitchen layout with seed %d (%d items)"), UsedSeed, Layout.Placements.Num());
+	return UsedSeed;
+}
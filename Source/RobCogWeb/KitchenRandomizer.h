@@ -0,0 +1,56 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "LayoutGenerator.h"
+#include "GameFramework/Actor.h"
+#include "KitchenRandomizer.generated.h"
+
+class AItemPool;
+
+/*Places the items of the pool on the configured surfaces with a seeded random layout.
+The game mode picks the seed at level start (or restores it when resuming) and stores it with the episode,
+so any trial can be reproduced from its seed.
+*/
+UCLASS()
+class ROBCOGWEB_API AKitchenRandomizer : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this actor's properties
+	AKitchenRandomizer();
+
+	//Pool providing the item instances
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Randomizer")
+	AItemPool* Pool;
+
+	//Areas of the kitchen on which items are placed (island, drawers, sink)
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Randomizer")
+	TArray<FLayoutSurface> Surfaces;
+
+	//Fixed seed for every trial, 0 lets the game mode pick a new one for each trial
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Randomizer")
+	int32 Seed;
+
+	//Layouts tried for a seed before falling back to the layout authored in the level
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Randomizer")
+	int32 MaxLayoutRetries;
+
+	//Replaces the items currently placed by the layout generated from the seed, returns the seed actually used or 0 for the authored layout
+	UFUNCTION(BlueprintCallable, Category = "Randomizer")
+	int32 ApplyLayout(int32 LayoutSeed);
+
+	//Builds the generator from the pool entries and the actors of the level the first time it is needed, null without a pool
+	FLayoutGenerator* GetGenerator();
+
+protected:
+
+	//Maps the layout item kinds back to the pool entries
+	TArray<int32> KindEntries;
+
+	TUniquePtr<FLayoutGenerator> Generator;
+
+	//Reused between layouts
+	FKitchenLayout Layout;
+};
@@ -0,0 +1,193 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "KitchenSnapshot.h"
+
+FArchive& operator<<(FArchive& Ar, FActorSnapshotRecord& Record)
+{
+	Ar << Record.ActorId;
+	Ar << Record.Location;
+	Ar << Record.Rotation;
+	Ar << Record.AssetState;
+	return Ar;
+}
+
+FCharacterSnapshot::FCharacterSnapshot()
+{
+	//Same defaults as a freshly spawned character
+	RightHandItem = 0;
+	LeftHandItem = 0;
+	RightHandRotator = FRotator::ZeroRotator;
+	LeftHandRotator = FRotator::ZeroRotator;
+	RightZPos = 30.f;
+	LeftZPos = 30.f;
+	RightYPos = 20;
+	LeftYPos = 20;
+	bRightHandSelected = true;
+}
+
+FArchive& operator<<(FArchive& Ar, FCharacterSnapshot& Character)
+{
+	Ar << Character.RightHandItem;
+	Ar << Character.LeftHandItem;
+	Ar << Character.TwoHandItems;
+	Ar << Character.RightHandRotator;
+	Ar << Character.LeftHandRotator;
+	Ar << Character.RightZPos;
+	Ar << Character.LeftZPos;
+	Ar << Character.RightYPos;
+	Ar << Character.LeftYPos;
+	Ar << Character.bRightHandSelected;
+	return Ar;
+}
+
+FKitchenSnapshot::FKitchenSnapshot()
+{
+	Progress = ELevelProgress::Playing;
+	LayoutSeed = 0;
+}
+
+void FKitchenSnapshot::Merge(const FKitchenSnapshot& Delta)
+{
+	Progress = Delta.Progress;
+	LayoutSeed = Delta.LayoutSeed;
+	Character = Delta.Character;
+
+	for (const auto& Record : Delta.Actors)
+	{
+		const int32* Index = ActorIndex.Find(Record.ActorId);
+		if (Index)
+		{
+			Actors[*Index] = Record;
+		}
+		else
+		{
+			ActorIndex.Add(Record.ActorId, Actors.Add(Record));
+		}
+	}
+}
+
+bool FKitchenSnapshot::Serialize(FArchive& Ar)
+{
+	uint32 FileMagic = Magic;
+	uint16 FileVersion = Version;
+	Ar << FileMagic;
+	Ar << FileVersion;
+
+	//Refuse files written by another format version, the level then simply starts from scratch
+	if (FileMagic != Magic || FileVersion != Version)
+	{
+		return false;
+	}
+
+	Ar << Progress;
+	Ar << LayoutSeed;
+	Ar << Character;
+	Ar << Actors;
+
+	if (Ar.IsLoading())
+	{
+		ActorIndex.Empty(Actors.Num());
+		for (int32 i = 0; i < Actors.Num(); i++)
+		{
+			ActorIndex.Add(Actors[i].ActorId, i);
+		}
+	}
+	return !Ar.IsError();
+}
+
+bool FKitchenSnapshot::LoadFromFile(const FString& FilePath, FKitchenSnapshot& OutSnapshot)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *FilePath, FILEREAD_Silent))
+	{
+		return false;
+	}
+	FMemoryReader Reader(Bytes);
+	return OutSnapshot.Serialize(Reader);
+}
+
+FString FKitchenSnapshot::GetFilePath(const FString& LevelName)
+{
+	return FPaths::Combine(*FPaths::GameSavedDir(), TEXT("Snapshots"), *(LevelName + TEXT(".snap")));
+}
+
+FKitchenSnapshotWriter::FKitchenSnapshotWriter(const FString& InFilePath, const FKitchenSnapshot& BaseSnapshot)
+	: FilePath(InFilePath)
+	, Snapshot(BaseSnapshot)
+{
+	WorkEvent = FPlatformProcess::GetSynchEventFromPool();
+	Thread = FRunnableThread::Create(this, TEXT("KitchenSnapshotWriter"), 0, TPri_BelowNormal);
+}
+
+FKitchenSnapshotWriter::~FKitchenSnapshotWriter()
+{
+	if (Thread)
+	{
+		Stop();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+	FPlatformProcess::ReturnSynchEventToPool(WorkEvent);
+	WorkEvent = nullptr;
+}
+
+void FKitchenSnapshotWriter::Enqueue(const FKitchenSnapshot& Delta)
+{
+	PendingDeltas.Enqueue(Delta);
+	WorkEvent->Trigger();
+}
+
+uint32 FKitchenSnapshotWriter::Run()
+{
+	while (!bStopping)
+	{
+		WorkEvent->Wait();
+		WritePending();
+	}
+	//Make sure the last delta sent before stopping reaches the disk
+	WritePending();
+	return 0;
+}
+
+void FKitchenSnapshotWriter::Stop()
+{
+	bStopping = true;
+	WorkEvent->Trigger();
+}
+
+void FKitchenSnapshotWriter::WritePending()
+{
+	if (PendingDeltas.IsEmpty())
+	{
+		return;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	FKitchenSnapshot Delta;
+	int32 ChangedActors = 0;
+	while (PendingDeltas.Dequeue(Delta))
+	{
+		ChangedActors += Delta.Actors.Num();
+		Snapshot.Merge(Delta);
+	}
+
+	TArray<uint8> Bytes;
+	FMemoryWriter Writer(Bytes);
+	Snapshot.Serialize(Writer);
+
+	//Write next to the old file and swap, so a reload during the write never sees a half written snapshot
+	const FString TempPath = FilePath + TEXT(".tmp");
+	if (FFileHelper::SaveArrayToFile(Bytes, *TempPath) && IFileManager::Get().Move(*FilePath, *TempPath, true))
+	{
+		LastSnapshotSize.Set(Bytes.Num());
+		UE_LOG(LogRobCogWeb, Verbose, TEXT("Snapshot written: %d bytes, %d changed actors, %.2f ms"),
+			Bytes.Num(), ChangedActors, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+	}
+	else
+	{
+		UE_LOG(LogRobCogWeb, Warning, TEXT("Could not write snapshot to %s"), *FilePath);
+	}
+}
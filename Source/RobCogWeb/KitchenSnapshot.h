@@ -0,0 +1,124 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "RobCogWebGameMode.h"
+
+//State of one interactive actor (item, drawer or door) stored in a snapshot
+struct FActorSnapshotRecord
+{
+	//Stable id of the actor (see FActorIdRegistry), used to find it again when restoring
+	uint32 ActorId;
+
+	//World pose of the actor (items are never scaled at runtime)
+	FVector Location;
+	FQuat Rotation;
+
+	//Open/closed state for drawers and doors, Unkown for items
+	EAssetState AssetState;
+
+	friend FArchive& operator<<(FArchive& Ar, FActorSnapshotRecord& Record);
+};
+
+//What the character holds and how the held items have been adjusted
+struct FCharacterSnapshot
+{
+	//Ids of the items held in each hand, 0 if the hand is free
+	uint32 RightHandItem;
+	uint32 LeftHandItem;
+
+	//Ids of the items held with both hands, ordered from bottom to top of the stack
+	TArray<uint32> TwoHandItems;
+
+	//Rotation and position adjustments of the items held
+	FRotator RightHandRotator;
+	FRotator LeftHandRotator;
+	float RightZPos;
+	float LeftZPos;
+	float RightYPos;
+	float LeftYPos;
+
+	bool bRightHandSelected;
+
+	FCharacterSnapshot();
+
+	friend FArchive& operator<<(FArchive& Ar, FCharacterSnapshot& Character);
+};
+
+/*Compact binary image of the interaction state of a level.
+Written incrementally: each delta only carries the actors changed since the previous one,
+the writer thread merges the deltas into the full snapshot kept on disk.
+*/
+struct FKitchenSnapshot
+{
+	//Identifies the file format, bumped whenever the layout changes
+	static const uint32 Magic = 0x53574352; // 'RCWS'
+	static const uint16 Version = 3;
+
+	ELevelProgress Progress;
+
+	//Seed of the item layout the recorded changes were made on
+	int32 LayoutSeed;
+
+	FCharacterSnapshot Character;
+
+	TArray<FActorSnapshotRecord> Actors;
+
+	FKitchenSnapshot();
+
+	//Overwrites the records of this snapshot with the ones from the delta, adds the missing ones
+	void Merge(const FKitchenSnapshot& Delta);
+
+	//Serialize to or from a byte buffer, returns false if the data is not a valid snapshot
+	bool Serialize(FArchive& Ar);
+
+	//Helpers for reading and writing snapshot files
+	static bool LoadFromFile(const FString& FilePath, FKitchenSnapshot& OutSnapshot);
+	static FString GetFilePath(const FString& LevelName);
+
+private:
+	//Index from actor id to the position of its record in Actors, used when merging
+	TMap<uint32, int32> ActorIndex;
+};
+
+/*Background thread which merges snapshot deltas and writes them to disk,
+so that the game thread never waits on file I/O
+*/
+class FKitchenSnapshotWriter : public FRunnable
+{
+public:
+	//Starts the writer thread; BaseSnapshot is the state restored at level load (if any)
+	FKitchenSnapshotWriter(const FString& InFilePath, const FKitchenSnapshot& BaseSnapshot);
+
+	//Flushes the pending deltas and stops the thread
+	virtual ~FKitchenSnapshotWriter();
+
+	//Hands a delta over to the writer thread, called from the game thread
+	void Enqueue(const FKitchenSnapshot& Delta);
+
+	//FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+	//Size in bytes of the last snapshot written to disk
+	FThreadSafeCounter LastSnapshotSize;
+
+private:
+	//Merges every queued delta and rewrites the snapshot file
+	void WritePending();
+
+	FString FilePath;
+
+	//Full state as currently written on disk
+	FKitchenSnapshot Snapshot;
+
+	//Deltas produced by the game thread, consumed by the writer thread
+	TQueue<FKitchenSnapshot, EQueueMode::Spsc> PendingDeltas;
+
+	//Wakes the thread up when there is something to write
+	FEvent* WorkEvent;
+
+	FThreadSafeBool bStopping;
+
+	FRunnableThread* Thread;
+};
@@ -0,0 +1,275 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "LayoutGenerator.h"
+#include "StackingRules.h"
+
+FLayoutGenerator::FLayoutGenerator(const TArray<FLayoutItemKind>& InKinds, const TArray<FLayoutSurface>& InSurfaces)
+	: Kinds(InKinds)
+	, Surfaces(InSurfaces)
+{
+	CellSize = 10.f;
+	StackChance = 0.5f;
+	MaxStackHeight = 4;
+	MaxAttempts = 20;
+	Margin = 1.f;
+	ObstacleTolerance = 2.f;
+
+	MaxItemHeight = 0.f;
+	for (const FLayoutItemKind& Kind : Kinds)
+	{
+		MaxItemHeight = FMath::Max(MaxItemHeight, Kind.BoundsMax.Z - Kind.BoundsMin.Z);
+	}
+
+	//Grid cells are computed once, only their content changes between layouts
+	GridSize.SetNum(Surfaces.Num());
+	GridOffset.SetNum(Surfaces.Num());
+	int32 CellCount = 0;
+	for (int32 i = 0; i < Surfaces.Num(); i++)
+	{
+		const FVector Size = Surfaces[i].Area.GetSize();
+		GridSize[i] = FIntPoint(FMath::Max(1, FMath::CeilToInt(Size.X / CellSize)), FMath::Max(1, FMath::CeilToInt(Size.Y / CellSize)));
+		GridOffset[i] = CellCount;
+		CellCount += GridSize[i].X * GridSize[i].Y;
+	}
+	CellHeads.SetNumUninitialized(CellCount);
+	Remaining.SetNumUninitialized(Kinds.Num());
+}
+
+void FLayoutGenerator::ResetGrid()
+{
+	for (int32& Head : CellHeads)
+	{
+		Head = INDEX_NONE;
+	}
+	CellEntries.Reset();
+	Footprints.Reset();
+	FootprintSurface.Reset();
+
+	//Actors around a surface (eg: the furniture it belongs to) start below it, only the ones standing on it take room
+	for (const FBox& Obstacle : Obstacles)
+	{
+		for (int32 Surface = 0; Surface < Surfaces.Num(); Surface++)
+		{
+			const FBox& Area = Surfaces[Surface].Area;
+			if (Obstacle.Min.Z < Area.Min.Z - ObstacleTolerance || Obstacle.Min.Z > Area.Min.Z + MaxItemHeight ||
+				Obstacle.Min.X > Area.Max.X || Obstacle.Max.X < Area.Min.X || Obstacle.Min.Y > Area.Max.Y || Obstacle.Max.Y < Area.Min.Y)
+			{
+				continue;
+			}
+
+			FFootprint Footprint;
+			Footprint.Kind = INDEX_NONE;
+			Footprint.Min = FVector2D(Obstacle.Min);
+			Footprint.Max = FVector2D(Obstacle.Max);
+			Footprint.TopPlacement = INDEX_NONE;
+			Footprint.Height = 0;
+			AddFootprint(Surface, Footprint);
+		}
+	}
+}
+
+void FLayoutGenerator::AddObstacle(const FBox& Bounds)
+{
+	if (Bounds.IsValid)
+	{
+		Obstacles.Add(Bounds);
+	}
+}
+
+void FLayoutGenerator::GetCellRange(int32 Surface, const FVector2D& Min, const FVector2D& Max, FIntPoint& OutMin, FIntPoint& OutMax) const
+{
+	const FVector& Origin = Surfaces[Surface].Area.Min;
+	const FIntPoint& Size = GridSize[Surface];
+	OutMin.X = FMath::Clamp(FMath::FloorToInt((Min.X - Origin.X) / CellSize), 0, Size.X - 1);
+	OutMin.Y = FMath::Clamp(FMath::FloorToInt((Min.Y - Origin.Y) / CellSize), 0, Size.Y - 1);
+	OutMax.X = FMath::Clamp(FMath::FloorToInt((Max.X - Origin.X) / CellSize), 0, Size.X - 1);
+	OutMax.Y = FMath::Clamp(FMath::FloorToInt((Max.Y - Origin.Y) / CellSize), 0, Size.Y - 1);
+}
+
+bool FLayoutGenerator::Overlaps(int32 Surface, const FVector2D& Min, const FVector2D& Max) const
+{
+	FIntPoint CellMin, CellMax;
+	GetCellRange(Surface, Min, Max, CellMin, CellMax);
+
+	for (int32 Y = CellMin.Y; Y <= CellMax.Y; Y++)
+	{
+		for (int32 X = CellMin.X; X <= CellMax.X; X++)
+		{
+			for (int32 Entry = CellHeads[GridOffset[Surface] + Y * GridSize[Surface].X + X]; Entry != INDEX_NONE; Entry = CellEntries[Entry].Next)
+			{
+				const FFootprint& Other = Footprints[CellEntries[Entry].Footprint];
+				if (Min.X < Other.Max.X + Margin && Other.Min.X < Max.X + Margin &&
+					Min.Y < Other.Max.Y + Margin && Other.Min.Y < Max.Y + Margin)
+				{
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+void FLayoutGenerator::AddFootprint(int32 Surface, const FFootprint& Footprint)
+{
+	const int32 FootprintIndex = Footprints.Add(Footprint);
+	FootprintSurface.Add(Surface);
+
+	FIntPoint CellMin, CellMax;
+	GetCellRange(Surface, Footprint.Min, Footprint.Max, CellMin, CellMax);
+
+	for (int32 Y = CellMin.Y; Y <= CellMax.Y; Y++)
+	{
+		for (int32 X = CellMin.X; X <= CellMax.X; X++)
+		{
+			int32& Head = CellHeads[GridOffset[Surface] + Y * GridSize[Surface].X + X];
+			FCellEntry Entry;
+			Entry.Footprint = FootprintIndex;
+			Entry.Next = Head;
+			Head = CellEntries.Add(Entry);
+		}
+	}
+}
+
+/*Stacking rule of the character: the new item copies the rotation of the topmost one and rests on its bounds*/
+bool FLayoutGenerator::TryStack(int32 Kind, int32 Surface, FRandomStream& Stream, FKitchenLayout& OutLayout)
+{
+	//Start from a random footprint so that stacks grow evenly
+	const int32 Count = Footprints.Num();
+	if (!Count)
+	{
+		return false;
+	}
+	const int32 First = Stream.RandHelper(Count);
+	for (int32 i = 0; i < Count; i++)
+	{
+		FFootprint& Stack = Footprints[(First + i) % Count];
+		const FLayoutItemKind& ItemKind = Kinds[Kind];
+		if (!FStackingRules::CanStack(ItemKind.bStackable, Stack.Kind == Kind) || FootprintSurface[(First + i) % Count] != Surface || Stack.Height >= MaxStackHeight)
+		{
+			continue;
+		}
+
+		const FLayoutPlacement& Top = OutLayout.Placements[Stack.TopPlacement];
+
+		FLayoutPlacement Placement;
+		Placement.Kind = Kind;
+		Placement.Surface = Surface;
+		Placement.Location = FStackingRules::GetStackedLocation(Top.Location, ItemKind.BoundsMax.Z, ItemKind.BoundsMin.Z);
+		Placement.Yaw = Top.Yaw;
+
+		Stack.TopPlacement = OutLayout.Placements.Add(Placement);
+		Stack.Height++;
+		return true;
+	}
+	return false;
+}
+
+bool FLayoutGenerator::TryPlace(int32 Kind, int32 Surface, FRandomStream& Stream, FKitchenLayout& OutLayout)
+{
+	const FLayoutItemKind& ItemKind = Kinds[Kind];
+	const FBox& Area = Surfaces[Surface].Area;
+
+	for (int32 Attempt = 0; Attempt < MaxAttempts; Attempt++)
+	{
+		const float Yaw = Stream.FRandRange(0.f, 360.f);
+
+		//Extent of the rotated bounds in the surface plane
+		float Sin, Cos;
+		FMath::SinCos(&Sin, &Cos, FMath::DegreesToRadians(Yaw));
+		const FVector2D LocalMin(ItemKind.BoundsMin.X, ItemKind.BoundsMin.Y);
+		const FVector2D LocalMax(ItemKind.BoundsMax.X, ItemKind.BoundsMax.Y);
+		const FVector2D Center = (LocalMin + LocalMax) * 0.5f;
+		const FVector2D HalfSize = (LocalMax - LocalMin) * 0.5f;
+		const FVector2D Extent(FMath::Abs(Cos) * HalfSize.X + FMath::Abs(Sin) * HalfSize.Y, FMath::Abs(Sin) * HalfSize.X + FMath::Abs(Cos) * HalfSize.Y);
+		const FVector2D RotatedCenter(Cos * Center.X - Sin * Center.Y, Sin * Center.X + Cos * Center.Y);
+
+		//Item does not fit on the surface at all with this rotation
+		if (Area.Min.X + Extent.X > Area.Max.X - Extent.X || Area.Min.Y + Extent.Y > Area.Max.Y - Extent.Y)
+		{
+			continue;
+		}
+
+		const FVector2D FootprintCenter(Stream.FRandRange(Area.Min.X + Extent.X, Area.Max.X - Extent.X), Stream.FRandRange(Area.Min.Y + Extent.Y, Area.Max.Y - Extent.Y));
+		const FVector2D Min = FootprintCenter - Extent;
+		const FVector2D Max = FootprintCenter + Extent;
+
+		if (Overlaps(Surface, Min, Max))
+		{
+			continue;
+		}
+
+		//Rest the bottom of the bounds on the surface, with the gap the character leaves on static surfaces
+		FLayoutPlacement Placement;
+		Placement.Kind = Kind;
+		Placement.Surface = Surface;
+		Placement.Location = FVector(FootprintCenter - RotatedCenter, FStackingRules::GetRestingZ(Area.Min.Z, ItemKind.BoundsMin.Z));
+		Placement.Yaw = Yaw;
+
+		FFootprint Footprint;
+		Footprint.Kind = Kind;
+		Footprint.Min = Min;
+		Footprint.Max = Max;
+		Footprint.TopPlacement = OutLayout.Placements.Add(Placement);
+		Footprint.Height = 1;
+		AddFootprint(Surface, Footprint);
+		return true;
+	}
+	return false;
+}
+
+/*Generates the layout for a seed. The same seed and inputs always give the same layout,
+which is what makes the trials reproducible.
+@param int32 Seed  -->  Seed of the random stream
+@param FKitchenLayout& OutLayout  -->  Layout to fill, its buffers are reused*/
+bool FLayoutGenerator::Generate(int32 Seed, FKitchenLayout& OutLayout)
+{
+	FRandomStream Stream(Seed);
+	OutLayout.Seed = Seed;
+	OutLayout.Placements.Reset();
+	ResetGrid();
+
+	for (int32 Kind = 0; Kind < Kinds.Num(); Kind++)
+	{
+		Remaining[Kind] = Kinds[Kind].Available;
+	}
+
+	bool bValid = true;
+	for (int32 Surface = 0; Surface < Surfaces.Num(); Surface++)
+	{
+		const int32 Target = Stream.RandRange(Surfaces[Surface].MinItems, FMath::Max(Surfaces[Surface].MinItems, Surfaces[Surface].MaxItems));
+		int32 Placed = 0;
+
+		for (int32 Item = 0; Item < Target; Item++)
+		{
+			//Pick a random kind which still has instances left
+			int32 Kind = INDEX_NONE;
+			const int32 FirstKind = Kinds.Num() ? Stream.RandHelper(Kinds.Num()) : 0;
+			for (int32 i = 0; i < Kinds.Num(); i++)
+			{
+				if (Remaining[(FirstKind + i) % Kinds.Num()] > 0)
+				{
+					Kind = (FirstKind + i) % Kinds.Num();
+					break;
+				}
+			}
+			if (Kind == INDEX_NONE)
+			{
+				break;
+			}
+
+			const bool bStacked = Kinds[Kind].bStackable && Stream.FRand() < StackChance && TryStack(Kind, Surface, Stream, OutLayout);
+			if (bStacked || TryPlace(Kind, Surface, Stream, OutLayout))
+			{
+				Remaining[Kind]--;
+				Placed++;
+			}
+		}
+
+		if (Placed < Surfaces[Surface].MinItems)
+		{
+			bValid = false;
+		}
+	}
+	return bValid;
+}
@@ -0,0 +1,162 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "LayoutGenerator.generated.h"
+
+//Area of the kitchen on which the randomizer may place items (eg: island top, drawer bottom, sink)
+USTRUCT(BlueprintType)
+struct FLayoutSurface
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	FName Name;
+
+	//World space area, items are placed within its X/Y limits and rest on its minimum Z
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	FBox Area;
+
+	//Number of items placed on the surface for each layout
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	int32 MinItems;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	int32 MaxItems;
+
+	FLayoutSurface()
+		: Area(ForceInit)
+		, MinItems(0)
+		, MaxItems(0)
+	{
+	}
+};
+
+//Item the generator may place, described by its local bounds
+struct FLayoutItemKind
+{
+	//Local bounds of the mesh, as returned by GetLocalBounds()
+	FVector BoundsMin;
+	FVector BoundsMax;
+
+	//Stackable items of the same kind can be placed on top of each other
+	bool bStackable;
+
+	//Number of instances available (eg: the size of the pool)
+	int32 Available;
+};
+
+//Pose chosen for one item
+struct FLayoutPlacement
+{
+	int32 Kind;
+	int32 Surface;
+	FVector Location;
+	float Yaw;
+};
+
+//Result of the generator, fully determined by the seed
+struct FKitchenLayout
+{
+	int32 Seed;
+	TArray<FLayoutPlacement> Placements;
+};
+
+/*Generates physically valid item layouts from a seed, without touching the world.
+Placement follows the FStackingRules the character places its items with: items rest on the surface,
+stackable items of the same kind are placed right on top of each other with the same rotation,
+and only the topmost item of a stack can receive another one (as checked by AMyCharacter::HasAnyOnTop()).
+Overlaps are tested with a uniform grid over each surface, against the items of the layout and the obstacles
+standing on the surface (the authored actors and the world geometry, see AddObstacle()); all buffers are reused
+between calls so that thousands of layouts per second can be generated for offline validation.
+*/
+class FLayoutGenerator
+{
+public:
+	FLayoutGenerator(const TArray<FLayoutItemKind>& InKinds, const TArray<FLayoutSurface>& InSurfaces);
+
+	//Fills the layout for the seed, returns false if a surface could not receive its minimum number of items
+	bool Generate(int32 Seed, FKitchenLayout& OutLayout);
+
+	//Keeps the items away from the world space bounds of an actor of the level, on the surfaces it stands on
+	void AddObstacle(const FBox& Bounds);
+
+	//Size of the grid cells in cm
+	float CellSize;
+
+	//Chance for a stackable item to be placed on an existing stack of its kind
+	float StackChance;
+
+	//Maximum number of items in a stack
+	int32 MaxStackHeight;
+
+	//Random positions tried for an item before giving up on it
+	int32 MaxAttempts;
+
+	//Empty space kept between two items, in cm
+	float Margin;
+
+	//Distance below a surface within which the bottom of an obstacle still counts as standing on it, in cm
+	float ObstacleTolerance;
+
+private:
+	//Area covered on a surface by an item or a stack of items, or by an obstacle (no kind)
+	struct FFootprint
+	{
+		int32 Kind;
+		FVector2D Min;
+		FVector2D Max;
+		//Placement of the topmost item of the stack
+		int32 TopPlacement;
+		int32 Height;
+	};
+
+	//Links a footprint to one of the grid cells it covers
+	struct FCellEntry
+	{
+		int32 Footprint;
+		int32 Next;
+	};
+
+	//Prepares the grid of each surface with the obstacles standing on it, called once per layout
+	void ResetGrid();
+
+	//Returns true if the rectangle overlaps a footprint placed on the surface
+	bool Overlaps(int32 Surface, const FVector2D& Min, const FVector2D& Max) const;
+
+	//Registers a footprint in the cells it covers
+	void AddFootprint(int32 Surface, const FFootprint& Footprint);
+
+	//Cell range covered by a rectangle on a surface
+	void GetCellRange(int32 Surface, const FVector2D& Min, const FVector2D& Max, FIntPoint& OutMin, FIntPoint& OutMax) const;
+
+	//Tries to put an item of the kind on top of a stack of the surface
+	bool TryStack(int32 Kind, int32 Surface, FRandomStream& Stream, FKitchenLayout& OutLayout);
+
+	//Tries to put an item of the kind directly on the surface
+	bool TryPlace(int32 Kind, int32 Surface, FRandomStream& Stream, FKitchenLayout& OutLayout);
+
+	TArray<FLayoutItemKind> Kinds;
+	TArray<FLayoutSurface> Surfaces;
+
+	//Grid dimensions and offset in CellHeads for each surface
+	TArray<FIntPoint> GridSize;
+	TArray<int32> GridOffset;
+
+	//First entry of each cell, INDEX_NONE if empty
+	TArray<int32> CellHeads;
+	TArray<FCellEntry> CellEntries;
+
+	//Footprints of the layout being generated, and the surface of each of them
+	TArray<FFootprint> Footprints;
+	TArray<int32> FootprintSurface;
+
+	//Instances left for each kind in the layout being generated
+	TArray<int32> Remaining;
+
+	//World space bounds of the obstacles
+	TArray<FBox> Obstacles;
+
+	//Height of the tallest kind, obstacles starting higher above a surface leave room for the items
+	float MaxItemHeight;
+};
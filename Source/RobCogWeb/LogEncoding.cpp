@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "LogEncoding.h"
+
+void LogEncoding::WriteQuat(FArchive& Ar, const FQuat& Quat)
+{
+	const float Components[4] = { Quat.X, Quat.Y, Quat.Z, Quat.W };
+	int32 Largest = 0;
+	for (int32 i = 1; i < 4; i++)
+	{
+		if (FMath::Abs(Components[i]) > FMath::Abs(Components[Largest]))
+		{
+			Largest = i;
+		}
+	}
+
+	//q and -q are the same rotation, flip it so that the dropped component is positive
+	const float Sign = Components[Largest] < 0.f ? -1.f : 1.f;
+	uint64 Packed = Largest;
+	int32 Shift = 2;
+	for (int32 i = 0; i < 4; i++)
+	{
+		if (i == Largest)
+		{
+			continue;
+		}
+		//The other components are within +-1/sqrt(2) once the largest one is dropped
+		const float Normalized = FMath::Clamp(Components[i] * Sign * 0.70710678f + 0.5f, 0.f, 1.f);
+		Packed |= (uint64)FMath::RoundToInt(Normalized * 32767.f) << Shift;
+		Shift += 15;
+	}
+
+	uint16 Low = Packed & 0xFFFF;
+	uint32 High = (uint32)(Packed >> 16);
+	Ar << Low;
+	Ar << High;
+}
+
+FQuat LogEncoding::ReadQuat(FArchive& Ar)
+{
+	uint16 Low;
+	uint32 High;
+	Ar << Low;
+	Ar << High;
+	const uint64 Packed = Low | ((uint64)High << 16);
+
+	const int32 Largest = Packed & 3;
+	float Components[4];
+	float SumSquares = 0.f;
+	int32 Shift = 2;
+	for (int32 i = 0; i < 4; i++)
+	{
+		if (i == Largest)
+		{
+			continue;
+		}
+		const float Normalized = ((Packed >> Shift) & 0x7FFF) / 32767.f;
+		Components[i] = (Normalized - 0.5f) * 1.41421356f;
+		SumSquares += Components[i] * Components[i];
+		Shift += 15;
+	}
+	Components[Largest] = FMath::Sqrt(FMath::Max(0.f, 1.f - SumSquares));
+	return FQuat(Components[0], Components[1], Components[2], Components[3]);
+}
+
+void FLogEncodingStats::Report(const TCHAR* LogName) const
+{
+	UE_LOG(LogRobCogWeb, Log, TEXT("%s: %llu bytes encoded to %llu (%.1fx), %.1f MB/s"), LogName, RawBytes, EncodedBytes,
+		EncodedBytes ? (double)RawBytes / EncodedBytes : 0.0, EncodeTime > 0.0 ? RawBytes / EncodeTime / (1024.0 * 1024.0) : 0.0);
+}
@@ -0,0 +1,130 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/*Compact encodings shared by the episode logs, self-contained so that they can run in the web build:
+zig-zag varints for integers and deltas, positions quantized to 0.1 mm and 48-bit smallest-three quaternions.
+The names are never repeated: the logs only carry actor ids, which the episode maps to names and tags once in Actors.bin and Names.bin (see FActorIdRegistry, FNameTable).
+*/
+namespace LogEncoding
+{
+	//Size in cm of the position quantization step
+	static const float PositionUnit = 0.01f;
+
+	//Maps signed values to unsigned ones so that small magnitudes give small varints (0, -1, 1, -2 -> 0, 1, 2, 3)
+	FORCEINLINE uint64 ZigZag(int64 Value)
+	{
+		return ((uint64)Value << 1) ^ (uint64)(Value >> 63);
+	}
+
+	FORCEINLINE int64 UnZigZag(uint64 Value)
+	{
+		return (int64)(Value >> 1) ^ -(int64)(Value & 1);
+	}
+
+	//7 bits per byte, the high bit tells that more bytes follow
+	FORCEINLINE void WriteVarint(FArchive& Ar, uint64 Value)
+	{
+		uint8 Bytes[10];
+		int32 Count = 0;
+		while (Value >= 0x80)
+		{
+			Bytes[Count++] = (uint8)(Value | 0x80);
+			Value >>= 7;
+		}
+		Bytes[Count++] = (uint8)Value;
+		Ar.Serialize(Bytes, Count);
+	}
+
+	FORCEINLINE void WriteSignedVarint(FArchive& Ar, int64 Value)
+	{
+		WriteVarint(Ar, ZigZag(Value));
+	}
+
+	FORCEINLINE uint64 ReadVarint(FArchive& Ar)
+	{
+		uint64 Value = 0;
+		for (int32 Shift = 0; Shift < 64 && !Ar.AtEnd(); Shift += 7)
+		{
+			uint8 Byte;
+			Ar << Byte;
+			Value |= (uint64)(Byte & 0x7F) << Shift;
+			if (!(Byte & 0x80))
+			{
+				break;
+			}
+		}
+		return Value;
+	}
+
+	FORCEINLINE int64 ReadSignedVarint(FArchive& Ar)
+	{
+		return UnZigZag(ReadVarint(Ar));
+	}
+
+	FORCEINLINE FIntVector QuantizeLocation(const FVector& Location)
+	{
+		return FIntVector(FMath::RoundToInt(Location.X / PositionUnit), FMath::RoundToInt(Location.Y / PositionUnit), FMath::RoundToInt(Location.Z / PositionUnit));
+	}
+
+	FORCEINLINE FVector DequantizeLocation(const FIntVector& Location)
+	{
+		return FVector(Location.X, Location.Y, Location.Z) * PositionUnit;
+	}
+
+	//Writes the difference to the previous position and makes the position the new reference
+	FORCEINLINE void WriteLocationDelta(FArchive& Ar, const FIntVector& Location, FIntVector& Previous)
+	{
+		WriteSignedVarint(Ar, Location.X - Previous.X);
+		WriteSignedVarint(Ar, Location.Y - Previous.Y);
+		WriteSignedVarint(Ar, Location.Z - Previous.Z);
+		Previous = Location;
+	}
+
+	FORCEINLINE FIntVector ReadLocationDelta(FArchive& Ar, FIntVector& Previous)
+	{
+		Previous.X += (int32)ReadSignedVarint(Ar);
+		Previous.Y += (int32)ReadSignedVarint(Ar);
+		Previous.Z += (int32)ReadSignedVarint(Ar);
+		return Previous;
+	}
+
+	//Three smallest components on 15 bits each plus the index of the largest one, stored on 6 bytes
+	void WriteQuat(FArchive& Ar, const FQuat& Quat);
+	FQuat ReadQuat(FArchive& Ar);
+
+	//Writes the time since the previous timestamp in milliseconds and advances the previous timestamp by what was written
+	FORCEINLINE void WriteTimeDelta(FArchive& Ar, double Timestamp, double& Previous)
+	{
+		const int64 Milliseconds = FMath::Max<int64>(0, (int64)FMath::RoundToDouble((Timestamp - Previous) * 1000.0));
+		WriteVarint(Ar, Milliseconds);
+		Previous += Milliseconds / 1000.0;
+	}
+
+	FORCEINLINE double ReadTimeDelta(FArchive& Ar, double& Previous)
+	{
+		Previous += ReadVarint(Ar) / 1000.0;
+		return Previous;
+	}
+}
+
+//Compression achieved by a log, reported when it closes
+struct FLogEncodingStats
+{
+	//Bytes the records would take with the fixed-size layout, and bytes actually written
+	uint64 RawBytes;
+	uint64 EncodedBytes;
+
+	//Seconds spent encoding
+	double EncodeTime;
+
+	FLogEncodingStats()
+		: RawBytes(0)
+		, EncodedBytes(0)
+		, EncodeTime(0.0)
+	{
+	}
+
+	//Logs the compression ratio and the encoding speed
+	void Report(const TCHAR* LogName) const;
+};
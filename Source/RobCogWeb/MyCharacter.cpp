@@ -2,6 +2,12 @@
 
 #include "RobCogWeb.h"
 #include "MyCharacter.h"
+#include "KitchenSnapshot.h"
+#include "StartupBenchmark.h"
+#include "TrajectoryLogger.h"
+#include "TaskEvaluator.h"
+#include "StackingRules.h"
+#include "SemanticMapExporter.h"
 #include "GameFramework/InputSettings.h"
 
 
@@ -67,6 +73,13 @@ AMyCharacter::AMyCharacter()
 	
 	//Default speed multiplier
 	CharacterSpeed = 0.4;
+
+	//Events are only recorded once the game mode starts an episode
+	EventLogger = nullptr;
+	TrajectoryLogger = nullptr;
+	InputRecorder = nullptr;
+	TaskEvaluator = nullptr;
+	PendingActions = 0;
 }
 
 // Called when the game starts or when spawned
@@ -74,12 +87,16 @@ void AMyCharacter::BeginPlay()
 {
 	Super::BeginPlay();
 
+	FStartupBenchmark::Mark(EStartupMilestone::CharacterBeginPlayStart);
+
 	//Gets all actors in the world, used for identifying our drawers and setting their initial state to closed
 	UGameplayStatics::GetAllActorsOfClass(GetWorld(), AActor::StaticClass(), AllActors);
 
 	//Loop that maps the actors in the level world to the proper array list
 	for (const auto ActorIt : AllActors)
 	{
+		ActorIds.Register(ActorIt);
+
 		//Set default stencil value (for blue outline effect)
 		if (GetStaticMesh(ActorIt))
 		{
@@ -91,17 +108,30 @@ void AMyCharacter::BeginPlay()
 		{
 			if (GetStaticMesh(ActorIt) != nullptr)
 			{
-				if (!ActorIt->GetName().Contains("Door"))
+				//Doors are tagged 'Door' in the level or have a door handle; the tag is added to the latter,
+				//so that the exporters and the episode tools tell doors from drawers by the tag alone
+				AActor* Asset = ActorIt->GetAttachParentActor();
+				if (Asset && (Asset->ActorHasTag(FName(TEXT("Door"))) || ActorIt->GetName().Contains("Door")))
+				{
+					Asset->Tags.AddUnique(FName(TEXT("Door")));
+				}
+				else
 				{
 					GetStaticMesh(ActorIt)->AddImpulse(-1 * AppliedForce * ActorIt->GetActorForwardVector());
 				}
 				AssetStateMap.Add(ActorIt->GetAttachParentActor(), EAssetState::Closed);
+				HandleMap.Add(ActorIt, ActorIt->GetAttachParentActor());
 			}
 		}
 		//Remember to tag pickable items with 'Item' when adding them into the world
 		else if (ActorIt->ActorHasTag(FName(TEXT("Item"))))
 		{
-			ItemMap.Add(ActorIt, EItemType::GeneralItem);
+			//Keep the type of items which have allready been registered (eg: by the item pool)
+			ItemMap.FindOrAdd(ActorIt);
+		}
+		else if (FSemanticMapCapture::IsSurface(ActorIt))
+		{
+			Surfaces.Add(ActorIt);
 		}
 
 		//Populate the list of stackable items in world. These assets should have the 'Stackable' tag
@@ -110,6 +140,8 @@ void AMyCharacter::BeginPlay()
 			AllStackableItems.Add(ActorIt);
 		}
 	}
+
+	FStartupBenchmark::Mark(EStartupMilestone::CharacterBeginPlayEnd);
 }
 
 /*This method loops through the components of an actor 
@@ -150,7 +182,8 @@ TSet<AActor*> AMyCharacter::GetStack(AActor* ContainedItem)
 	*/
 	for (const auto Iterator : AllStackableItems)
 	{
-		if (Iterator->Tags == ContainedItem->Tags)
+		//The id tags are unique, only the other tags tell the kind of the item
+		if (FActorIdRegistry::HaveSameTags(Iterator, ContainedItem))
 		{
 			if ((ContainedItem->GetActorLocation().X - 2 < Iterator->GetActorLocation().X) &&
 				(Iterator->GetActorLocation().X < ContainedItem->GetActorLocation().X + 2) &&
@@ -187,6 +220,8 @@ Picks up stacks of items at once using both 'hands'
 */
 void AMyCharacter::GrabWithTwoHands()
 {
+	MarkInput(EInputAction::GrabWithTwoHands);
+
 	/**
 		Section to treat unacceptable function calls
 	*/
@@ -245,11 +280,17 @@ void AMyCharacter::GrabWithTwoHands()
 			FirstIndex = LocalStackVariable.Num() - StackGrabLimit;
 		}
 
+		//Each item of the stack is taken off the one below it, the bottom one off what it rests on; traced while it still collides
+		const AActor* Support = FindSupport(LocalStackVariable[FSetElementId::FromInteger(FirstIndex)]);
+
 		for (int i = FirstIndex; i < LocalStackVariable.Num(); i++)
 		{
 			GetStaticMesh(LocalStackVariable[FSetElementId::FromInteger(i)])->SetEnableGravity(false);
 			GetStaticMesh(LocalStackVariable[FSetElementId::FromInteger(i)])->SetCollisionEnabled(ECollisionEnabled::NoCollision);
 			ReturnStack.Add(LocalStackVariable[FSetElementId::FromInteger(i)]);
+			MarkChanged(LocalStackVariable[FSetElementId::FromInteger(i)]);
+			LogEvent(ESemanticEventKind::Pick, EEventHand::Both, LocalStackVariable[FSetElementId::FromInteger(i)], Support);
+			Support = LocalStackVariable[FSetElementId::FromInteger(i)];
 		}
 		TwoHandSlot = ReturnStack;
 		SelectedObject = LocalStackVariable[FSetElementId::FromInteger(LocalStackVariable.Num()-1)];
@@ -279,13 +320,13 @@ void AMyCharacter::PlaceOnTop(AActor* ActorToPlace, FHitResult HitSurface)
 	else
 	{
 		//Small offset to make sure objects are not colliding when we place them
-		HMax.Z = 0.2;
+		HMax.Z = FStackingRules::SurfaceGap;
 	}
 
 	//Check if the items are stackable together, and if so place them acordingly (copy rotation and match positioning)
-	if (ActorToPlace->ActorHasTag(FName(TEXT("Stackable"))) && ActorToPlace->Tags == HitSurface.GetActor()->Tags)
+	if (FStackingRules::CanStack(ActorToPlace->ActorHasTag(FName(TEXT("Stackable"))), FActorIdRegistry::HaveSameTags(ActorToPlace, HitSurface.GetActor())))
 	{
-		GetStaticMesh(ActorToPlace)->SetWorldLocationAndRotation(HitSurface.GetActor()->GetActorLocation() + FVector(0.f, 0.f, HMax.Z - Min.Z), HitSurface.GetActor()->GetActorRotation());
+		GetStaticMesh(ActorToPlace)->SetWorldLocationAndRotation(FStackingRules::GetStackedLocation(HitSurface.GetActor()->GetActorLocation(), HMax.Z, Min.Z), HitSurface.GetActor()->GetActorRotation());
 	}
 	else
 	{
@@ -311,9 +352,10 @@ Physical constraint joints are used within the editor to restrict the movement o
 void AMyCharacter::OpenCloseAction(AActor* OpenableActor)
 {
 	//Switch to parent if user has clicked on a handle
-	if (OpenableActor->GetName().Contains("Handle"))
+	AActor* const* HandleParent = HandleMap.Find(OpenableActor);
+	if (HandleParent)
 	{
-		OpenableActor = OpenableActor->GetAttachParentActor();
+		OpenableActor = *HandleParent;
 	}
 
 	//Check that function call is valid
@@ -329,12 +371,16 @@ void AMyCharacter::OpenCloseAction(AActor* OpenableActor)
 		{
 			GetStaticMesh(OpenableActor)->AddImpulse(AppliedForce * OpenableActor->GetActorForwardVector());
 			AssetStateMap.Add(OpenableActor, EAssetState::Open);
+			MarkChanged(OpenableActor);
+			LogEvent(ESemanticEventKind::Open, GetSelectedHand(), OpenableActor);
 		}
 		//Apply force to close
 		else if (AssetStateMap.FindRef(OpenableActor) == EAssetState::Open)
 		{
 			GetStaticMesh(OpenableActor)->AddImpulse(-AppliedForce * OpenableActor->GetActorForwardVector());
 			AssetStateMap.Add(OpenableActor, EAssetState::Closed);
+			MarkChanged(OpenableActor);
+			LogEvent(ESemanticEventKind::Close, GetSelectedHand(), OpenableActor);
 		}
 		return;
 	}
@@ -345,54 +391,15 @@ void AMyCharacter::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
-	//Draw a straight line in front of our character
-	Start = MyCharacterCamera->GetComponentLocation();
-	End = Start + MyCharacterCamera->GetForwardVector()*MaxGraspLength;
-	HitObject = FHitResult(ForceInit);
-	GetWorld()->LineTraceSingleByChannel(HitObject, Start, End, ECC_Pawn, TraceParams);
+	RecordInput(DeltaTime);
 
-	//Mouse hovered behaviour with an empty hand
-	if (!SelectedObject)
-	{
-		//Turn off the highlight effect when changing to another actor
-		if (HighlightedActor && HitObject.GetActor() != HighlightedActor)
-		{
-			GetStaticMesh(HighlightedActor)->SetRenderCustomDepth(false);
-			HighlightedActor = nullptr;
-		}
-
-		//Check if there is an object blocking the hit and if it is in our hand's range
-		if (HitObject.bBlockingHit && HitObject.Distance < MaxGraspLength)
-		{
-			//Check if the object has interractive behaviour enabled
-			if (AssetStateMap.Contains(HitObject.GetActor()) || AssetStateMap.Contains(HitObject.GetActor()->GetAttachParentActor()) || ItemMap.Contains(HitObject.GetActor()))
-			{
-				HighlightedActor = HitObject.GetActor();
-				GetStaticMesh(HighlightedActor)->SetRenderCustomDepth(true);
-			}
-		}
-	}
-
-	//Behaviour for selected object in hand
-	else
-	{
-		//Turn off the highlight effect because we can't pick up with this hand.
-		if (HighlightedActor && HighlightedActor)
-		{
-			GetStaticMesh(HighlightedActor)->SetRenderCustomDepth(false);
-			HighlightedActor = nullptr;
-		}
-
-		//Enable the player to access rotation mode
-		bRotationModeAllowed = true;
-
-	}
+	UpdateFocus();
 
 	//Draw object from the right hand
 	if (RightHandSlot)
 	{
 		RightHandSlot->SetActorRotation(RightHandRotator + FRotator(0.f, GetActorRotation().Yaw, 0.f));
-		GetStaticMesh(RightHandSlot)->SetWorldLocation(GetActorLocation() + FVector(20.f, 20.f, 20.f) * GetActorForwardVector() + FVector(RightYPos, RightYPos, RightYPos) * GetActorRightVector() + FVector(0.f, 0.f, RightZPos));
+		GetStaticMesh(RightHandSlot)->SetWorldLocation(GetHandLocation(true));
 
 		//Add highlight if it is selected
 		if (SelectedObject == RightHandSlot)
@@ -409,7 +416,7 @@ void AMyCharacter::Tick(float DeltaTime)
 	if (LeftHandSlot)
 	{
 		LeftHandSlot->SetActorRotation(LeftHandRotator + FRotator(0.f, GetActorRotation().Yaw, 0.f));
-		GetStaticMesh(LeftHandSlot)->SetWorldLocation(GetActorLocation() + FVector(20.f, 20.f, 20.f) * GetActorForwardVector() - FVector(LeftYPos, LeftYPos, LeftYPos) * GetActorRightVector() + FVector(0.f, 0.f, LeftZPos));
+		GetStaticMesh(LeftHandSlot)->SetWorldLocation(GetHandLocation(false));
 
 		//Add highlight if it is selected
 		if (SelectedObject == LeftHandSlot)
@@ -449,6 +456,8 @@ void AMyCharacter::Tick(float DeltaTime)
 			GetStaticMesh(SelectedObject)->SetRenderCustomDepth(false);
 		}
 	}
+
+	RecordTrajectory();
 }
 
 // Called to bind functionality to input
@@ -525,6 +534,8 @@ void AMyCharacter::MoveRight(const float Value)
 /*Toggle between which hand to perform actions with*/
 void AMyCharacter::SwitchSelectedHand()
 {
+	MarkInput(EInputAction::SwitchSelectedHand);
+
 	if (TwoHandSlot.Num())
 	{
 		return;
@@ -546,15 +557,17 @@ void AMyCharacter::SwitchSelectedHand()
 	RotationAxisIndex = 0;
 }
 
-//Empty body, behaviour set up in blueprint
+//Behaviour set up in blueprint, the press is only recorded here
 void AMyCharacter::Pause()
 {
-
+	MarkInput(EInputAction::Pause);
 }
 
-/*Method to finish the game and submit the progress to the database*/
+/*Method to finish the game, the episode is uploaded once the level exits (see FEpisodeUploader)*/
 void AMyCharacter::Submit()
 {
+	MarkInput(EInputAction::Submit);
+
 	if (UGameplayStatics::GetCurrentLevelName(GetWorld(), true) == "TutorialLevel")
 	{
 		return;
@@ -565,6 +578,8 @@ void AMyCharacter::Submit()
 /*Method to return to playing state after calling the Submit() method*/
 void AMyCharacter::ReturnToPlay()
 {
+	MarkInput(EInputAction::ReturnToPlay);
+
 	if (UGameplayStatics::GetCurrentLevelName(GetWorld(), true) == "TutorialLevel")
 	{
 		return;
@@ -576,6 +591,8 @@ void AMyCharacter::ReturnToPlay()
 Based on the current state of the character it either picks up or drops an item in the world, or open/close drawers and doors*/
 void AMyCharacter::Click()
 {
+	MarkInput(EInputAction::Click);
+
 	//Exit function call if invalid apelation
 	if (!HitObject.IsValidBlockingHit())
 	{
@@ -630,6 +647,9 @@ void AMyCharacter::PickToInventory(AActor* CurrentObject)
 	//Get the stack which contains this item in order to grab the topmost item only
 	TSet<AActor*> LocalStackVariable = GetStack(CurrentObject);
 
+	//What the item is taken off, traced while it still collides
+	const AActor* Support = FindSupport(CurrentObject);
+
 	//Change the referenced of the selected object to the one we actually manipulate
 	SelectedObject = CurrentObject;
 	
@@ -653,6 +673,9 @@ void AMyCharacter::PickToInventory(AActor* CurrentObject)
 	GetStaticMesh(CurrentObject)->SetCollisionEnabled(ECollisionEnabled::NoCollision);
 	//Ignore clicking on item if held in hand
 	TraceParams.AddIgnoredComponent(GetStaticMesh(CurrentObject));
+
+	MarkChanged(CurrentObject);
+	LogEvent(ESemanticEventKind::Pick, GetSelectedHand(), CurrentObject, Support);
 }
 
 /*Method called when wanting to place an object previously picked up back in the world.
@@ -678,6 +701,8 @@ void AMyCharacter::DropFromInventory(AActor* CurrentObject, FHitResult HitSurfac
 	{
 		bool bFirstLoop = true;
 		FVector WorldPositionChange = FVector(0.f, 0.f, 0.f);
+		//Each item of the stack lands on the one below it, the bottom one on the surface clicked
+		const AActor* Support = HitSurface.GetActor();
 
 		for (auto Iterator : TwoHandSlot)
 		{
@@ -696,6 +721,9 @@ void AMyCharacter::DropFromInventory(AActor* CurrentObject, FHitResult HitSurfac
 				WorldPositionChange = WorldPositionChange - Iterator->GetActorLocation();
 				bFirstLoop = false;
 			}
+			MarkChanged(Iterator);
+			LogEvent(ESemanticEventKind::Drop, EEventHand::Both, Iterator, Support);
+			Support = Iterator;
 		}
 		TwoHandSlot.Empty();
 		GetStaticMesh(SelectedObject)->SetCustomDepthStencilValue(1);
@@ -705,7 +733,9 @@ void AMyCharacter::DropFromInventory(AActor* CurrentObject, FHitResult HitSurfac
 	}
 
 	PlaceOnTop(CurrentObject, HitSurface);
-	
+	MarkChanged(CurrentObject);
+	LogEvent(ESemanticEventKind::Drop, GetSelectedHand(), CurrentObject, HitSurface.GetActor());
+
 	//Reset ignored parameters
 	TraceParams.ClearIgnoredComponents();
 
@@ -746,6 +776,8 @@ void AMyCharacter::DropFromInventory(AActor* CurrentObject, FHitResult HitSurfac
 
 void AMyCharacter::SwitchRotationAxis()
 {
+	MarkInput(EInputAction::SwitchRotationAxis);
+
 	//Exit function call if rotation is not permited here
 	if (!bRotationModeAllowed)
 	{
@@ -844,25 +876,19 @@ void AMyCharacter::MoveItemY(const float Value)
 bool AMyCharacter::HasAnyOnTop(const AActor* CheckActor)
 {
 	GetStaticMesh(CheckActor)->GetLocalBounds(Min, Max);
-	FVector LowBound = CheckActor->GetActorLocation() + Min;
-	FVector HighBound = CheckActor->GetActorLocation() + Max;
 	FVector HMin, HMax;
 
 	//Loop through the list of items and check if it's location is on top of our item of interest
 	for (const auto Item : ItemMap)
 	{
-		FVector IteratorLocation = Item.Key->GetActorLocation();
-
-		if (Item.Key != CheckActor &&
-			(LowBound.X < IteratorLocation.X && HighBound.X > IteratorLocation.X) &&
-			(LowBound.Y < IteratorLocation.Y && HighBound.Y > IteratorLocation.Y) &&
-			(CheckActor->GetActorLocation().Z + Min.Z< IteratorLocation.Z && HighBound.Z + 15 > IteratorLocation.Z))
+		if (Item.Key == CheckActor)
 		{
-			GetStaticMesh(Item.Key)->GetLocalBounds(HMin, HMax);
-			if (IteratorLocation.Z + HMin.Z > CheckActor->GetActorLocation().Z + Min.Z)
-			{
-				return true;                                                                                        
-			}
+			continue;
+		}
+		GetStaticMesh(Item.Key)->GetLocalBounds(HMin, HMax);
+		if (FStackingRules::IsOnTop(CheckActor->GetActorLocation(), Min, Max, Item.Key->GetActorLocation(), HMin.Z))
+		{
+			return true;
 		}
 	}
 	return false;
@@ -892,5 +918,311 @@ void AMyCharacter::UpdateCharacterSpeed()
 	return;
 }
 
+void AMyCharacter::MarkChanged(AActor* Actor)
+{
+	DirtyActors.Add(Actor);
+	ChangedActors.Add(Actor);
+}
+
+void AMyCharacter::LogEvent(ESemanticEventKind Kind, EEventHand Hand, const AActor* Actor, const AActor* Surface)
+{
+	if (EventLogger)
+	{
+		EventLogger->Log(Kind, Hand, Actor, ActorIds.GetId(Actor), ActorIds.GetId(Surface), GetWorld()->GetTimeSeconds());
+	}
+	if (TaskEvaluator)
+	{
+		TaskEvaluator->OnEvent(Kind, Actor, Surface, GetWorld()->GetTimeSeconds());
+	}
+}
+
+EEventHand AMyCharacter::GetSelectedHand() const
+{
+	return bRightHandSelected ? EEventHand::Right : EEventHand::Left;
+}
+
+AActor* AMyCharacter::FindSupport(const AActor* Item) const
+{
+	FVector Origin;
+	FVector Extent;
+	Item->GetActorBounds(false, Origin, Extent);
+
+	FCollisionQueryParams Params(FName(TEXT("Support")), false, Item);
+	FHitResult Hit;
+	if (GetWorld()->LineTraceSingleByChannel(Hit, Origin, Origin - FVector(0.f, 0.f, Extent.Z + FTaskEvaluator::SupportTraceDepth), ECC_Visibility, Params))
+	{
+		return Hit.GetActor();
+	}
+	return nullptr;
+}
+
+FVector AMyCharacter::GetHandLocation(bool bRightHand) const
+{
+	if (bRightHand)
+	{
+		return GetActorLocation() + FVector(20.f, 20.f, 20.f) * GetActorForwardVector() + FVector(RightYPos, RightYPos, RightYPos) * GetActorRightVector() + FVector(0.f, 0.f, RightZPos);
+	}
+	return GetActorLocation() + FVector(20.f, 20.f, 20.f) * GetActorForwardVector() - FVector(LeftYPos, LeftYPos, LeftYPos) * GetActorRightVector() + FVector(0.f, 0.f, LeftZPos);
+}
+
+/*First step of the tick, split out so that a replay can refocus after moving the camera within a frame*/
+void AMyCharacter::UpdateFocus()
+{
+	//Draw a straight line in front of our character
+	Start = MyCharacterCamera->GetComponentLocation();
+	End = Start + MyCharacterCamera->GetForwardVector()*MaxGraspLength;
+	HitObject = FHitResult(ForceInit);
+	GetWorld()->LineTraceSingleByChannel(HitObject, Start, End, ECC_Pawn, TraceParams);
+
+	//Mouse hovered behaviour with an empty hand
+	if (!SelectedObject)
+	{
+		//Turn off the highlight effect when changing to another actor
+		if (HighlightedActor && HitObject.GetActor() != HighlightedActor)
+		{
+			GetStaticMesh(HighlightedActor)->SetRenderCustomDepth(false);
+			HighlightedActor = nullptr;
+		}
+
+		//Check if there is an object blocking the hit and if it is in our hand's range
+		if (HitObject.bBlockingHit && HitObject.Distance < MaxGraspLength)
+		{
+			//Check if the object has interractive behaviour enabled
+			if (AssetStateMap.Contains(HitObject.GetActor()) || AssetStateMap.Contains(HitObject.GetActor()->GetAttachParentActor()) || ItemMap.Contains(HitObject.GetActor()))
+			{
+				HighlightedActor = HitObject.GetActor();
+				GetStaticMesh(HighlightedActor)->SetRenderCustomDepth(true);
+			}
+		}
+	}
+
+	//Behaviour for selected object in hand
+	else
+	{
+		//Turn off the highlight effect because we can't pick up with this hand.
+		if (HighlightedActor && HighlightedActor)
+		{
+			GetStaticMesh(HighlightedActor)->SetRenderCustomDepth(false);
+			HighlightedActor = nullptr;
+		}
+
+		//Enable the player to access rotation mode
+		bRotationModeAllowed = true;
+
+	}
+}
+
+/*Called at the end of the tick, once the held items have been moved to their new pose.
+The hands are the points where the items of each hand are drawn, oriented like the items they would hold.*/
+void AMyCharacter::RecordTrajectory()
+{
+	if (!TrajectoryLogger)
+	{
+		return;
+	}
+
+	FTrajectorySample* Sample = TrajectoryLogger->BeginSample(GetWorld()->GetTimeSeconds());
+	if (!Sample)
+	{
+		return;
+	}
+
+	const FRotator Yaw(0.f, GetActorRotation().Yaw, 0.f);
+	Sample->Bodies[FTrajectorySample::Camera].Location = MyCharacterCamera->GetComponentLocation();
+	Sample->Bodies[FTrajectorySample::Camera].Rotation = MyCharacterCamera->GetComponentQuat();
+	Sample->Bodies[FTrajectorySample::RightHand].Location = GetHandLocation(true);
+	Sample->Bodies[FTrajectorySample::RightHand].Rotation = (RightHandRotator + Yaw).Quaternion();
+	Sample->Bodies[FTrajectorySample::LeftHand].Location = GetHandLocation(false);
+	Sample->Bodies[FTrajectorySample::LeftHand].Rotation = (LeftHandRotator + Yaw).Quaternion();
+
+	auto AddItem = [this, Sample](const AActor* Item)
+	{
+		if (Sample->NumItems < FTrajectorySample::MaxItems)
+		{
+			Sample->ItemIds[Sample->NumItems] = ActorIds.GetId(Item);
+			Sample->Items[Sample->NumItems].Location = Item->GetActorLocation();
+			Sample->Items[Sample->NumItems].Rotation = Item->GetActorQuat();
+			Sample->NumItems++;
+		}
+	};
+
+	if (RightHandSlot)
+	{
+		AddItem(RightHandSlot);
+	}
+	if (LeftHandSlot)
+	{
+		AddItem(LeftHandSlot);
+	}
+	for (const AActor* StackItem : TwoHandSlot)
+	{
+		AddItem(StackItem);
+	}
+}
+
+/*Called at the start of the tick: the player input of the frame has been processed by then, the bound axes
+still hold the values they were dispatched with and the pressed actions have marked themselves.
+@param float DeltaTime  -->  Duration of the frame*/
+void AMyCharacter::RecordInput(float DeltaTime)
+{
+	const uint8 Actions = PendingActions;
+	PendingActions = 0;
+	if (!InputRecorder)
+	{
+		return;
+	}
+
+	FInputFrame* Frame = InputRecorder->BeginFrame(GFrameCounter, GetWorld()->GetTimeSeconds(), DeltaTime);
+	if (!Frame)
+	{
+		return;
+	}
+
+	const FName* AxisNames = FInputRecorder::GetAxisNames();
+	for (int32 Axis = 0; Axis < FInputFrame::NumAxes; Axis++)
+	{
+		Frame->Axes[Axis] = InputComponent ? InputComponent->GetAxisValue(AxisNames[Axis]) : 0.f;
+	}
+	Frame->Actions = Actions;
+}
+
+/*Registers an item spawned after the level started (eg: by the item pool) in the interactable tables.
+@param AActor* Item  -->  Item to register, needs to have a static mesh component
+@param EItemType ItemType  -->  Type stored in the ItemMap*/
+void AMyCharacter::RegisterItem(AActor* Item, EItemType ItemType)
+{
+	AllActors.AddUnique(Item);
+	ActorIds.Register(Item);
+	ItemMap.Add(Item, ItemType);
+
+	if (Item->ActorHasTag(FName(TEXT("Stackable"))))
+	{
+		AllStackableItems.Add(Item);
+	}
+
+	//Set default stencil value (for blue outline effect)
+	if (GetStaticMesh(Item))
+	{
+		GetStaticMesh(Item)->SetCustomDepthStencilValue(1);
+	}
+}
+
+/*Fills a snapshot delta with the state of the actors changed since the last call and with the content of the hands.
+Actors still moving (drawers sliding, items settling after a drop) stay dirty so they are captured again once at rest.
+@param FKitchenSnapshot& OutSnapshot  -->  Snapshot delta to be filled*/
+void AMyCharacter::CaptureSnapshot(FKitchenSnapshot& OutSnapshot)
+{
+	OutSnapshot.Actors.Reserve(DirtyActors.Num());
+
+	for (auto It = DirtyActors.CreateIterator(); It; ++It)
+	{
+		AActor* DirtyActor = *It;
+
+		FActorSnapshotRecord Record;
+		Record.ActorId = ActorIds.GetId(DirtyActor);
+		Record.Location = DirtyActor->GetActorLocation();
+		Record.Rotation = DirtyActor->GetActorQuat();
+		Record.AssetState = AssetStateMap.Contains(DirtyActor) ? AssetStateMap.FindRef(DirtyActor) : EAssetState::Unkown;
+		OutSnapshot.Actors.Add(Record);
+
+		UStaticMeshComponent* Mesh = GetStaticMesh(DirtyActor);
+		if (!Mesh || !Mesh->RigidBodyIsAwake())
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	FCharacterSnapshot& Hands = OutSnapshot.Character;
+	Hands.RightHandItem = ActorIds.GetId(RightHandSlot);
+	Hands.LeftHandItem = ActorIds.GetId(LeftHandSlot);
+	Hands.TwoHandItems.Empty(TwoHandSlot.Num());
+	for (const auto StackItem : TwoHandSlot)
+	{
+		Hands.TwoHandItems.Add(ActorIds.GetId(StackItem));
+	}
+	Hands.RightHandRotator = RightHandRotator;
+	Hands.LeftHandRotator = LeftHandRotator;
+	Hands.RightZPos = RightZPos;
+	Hands.LeftZPos = LeftZPos;
+	Hands.RightYPos = RightYPos;
+	Hands.LeftYPos = LeftYPos;
+	Hands.bRightHandSelected = bRightHandSelected;
+}
+
+/*Puts the kitchen back in the state stored in a snapshot, each record is resolved directly through its actor id.
+Needs to be called after BeginPlay() since it relies on the AssetStateMap, ItemMap and ActorIds.
+@param const FKitchenSnapshot& Snapshot  -->  Snapshot loaded from disk*/
+void AMyCharacter::RestoreFromSnapshot(const FKitchenSnapshot& Snapshot)
+{
+	const FCharacterSnapshot& Hands = Snapshot.Character;
+
+	for (const auto& Record : Snapshot.Actors)
+	{
+		AActor* RecordActor = ActorIds.Resolve(Record.ActorId);
+		if (!RecordActor || !GetStaticMesh(RecordActor))
+		{
+			UE_LOG(LogRobCogWeb, Warning, TEXT("Snapshot record for unknown actor id %u skipped"), Record.ActorId);
+			continue;
+		}
+		GetStaticMesh(RecordActor)->SetWorldLocationAndRotation(Record.Location, Record.Rotation, false, nullptr, ETeleportType::TeleportPhysics);
+		if (AssetStateMap.Contains(RecordActor))
+		{
+			AssetStateMap.Add(RecordActor, Record.AssetState);
+		}
+
+		//Changes from the previous session, on top of the layout the episode started with
+		ChangedActors.Add(RecordActor);
+	}
+
+	RightHandSlot = Hands.RightHandItem ? ActorIds.Resolve(Hands.RightHandItem) : nullptr;
+	LeftHandSlot = Hands.LeftHandItem ? ActorIds.Resolve(Hands.LeftHandItem) : nullptr;
+
+	//The held stack keeps the bottom to top order it was saved in
+	TArray<AActor*> StackItems;
+	StackItems.Reserve(Hands.TwoHandItems.Num());
+	for (const uint32 StackItemId : Hands.TwoHandItems)
+	{
+		StackItems.Add(ActorIds.Resolve(StackItemId));
+	}
+
+	RightHandRotator = Hands.RightHandRotator;
+	LeftHandRotator = Hands.LeftHandRotator;
+	RightZPos = Hands.RightZPos;
+	LeftZPos = Hands.LeftZPos;
+	RightYPos = Hands.RightYPos;
+	LeftYPos = Hands.LeftYPos;
+	bRightHandSelected = Hands.bRightHandSelected;
+
+	//Held items need the same properties as when they were picked up
+	for (AActor* HeldItem : { RightHandSlot, LeftHandSlot })
+	{
+		if (HeldItem)
+		{
+			GetStaticMesh(HeldItem)->SetEnableGravity(false);
+			GetStaticMesh(HeldItem)->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+			GetStaticMesh(HeldItem)->SetCustomDepthStencilValue(2);
+			TraceParams.AddIgnoredComponent(GetStaticMesh(HeldItem));
+		}
+	}
+	SelectedObject = bRightHandSelected ? RightHandSlot : LeftHandSlot;
+
+	for (AActor* StackItem : StackItems)
+	{
+		if (StackItem)
+		{
+			GetStaticMesh(StackItem)->SetEnableGravity(false);
+			GetStaticMesh(StackItem)->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+			TwoHandSlot.Add(StackItem);
+			SelectedObject = StackItem;
+		}
+	}
+	if (TwoHandSlot.Num())
+	{
+		GetStaticMesh(SelectedObject)->SetCustomDepthStencilValue(2);
+	}
+
+	UpdateCharacterSpeed();
+}
+
 
 
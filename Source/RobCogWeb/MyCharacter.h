@@ -24,6 +24,9 @@ enum class EItemType : uint8
 	Spoon UMETA(DisplayName = "Spoon")
 };
 
+#include "SemanticEventLogger.h"
+#include "ActorIdRegistry.h"
+#include "InputRecorder.h"
 #include "GameFramework/Character.h"
 #include "MyCharacter.generated.h"
 
@@ -31,11 +34,19 @@ enum class EItemType : uint8
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FStringDelegate, FString, PopupMessage);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FSubmitProgress, FString, PopupMessage, bool, bEndOrResume);
 
+struct FKitchenSnapshot;
+class FTrajectoryLogger;
+class FEpisodeReplayer;
+class FTaskEvaluator;
+
 UCLASS()
 class ROBCOGWEB_API AMyCharacter : public ACharacter
 {
 	GENERATED_BODY()
 
+	//Drives the character through the same input handlers as the player when replaying an episode
+	friend class FEpisodeReplayer;
+
 public:
 	// Sets default values for this character's properties
 	AMyCharacter();
@@ -58,9 +69,15 @@ public:
 	//TMap which keeps the open/closed state for our island drawers
 	TMap<AActor*, EAssetState> AssetStateMap;
 
+	//Drawer or door opened by each handle, so that clicks on a handle do not need to look at its name
+	TMap<AActor*, AActor*> HandleMap;
+
 	//TMap which keeps a reference to the interactive items from the kitchen
 	TMap<AActor*, EItemType> ItemMap;
 
+	//Tables, counters and the sink the items are put on (see FSemanticMapCapture::IsSurface())
+	TSet<AActor*> Surfaces;
+
 	//Actor pointer for the item currently selected
 	AActor* SelectedObject;
 
@@ -134,6 +151,42 @@ public:
 	//Variable to change the speed of the character
 	UPROPERTY(BlueprintReadOnly, VisibleAnywhere)
 	float CharacterSpeed;
+
+	//Stable ids of the actors of the world, used by the snapshots and the episode logs
+	FActorIdRegistry ActorIds;
+
+	//Actors whose state changed since the last snapshot was captured
+	TSet<AActor*> DirtyActors;
+
+	//Actors whose state changed since the start of the episode, the only ones the world state diff looks at
+	TSet<AActor*> ChangedActors;
+
+	//Fills a snapshot delta with the dirty actors and the content of the hands
+	void CaptureSnapshot(FKitchenSnapshot& OutSnapshot);
+
+	//Puts the actors and the hands back in the state saved in the snapshot
+	void RestoreFromSnapshot(const FKitchenSnapshot& Snapshot);
+
+	//Makes an item spawned at runtime interactive, as if it had been placed in the level with the 'Item' tag
+	void RegisterItem(AActor* Item, EItemType ItemType);
+
+	//Logger receiving the semantic events of the episode, set by the game mode (null when not recording)
+	FSemanticEventLogger* EventLogger;
+
+	//Logger receiving the trajectories of the camera, hands and held items, set by the game mode (null when not recording)
+	FTrajectoryLogger* TrajectoryLogger;
+
+	//Recorder of the raw input of the episode, set by the game mode (null when not recording)
+	FInputRecorder* InputRecorder;
+
+	//Evaluator of the task of the level, set by the game mode (null when the level has no task)
+	FTaskEvaluator* TaskEvaluator;
+
+	//Point in front of the character where the items of a hand are held
+	FVector GetHandLocation(bool bRightHand) const;
+
+	//Actor right below the bounds of an item, which the item rests on; null if there is none within FTaskEvaluator::SupportTraceDepth
+	AActor* FindSupport(const AActor* Item) const;
 	
 protected:
 	/** Base turn rate, in deg/sec. Other scaling may affect final turn rate. */
@@ -205,4 +258,31 @@ protected:
 	//Method to update the speed based on it's state (if it holds items)
 	void UpdateCharacterSpeed();
 
+	//Adds an actor to the dirty set of the snapshots and to the changes of the episode
+	void MarkChanged(AActor* Actor);
+
+	//Sends an event to the episode logger, if one is recording, and to the task evaluator
+	void LogEvent(ESemanticEventKind Kind, EEventHand Hand, const AActor* Actor, const AActor* Surface = nullptr);
+
+	//Hand currently performing the actions, as recorded in the events
+	EEventHand GetSelectedHand() const;
+
+	//Samples the poses of the camera, the hands and the held items into the trajectory logger
+	void RecordTrajectory();
+
+	//Traces from the camera and updates the focused actor (HitObject and HighlightedActor)
+	void UpdateFocus();
+
+	//Writes the axis values and the actions of the frame into the input recorder
+	void RecordInput(float DeltaTime);
+
+	//Remembers an action pressed during the frame, for the input recorder
+	void MarkInput(EInputAction Action)
+	{
+		PendingActions |= 1 << (uint8)Action;
+	}
+
+	//Actions pressed since the last recorded frame, one bit per EInputAction
+	uint8 PendingActions;
+
 };
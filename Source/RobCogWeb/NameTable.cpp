@@ -0,0 +1,116 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "NameTable.h"
+#include "MyCharacter.h"
+#include "LogEncoding.h"
+
+uint32 FNameTable::Register(FName Name)
+{
+	if (Name == NAME_None)
+	{
+		return 0;
+	}
+
+	const uint32* Id = Ids.Find(Name);
+	if (Id)
+	{
+		return *Id;
+	}
+	Names.Add(Name);
+	Ids.Add(Name, Names.Num());
+	return Names.Num();
+}
+
+/*Everything the logs name over and over: the tags of the interactive actors (Item, Stackable, ...),
+the item types and states and the labels of the events and hands.
+@param const AMyCharacter& Character  -->  Character which has mapped the world*/
+void FNameTable::Seed(const AMyCharacter& Character)
+{
+	static const TCHAR* Vocabulary[] =
+	{
+		TEXT("Pick"), TEXT("Drop"), TEXT("Open"), TEXT("Close"), TEXT("Finish"), TEXT("Resume"), TEXT("Exit"),
+		TEXT("Right"), TEXT("Left"), TEXT("Both")
+	};
+	for (const TCHAR* Word : Vocabulary)
+	{
+		Register(FName(Word));
+	}
+
+	const UEnum* ItemTypes = FindObject<UEnum>(ANY_PACKAGE, TEXT("EItemType"));
+	const UEnum* AssetStates = FindObject<UEnum>(ANY_PACKAGE, TEXT("EAssetState"));
+	const UEnum* Enums[] = { ItemTypes, AssetStates };
+	for (const UEnum* Enum : Enums)
+	{
+		//The last entry is the generated _MAX value
+		for (int32 i = 0; Enum && i < Enum->NumEnums() - 1; i++)
+		{
+			Register(FName(*Enum->GetEnumName(i)));
+		}
+	}
+
+	for (const auto ActorIt : Character.AllActors)
+	{
+		for (const FName& Tag : ActorIt->Tags)
+		{
+			//Id tags are unique per actor, the actor directory already holds the id
+			if (!FActorIdRegistry::IsIdTag(Tag))
+			{
+				Register(Tag);
+			}
+		}
+	}
+}
+
+FName FNameTable::GetName(uint32 Id) const
+{
+	return Id > 0 && Id <= (uint32)Names.Num() ? Names[Id - 1] : NAME_None;
+}
+
+bool FNameTable::Save(const FString& FilePath) const
+{
+	TArray<uint8> Bytes;
+	FMemoryWriter Writer(Bytes);
+	uint32 FileMagic = Magic;
+	uint16 FileVersion = Version;
+	Writer << FileMagic;
+	Writer << FileVersion;
+	LogEncoding::WriteVarint(Writer, Names.Num());
+	for (const FName& Name : Names)
+	{
+		FString NameString = Name.ToString();
+		Writer << NameString;
+	}
+	return FFileHelper::SaveArrayToFile(Bytes, *FilePath);
+}
+
+bool FNameTable::Load(const FString& FilePath, FNameTable& OutTable)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *FilePath, FILEREAD_Silent))
+	{
+		return false;
+	}
+
+	FMemoryReader Reader(Bytes);
+	uint32 FileMagic;
+	uint16 FileVersion;
+	Reader << FileMagic;
+	Reader << FileVersion;
+	if (FileMagic != Magic || FileVersion != Version)
+	{
+		return false;
+	}
+
+	const uint64 NumNames = LogEncoding::ReadVarint(Reader);
+	OutTable.Ids.Empty(NumNames);
+	OutTable.Names.Empty(NumNames);
+	for (uint64 i = 0; i < NumNames && !Reader.IsError(); i++)
+	{
+		FString NameString;
+		Reader << NameString;
+		OutTable.Names.Add(FName(*NameString));
+		OutTable.Ids.Add(OutTable.Names.Last(), OutTable.Names.Num());
+	}
+	return !Reader.IsError();
+}
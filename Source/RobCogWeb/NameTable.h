@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+class AMyCharacter;
+
+/*Interned names of an episode: tags, enum values and the event vocabulary get small ids once, at registration,
+and the logs only refer to them by id (actors themselves are referenced by their stable id, see FActorIdRegistry). The table is filled on the game thread before the loggers start,
+then never changes, so the writer threads read it without locking. It is written once per episode (Names.bin).
+*/
+class FNameTable
+{
+public:
+	//Registers a name and returns its id (ids start at 1, 0 stands for no name); only before the loggers start
+	uint32 Register(FName Name);
+
+	//Registers the tags of the drawers, doors and items of the character and the event vocabulary
+	void Seed(const AMyCharacter& Character);
+
+	//Id of a registered name, 0 if the name is unknown
+	FORCEINLINE uint32 Find(FName Name) const
+	{
+		const uint32* Id = Ids.Find(Name);
+		return Id ? *Id : 0;
+	}
+
+	//Name of an id, NAME_None if the id is unknown
+	FName GetName(uint32 Id) const;
+
+	//Highest id given
+	FORCEINLINE uint32 Num() const
+	{
+		return Names.Num();
+	}
+
+	//Reading and writing the table files
+	bool Save(const FString& FilePath) const;
+	static bool Load(const FString& FilePath, FNameTable& OutTable);
+
+	//Identifies the file format
+	static const uint32 Magic = 0x4E574352; // 'RCWN'
+	static const uint16 Version = 1;
+
+private:
+	TMap<FName, uint32> Ids;
+
+	//Names in id order, the name of id i is at i - 1
+	TArray<FName> Names;
+};
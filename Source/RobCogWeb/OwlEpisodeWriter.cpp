@@ -0,0 +1,197 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "OwlEpisodeWriter.h"
+
+const TCHAR* FOwlEpisodeWriter::KnowRobNs = TEXT("http://knowrob.org/kb/knowrob.owl#");
+const TCHAR* FOwlEpisodeWriter::LogNs = TEXT("http://knowrob.org/kb/robcog_log.owl#");
+const TCHAR* FOwlEpisodeWriter::MapNs = TEXT("http://knowrob.org/kb/u_map.owl#");
+
+using namespace RapidXmlHelpers;
+
+FOwlEpisodeWriter::FOwlEpisodeWriter(const FString& InFilePath, const FString& InEpisodeName, const TMap<uint32, FString>& InActorNames, const TSet<uint32>& InDoorIds, FXmlDocument* InDoc)
+	: EpisodeName(InEpisodeName)
+	, ActorNames(InActorNames)
+	, DoorIds(InDoorIds)
+	, OwnedDoc(InDoc ? nullptr : new FXmlDocument())
+	, Doc(InDoc ? *InDoc : *OwnedDoc)
+	, PendingIndividuals(0)
+	, ActionCount(0)
+	, EpisodeStart(-1.0)
+	, EpisodeEnd(0.0)
+{
+	FlushThreshold = 64;
+
+	File = IFileManager::Get().CreateFileWriter(*InFilePath);
+	if (!File)
+	{
+		UE_LOG(LogRobCogWeb, Warning, TEXT("Could not create OWL file %s"), *InFilePath);
+		return;
+	}
+
+	//The root element stays open for the whole session, the individuals are streamed inside it
+	const FString Header = FString::Printf(TEXT("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n")
+		TEXT("<rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\"\n")
+		TEXT("\txmlns:rdfs=\"http://www.w3.org/2000/01/rdf-schema#\"\n")
+		TEXT("\txmlns:owl=\"http://www.w3.org/2002/07/owl#\"\n")
+		TEXT("\txmlns:knowrob=\"%s\"\n")
+		TEXT("\txmlns:log=\"%s\">\n")
+		TEXT("<owl:Ontology rdf:about=\"%s\">\n")
+		TEXT("\t<owl:imports rdf:resource=\"package://knowrob_common/owl/knowrob.owl\"/>\n")
+		TEXT("</owl:Ontology>\n"), KnowRobNs, LogNs, *FString(LogNs).LeftChop(1));
+	FTCHARToUTF8 Utf8Header(*Header);
+	File->Serialize((void*)Utf8Header.Get(), Utf8Header.Length());
+}
+
+FOwlEpisodeWriter::~FOwlEpisodeWriter()
+{
+	Close();
+	delete OwnedDoc;
+}
+
+FXmlNode* FOwlEpisodeWriter::AddIndividual(const FString& Iri, const FString& ClassIri)
+{
+	FXmlNode* Individual = AddElement(Doc, &Doc, "owl:NamedIndividual");
+	AddAttribute(Doc, Individual, "rdf:about", Iri);
+	AddResource(Individual, "rdf:type", ClassIri);
+	PendingIndividuals++;
+	return Individual;
+}
+
+void FOwlEpisodeWriter::AddResource(FXmlNode* Individual, const char* Property, const FString& Iri)
+{
+	FXmlNode* Node = AddElement(Doc, Individual, Property);
+	AddAttribute(Doc, Node, "rdf:resource", Iri);
+}
+
+FString FOwlEpisodeWriter::AddTimepoint(double Time)
+{
+	const FString Iri = FString::Printf(TEXT("%stimepoint_%.3f"), LogNs, Time);
+	AddIndividual(Iri, FString(KnowRobNs) + TEXT("TimePoint"));
+	return Iri;
+}
+
+const FString& FOwlEpisodeWriter::GetActorName(uint32 Id) const
+{
+	static const FString Unknown(TEXT("Unknown"));
+	const FString* Name = ActorNames.Find(Id);
+	return Name ? *Name : Unknown;
+}
+
+void FOwlEpisodeWriter::AddAction(const TCHAR* ActionClass, double StartTime, double EndTime, uint32 Object, uint32 FromLocation, uint32 ToLocation)
+{
+	const FString ActionIri = FString::Printf(TEXT("%s%s_%d"), LogNs, ActionClass, ActionCount++);
+	const FString StartIri = AddTimepoint(StartTime);
+	const FString EndIri = EndTime != StartTime ? AddTimepoint(EndTime) : StartIri;
+
+	FXmlNode* Action = AddIndividual(ActionIri, FString(KnowRobNs) + ActionClass);
+	AddResource(Action, "knowrob:startTime", StartIri);
+	AddResource(Action, "knowrob:endTime", EndIri);
+	AddResource(Action, "knowrob:objectActedOn", MapNs + GetActorName(Object));
+	if (FromLocation)
+	{
+		AddResource(Action, "knowrob:fromLocation", MapNs + GetActorName(FromLocation));
+	}
+	if (ToLocation)
+	{
+		AddResource(Action, "knowrob:toLocation", MapNs + GetActorName(ToLocation));
+	}
+
+	//RDF allows describing the episode again for every action, so its sub actions never have to be kept in memory
+	FXmlNode* Episode = AddElement(Doc, &Doc, "rdf:Description");
+	AddAttribute(Doc, Episode, "rdf:about", LogNs + EpisodeName);
+	AddResource(Episode, "knowrob:subAction", ActionIri);
+
+	if (PendingIndividuals >= FlushThreshold)
+	{
+		Flush();
+	}
+}
+
+void FOwlEpisodeWriter::Consume(const FSemanticEvent& Event)
+{
+	if (EpisodeStart < 0.0)
+	{
+		EpisodeStart = Event.Timestamp;
+	}
+	EpisodeEnd = Event.Timestamp;
+
+	switch (Event.Kind)
+	{
+	case ESemanticEventKind::Pick:
+	{
+		FPendingTransport Transport;
+		Transport.StartTime = Event.Timestamp;
+		//The surface traced at the pick, or where the item was last dropped for logs written before picks had one
+		Transport.FromLocation = Event.SurfaceId ? Event.SurfaceId : LastLocation.FindRef(Event.ActorId);
+		InHand.Add(Event.ActorId, Transport);
+		break;
+	}
+	case ESemanticEventKind::Drop:
+	{
+		FPendingTransport Transport;
+		if (InHand.RemoveAndCopyValue(Event.ActorId, Transport))
+		{
+			AddAction(TEXT("PuttingSomethingSomewhere"), Transport.StartTime, Event.Timestamp, Event.ActorId, Transport.FromLocation, Event.SurfaceId);
+		}
+		LastLocation.Add(Event.ActorId, Event.SurfaceId);
+		break;
+	}
+	case ESemanticEventKind::Open:
+		AddAction(DoorIds.Contains(Event.ActorId) ? TEXT("OpeningADoor") : TEXT("OpeningADrawer"), Event.Timestamp, Event.Timestamp, Event.ActorId, 0, 0);
+		break;
+	case ESemanticEventKind::Close:
+		AddAction(DoorIds.Contains(Event.ActorId) ? TEXT("ClosingADoor") : TEXT("ClosingADrawer"), Event.Timestamp, Event.Timestamp, Event.ActorId, 0, 0);
+		break;
+	default:
+		break;
+	}
+}
+
+void FOwlEpisodeWriter::Flush()
+{
+	if (!File)
+	{
+		Doc.clear();
+		PendingIndividuals = 0;
+		return;
+	}
+
+	OutBuffer.clear();
+	for (FXmlNode* Node = Doc.first_node(); Node; Node = Node->next_sibling())
+	{
+		Print(OutBuffer, *Node);
+	}
+	File->Serialize((void*)OutBuffer.data(), OutBuffer.size());
+	File->Flush();
+
+	//Releases the memory of the printed individuals
+	Doc.clear();
+	PendingIndividuals = 0;
+}
+
+void FOwlEpisodeWriter::Close()
+{
+	if (!File)
+	{
+		//Leaves a shared pool empty for the next writer
+		Doc.clear();
+		PendingIndividuals = 0;
+		return;
+	}
+
+	//The episode itself spans from the first to the last event
+	if (EpisodeStart >= 0.0)
+	{
+		FXmlNode* Episode = AddIndividual(LogNs + EpisodeName, FString(KnowRobNs) + TEXT("RobotExperiment"));
+		AddResource(Episode, "knowrob:startTime", AddTimepoint(EpisodeStart));
+		AddResource(Episode, "knowrob:endTime", AddTimepoint(EpisodeEnd));
+	}
+	Flush();
+
+	const char Footer[] = "</rdf:RDF>\n";
+	File->Serialize((void*)Footer, sizeof(Footer) - 1);
+	File->Close();
+	delete File;
+	File = nullptr;
+}
@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "SemanticEventLogger.h"
+#include "RapidXmlHelpers.h"
+
+/*Exports the episode as KnowRob-style OWL while it is being recorded.
+Every completed action becomes an individual (class, start and end time, objectActedOn, fromLocation/toLocation)
+built as a small subtree in the memory pool of a rapidxml document. The subtrees are printed and appended
+to the file every few actions and the pool is cleared, so memory does not grow with the length of the session.
+*/
+class FOwlEpisodeWriter : public IEpisodeEventSink
+{
+public:
+	//ActorNames maps the stable ids of the events to the names used in the semantic map, DoorIds are the articulated actors tagged 'Door'.
+	//The individuals are built in the given document when there is one (eg: the pool of a batch worker), in a document of the writer otherwise
+	FOwlEpisodeWriter(const FString& InFilePath, const FString& InEpisodeName, const TMap<uint32, FString>& InActorNames, const TSet<uint32>& InDoorIds, FXmlDocument* InDoc = nullptr);
+	virtual ~FOwlEpisodeWriter();
+
+	//IEpisodeEventSink interface
+	virtual void Consume(const FSemanticEvent& Event) override;
+	virtual void Close() override;
+
+	//Individuals kept in the pool before they are written to the file
+	int32 FlushThreshold;
+
+	//Namespaces of the generated individuals
+	static const TCHAR* KnowRobNs;
+	static const TCHAR* LogNs;
+	static const TCHAR* MapNs;
+
+private:
+	//Item picked up and not yet put down, becomes a transport action at the drop
+	struct FPendingTransport
+	{
+		double StartTime;
+		uint32 FromLocation;
+	};
+
+	//Adds an action individual with its time interval and objects
+	void AddAction(const TCHAR* ActionClass, double StartTime, double EndTime, uint32 Object, uint32 FromLocation, uint32 ToLocation);
+
+	//Name of the actor of an id, as used in the IRIs of the map
+	const FString& GetActorName(uint32 Id) const;
+
+	//Adds a named individual of the class and returns its node
+	FXmlNode* AddIndividual(const FString& Iri, const FString& ClassIri);
+
+	//Adds an object property pointing to an individual
+	void AddResource(FXmlNode* Individual, const char* Property, const FString& Iri);
+
+	//Adds the time point individual and returns its IRI
+	FString AddTimepoint(double Time);
+
+	//Prints the pending individuals to the file and empties the pool
+	void Flush();
+
+	FString EpisodeName;
+
+	//Copied at construction, the events are consumed on the writer thread of the logger
+	TMap<uint32, FString> ActorNames;
+	TSet<uint32> DoorIds;
+
+	FArchive* File;
+
+	//Pool of the individuals not yet flushed, owned by the writer if none was given
+	FXmlDocument* OwnedDoc;
+	FXmlDocument& Doc;
+	int32 PendingIndividuals;
+
+	//Printing buffer reused between flushes
+	std::string OutBuffer;
+
+	//Items currently held, and the last location each item was put on
+	TMap<uint32, FPendingTransport> InHand;
+	TMap<uint32, uint32> LastLocation;
+
+	int32 ActionCount;
+	double EpisodeStart;
+	double EpisodeEnd;
+};
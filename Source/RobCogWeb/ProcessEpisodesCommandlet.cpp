@@ -0,0 +1,205 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "ProcessEpisodesCommandlet.h"
+#include "EpisodeBatchProcessor.h"
+#include "EpisodeWorkQueue.h"
+
+UProcessEpisodesCommandlet::UProcessEpisodesCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UProcessEpisodesCommandlet::Main(const FString& Params)
+{
+	FString Dir = FPaths::Combine(*FPaths::GameSavedDir(), TEXT("Episodes"));
+	FString Output = FPaths::Combine(*FPaths::GameSavedDir(), TEXT("Processed"));
+	FString QueueDir;
+	int32 Threads = 0;
+	int32 Workers = 0;
+	uint32 WorkerId = 0;
+	float LeaseTimeout = 600.f;
+	FParse::Value(*Params, TEXT("Dir="), Dir);
+	FParse::Value(*Params, TEXT("Output="), Output);
+	FParse::Value(*Params, TEXT("Queue="), QueueDir);
+	FParse::Value(*Params, TEXT("Threads="), Threads);
+	FParse::Value(*Params, TEXT("Workers="), Workers);
+	FParse::Value(*Params, TEXT("WorkerId="), WorkerId);
+	FParse::Value(*Params, TEXT("LeaseTimeout="), LeaseTimeout);
+	const bool bExportOwl = !FParse::Param(*Params, TEXT("NoOwl"));
+
+	if (WorkerId)
+	{
+		return RunWorker(QueueDir.IsEmpty() ? FPaths::Combine(*Output, TEXT("Queue")) : QueueDir, Output, WorkerId, bExportOwl);
+	}
+
+	TArray<FString> EpisodeDirs;
+	FEpisodeBatchProcessor::FindEpisodes(Dir, EpisodeDirs);
+	if (!EpisodeDirs.Num())
+	{
+		//A coordinator may still have the episodes of a previous run left in its queue
+		UE_LOG(LogRobCogWeb, Warning, TEXT("No episode found in %s"), *Dir);
+		if (!Workers)
+		{
+			return 1;
+		}
+	}
+	else
+	{
+		UE_LOG(LogRobCogWeb, Display, TEXT("Found %d episodes in %s"), EpisodeDirs.Num(), *Dir);
+	}
+
+	if (Workers > 0)
+	{
+		return RunCoordinator(EpisodeDirs, QueueDir.IsEmpty() ? FPaths::Combine(*Output, TEXT("Queue")) : QueueDir, Output, Workers, LeaseTimeout, bExportOwl);
+	}
+
+	FEpisodeBatchProcessor Processor(Output, Threads, bExportOwl);
+	const int32 NumProcessed = Processor.Run(EpisodeDirs);
+	if (!Processor.SaveMetrics(FPaths::Combine(*Output, TEXT("Metrics.csv"))))
+	{
+		UE_LOG(LogRobCogWeb, Error, TEXT("Could not write the metrics to %s"), *Output);
+		return 1;
+	}
+	return NumProcessed == EpisodeDirs.Num() ? 0 : 1;
+}
+
+/*The workers are this executable run again in worker mode, each one processes one episode at a time.
+A worker which exits with jobs still leased had crashed: its leases go back to the queue right away and a new worker
+takes its place, within a budget of restarts so that an episode crashing every worker cannot loop forever.
+@param const TArray<FString>& EpisodeDirs  -->  Episodes to add to the queue, the ones already in it are kept as they are
+@param int32 NumWorkers  -->  Worker processes running at once
+@param float LeaseTimeout  -->  Seconds after which the episode of a worker which hangs is given to another one*/
+int32 UProcessEpisodesCommandlet::RunCoordinator(const TArray<FString>& EpisodeDirs, const FString& QueueDir, const FString& Output, int32 NumWorkers, float LeaseTimeout, bool bExportOwl)
+{
+	FEpisodeWorkQueue Queue(QueueDir);
+
+	//Leases left by a previous run belong to workers which are gone
+	const int32 Resumed = Queue.RequeueAll();
+	const int32 Added = Queue.Enqueue(EpisodeDirs);
+	UE_LOG(LogRobCogWeb, Display, TEXT("Queue %s: %d episodes added, %d leases taken back, %d pending"), *QueueDir, Added, Resumed, Queue.Num(EEpisodeJobState::Pending));
+	if (!EpisodeDirs.Num() && !Queue.Num(EEpisodeJobState::Pending))
+	{
+		UE_LOG(LogRobCogWeb, Error, TEXT("Nothing to process: no episode found and none pending in %s"), *QueueDir);
+		return 1;
+	}
+
+	struct FWorkerProcess
+	{
+		FProcHandle Handle;
+		uint32 WorkerId;
+	};
+	TArray<FWorkerProcess> Workers;
+	uint32 NextWorkerId = 1;
+	int32 SpawnBudget = NumWorkers * (FEpisodeWorkQueue::MaxAttempts + 1);
+
+	const FString Executable = FPaths::Combine(FPlatformProcess::BaseDir(), FPlatformProcess::ExecutableName(false));
+	const FString BaseArgs = FString::Printf(TEXT("\"%s\" -run=ProcessEpisodes -Queue=\"%s\" -Output=\"%s\"%s -unattended -nullrhi -nosound"),
+		*FPaths::GetProjectFilePath(), *FPaths::ConvertRelativePathToFull(QueueDir), *FPaths::ConvertRelativePathToFull(Output), bExportOwl ? TEXT("") : TEXT(" -NoOwl"));
+
+	const double StartTime = FPlatformTime::Seconds();
+	while (true)
+	{
+		for (int32 i = Workers.Num() - 1; i >= 0; i--)
+		{
+			if (FPlatformProcess::IsProcRunning(Workers[i].Handle))
+			{
+				continue;
+			}
+			int32 ReturnCode = 0;
+			FPlatformProcess::GetProcReturnCode(Workers[i].Handle, &ReturnCode);
+			const int32 Released = Queue.Requeue(Workers[i].WorkerId);
+			if (ReturnCode != 0 || Released)
+			{
+				UE_LOG(LogRobCogWeb, Warning, TEXT("Worker %u exited with code %d, %d episodes taken back"), Workers[i].WorkerId, ReturnCode, Released);
+			}
+			FPlatformProcess::CloseProc(Workers[i].Handle);
+			Workers.RemoveAt(i);
+		}
+		Queue.RequeueExpired(LeaseTimeout);
+
+		const int32 NumPending = Queue.Num(EEpisodeJobState::Pending);
+		if (!NumPending && !Queue.Num(EEpisodeJobState::Leased) && !Workers.Num())
+		{
+			break;
+		}
+
+		while (Workers.Num() < FMath::Min(NumWorkers, NumPending) && SpawnBudget > 0)
+		{
+			FWorkerProcess Worker;
+			Worker.WorkerId = NextWorkerId++;
+			Worker.Handle = FPlatformProcess::CreateProc(*Executable, *FString::Printf(TEXT("%s -WorkerId=%u"), *BaseArgs, Worker.WorkerId), false, true, true, nullptr, 0, nullptr, nullptr);
+			SpawnBudget--;
+			if (Worker.Handle.IsValid())
+			{
+				Workers.Add(Worker);
+			}
+		}
+		if (!Workers.Num() && !SpawnBudget)
+		{
+			UE_LOG(LogRobCogWeb, Error, TEXT("Workers keep failing, %d episodes left pending in %s"), NumPending, *QueueDir);
+			break;
+		}
+
+		FPlatformProcess::Sleep(0.5f);
+	}
+	const double Elapsed = FPlatformTime::Seconds() - StartTime;
+
+	//The per-episode rows are merged in name order, whatever worker wrote them
+	TArray<FString> Results;
+	IFileManager::Get().FindFiles(Results, *FPaths::Combine(*Queue.GetResultDir(), TEXT("*.csv")), true, false);
+	Results.Sort();
+	FString Csv;
+	for (const FString& Result : Results)
+	{
+		FString Rows;
+		if (!FFileHelper::LoadFileToString(Rows, *FPaths::Combine(*Queue.GetResultDir(), *Result)))
+		{
+			continue;
+		}
+		FString Header;
+		FString Row;
+		if (Rows.Split(TEXT("\n"), &Header, &Row))
+		{
+			Csv += Csv.IsEmpty() ? Header + TEXT("\n") + Row : Row;
+		}
+	}
+	if (!FFileHelper::SaveStringToFile(Csv, *FPaths::Combine(*Output, TEXT("Metrics.csv"))))
+	{
+		UE_LOG(LogRobCogWeb, Error, TEXT("Could not write the metrics to %s"), *Output);
+		return 1;
+	}
+
+	const int32 NumDone = Queue.Num(EEpisodeJobState::Done);
+	const int32 NumFailed = Queue.Num(EEpisodeJobState::Failed);
+	UE_LOG(LogRobCogWeb, Display, TEXT("%d episodes done, %d failed in %.2f s with %d workers (%d started): %.1f episodes/s"),
+		NumDone, NumFailed, Elapsed, NumWorkers, NextWorkerId - 1, Elapsed > 0.0 ? NumDone / Elapsed : 0.0);
+	return NumFailed || Queue.Num(EEpisodeJobState::Pending) ? 1 : 0;
+}
+
+int32 UProcessEpisodesCommandlet::RunWorker(const FString& QueueDir, const FString& Output, uint32 WorkerId, bool bExportOwl)
+{
+	FEpisodeWorkQueue Queue(QueueDir);
+	FEpisodeBatchProcessor Processor(Output, 1, bExportOwl);
+	TArray<FString> Batch;
+	FString Key;
+	FString EpisodeDir;
+	int32 NumProcessed = 0;
+	while (Queue.Claim(WorkerId, Key, EpisodeDir))
+	{
+		//The outputs are complete before the job moves to Done, a crash before leaves it leased and it is done again
+		Batch.Reset();
+		Batch.Add(EpisodeDir);
+		const bool bSucceeded = Processor.Run(Batch) == 1 && Processor.SaveMetrics(Queue.GetResultPath(Key));
+		if (!Queue.Complete(Key, WorkerId, bSucceeded))
+		{
+			UE_LOG(LogRobCogWeb, Warning, TEXT("Lease of %s was taken back, it is processed again elsewhere"), *Key);
+		}
+		NumProcessed += bSucceeded ? 1 : 0;
+	}
+	UE_LOG(LogRobCogWeb, Display, TEXT("Worker %u processed %d episodes"), WorkerId, NumProcessed);
+	return 0;
+}
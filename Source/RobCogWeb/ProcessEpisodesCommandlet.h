@@ -0,0 +1,34 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+#include "ProcessEpisodesCommandlet.generated.h"
+
+/*Post-processes every recorded episode into OWL, statistics and training features (see FEpisodeBatchProcessor).
+Usage: UE4Editor-Cmd RobCogWeb.uproject -run=ProcessEpisodes [-Dir=<episodes>] [-Output=<folder>] [-Threads=<n>] [-NoOwl]
+	[-Workers=<n> [-Queue=<folder>] [-LeaseTimeout=<s>]]
+Episodes are searched under Saved/Episodes by default, the results go to Saved/Processed: one <episode>.owl per episode
+and Metrics.csv with one row per episode. Without -Threads every core is used.
+With -Workers the episodes are sharded over that many worker processes through a file queue (see FEpisodeWorkQueue,
+Output/Queue by default); the coordinator restarts the workers which crash and resumes a queue left by a previous run.
+Workers on other machines join by running -run=ProcessEpisodes -Queue=<shared folder> -WorkerId=<unique id>.
+*/
+UCLASS()
+class ROBCOGWEB_API UProcessEpisodesCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UProcessEpisodesCommandlet();
+
+	//UCommandlet interface
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	//Fills the queue, runs the worker processes until every episode is done or failed and merges their metrics
+	int32 RunCoordinator(const TArray<FString>& EpisodeDirs, const FString& QueueDir, const FString& Output, int32 NumWorkers, float LeaseTimeout, bool bExportOwl);
+
+	//Processes the episodes of the queue one at a time until none is pending
+	int32 RunWorker(const FString& QueueDir, const FString& Output, uint32 WorkerId, bool bExportOwl);
+};
@@ -0,0 +1,10 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "RapidXmlHelpers.h"
+
+//Called by rapidxml instead of throwing, parsing is never expected to fail on files we wrote ourselves
+void rapidxml::parse_error_handler(const char* What, void* Where)
+{
+	UE_LOG(LogRobCogWeb, Fatal, TEXT("RapidXml error: %s"), UTF8_TO_TCHAR(What));
+}
@@ -0,0 +1,45 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+//The engine is built without exceptions, errors go through rapidxml::parse_error_handler instead (defined in RapidXmlHelpers.cpp)
+#define RAPIDXML_NO_EXCEPTIONS
+#include "rapidxml/rapidxml.hpp"
+#include "rapidxml/rapidxml_print.hpp"
+#include <string>
+#include <iterator>
+
+typedef rapidxml::xml_node<char> FXmlNode;
+typedef rapidxml::xml_document<char> FXmlDocument;
+
+//Helpers building nodes whose strings are copied into the memory pool of the document
+namespace RapidXmlHelpers
+{
+	//Copies an FString as UTF-8 into the pool
+	inline const char* AllocateString(rapidxml::memory_pool<char>& Pool, const FString& String)
+	{
+		return Pool.allocate_string(TCHAR_TO_UTF8(*String));
+	}
+
+	//Element with an optional text value, names and values are copied into the pool
+	inline FXmlNode* AddElement(rapidxml::memory_pool<char>& Pool, FXmlNode* Parent, const char* Name, const FString& Value = FString())
+	{
+		FXmlNode* Node = Pool.allocate_node(rapidxml::node_element, Name, Value.IsEmpty() ? nullptr : AllocateString(Pool, Value));
+		if (Parent)
+		{
+			Parent->append_node(Node);
+		}
+		return Node;
+	}
+
+	inline void AddAttribute(rapidxml::memory_pool<char>& Pool, FXmlNode* Node, const char* Name, const FString& Value)
+	{
+		Node->append_attribute(Pool.allocate_attribute(Name, AllocateString(Pool, Value)));
+	}
+
+	//Appends the printed node to a UTF-8 buffer
+	inline void Print(std::string& OutBuffer, const FXmlNode& Node)
+	{
+		rapidxml::print(std::back_inserter(OutBuffer), Node);
+	}
+}
@@ -18,6 +18,7 @@ public class RobCogWeb : ModuleRules
 			"CoreUObject",
 			"Engine",
 			"InputCore",
+			"HTTP",
 			//"Json",
 			//"JsonUtilities",
 			//"XmlParser"
@@ -47,6 +48,6 @@ public class RobCogWeb : ModuleRules
 		
 		// THIRD PARTY
         //PublicIncludePaths.Add(Path.Combine(ThirdPartyPath, "RapidJson", "Includes"));
-       // PublicIncludePaths.Add(Path.Combine(ThirdPartyPath, "RapidXml", "Includes"));
+        PublicIncludePaths.Add(Path.Combine(ThirdPartyPath, "RapidXml", "Includes"));
 	}
 }
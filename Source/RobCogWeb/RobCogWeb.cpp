@@ -1,5 +1,45 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "RobCogWeb.h"
+#include "StartupBenchmark.h"
+#include "EpisodeUploader.h"
+#include "EpisodeReader.h"
+#include "Async/Async.h"
 
-IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, RobCogWeb, "RobCogWeb" );
+//Game module, hooks the startup benchmark and recovers the crashed episodes once the game runs
+class FRobCogWebModule : public FDefaultGameModuleImpl
+{
+	virtual void StartupModule() override
+	{
+		FStartupBenchmark::Startup();
+
+		//Only a game records episodes; the editor and the commandlets (eg: the ProcessEpisodes workers) leave the journals alone,
+		//and so does the startup benchmark
+		if (FApp::IsGame() && !IsRunningCommandlet() && !FStartupBenchmark::IsEnabled())
+		{
+			FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&FRobCogWebModule::RecoverCrashedEpisodes));
+		}
+	}
+
+	//Called at the first frame, the recovery reads and writes whole logs so it runs on a worker thread, away from the map load
+	static bool RecoverCrashedEpisodes(float DeltaTime)
+	{
+		AsyncTask(ENamedThreads::AnyThread, []()
+		{
+			TArray<FString> Recovered;
+			FEpisodeReader::RecoverCrashedEpisodes(FPaths::Combine(*FPaths::GameSavedDir(), TEXT("Episodes")), Recovered);
+			FEpisodeUploader::AddRecoveredEpisodes(Recovered);
+		});
+		return false;
+	}
+
+	//The uploader normally stops at pre-exit, this covers the module being unloaded without it
+	virtual void ShutdownModule() override
+	{
+		FEpisodeUploader::Shutdown();
+	}
+};
+
+IMPLEMENT_PRIMARY_GAME_MODULE( FRobCogWebModule, RobCogWeb, "RobCogWeb" );
+
+DEFINE_LOG_CATEGORY(LogRobCogWeb);
@@ -4,3 +4,5 @@
 
 #include "Engine.h"
 
+//Log category shared by the project classes
+DECLARE_LOG_CATEGORY_EXTERN(LogRobCogWeb, Log, All);
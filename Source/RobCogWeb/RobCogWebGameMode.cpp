@@ -2,6 +2,23 @@
 
 #include "RobCogWeb.h"
 #include "RobCogWebGameMode.h"
+#include "KitchenSnapshot.h"
+#include "KitchenRandomizer.h"
+#include "StartupBenchmark.h"
+#include "SemanticEventLogger.h"
+#include "OwlEpisodeWriter.h"
+#include "SemanticMapExporter.h"
+#include "TrajectoryLogger.h"
+#include "WorldPoseLogger.h"
+#include "NameTable.h"
+#include "EpisodeReplayer.h"
+#include "EpisodeReader.h"
+#include "InputRecorder.h"
+#include "EpisodeUploader.h"
+#include "WorldStateDiff.h"
+#include "TaskEvaluator.h"
+
+UPackage* ARobCogWebGameMode::RootedLevelPackage = nullptr;
 
 //Default construct varaibles 
 ARobCogWebGameMode::ARobCogWebGameMode()
@@ -9,6 +26,58 @@ ARobCogWebGameMode::ARobCogWebGameMode()
 
 	PopUpMessage = FString(TEXT(""));
 	EndLevelMessage = FString(TEXT(""));
+
+	//Snapshot every few seconds, so that a reload loses at most that much progress
+	SnapshotInterval = 5.f;
+	bResumeFromSnapshot = true;
+	LastSnapshotSize = 0;
+	SnapshotRestoreTime = 0.f;
+	SnapshotWriter = nullptr;
+	LayoutSeed = 0;
+
+	//Load the next level while the participant is still playing, so it is ready long before the exit
+	NextLevel = NAME_None;
+	PreloadAtProgress = ELevelProgress::Playing;
+	NextLevelLoadProgress = 0.f;
+	PreloadHiddenTime = 0.f;
+	NextLevelPackage = nullptr;
+	PreloadStartTime = 0.0;
+	PreloadEndTime = 0.0;
+
+	bRecordEpisode = true;
+	EventLogger = nullptr;
+	TrajectorySampleInterval = 0.f;
+	TrajectoryLogger = nullptr;
+	PoseKeyframeInterval = 2.f;
+	WorldPoseLogger = nullptr;
+	bRecordInput = true;
+	InputRecorder = nullptr;
+	NameTable = nullptr;
+
+	bExportSemanticMap = true;
+	SemanticMapCaptureTime = 0.f;
+	SemanticMapExporter = nullptr;
+	WorldStateDiffTime = 0.f;
+	WorldStateTracker = nullptr;
+	WorldStateDiff = nullptr;
+
+	//The tags are set on the actors of the kitchen maps
+	TableTag = FName(TEXT("Table"));
+	SinkTag = FName(TEXT("Sink"));
+	DirtyTag = FName(TEXT("Dirty"));
+	RequiredPlates = 0;
+	PlaceRadius = 30.f;
+	bTaskComplete = false;
+	TaskProgress = 0.f;
+	TaskEvaluationTime = 0.f;
+	TaskEvaluator = nullptr;
+
+	ReplayTimeStep = 1.f / 60.f;
+	Replayer = nullptr;
+
+	UploadQueueDepth = 0;
+	UploadMegabytesInFlight = 0.f;
+	UploadLatency = 0.f;
 }
 
 //Called every frame
@@ -18,6 +87,46 @@ void ARobCogWebGameMode::Tick(float DeltaTime)
 
 	UpdateTextBoxes();
 
+	if (SnapshotWriter)
+	{
+		LastSnapshotSize = SnapshotWriter->LastSnapshotSize.GetValue();
+	}
+
+	UpdatePreload();
+
+	if (FEpisodeUploaderPtr Uploader = FEpisodeUploader::Get())
+	{
+		const FUploadStats Stats = Uploader->GetStats();
+		UploadQueueDepth = Stats.QueueDepth;
+		UploadMegabytesInFlight = Stats.BytesInFlight / (1024.f * 1024.f);
+		UploadLatency = Stats.AverageLatencyMs;
+	}
+
+	if (TaskEvaluator)
+	{
+		bTaskComplete = TaskEvaluator->IsComplete();
+		TaskProgress = TaskEvaluator->GetProgress();
+		TaskStatus = TaskEvaluator->GetStatus();
+		TaskEvaluationTime = TaskEvaluator->GetStats().AverageCostUs;
+	}
+
+	if (Replayer)
+	{
+		Replayer->Step(GetWorld()->GetTimeSeconds());
+		if (Replayer->IsFinished())
+		{
+			Replayer->Report();
+			EndEpisode();
+			delete Replayer;
+			Replayer = nullptr;
+			FPlatformMisc::RequestExit(false);
+		}
+	}
+
+	if (WorldPoseLogger)
+	{
+		WorldPoseLogger->Tick();
+	}
 }
 
 //Initializing variables
@@ -25,7 +134,31 @@ void ARobCogWebGameMode::BeginPlay()
 {
 	Super::BeginPlay();
 
+	FStartupBenchmark::Mark(EStartupMilestone::GameModeBeginPlayStart);
+
+	//The previous level may have preloaded this one and kept it in memory until now, only the package it rooted is released
+	if (RootedLevelPackage)
+	{
+		RootedLevelPackage->RemoveFromRoot();
+		RootedLevelPackage = nullptr;
+	}
+
 	CurrentProgress = ELevelProgress::Playing;
+
+	//The uploads outlive the level, the first level of the session starts the uploader
+	FString Endpoint = UploadEndpoint;
+	FParse::Value(FCommandLine::Get(), TEXT("UploadEndpoint="), Endpoint);
+
+	//The startup benchmark measures the level alone, without the loggers and the uploader starting with it
+	if (FStartupBenchmark::IsEnabled())
+	{
+		bRecordEpisode = false;
+		Endpoint.Empty();
+	}
+	FEpisodeUploader::Start(Endpoint);
+
+	//At exit the uploader stops before the level ends, the episode is closed and queued before it
+	UploaderShutdownHandle = FEpisodeUploader::OnShutdown.AddUObject(this, &ARobCogWebGameMode::EndEpisode);
 	
 	//Pointer to the character currently in play
 	ThePlayer = Cast<AMyCharacter>(UGameplayStatics::GetPlayerPawn(this, 0));
@@ -35,7 +168,415 @@ void ARobCogWebGameMode::BeginPlay()
 	{
 		ThePlayer->PopUp.AddDynamic(this, &ARobCogWebGameMode::PopUp);
 		ThePlayer->Sub.AddDynamic(this, &ARobCogWebGameMode::Submit);
+
+		StartReplay();
+
+		//Wait for the character to map the world before touching its state
+		GetWorldTimerManager().SetTimerForNextTick(this, &ARobCogWebGameMode::ResumeSession);
 	}
+
+	FStartupBenchmark::Mark(EStartupMilestone::GameModeBeginPlayEnd);
+}
+
+void ARobCogWebGameMode::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	FEpisodeUploader::OnShutdown.Remove(UploaderShutdownHandle);
+	EndEpisode();
+
+	delete Replayer;
+	Replayer = nullptr;
+
+	//Waits for the last export to reach the disk
+	delete SemanticMapExporter;
+	SemanticMapExporter = nullptr;
+
+	delete WorldStateTracker;
+	WorldStateTracker = nullptr;
+	delete WorldStateDiff;
+	WorldStateDiff = nullptr;
+
+	if (ThePlayer)
+	{
+		ThePlayer->TaskEvaluator = nullptr;
+	}
+	delete TaskEvaluator;
+	TaskEvaluator = nullptr;
+
+	if (SnapshotWriter)
+	{
+		//Write what changed since the last timer call, the writer flushes it before stopping
+		WriteSnapshot();
+		delete SnapshotWriter;
+		SnapshotWriter = nullptr;
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+/*Replays run headless with a fixed timestep and no frame rate limit, so the physics steps are the same as in any other
+replay of the episode and the frames follow each other as fast as they are computed*/
+void ARobCogWebGameMode::StartReplay()
+{
+	FString ReplayDir;
+	if (!FParse::Value(FCommandLine::Get(), TEXT("ReplayEpisode="), ReplayDir))
+	{
+		return;
+	}
+	FParse::Value(FCommandLine::Get(), TEXT("ReplayTimeStep="), ReplayTimeStep);
+
+	Replayer = new FEpisodeReplayer(ThePlayer);
+	if (!Replayer->Load(ReplayDir) || Replayer->GetLevelName() != UGameplayStatics::GetCurrentLevelName(GetWorld(), true))
+	{
+		UE_LOG(LogRobCogWeb, Error, TEXT("Could not replay %s in %s"), *ReplayDir, *UGameplayStatics::GetCurrentLevelName(GetWorld(), true));
+		delete Replayer;
+		Replayer = nullptr;
+		FPlatformMisc::RequestExit(false);
+		return;
+	}
+
+	FApp::SetBenchmarking(true);
+	FApp::SetFixedDeltaTime(ReplayTimeStep);
+	GEngine->bSmoothFrameRate = false;
+	GEngine->bUseFixedFrameRate = false;
+
+	//The replay starts from the recorded layout and the snapshot the episode resumed from, if any: no snapshot of this level
+	//is read or written, and the level is never left
+	SnapshotInterval = 0.f;
+	NextLevel = NAME_None;
+
+	//The replayer feeds the character before it ticks, and the controller before it turns the view
+	ThePlayer->AddTickPrerequisiteActor(this);
+	APlayerController* PlayerController = UGameplayStatics::GetPlayerController(this, 0);
+	if (PlayerController)
+	{
+		PlayerController->AddTickPrerequisiteActor(this);
+	}
+
+	//Without the raw input the character is placed by the replayer, and not by its movement component
+	if (!Replayer->IsInputReplay())
+	{
+		ThePlayer->GetCharacterMovement()->DisableMovement();
+	}
+}
+
+/*Lays out the kitchen, loads the snapshot written by a previous session of this level (eg: before the page was reloaded)
+and starts the timer which keeps it up to date during play. The episode keeps a copy of the snapshot it resumed from,
+a replay restores it the same way before replaying the events*/
+void ARobCogWebGameMode::ResumeSession()
+{
+	if (!ThePlayer)
+	{
+		return;
+	}
+
+	const FString SnapshotPath = FKitchenSnapshot::GetFilePath(UGameplayStatics::GetCurrentLevelName(GetWorld(), true));
+
+	FKitchenSnapshot Snapshot;
+	bool bResume = SnapshotInterval > 0.f && bResumeFromSnapshot && FKitchenSnapshot::LoadFromFile(SnapshotPath, Snapshot);
+	if (Replayer)
+	{
+		bResume = Replayer->GetSnapshot() != nullptr;
+		if (bResume)
+		{
+			Snapshot = *Replayer->GetSnapshot();
+		}
+	}
+
+	//The layout comes first, the snapshot only holds what changed on top of it
+	for (TActorIterator<AKitchenRandomizer> It(GetWorld()); It; ++It)
+	{
+		int32 Seed = bResume ? Snapshot.LayoutSeed : (It->Seed ? It->Seed : FMath::Max(1, FMath::Rand()));
+		if (Replayer)
+		{
+			Seed = Replayer->GetLayoutSeed();
+		}
+		LayoutSeed = It->ApplyLayout(Seed);
+		break;
+	}
+
+	//The diff at Finish starts from the layout, the changes restored from the snapshot below count as made during play
+	WorldStateTracker = new FWorldStateTracker();
+	WorldStateTracker->Begin(*ThePlayer);
+	ThePlayer->ChangedActors.Reset();
+
+	StartTaskEvaluation();
+	StartEpisode();
+
+	if (bResume)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		ThePlayer->RestoreFromSnapshot(Snapshot);
+		SnapshotRestoreTime = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+		//The progress changes without its key being pressed, the event tells the readers of the episode and the replay skips it
+		CurrentProgress = Snapshot.Progress;
+		if (CurrentProgress == ELevelProgress::Finish)
+		{
+			LogProgressEvent(ESemanticEventKind::Finish);
+		}
+		else if (CurrentProgress == ELevelProgress::Exit)
+		{
+			LogProgressEvent(ESemanticEventKind::Exit);
+		}
+
+		//The restored actors moved without events, what they rest on is traced again
+		if (TaskEvaluator)
+		{
+			TaskEvaluator->Begin(*ThePlayer, GetWorld()->GetTimeSeconds());
+		}
+
+		if (!EpisodeDir.IsEmpty() && EventLogger)
+		{
+			TArray<uint8> Bytes;
+			FMemoryWriter Writer(Bytes);
+			Snapshot.Serialize(Writer);
+			FFileHelper::SaveArrayToFile(Bytes, *FPaths::Combine(*EpisodeDir, FEpisodeReplayer::SnapshotFilename));
+		}
+
+		UE_LOG(LogRobCogWeb, Log, TEXT("Resumed from snapshot: %d actors restored in %.2f ms"), Snapshot.Actors.Num(), SnapshotRestoreTime);
+	}
+
+	//The state the episode starts from, the restored snapshot included
+	ExportSemanticMap(TEXT("SemanticMap_Start"));
+
+	//The recording started with the frame after this one, so does the replay
+	if (Replayer)
+	{
+		Replayer->Start();
+	}
+
+	//The kitchen is interactive once its layout is applied and the snapshot restored, which is the end of this function
+	if (SnapshotInterval <= 0.f)
+	{
+		FStartupBenchmark::Mark(EStartupMilestone::FirstInteractiveFrame);
+		return;
+	}
+
+	//The restored state is the base on which the next deltas are merged
+	Snapshot.LayoutSeed = LayoutSeed;
+	SnapshotWriter = new FKitchenSnapshotWriter(SnapshotPath, Snapshot);
+	GetWorldTimerManager().SetTimer(SnapshotTimer, this, &ARobCogWebGameMode::WriteSnapshot, SnapshotInterval, true);
+
+	FStartupBenchmark::Mark(EStartupMilestone::FirstInteractiveFrame);
+}
+
+/*Each trial is recorded in its own folder under Saved/Episodes, named after the level and the start time*/
+void ARobCogWebGameMode::StartEpisode()
+{
+	if (!bRecordEpisode || EventLogger)
+	{
+		return;
+	}
+
+	const FString CurrentLevel = UGameplayStatics::GetCurrentLevelName(GetWorld(), true);
+	EpisodeDir = FPaths::Combine(*FPaths::GameSavedDir(), TEXT("Episodes"), *(CurrentLevel + TEXT("_") + FDateTime::Now().ToString() + (Replayer ? TEXT("_Replay") : TEXT(""))));
+	IFileManager::Get().MakeDirectory(*EpisodeDir, true);
+
+	//Keeps the crash recovery of other processes away from the journals of this episode while it records
+	FFileHelper::SaveStringToFile(FString::Printf(TEXT("%u"), FPlatformProcess::GetCurrentProcessId()), *FEpisodeReader::GetOwnerPath(EpisodeDir));
+
+	//Names are interned once for all the logs of the episode, before any writer thread reads the table;
+	//the logs refer to the actors by their stable id, the directory maps the ids back to names and tags
+	NameTable = new FNameTable();
+	NameTable->Seed(*ThePlayer);
+	NameTable->Save(FPaths::Combine(*EpisodeDir, TEXT("Names.bin")));
+	ThePlayer->ActorIds.Save(FPaths::Combine(*EpisodeDir, TEXT("Actors.bin")), *NameTable);
+
+	//The OWL export is fed by the writer thread of the logger, it never runs on the game thread
+	TMap<uint32, FString> ActorNames;
+	ThePlayer->ActorIds.GetNames(ActorNames);
+	TSet<uint32> DoorIds;
+	for (const auto& Asset : ThePlayer->AssetStateMap)
+	{
+		if (Asset.Key && Asset.Key->ActorHasTag(FName(TEXT("Door"))))
+		{
+			DoorIds.Add(ThePlayer->ActorIds.GetId(Asset.Key));
+		}
+	}
+	TArray<IEpisodeEventSink*> Sinks;
+	Sinks.Add(new FOwlEpisodeWriter(FPaths::Combine(*EpisodeDir, TEXT("Episode.owl")), FPaths::GetCleanFilename(EpisodeDir), ActorNames, DoorIds));
+
+	//The segments are uploaded from the writer threads as soon as they are closed, the end of the episode only sends the rest;
+	//the uploader is looked up at each call since it may shut down before the loggers do, the reference keeps it alive meanwhile
+	TFunction<void(const FString&)> OnSegmentWritten;
+	if (!Replayer && FEpisodeUploader::Get().IsValid())
+	{
+		OnSegmentWritten = [](const FString& SegmentPath)
+		{
+			if (FEpisodeUploaderPtr Uploader = FEpisodeUploader::Get())
+			{
+				Uploader->EnqueueSegment(SegmentPath);
+			}
+		};
+	}
+
+	EventLogger = new FSemanticEventLogger(FPaths::Combine(*EpisodeDir, TEXT("Events.bin")), CurrentLevel, LayoutSeed, Sinks, OnSegmentWritten);
+	ThePlayer->EventLogger = EventLogger;
+
+	if (TrajectorySampleInterval >= 0.f)
+	{
+		TrajectoryLogger = new FTrajectoryLogger(FPaths::Combine(*EpisodeDir, TEXT("Trajectories.bin")), CurrentLevel, TrajectorySampleInterval, OnSegmentWritten);
+		ThePlayer->TrajectoryLogger = TrajectoryLogger;
+	}
+
+	//A replay drives the handlers directly, the player input it would record stays empty
+	if (bRecordInput && !Replayer)
+	{
+		InputRecorder = new FInputRecorder(FPaths::Combine(*EpisodeDir, TEXT("Inputs.bin")), CurrentLevel, OnSegmentWritten);
+		ThePlayer->InputRecorder = InputRecorder;
+	}
+
+	if (PoseKeyframeInterval >= 0.f)
+	{
+		WorldPoseLogger = new FWorldPoseLogger(FPaths::Combine(*EpisodeDir, TEXT("WorldPoses.bin")), CurrentLevel, GetWorld(), OnSegmentWritten);
+		WorldPoseLogger->KeyframeInterval = PoseKeyframeInterval;
+		for (const auto& Asset : ThePlayer->AssetStateMap)
+		{
+			WorldPoseLogger->Track(Asset.Key, ThePlayer->ActorIds.GetId(Asset.Key));
+		}
+		for (const auto& Item : ThePlayer->ItemMap)
+		{
+			//Pooled items left out of the layout stay parked for the whole episode
+			if (!Item.Key->bHidden)
+			{
+				WorldPoseLogger->Track(Item.Key, ThePlayer->ActorIds.GetId(Item.Key));
+			}
+		}
+	}
+}
+
+void ARobCogWebGameMode::EndEpisode()
+{
+	if (!EventLogger)
+	{
+		return;
+	}
+
+	if (ThePlayer)
+	{
+		ThePlayer->EventLogger = nullptr;
+		ThePlayer->TrajectoryLogger = nullptr;
+		ThePlayer->InputRecorder = nullptr;
+	}
+	delete EventLogger;
+	EventLogger = nullptr;
+	delete TrajectoryLogger;
+	TrajectoryLogger = nullptr;
+	delete WorldPoseLogger;
+	WorldPoseLogger = nullptr;
+	delete InputRecorder;
+	InputRecorder = nullptr;
+	delete NameTable;
+	NameTable = nullptr;
+
+	//The logs are closed and their journals deleted, nothing is left to recover
+	IFileManager::Get().Delete(*FEpisodeReader::GetOwnerPath(EpisodeDir), false, false, true);
+
+	//Written before the episode is queued, so that the upload includes it
+	if (TaskEvaluator)
+	{
+		const FTaskEvaluationStats& Stats = TaskEvaluator->GetStats();
+		UE_LOG(LogRobCogWeb, Log, TEXT("Task evaluation: %s, %d events, %.2f us average, %.2f us max, supports traced in %.3f ms"),
+			*TaskEvaluator->GetStatus(), Stats.NumEvents, Stats.AverageCostUs, Stats.MaxCostUs, Stats.BeginTimeMs);
+		if (!TaskEvaluator->SaveToFile(FPaths::Combine(*EpisodeDir, TEXT("TaskEvaluation.bin"))))
+		{
+			UE_LOG(LogRobCogWeb, Warning, TEXT("Could not write the task evaluation to %s"), *EpisodeDir);
+		}
+	}
+
+	//The logs are closed and their last segments queued, the uploader sends what was not streamed and the manifest; replays are not uploaded
+	FEpisodeUploaderPtr Uploader = FEpisodeUploader::Get();
+	if (!Replayer && Uploader.IsValid())
+	{
+		Uploader->EnqueueEpisode(EpisodeDir);
+	}
+}
+
+void ARobCogWebGameMode::LogProgressEvent(ESemanticEventKind Kind)
+{
+	if (EventLogger)
+	{
+		EventLogger->Log(Kind, EEventHand::None, nullptr, 0, 0, GetWorld()->GetTimeSeconds());
+	}
+}
+
+void ARobCogWebGameMode::ExportSemanticMap(const FString& MapName)
+{
+	if (!bExportSemanticMap || !ThePlayer || EpisodeDir.IsEmpty())
+	{
+		return;
+	}
+
+	FSemanticMapCapture Capture;
+	Capture.Capture(*ThePlayer);
+	Capture.Timestamp = GetWorld()->GetTimeSeconds();
+	SemanticMapCaptureTime = Capture.CaptureTime;
+
+	//Only one export runs at a time, a resubmit waits for the previous finish export to be written
+	delete SemanticMapExporter;
+	SemanticMapExporter = new FSemanticMapExporter(FPaths::Combine(*EpisodeDir, *(MapName + TEXT(".owl"))), MapName, Capture);
+}
+
+/*Only the actors the character changed are read back, the rest of the kitchen is taken from the start state.
+A resume followed by another Finish recomputes it from the start, with the changes made since*/
+void ARobCogWebGameMode::ComputeWorldStateDiff()
+{
+	if (!WorldStateTracker || !ThePlayer)
+	{
+		return;
+	}
+
+	if (!WorldStateDiff)
+	{
+		WorldStateDiff = new FWorldStateDiff();
+	}
+	WorldStateTracker->Compute(*ThePlayer, *WorldStateDiff);
+	WorldStateDiffTime = WorldStateDiff->ComputeTime;
+
+	UE_LOG(LogRobCogWeb, Log, TEXT("World state diff: %d actors changed, %d items moved, %d drawers and doors changed, %d new relations in %.3f ms"),
+		WorldStateDiff->NumChanged, WorldStateDiff->MovedItems.Num(), WorldStateDiff->ChangedAssets.Num(), WorldStateDiff->NewRelations.Num(), WorldStateDiffTime);
+
+	//A few hundred bytes, written like the name table and the actor directory
+	if (!EpisodeDir.IsEmpty() && EventLogger && !WorldStateDiff->SaveToFile(FPaths::Combine(*EpisodeDir, TEXT("WorldStateDiff.bin"))))
+	{
+		UE_LOG(LogRobCogWeb, Warning, TEXT("Could not write the world state diff to %s"), *EpisodeDir);
+	}
+}
+
+/*The rules follow the level: the breakfast sets the table, the cleaning brings the dirty items to the sink.
+The evaluator starts from the layout, before any event of the episode*/
+void ARobCogWebGameMode::StartTaskEvaluation()
+{
+	ITaskRule* Rule = nullptr;
+	switch (LevelName)
+	{
+	case ECurrentLevel::BreakfastLevel:
+		Rule = new FBreakfastRule(TableTag, RequiredPlates, PlaceRadius);
+		break;
+	case ECurrentLevel::CleaningLevel:
+		Rule = new FCleaningRule(SinkTag, DirtyTag);
+		break;
+	default:
+		return;
+	}
+
+	TaskEvaluator = new FTaskEvaluator(Rule);
+	TaskEvaluator->Begin(*ThePlayer, GetWorld()->GetTimeSeconds());
+	ThePlayer->TaskEvaluator = TaskEvaluator;
+}
+
+void ARobCogWebGameMode::WriteSnapshot()
+{
+	if (!SnapshotWriter || !ThePlayer)
+	{
+		return;
+	}
+
+	FKitchenSnapshot Delta;
+	Delta.Progress = CurrentProgress;
+	Delta.LayoutSeed = LayoutSeed;
+	ThePlayer->CaptureSnapshot(Delta);
+	SnapshotWriter->Enqueue(Delta);
 }
 
 //Print a message to the screen whenever the character performs actions which are not permited
@@ -55,19 +596,112 @@ void ARobCogWebGameMode::Submit(FString Message, bool bEndOrResume)
 		if (CurrentProgress == ELevelProgress::Playing)
 		{
 			CurrentProgress = ELevelProgress::Finish;
+			LogProgressEvent(ESemanticEventKind::Finish);
+			ExportSemanticMap(TEXT("SemanticMap_Finish"));
+			ComputeWorldStateDiff();
 		}
 		else if (CurrentProgress == ELevelProgress::Finish)
 		{
 			CurrentProgress = ELevelProgress::Exit;
+			LogProgressEvent(ESemanticEventKind::Exit);
+			EndEpisode();
+
+			//The session is complete, there is nothing left to resume
+			if (SnapshotWriter)
+			{
+				GetWorldTimerManager().ClearTimer(SnapshotTimer);
+				delete SnapshotWriter;
+				SnapshotWriter = nullptr;
+				IFileManager::Get().Delete(*FKitchenSnapshot::GetFilePath(UGameplayStatics::GetCurrentLevelName(GetWorld(), true)));
+			}
+
+			OpenNextLevel();
 		}
 	}
 	else
 	{
+		if (CurrentProgress == ELevelProgress::Finish)
+		{
+			LogProgressEvent(ESemanticEventKind::Resume);
+		}
 		CurrentProgress = ELevelProgress::Playing;
 	}
 
 }
 
+FString ARobCogWebGameMode::GetNextLevelPackageName() const
+{
+	//Short names refer to the maps folder of the project
+	const FString LevelName = NextLevel.ToString();
+	return FPackageName::IsValidLongPackageName(LevelName) ? LevelName : FString(TEXT("/Game/Maps/")) + LevelName;
+}
+
+void ARobCogWebGameMode::UpdatePreload()
+{
+	if (NextLevel == NAME_None)
+	{
+		return;
+	}
+
+	//Start the async load when the configured progress is reached (Playing < Finish < Exit)
+	if (PreloadStartTime == 0.0 && (uint8)CurrentProgress >= (uint8)PreloadAtProgress)
+	{
+		PreloadStartTime = FPlatformTime::Seconds();
+		LoadPackageAsync(GetNextLevelPackageName(), FLoadPackageAsyncDelegate::CreateUObject(this, &ARobCogWebGameMode::OnNextLevelLoaded));
+	}
+
+	if (PreloadStartTime != 0.0 && PreloadEndTime == 0.0)
+	{
+		//Percentage is negative while the package is not (or no longer) in the loading queue
+		const float Percentage = GetAsyncLoadPercentage(FName(*GetNextLevelPackageName()));
+		if (Percentage >= 0.f)
+		{
+			NextLevelLoadProgress = Percentage / 100.f;
+		}
+	}
+}
+
+void ARobCogWebGameMode::OnNextLevelLoaded(const FName& PackageName, UPackage* LoadedPackage, EAsyncLoadingResult::Type Result)
+{
+	PreloadEndTime = FPlatformTime::Seconds();
+	NextLevelLoadProgress = 1.f;
+
+	if (Result != EAsyncLoadingResult::Succeeded || !LoadedPackage)
+	{
+		UE_LOG(LogRobCogWeb, Warning, TEXT("Preloading %s failed"), *PackageName.ToString());
+		return;
+	}
+
+	//Rooted so the garbage collection of the level transition does not throw it away, the next game mode releases it
+	NextLevelPackage = LoadedPackage;
+	if (!NextLevelPackage->IsRooted())
+	{
+		NextLevelPackage->AddToRoot();
+		RootedLevelPackage = NextLevelPackage;
+	}
+
+	UE_LOG(LogRobCogWeb, Log, TEXT("Preloaded %s in %.0f ms"), *PackageName.ToString(), (PreloadEndTime - PreloadStartTime) * 1000.0);
+}
+
+void ARobCogWebGameMode::OpenNextLevel()
+{
+	if (NextLevel == NAME_None)
+	{
+		return;
+	}
+
+	//Everything loaded before the exit is time the participant does not wait for during the transition
+	const double ExitTime = FPlatformTime::Seconds();
+	if (PreloadStartTime != 0.0)
+	{
+		PreloadHiddenTime = ((PreloadEndTime != 0.0 ? PreloadEndTime : ExitTime) - PreloadStartTime) * 1000.0;
+	}
+	UE_LOG(LogRobCogWeb, Log, TEXT("Opening %s: %.0f ms of loading hidden during play, preload %s"),
+		*NextLevel.ToString(), PreloadHiddenTime, PreloadEndTime != 0.0 ? TEXT("complete") : TEXT("still running"));
+
+	UGameplayStatics::OpenLevel(this, NextLevel);
+}
+
 void ARobCogWebGameMode::ResetPopUp()
 {
 	PopUpMessage = FString(TEXT(""));
@@ -28,6 +28,17 @@ enum class ELevelProgress : uint8
 
 };
 
+class FKitchenSnapshotWriter;
+class FSemanticEventLogger;
+class FSemanticMapExporter;
+class FTrajectoryLogger;
+class FWorldPoseLogger;
+class FInputRecorder;
+class FNameTable;
+class FEpisodeReplayer;
+class FWorldStateTracker;
+struct FWorldStateDiff;
+class FTaskEvaluator;
 
 /**
  * 
@@ -63,6 +74,132 @@ protected:
 
 	UPROPERTY(BlueprintReadWrite, EditAnywhere)
 	ELevelProgress CurrentProgress;
+
+	//Seconds between two incremental snapshots of the kitchen state (0 disables snapshots)
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	float SnapshotInterval;
+
+	//Resume the level from the last snapshot written for it, if there is one
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	bool bResumeFromSnapshot;
+
+	//Size in bytes of the last snapshot written to disk
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere)
+	int32 LastSnapshotSize;
+
+	//Time in milliseconds spent restoring the snapshot at level load
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere)
+	float SnapshotRestoreTime;
+
+	//Seed of the randomized item layout of this trial, 0 if the level has no randomizer or kept its authored layout
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere)
+	int32 LayoutSeed;
+
+	//Map opened when the level exits (eg: CleaningLevel after BreakfastLevel), none keeps the exit to the blueprints
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	FName NextLevel;
+
+	//Progress at which the next level starts loading in the background
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	ELevelProgress PreloadAtProgress;
+
+	//Loading progress of the next level between 0 and 1, displayed by the HUD
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere)
+	float NextLevelLoadProgress;
+
+	//Milliseconds of the next level loading which happened during play instead of during the transition
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere)
+	float PreloadHiddenTime;
+
+	//Package of the next level, kept in memory until the transition
+	UPROPERTY()
+	UPackage* NextLevelPackage;
+
+	//Record the semantic events of the trial
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	bool bRecordEpisode;
+
+	//Folder receiving the files of the current episode
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere)
+	FString EpisodeDir;
+
+	//Seconds between two trajectory samples, 0 samples every frame (negative disables the trajectories)
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	float TrajectorySampleInterval;
+
+	//Seconds between two keyframes of the world pose log (negative disables the log)
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	float PoseKeyframeInterval;
+
+	//Record the raw input of the player every frame, to play the session back exactly
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	bool bRecordInput;
+
+	//Export the kitchen as an OWL semantic map at the start of the episode and when the task is finished
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	bool bExportSemanticMap;
+
+	//Time in milliseconds the game thread spent on the last semantic map capture
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere)
+	float SemanticMapCaptureTime;
+
+	//Time in milliseconds the game thread spent on the last world state diff
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere)
+	float WorldStateDiffTime;
+
+	//Tags of the actors the task rules look for: the table of the breakfast, the sink and the items to clean of the cleaning
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	FName TableTag;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	FName SinkTag;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	FName DirtyTag;
+
+	//Places to set for the breakfast, 0 sets as many as the plates, mugs and spoons of the level allow
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	int32 RequiredPlates;
+
+	//Distance from its plate within which a mug or a spoon on the table belongs to the place, in cm
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	float PlaceRadius;
+
+	//Whether the rules of the level hold, as of the last event
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere)
+	bool bTaskComplete;
+
+	//Share of the task done, between 0 and 1
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere)
+	float TaskProgress;
+
+	//Short description of what is left, for the HUD
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere)
+	FString TaskStatus;
+
+	//Average time in microseconds the game thread spent evaluating the task after an event
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere)
+	float TaskEvaluationTime;
+
+	//Fixed timestep of the replays in seconds, the replay runs as fast as the frames are computed
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	float ReplayTimeStep;
+
+	//URL (http:// or https://) or folder the finished episodes are uploaded to, empty disables the upload; -UploadEndpoint= overrides it
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	FString UploadEndpoint;
+
+	//Files waiting for the upload
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere)
+	int32 UploadQueueDepth;
+
+	//Size of the batch being uploaded, in MB
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere)
+	float UploadMegabytesInFlight;
+
+	//Average time from the end of an episode to the acknowledgement of its files, in ms
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere)
+	float UploadLatency;
 	
 public:
 	//Constructor for the game mode class
@@ -74,6 +211,9 @@ public:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	// Called when the level is left or the game closed
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	//Setter functions for the Display Message varraibles
 	void UpdateRightText(FString Message);
 	void UpdateLeftText(FString Message);
@@ -95,4 +235,91 @@ public:
 	//Timer for reseting the pop up text
 	FTimerHandle ResetPopUpTimer;
 
+	//Applies the item layout, restores the last snapshot of the level and starts writing new ones
+	void ResumeSession();
+
+	//Sends the changes since the last snapshot to the writer thread
+	void WriteSnapshot();
+
+	//Timer for writing the snapshots
+	FTimerHandle SnapshotTimer;
+
+	//Background writer for the snapshots, null when snapshots are disabled
+	FKitchenSnapshotWriter* SnapshotWriter;
+
+	//Creates the episode folder and starts the event logger, called once the layout is known
+	void StartEpisode();
+
+	//Stops the recording and closes the episode files
+	void EndEpisode();
+
+	//Closes the episode when the uploader shuts down at exit, before the level ends
+	FDelegateHandle UploaderShutdownHandle;
+
+	//Records an event which is not tied to an actor (progress changes)
+	void LogProgressEvent(ESemanticEventKind Kind);
+
+	//Logger of the semantic events, null when not recording
+	FSemanticEventLogger* EventLogger;
+
+	//Logger of the trajectories, null when not recording
+	FTrajectoryLogger* TrajectoryLogger;
+
+	//Logger of the moves of the drawers, doors and items, null when not recording
+	FWorldPoseLogger* WorldPoseLogger;
+
+	//Recorder of the raw input, null when not recording
+	FInputRecorder* InputRecorder;
+
+	//Names interned for the logs of the episode, null when not recording
+	FNameTable* NameTable;
+
+	//Captures the kitchen and exports it to the episode folder on a background thread
+	void ExportSemanticMap(const FString& MapName);
+
+	//Background export of the semantic map, kept until the next export or the end of the level
+	FSemanticMapExporter* SemanticMapExporter;
+
+	//Diffs the kitchen against its state once the layout was applied and writes it to the episode folder (WorldStateDiff.bin)
+	void ComputeWorldStateDiff();
+
+	//Start state of the kitchen, null until the layout is applied
+	FWorldStateTracker* WorldStateTracker;
+
+	//Changes made during the episode, as of the last Finish; null before it
+	FWorldStateDiff* WorldStateDiff;
+
+	//Creates the evaluator of the rules of the level, if it has any, and hands it to the character
+	void StartTaskEvaluation();
+
+	//Evaluator of the task of the level, null for the tutorial
+	FTaskEvaluator* TaskEvaluator;
+
+	/*Starts replaying the episode given on the command line, if any:
+	UE4Editor-Cmd RobCogWeb.uproject KitchenSemLog -game -nullrhi -nosound -ReplayEpisode=<episode folder> [-ReplayTimeStep=<seconds>]
+	The replay records a new episode and quits once it is over.*/
+	void StartReplay();
+
+	//Drives the character during a replay, null otherwise
+	FEpisodeReplayer* Replayer;
+
+	//Starts loading the next level asynchronously once the progress point is reached
+	void UpdatePreload();
+
+	//Called by the async loading when the next level package is in memory
+	void OnNextLevelLoaded(const FName& PackageName, UPackage* LoadedPackage, EAsyncLoadingResult::Type Result);
+
+	//Opens the next level, the remaining part of the async load is finished by the engine
+	void OpenNextLevel();
+
+	//Full package name of the next level
+	FString GetNextLevelPackageName() const;
+
+	//Times of the preload start and end, in seconds
+	double PreloadStartTime;
+	double PreloadEndTime;
+
+	//Package rooted by the preload of the previous level, un-rooted by the next game mode whichever level it plays
+	static UPackage* RootedLevelPackage;
+
 };
@@ -0,0 +1,157 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "SegmentedFileReader.h"
+#include "SegmentedFileWriter.h"
+
+FSegmentedFileReader::FSegmentedFileReader(const FString& InBasePath)
+	: BasePath(InBasePath)
+	, CurrentSegment(INDEX_NONE)
+	, Position(0)
+	, StreamSize(0)
+	, SegmentsLoaded(0)
+{
+	ArIsLoading = true;
+	ArIsPersistent = true;
+}
+
+bool FSegmentedFileReader::Open()
+{
+	Segments.Reset();
+	StreamSize = 0;
+
+	//Mirror of FSegmentedFileWriter::Close()
+	TArray<uint8> IndexBytes;
+	if (FFileHelper::LoadFileToArray(IndexBytes, *(BasePath + TEXT(".index")), FILEREAD_Silent))
+	{
+		FMemoryReader Reader(IndexBytes);
+		uint32 Magic;
+		uint16 FileVersion;
+		int32 NumSegments = 0;
+		Reader << Magic;
+		Reader << FileVersion;
+		Reader << NumSegments;
+		if (Magic == FSegmentedFileWriter::SegmentMagic && FileVersion == FSegmentedFileWriter::Version)
+		{
+			for (int32 i = 0; i < NumSegments && !Reader.IsError(); i++)
+			{
+				FSegmentInfo& Info = Segments[Segments.AddUninitialized()];
+				int32 NumRecords;
+				Reader << Info.StreamOffset;
+				Reader << Info.PayloadSize;
+				Reader << NumRecords;
+			}
+		}
+		if (Reader.IsError())
+		{
+			Segments.Reset();
+		}
+	}
+
+	//Without the index (eg: after a crash) the segments are read once to learn their size
+	if (!Segments.Num())
+	{
+		int64 StreamOffset = 0;
+		for (int32 SegmentIndex = 0; IFileManager::Get().FileExists(*FSegmentedFileWriter::GetSegmentPath(BasePath, SegmentIndex)); SegmentIndex++)
+		{
+			if (!FSegmentedFileWriter::ReadSegment(FSegmentedFileWriter::GetSegmentPath(BasePath, SegmentIndex), Payload, RecordEnds))
+			{
+				break;
+			}
+			FSegmentInfo& Info = Segments[Segments.AddUninitialized()];
+			Info.StreamOffset = StreamOffset;
+			Info.PayloadSize = Payload.Num();
+			StreamOffset += Payload.Num();
+		}
+		CurrentSegment = INDEX_NONE;
+	}
+
+	if (Segments.Num())
+	{
+		StreamSize = Segments.Last().StreamOffset + Segments.Last().PayloadSize;
+	}
+	Position = 0;
+	return Segments.Num() > 0;
+}
+
+bool FSegmentedFileReader::LoadSegmentAt(int64 StreamOffset)
+{
+	if (CurrentSegment != INDEX_NONE && StreamOffset >= Segments[CurrentSegment].StreamOffset &&
+		StreamOffset < Segments[CurrentSegment].StreamOffset + Segments[CurrentSegment].PayloadSize)
+	{
+		return true;
+	}
+
+	//Last segment starting at or before the offset
+	int32 Low = 0;
+	int32 High = Segments.Num() - 1;
+	while (Low < High)
+	{
+		const int32 Middle = (Low + High + 1) / 2;
+		if (Segments[Middle].StreamOffset <= StreamOffset)
+		{
+			Low = Middle;
+		}
+		else
+		{
+			High = Middle - 1;
+		}
+	}
+	if (!Segments.Num() || StreamOffset < Segments[Low].StreamOffset || StreamOffset >= Segments[Low].StreamOffset + Segments[Low].PayloadSize)
+	{
+		return false;
+	}
+
+	CurrentSegment = INDEX_NONE;
+	if (!FSegmentedFileWriter::ReadSegment(FSegmentedFileWriter::GetSegmentPath(BasePath, Low), Payload, RecordEnds) || Payload.Num() != Segments[Low].PayloadSize)
+	{
+		UE_LOG(LogRobCogWeb, Warning, TEXT("Segment %s is corrupted"), *FSegmentedFileWriter::GetSegmentPath(BasePath, Low));
+		return false;
+	}
+	CurrentSegment = Low;
+	SegmentsLoaded++;
+	return true;
+}
+
+void FSegmentedFileReader::Serialize(void* Data, int64 Num)
+{
+	uint8* Destination = (uint8*)Data;
+	while (Num > 0)
+	{
+		if (!LoadSegmentAt(Position))
+		{
+			FMemory::Memzero(Destination, Num);
+			ArIsError = true;
+			return;
+		}
+
+		//Records may continue in the next segment
+		const FSegmentInfo& Info = Segments[CurrentSegment];
+		const int64 SegmentOffset = Position - Info.StreamOffset;
+		const int64 Count = FMath::Min<int64>(Num, Info.PayloadSize - SegmentOffset);
+		FMemory::Memcpy(Destination, Payload.GetData() + SegmentOffset, Count);
+		Destination += Count;
+		Position += Count;
+		Num -= Count;
+	}
+}
+
+void FSegmentedFileReader::Seek(int64 InPos)
+{
+	Position = InPos;
+}
+
+int64 FSegmentedFileReader::Tell()
+{
+	return Position;
+}
+
+int64 FSegmentedFileReader::TotalSize()
+{
+	return StreamSize;
+}
+
+FString FSegmentedFileReader::GetArchiveName() const
+{
+	return BasePath;
+}
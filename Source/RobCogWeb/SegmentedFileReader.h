@@ -0,0 +1,51 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/*Archive reading a log written by FSegmentedFileWriter at any stream offset, one segment at a time.
+Seeking only looks up the segment table; a segment is read from disk and checked against its CRC
+the first time a read lands in it, and stays loaded until a read lands in another one.
+*/
+class FSegmentedFileReader : public FArchive
+{
+public:
+	FSegmentedFileReader(const FString& InBasePath);
+
+	//Reads the segment table from the index of the log, or from the segments themselves if the log was never closed;
+	//returns false if the log has no segment
+	bool Open();
+
+	//FArchive interface
+	virtual void Serialize(void* Data, int64 Num) override;
+	virtual void Seek(int64 InPos) override;
+	virtual int64 Tell() override;
+	virtual int64 TotalSize() override;
+	virtual FString GetArchiveName() const override;
+
+	//Segments read from disk since the log was opened
+	int32 GetSegmentsLoaded() const { return SegmentsLoaded; }
+
+private:
+	//Makes the segment holding the stream offset the current one, returns false past the end or on a corrupted segment
+	bool LoadSegmentAt(int64 StreamOffset);
+
+	struct FSegmentInfo
+	{
+		int64 StreamOffset;
+		int32 PayloadSize;
+	};
+
+	FString BasePath;
+
+	TArray<FSegmentInfo> Segments;
+
+	//Segment loaded, INDEX_NONE if none, and its payload
+	int32 CurrentSegment;
+	TArray<uint8> Payload;
+	TArray<uint32> RecordEnds;
+
+	int64 Position;
+	int64 StreamSize;
+
+	int32 SegmentsLoaded;
+};
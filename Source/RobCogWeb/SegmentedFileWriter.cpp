@@ -0,0 +1,466 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "SegmentedFileWriter.h"
+
+const float FSegmentedFileWriter::RetryInterval = 1.f;
+
+FSegmentedFileWriter::FSegmentedFileWriter(const FString& InBasePath, int32 InSegmentSize, float InMaxSegmentAge, float InJournalSyncInterval)
+	: BasePath(InBasePath)
+	, SegmentSize(InSegmentSize)
+	, MaxSegmentAge(InMaxSegmentAge)
+	, SegmentStreamOffset(0)
+	, WriteTime(0.0)
+	, TotalRecords(0)
+	, Journal(nullptr)
+	, JournalPath(GetJournalPath(InBasePath))
+	, JournalSyncInterval(InJournalSyncInterval)
+	, LastJournalSync(0.0)
+	, JournalEnd(0)
+	, bJournalDirty(false)
+	, NextRetryTime(0.0)
+	, NumFailedWrites(0)
+	, bClosed(false)
+{
+	ArIsSaving = true;
+	ArIsPersistent = true;
+
+	//The buffers are sized for a full segment now, so that appending never allocates
+	Buffer.Reserve(SegmentSize);
+	RecordEnds.Reserve(SegmentSize / 16);
+	FileBuffer.Reserve(HeaderSize + SegmentSize + RecordEnds.Max() * sizeof(uint32) + 64);
+
+	SegmentStartTime = FPlatformTime::Seconds();
+
+	if (JournalSyncInterval >= 0.f)
+	{
+		Journal = IFileManager::Get().CreateFileWriter(*JournalPath, FILEWRITE_AllowRead);
+		if (!Journal)
+		{
+			UE_LOG(LogRobCogWeb, Warning, TEXT("Could not open the journal %s, a crash loses the current segment"), *JournalPath);
+		}
+	}
+}
+
+FSegmentedFileWriter::~FSegmentedFileWriter()
+{
+	Close();
+}
+
+FString FSegmentedFileWriter::GetSegmentPath(const FString& BasePath, int32 SegmentIndex)
+{
+	return FString::Printf(TEXT("%s.%04d"), *BasePath, SegmentIndex);
+}
+
+FString FSegmentedFileWriter::GetJournalPath(const FString& BasePath)
+{
+	return BasePath + TEXT(".journal");
+}
+
+FString FSegmentedFileWriter::GetArchiveName() const
+{
+	return BasePath;
+}
+
+int64 FSegmentedFileWriter::Tell()
+{
+	return SegmentStreamOffset + Buffer.Num();
+}
+
+int64 FSegmentedFileWriter::TotalSize()
+{
+	return Tell();
+}
+
+/*Segments roll over on record boundaries only: before a record which does not fit in the rest of the segment, or once
+a record filled it. A record larger than a segment grows the buffer, so that every segment holds whole records.*/
+void FSegmentedFileWriter::Serialize(void* Data, int64 Num)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	if (Buffer.Num() + Num > SegmentSize && RecordEnds.Num() && RecordEnds.Last() == Buffer.Num())
+	{
+		WriteSegment();
+	}
+	Buffer.Append((uint8*)Data, Num);
+
+	WriteTime += FPlatformTime::Seconds() - StartTime;
+}
+
+void FSegmentedFileWriter::Flush()
+{
+	//Called with nothing new when the log is idle, to keep the journal and the segment age on time
+	if (Buffer.Num() && (!RecordEnds.Num() || RecordEnds.Last() != Buffer.Num()))
+	{
+		RecordEnds.Add(Buffer.Num());
+		TotalRecords++;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	AppendJournal();
+	if (bJournalDirty && StartTime - LastJournalSync >= JournalSyncInterval)
+	{
+		SyncJournal();
+	}
+
+	//Full, or old enough to bound what a crash can lose when the log grows slowly
+	if (Buffer.Num() >= SegmentSize || StartTime - SegmentStartTime > MaxSegmentAge)
+	{
+		WriteSegment();
+	}
+	WriteTime += FPlatformTime::Seconds() - StartTime;
+}
+
+/*Layout of a journal record: magic, stream offset of the data, size, CRC and the data, which runs from a record end to another*/
+void FSegmentedFileWriter::AppendJournal()
+{
+	if (!Journal || JournalEnd == Buffer.Num() || !RecordEnds.Num() || RecordEnds.Last() != Buffer.Num())
+	{
+		return;
+	}
+
+	uint32 Magic = JournalMagic;
+	int64 StreamOffset = SegmentStreamOffset + JournalEnd;
+	uint32 Size = Buffer.Num() - JournalEnd;
+	uint32 Crc = GetJournalCrc(StreamOffset, Size, Buffer.GetData() + JournalEnd);
+	*Journal << Magic;
+	*Journal << StreamOffset;
+	*Journal << Size;
+	*Journal << Crc;
+	Journal->Serialize(Buffer.GetData() + JournalEnd, Size);
+	JournalEnd = Buffer.Num();
+	bJournalDirty = true;
+}
+
+/*The archive buffers the records, they reach the operating system (and outlive a crash of the game) when pushed here.
+The engine has no portable call to force them to the device, a power loss may still lose the last interval.*/
+void FSegmentedFileWriter::SyncJournal()
+{
+	if (Journal)
+	{
+		Journal->Flush();
+	}
+	LastJournalSync = FPlatformTime::Seconds();
+	bJournalDirty = false;
+}
+
+uint32 FSegmentedFileWriter::GetJournalCrc(int64 StreamOffset, uint32 Size, const uint8* Data)
+{
+	uint32 Crc = FCrc::MemCrc32(&StreamOffset, sizeof(StreamOffset));
+	Crc = FCrc::MemCrc32(&Size, sizeof(Size), Crc);
+	return FCrc::MemCrc32(Data, Size, Crc);
+}
+
+/*Layout of a segment file: header, payload, end offset of each record in the payload, CRC of the payload,
+number of records, payload size and footer magic. Readers start from the end, so a torn file is detected
+by a missing footer magic or a wrong CRC.*/
+void FSegmentedFileWriter::WriteSegment()
+{
+	if (!Buffer.Num())
+	{
+		SegmentStartTime = FPlatformTime::Seconds();
+		return;
+	}
+
+	//After a failure the segment is retried at most every RetryInterval, the last attempt is made by Close()
+	if (NumFailedWrites && !bClosed && FPlatformTime::Seconds() < NextRetryTime)
+	{
+		return;
+	}
+
+	const int32 SegmentIndex = Segments.Num();
+	const FString SegmentPath = GetSegmentPath(BasePath, SegmentIndex);
+	if (!SaveSegment(SegmentPath, SegmentIndex, SegmentStreamOffset, Buffer, RecordEnds, FileBuffer))
+	{
+		//The records stay in the buffer and in the journal, which is only started over once they are all in segments
+		UE_LOG(LogRobCogWeb, Warning, TEXT("Could not write log segment %s, retrying with the next records"), *SegmentPath);
+		ArIsError = true;
+		NumFailedWrites++;
+		NextRetryTime = FPlatformTime::Seconds() + RetryInterval;
+		return;
+	}
+	if (NumFailedWrites)
+	{
+		//Nothing was lost, the log is whole again
+		UE_LOG(LogRobCogWeb, Log, TEXT("Log segment %s written after %d failed attempts"), *SegmentPath, NumFailedWrites);
+		ArIsError = false;
+		NumFailedWrites = 0;
+	}
+
+	//Every record written so far is in a segment, the journal starts over
+	if (Journal)
+	{
+		delete Journal;
+		Journal = IFileManager::Get().CreateFileWriter(*JournalPath, FILEWRITE_AllowRead);
+		bJournalDirty = false;
+	}
+	if (OnSegmentWritten)
+	{
+		OnSegmentWritten(SegmentPath);
+	}
+
+	FSegmentInfo Info;
+	Info.StreamOffset = SegmentStreamOffset;
+	Info.PayloadSize = Buffer.Num();
+	Info.NumRecords = RecordEnds.Num();
+	Segments.Add(Info);
+
+	SegmentStreamOffset += Buffer.Num();
+	Buffer.Reset();
+	RecordEnds.Reset();
+	JournalEnd = 0;
+	SegmentStartTime = FPlatformTime::Seconds();
+}
+
+bool FSegmentedFileWriter::SaveSegment(const FString& SegmentPath, int32 SegmentIndex, int64 StreamOffset, const TArray<uint8>& Payload, const TArray<uint32>& RecordEnds, TArray<uint8>& FileBuffer)
+{
+	uint32 Magic = SegmentMagic;
+	uint16 FileVersion = Version;
+	uint32 Crc = FCrc::MemCrc32(Payload.GetData(), Payload.Num());
+	int32 NumRecords = RecordEnds.Num();
+	int32 PayloadSize = Payload.Num();
+	uint32 EndMagic = FooterMagic;
+
+	FileBuffer.Reset();
+	FMemoryWriter Writer(FileBuffer);
+	Writer << Magic;
+	Writer << FileVersion;
+	Writer << SegmentIndex;
+	Writer << StreamOffset;
+	Writer.Serialize((void*)Payload.GetData(), Payload.Num());
+	for (uint32 End : RecordEnds)
+	{
+		Writer << End;
+	}
+	Writer << Crc;
+	Writer << NumRecords;
+	Writer << PayloadSize;
+	Writer << EndMagic;
+
+	//Written beside and moved into place, a segment file is either absent or complete
+	const FString TempPath = SegmentPath + TEXT(".tmp");
+	return FFileHelper::SaveArrayToFile(FileBuffer, *TempPath) && IFileManager::Get().Move(*SegmentPath, *TempPath, true);
+}
+
+bool FSegmentedFileWriter::Close()
+{
+	if (bClosed)
+	{
+		return !ArIsError;
+	}
+	bClosed = true;
+
+	const double StartTime = FPlatformTime::Seconds();
+	Flush();
+	WriteSegment();
+
+	SaveIndex(BasePath, Segments);
+	WriteTime += FPlatformTime::Seconds() - StartTime;
+
+	//Every record is in a segment, unless one of them could not be written
+	delete Journal;
+	Journal = nullptr;
+	if (!ArIsError)
+	{
+		IFileManager::Get().Delete(*JournalPath, false, false, true);
+	}
+
+	UE_LOG(LogRobCogWeb, Log, TEXT("%s: %lld bytes in %d segments, %lld records, %.1f MB/s"),
+		*FPaths::GetCleanFilename(BasePath), SegmentStreamOffset, Segments.Num(), TotalRecords,
+		WriteTime > 0.0 ? SegmentStreamOffset / WriteTime / (1024.0 * 1024.0) : 0.0);
+	return !ArIsError;
+}
+
+/*Index of the segments, only a convenience for the readers: the segments alone hold the whole log.
+It is written once the log is complete (closed, or recovered after a crash), so it also marks the logs which can be processed.*/
+bool FSegmentedFileWriter::SaveIndex(const FString& BasePath, const TArray<FSegmentInfo>& Segments)
+{
+	TArray<uint8> IndexBytes;
+	FMemoryWriter Writer(IndexBytes);
+	uint32 Magic = SegmentMagic;
+	uint16 FileVersion = Version;
+	int32 NumSegments = Segments.Num();
+	Writer << Magic;
+	Writer << FileVersion;
+	Writer << NumSegments;
+	for (FSegmentInfo Info : Segments)
+	{
+		Writer << Info.StreamOffset;
+		Writer << Info.PayloadSize;
+		Writer << Info.NumRecords;
+	}
+	return FFileHelper::SaveArrayToFile(IndexBytes, *(BasePath + TEXT(".index")));
+}
+
+bool FSegmentedFileWriter::ReadSegment(const FString& SegmentPath, TArray<uint8>& OutPayload, TArray<uint32>& OutRecordEnds)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *SegmentPath, FILEREAD_Silent) || Bytes.Num() < HeaderSize + 16)
+	{
+		return false;
+	}
+
+	//Footer first: magic, payload size, number of records, CRC
+	FMemoryReader Reader(Bytes);
+	uint32 EndMagic, Crc;
+	int32 NumRecords, PayloadSize;
+	Reader.Seek(Bytes.Num() - 16);
+	Reader << Crc;
+	Reader << NumRecords;
+	Reader << PayloadSize;
+	Reader << EndMagic;
+	if (EndMagic != FooterMagic || PayloadSize < 0 || NumRecords < 0 ||
+		HeaderSize + PayloadSize + NumRecords * (int64)sizeof(uint32) + 16 != Bytes.Num())
+	{
+		return false;
+	}
+
+	uint32 Magic;
+	uint16 FileVersion;
+	Reader.Seek(0);
+	Reader << Magic;
+	Reader << FileVersion;
+	if (Magic != SegmentMagic || FileVersion != Version || FCrc::MemCrc32(Bytes.GetData() + HeaderSize, PayloadSize) != Crc)
+	{
+		return false;
+	}
+
+	OutPayload.Reset(PayloadSize);
+	OutPayload.Append(Bytes.GetData() + HeaderSize, PayloadSize);
+	OutRecordEnds.SetNumUninitialized(NumRecords);
+	Reader.Seek(HeaderSize + PayloadSize);
+	for (uint32& End : OutRecordEnds)
+	{
+		Reader << End;
+	}
+	return !Reader.IsError();
+}
+
+bool FSegmentedFileWriter::ReadStream(const FString& BasePath, TArray<uint8>& OutStream)
+{
+	OutStream.Reset();
+	TArray<uint8> Payload;
+	TArray<uint32> RecordEnds;
+	int32 SegmentIndex = 0;
+	for (; IFileManager::Get().FileExists(*GetSegmentPath(BasePath, SegmentIndex)); SegmentIndex++)
+	{
+		if (!ReadSegment(GetSegmentPath(BasePath, SegmentIndex), Payload, RecordEnds))
+		{
+			UE_LOG(LogRobCogWeb, Warning, TEXT("Segment %s is corrupted"), *GetSegmentPath(BasePath, SegmentIndex));
+			return false;
+		}
+		OutStream.Append(Payload);
+	}
+	return SegmentIndex > 0;
+}
+
+int32 FSegmentedFileWriter::RecoverJournal(const FString& BasePath)
+{
+	return RecoverJournal(BasePath, GetJournalPath(BasePath));
+}
+
+/*Segments are moved into place whole, so the ones on disk give where the stream ends; the journal may still hold records
+from before that end (the crash came between a segment and the restart of the journal), they are skipped.
+@param const FString& BasePath  -->  Path of the log, without the segment number
+@param const FString& JournalPath  -->  Path of its journal*/
+int32 FSegmentedFileWriter::RecoverJournal(const FString& BasePath, const FString& JournalPath)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *JournalPath, FILEREAD_Silent))
+	{
+		return 0;
+	}
+
+	TArray<FSegmentInfo> Segments;
+	int64 StreamEnd = 0;
+	TArray<uint8> Payload;
+	TArray<uint32> RecordEnds;
+	while (IFileManager::Get().FileExists(*GetSegmentPath(BasePath, Segments.Num())))
+	{
+		if (!ReadSegment(GetSegmentPath(BasePath, Segments.Num()), Payload, RecordEnds))
+		{
+			break;
+		}
+		FSegmentInfo& Info = Segments[Segments.AddUninitialized()];
+		Info.StreamOffset = StreamEnd;
+		Info.PayloadSize = Payload.Num();
+		Info.NumRecords = RecordEnds.Num();
+		StreamEnd += Payload.Num();
+	}
+	const int32 NumSegments = Segments.Num();
+
+	//One pass: every record has to be whole, valid and follow the previous one
+	Payload.Reset();
+	RecordEnds.Reset();
+	int64 ValidEnd = 0;
+	int64 NextOffset = -1;
+	FMemoryReader Reader(Bytes);
+	while (ValidEnd + JournalHeaderSize <= Bytes.Num())
+	{
+		Reader.Seek(ValidEnd);
+		uint32 Magic, Size, Crc;
+		int64 StreamOffset;
+		Reader << Magic;
+		Reader << StreamOffset;
+		Reader << Size;
+		Reader << Crc;
+		const uint8* Data = Bytes.GetData() + ValidEnd + JournalHeaderSize;
+		if (Magic != JournalMagic || Size > Bytes.Num() - ValidEnd - JournalHeaderSize || GetJournalCrc(StreamOffset, Size, Data) != Crc ||
+			(NextOffset >= 0 && StreamOffset != NextOffset))
+		{
+			break;
+		}
+		NextOffset = StreamOffset + Size;
+		ValidEnd += JournalHeaderSize + Size;
+
+		//A gap after the segments cannot be bridged, what follows would not decode
+		const int64 RecoveredEnd = StreamEnd + Payload.Num();
+		if (NextOffset <= RecoveredEnd)
+		{
+			continue;
+		}
+		if (StreamOffset > RecoveredEnd)
+		{
+			UE_LOG(LogRobCogWeb, Warning, TEXT("Journal %s misses the data from offset %lld, it is not recovered"), *JournalPath, RecoveredEnd);
+			break;
+		}
+		Payload.Append(Data + (RecoveredEnd - StreamOffset), NextOffset - RecoveredEnd);
+		RecordEnds.Add(Payload.Num());
+	}
+
+	//The torn tail goes first, so that a crash during the recovery leaves a clean journal behind
+	if (ValidEnd < Bytes.Num())
+	{
+		UE_LOG(LogRobCogWeb, Warning, TEXT("Journal %s: %lld torn bytes truncated"), *JournalPath, Bytes.Num() - ValidEnd);
+		Bytes.SetNum((int32)ValidEnd, false);
+		const FString TempPath = JournalPath + TEXT(".tmp");
+		if (!FFileHelper::SaveArrayToFile(Bytes, *TempPath) || !IFileManager::Get().Move(*JournalPath, *TempPath, true))
+		{
+			return -1;
+		}
+	}
+
+	if (Payload.Num())
+	{
+		TArray<uint8> FileBuffer;
+		if (!SaveSegment(GetSegmentPath(BasePath, NumSegments), NumSegments, StreamEnd, Payload, RecordEnds, FileBuffer))
+		{
+			UE_LOG(LogRobCogWeb, Warning, TEXT("Could not write the recovered segment of %s"), *BasePath);
+			return -1;
+		}
+		FSegmentInfo& Info = Segments[Segments.AddUninitialized()];
+		Info.StreamOffset = StreamEnd;
+		Info.PayloadSize = Payload.Num();
+		Info.NumRecords = RecordEnds.Num();
+	}
+
+	//The log is complete again, the index lists its segments as if it had been closed
+	if (!SaveIndex(BasePath, Segments))
+	{
+		return -1;
+	}
+	IFileManager::Get().Delete(*JournalPath, false, false, true);
+
+	UE_LOG(LogRobCogWeb, Log, TEXT("%s: %d records (%d bytes) recovered from the journal"), *FPaths::GetCleanFilename(BasePath), RecordEnds.Num(), Payload.Num());
+	return RecordEnds.Num();
+}
@@ -0,0 +1,143 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/*Archive writing a log as a series of fixed-size segment files (<path>.0000, <path>.0001, ...).
+The current segment is a buffer allocated once up front; serializing only copies into it, and the
+segment reaches the disk in a single write when it is full or old enough. Flush() marks a record
+boundary; segments roll over on record boundaries only, a record larger than a segment grows it.
+Every segment ends with a footer (record end offsets, CRC of the payload) and is moved into place
+only once complete, so after a crash every segment on disk is whole and verifiable.
+Close() writes the last segment and an index of all segments (<path>.index), which marks the log as complete.
+The records of the current segment are also appended to a journal (<path>.journal), each with its stream offset and a CRC;
+the journal is pushed to the disk every JournalSyncInterval and started over once every record before it is in a segment,
+so a crash only loses the last interval. A segment which could not be written keeps its records in the buffer (and the
+journal) and is written again with the next records, at most every RetryInterval. RecoverJournal() turns what a crash left in the journal into the last segment of the log.
+*/
+class FSegmentedFileWriter : public FArchive
+{
+public:
+	//Allocates the segment buffer and opens the journal, a negative sync interval disables the journal
+	FSegmentedFileWriter(const FString& InBasePath, int32 InSegmentSize = 1024 * 1024, float InMaxSegmentAge = 10.f, float InJournalSyncInterval = 0.5f);
+
+	virtual ~FSegmentedFileWriter();
+
+	//FArchive interface
+	virtual void Serialize(void* Data, int64 Num) override;
+	virtual void Flush() override;
+	virtual bool Close() override;
+	virtual int64 Tell() override;
+	virtual int64 TotalSize() override;
+	virtual FString GetArchiveName() const override;
+
+	//Path of a segment file
+	static FString GetSegmentPath(const FString& BasePath, int32 SegmentIndex);
+
+	//Reads a segment file back and checks its footer, returns false if it is torn or corrupted
+	static bool ReadSegment(const FString& SegmentPath, TArray<uint8>& OutPayload, TArray<uint32>& OutRecordEnds);
+
+	//Reads every segment of a log back into one stream, returns false if there is none or one of them is corrupted
+	static bool ReadStream(const FString& BasePath, TArray<uint8>& OutStream);
+
+	//Path of the journal of a log
+	static FString GetJournalPath(const FString& BasePath);
+
+	/*Writes the records of the journal of a log which are not in its segments as a new last segment, writes the index of the
+	segments and deletes the journal.
+	The journal is read once from the start: the first torn or corrupted record ends it and is truncated away.
+	Returns the number of records recovered, -1 if they could not be written (the journal is kept).*/
+	static int32 RecoverJournal(const FString& BasePath);
+
+	//Same, from a journal moved away from its path (eg: claimed by renaming it, see FEpisodeReader::RecoverCrashedEpisodes)
+	static int32 RecoverJournal(const FString& BasePath, const FString& JournalPath);
+
+	//Pushes the journaled records to the disk now instead of at the next interval
+	void SyncJournal();
+
+	//Identifies the segment files
+	static const uint32 SegmentMagic = 0x47534352; // 'RCSG'
+	static const uint32 FooterMagic = 0x46534352; // 'RCSF'
+	static const uint32 JournalMagic = 0x4A534352; // 'RCSJ'
+	static const uint16 Version = 1;
+
+	//Bytes of the segment header (magic, version, segment index, stream offset)
+	static const int32 HeaderSize = 4 + 2 + 4 + 8;
+
+	//Bytes of the header of a journal record (magic, stream offset, size, CRC)
+	static const int32 JournalHeaderSize = 4 + 8 + 4 + 4;
+
+	//Seconds between two attempts to write a segment which failed
+	static const float RetryInterval;
+
+	//Number of segments written so far
+	int32 GetNumSegments() const { return Segments.Num(); }
+
+	//Called on the writing thread with the path of each segment once it is in place (eg: to upload it while the log grows)
+	TFunction<void(const FString&)> OnSegmentWritten;
+
+private:
+	//Writes the current segment to disk and starts a new one
+	void WriteSegment();
+
+	//Writes a complete segment file beside its path and moves it into place
+	static bool SaveSegment(const FString& SegmentPath, int32 SegmentIndex, int64 StreamOffset, const TArray<uint8>& Payload, const TArray<uint32>& RecordEnds, TArray<uint8>& FileBuffer);
+
+	//CRC of a journal record, covering its offset and size so that a torn header is caught as well
+	static uint32 GetJournalCrc(int64 StreamOffset, uint32 Size, const uint8* Data);
+
+	//Appends the records of the current segment not journaled yet
+	void AppendJournal();
+
+	//Summary of a written segment, kept for the index
+	struct FSegmentInfo
+	{
+		int64 StreamOffset;
+		int32 PayloadSize;
+		int32 NumRecords;
+	};
+
+	//Writes <path>.index, listing the segments of a complete log
+	static bool SaveIndex(const FString& BasePath, const TArray<FSegmentInfo>& Segments);
+
+	FString BasePath;
+
+	//Payload capacity of a segment, and seconds after which a segment with records is written anyway
+	const int32 SegmentSize;
+	const float MaxSegmentAge;
+
+	//Payload of the current segment, allocated once
+	TArray<uint8> Buffer;
+
+	//End of each record in the current segment, and the end of the last complete record
+	TArray<uint32> RecordEnds;
+
+	//Offset in the whole stream of the start of the current segment
+	int64 SegmentStreamOffset;
+
+	double SegmentStartTime;
+
+	//Serialization buffer of the segment file, allocated once
+	TArray<uint8> FileBuffer;
+
+	TArray<FSegmentInfo> Segments;
+
+	//Time spent and bytes written, for the throughput report
+	double WriteTime;
+	int64 TotalRecords;
+
+	//Null if the journal is disabled or could not be opened
+	FArchive* Journal;
+	FString JournalPath;
+	const float JournalSyncInterval;
+	double LastJournalSync;
+
+	//End of the records of the current segment already journaled, and whether some are not pushed to the disk yet
+	int32 JournalEnd;
+	bool bJournalDirty;
+
+	//Attempts failed since the last segment written, and when the next one is made
+	double NextRetryTime;
+	int32 NumFailedWrites;
+
+	bool bClosed;
+};
@@ -0,0 +1,164 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "SemanticEventLogger.h"
+#include "SegmentedFileWriter.h"
+#include "LogEncoding.h"
+#include "EventLogIndex.h"
+
+FSemanticEventLogger::FSemanticEventLogger(const FString& InFilePath, const FString& LevelName, int32 LayoutSeed, const TArray<IEpisodeEventSink*>& InSinks, const TFunction<void(const FString&)>& OnSegmentWritten)
+	: DroppedEvents(0)
+	, IndexPath(FPaths::ChangeExtension(InFilePath, TEXT("idx")))
+	, Sinks(InSinks)
+	, PreviousTimestamp(0.0)
+	, WrittenEvents(0)
+	, WriteTime(0.0)
+{
+	//Nothing reaches the disk before the first segment is complete, failures are reported when it is written
+	FSegmentedFileWriter* SegmentWriter = new FSegmentedFileWriter(InFilePath);
+	SegmentWriter->OnSegmentWritten = OnSegmentWritten;
+	File = SegmentWriter;
+	uint32 FileMagic = Magic;
+	uint16 FileVersion = Version;
+	FString FileLevelName = LevelName;
+	*File << FileMagic;
+	*File << FileVersion;
+	*File << FileLevelName;
+	*File << LayoutSeed;
+	//The header is a record of its own, the first segment starts with it
+	File->Flush();
+	Index = new FEventLogIndex();
+
+	WriteBuffer.Reserve(64 * 1024);
+	DrainBatch.Reserve(256);
+
+	Thread = FRunnableThread::Create(this, TEXT("SemanticEventLogger"), 0, TPri_BelowNormal);
+}
+
+FSemanticEventLogger::~FSemanticEventLogger()
+{
+	if (Thread)
+	{
+		Stop();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	if (File)
+	{
+		File->Close();
+		delete File;
+		File = nullptr;
+	}
+
+	if (!Index->Save(IndexPath))
+	{
+		UE_LOG(LogRobCogWeb, Warning, TEXT("Could not write the event index %s"), *IndexPath);
+	}
+	delete Index;
+	Index = nullptr;
+
+	for (IEpisodeEventSink* Sink : Sinks)
+	{
+		Sink->Close();
+		delete Sink;
+	}
+	Sinks.Empty();
+
+	UE_LOG(LogRobCogWeb, Log, TEXT("Semantic events: %llu written at %.0f events/s"), WrittenEvents, WriteTime > 0.0 ? WrittenEvents / WriteTime : 0.0);
+	Stats.Report(TEXT("Semantic events"));
+
+	if (DroppedEvents)
+	{
+		UE_LOG(LogRobCogWeb, Warning, TEXT("%u semantic events were dropped, the event buffer was full"), DroppedEvents);
+	}
+}
+
+uint32 FSemanticEventLogger::Run()
+{
+	while (!bStopping)
+	{
+		//The game thread never signals the writer, it simply polls at a low rate
+		if (!Drain())
+		{
+			//Idle, the last events still reach the journal on time
+			if (File)
+			{
+				File->Flush();
+			}
+			FPlatformProcess::Sleep(0.01f);
+		}
+	}
+	Drain();
+	return 0;
+}
+
+void FSemanticEventLogger::Stop()
+{
+	bStopping = true;
+}
+
+/*Layout of an event record: tag, time since the previous event in ms, kind and hand packed in one byte, actor and surface ids,
+then for events on an actor its position as a delta to the previous position of the same actor and its compressed rotation.
+All integers are zig-zag varints, actors are referenced by their stable id.
+Every record is added to the index with its offset in the stream and the state needed to decode it on its own.*/
+bool FSemanticEventLogger::Drain()
+{
+	FSemanticEvent Event;
+	while (DrainBatch.Num() < DrainBatch.Max() && Events.Pop(Event))
+	{
+		DrainBatch.Add(Event);
+	}
+	if (!DrainBatch.Num())
+	{
+		return false;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	WriteBuffer.Reset();
+	FMemoryWriter Writer(WriteBuffer);
+	const int64 BatchOffset = File ? File->Tell() : 0;
+	for (const FSemanticEvent& BatchEvent : DrainBatch)
+	{
+		uint8 Tag = EventTag;
+		uint8 KindAndHand = (uint8)BatchEvent.Kind | ((uint8)BatchEvent.Hand << 4);
+		const int64 RecordOffset = BatchOffset + Writer.Tell();
+
+		Writer << Tag;
+		LogEncoding::WriteTimeDelta(Writer, BatchEvent.Timestamp, PreviousTimestamp);
+		Writer << KindAndHand;
+		LogEncoding::WriteVarint(Writer, BatchEvent.ActorId);
+		LogEncoding::WriteVarint(Writer, BatchEvent.SurfaceId);
+		FIntVector PreviousLocation = FIntVector::ZeroValue;
+		if (BatchEvent.ActorId)
+		{
+			FIntVector& LastLocation = LastLocations.FindOrAdd(BatchEvent.ActorId);
+			PreviousLocation = LastLocation;
+			LogEncoding::WriteLocationDelta(Writer, LogEncoding::QuantizeLocation(BatchEvent.Location), LastLocation);
+			LogEncoding::WriteQuat(Writer, BatchEvent.Rotation);
+		}
+		Index->Add(RecordOffset, (int64)FMath::RoundToDouble(PreviousTimestamp * 1000.0), BatchEvent, PreviousLocation);
+	}
+	WrittenEvents += DrainBatch.Num();
+	Stats.RawBytes += DrainBatch.Num() * RawEventSize;
+	Stats.EncodedBytes += WriteBuffer.Num();
+	Stats.EncodeTime += FPlatformTime::Seconds() - StartTime;
+
+	if (File)
+	{
+		File->Serialize(WriteBuffer.GetData(), WriteBuffer.Num());
+		File->Flush();
+	}
+	WriteTime += FPlatformTime::Seconds() - StartTime;
+
+	for (const FSemanticEvent& BatchEvent : DrainBatch)
+	{
+		for (IEpisodeEventSink* Sink : Sinks)
+		{
+			Sink->Consume(BatchEvent);
+		}
+	}
+	DrainBatch.Reset();
+	return true;
+}
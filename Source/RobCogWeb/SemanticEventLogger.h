@@ -0,0 +1,148 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "SpscRingBuffer.h"
+#include "LogEncoding.h"
+
+//High-level actions recorded in an episode
+enum class ESemanticEventKind : uint8
+{
+	Pick,
+	Drop,
+	Open,
+	Close,
+	Finish,
+	Resume,
+	Exit
+};
+
+//Hand which performed an action
+enum class EEventHand : uint8
+{
+	None,
+	Right,
+	Left,
+	Both
+};
+
+/*Fixed-size record of one event, copied as is into the ring buffer.
+Actors are referenced by their stable id (see FActorIdRegistry), 0 stands for no actor.
+*/
+struct FSemanticEvent
+{
+	//World time of the event, in seconds since the level started
+	double Timestamp;
+
+	//Actor acted on, and the surface it was placed on (drops) or taken off (picks), 0 if none was found
+	uint32 ActorId;
+	uint32 SurfaceId;
+
+	//Pose of the actor right after the action
+	FVector Location;
+	FQuat Rotation;
+
+	ESemanticEventKind Kind;
+	EEventHand Hand;
+};
+
+class FEventLogIndex;
+
+//Consumer of the event stream (eg: exporters), called on the writer thread in event order
+class IEpisodeEventSink
+{
+public:
+	virtual ~IEpisodeEventSink() {}
+
+	virtual void Consume(const FSemanticEvent& Event) = 0;
+
+	//Called once after the last event
+	virtual void Close() = 0;
+};
+
+/*Records the semantic events of an episode with a fixed cost on the game thread:
+Log() fills a record and pushes it into a single-producer lock-free ring buffer, without allocating or locking.
+A background thread drains the buffer and appends the events to the episode file.
+Only the game thread may call Log().
+*/
+class FSemanticEventLogger : public FRunnable
+{
+public:
+	//Opens the episode file and starts the writer thread, the logger takes ownership of the sinks.
+	//The index of the records is written next to the file (Events.bin -> Events.idx) when the logger closes.
+	//OnSegmentWritten is called on the writer thread with each segment of the file once it is in place.
+	FSemanticEventLogger(const FString& InFilePath, const FString& LevelName, int32 LayoutSeed, const TArray<IEpisodeEventSink*>& InSinks = TArray<IEpisodeEventSink*>(), const TFunction<void(const FString&)>& OnSegmentWritten = nullptr);
+
+	//Writes the remaining events and closes the file
+	virtual ~FSemanticEventLogger();
+
+	//Records an event, called from the interaction points of the character and the game mode
+	FORCEINLINE void Log(ESemanticEventKind Kind, EEventHand Hand, const AActor* Actor, uint32 ActorId, uint32 SurfaceId, double Timestamp)
+	{
+		FSemanticEvent Event;
+		Event.Timestamp = Timestamp;
+		Event.Kind = Kind;
+		Event.Hand = Hand;
+		Event.ActorId = ActorId;
+		Event.SurfaceId = SurfaceId;
+		Event.Location = Actor ? Actor->GetActorLocation() : FVector::ZeroVector;
+		Event.Rotation = Actor ? Actor->GetActorQuat() : FQuat::Identity;
+
+		if (!Events.Push(Event))
+		{
+			DroppedEvents++;
+		}
+	}
+
+	//FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+	//Identifies the file format, bumped whenever the layout changes. 3 references the actors by id, 2 defined their names in
+	//the log; the logs of the few builds which took the names from the episode name table also say 2 and cannot be read
+	static const uint32 Magic = 0x45574352; // 'RCWE'
+	static const uint16 Version = 3;
+
+	//Record tag of the events
+	static const uint8 EventTag = 'E';
+
+	//Bytes of an event with the fixed-size layout of the first version, to measure the compression
+	static const int32 RawEventSize = 1 + 8 + 1 + 1 + 4 + 4 + 12 + 16;
+
+private:
+	//Moves the buffered events to the file, returns false if there was nothing to write
+	bool Drain();
+
+	TSpscRingBuffer<FSemanticEvent, 4096> Events;
+
+	//Events lost because the writer thread could not keep up, only touched by the game thread
+	uint32 DroppedEvents;
+
+
+	//Episode file, only used by the writer thread
+	FArchive* File;
+
+	//Index of the written records, filled by the writer thread and saved at close
+	FEventLogIndex* Index;
+	FString IndexPath;
+
+	//Exporters fed with every event after it is written
+	TArray<IEpisodeEventSink*> Sinks;
+
+	//Events popped from the buffer by a drain, and the serialization buffer they are encoded to
+	TArray<FSemanticEvent> DrainBatch;
+	TArray<uint8> WriteBuffer;
+
+	//Delta encoding state: timestamp of the last event and quantized location of the last event on each actor
+	double PreviousTimestamp;
+	TMap<uint32, FIntVector> LastLocations;
+
+	//Events written and time spent writing them, for the throughput report
+	uint64 WrittenEvents;
+	double WriteTime;
+	FLogEncodingStats Stats;
+
+	FThreadSafeBool bStopping;
+
+	FRunnableThread* Thread;
+};
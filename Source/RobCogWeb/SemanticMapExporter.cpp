@@ -0,0 +1,342 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "SemanticMapExporter.h"
+
+const float FSemanticMapExporter::SupportTolerance = 2.f;
+
+namespace
+{
+	const TCHAR* KnowRobNs = TEXT("http://knowrob.org/kb/knowrob.owl#");
+	const TCHAR* MapNs = TEXT("http://knowrob.org/kb/u_map.owl#");
+
+	//KnowRob class of each item type
+	const TCHAR* GetItemClass(EItemType ItemType)
+	{
+		switch (ItemType)
+		{
+		case EItemType::Cup: return TEXT("Cup");
+		case EItemType::Plate: return TEXT("DinnerPlate");
+		case EItemType::Mug: return TEXT("DrinkingMug");
+		case EItemType::Pan: return TEXT("FryingPan");
+		case EItemType::Spatula: return TEXT("Spatula");
+		case EItemType::Spoon: return TEXT("Spoon");
+		default: return TEXT("HumanScaleObject");
+		}
+	}
+
+	const TCHAR* GetObjectClass(const FSemanticMapObject& Object)
+	{
+		switch (Object.Kind)
+		{
+		case ESemanticMapObjectKind::Articulated:
+			return Object.bDoor ? TEXT("Door") : TEXT("Drawer");
+		case ESemanticMapObjectKind::Furniture:
+			return TEXT("Cupboard");
+		case ESemanticMapObjectKind::Surface:
+			return TEXT("CounterTop");
+		default:
+			return GetItemClass(Object.ItemType);
+		}
+	}
+}
+
+FArchive& operator<<(FArchive& Ar, FSemanticMapObject& Object)
+{
+	FString Name = Object.Name.ToString();
+	Ar << Name;
+	if (Ar.IsLoading())
+	{
+		Object.Name = FName(*Name);
+	}
+	Ar << Object.ActorId;
+	Ar << Object.Kind;
+	Ar << Object.bDoor;
+	Ar << Object.ItemType;
+	Ar << Object.State;
+	Ar << Object.Location;
+	Ar << Object.Rotation;
+	Ar << Object.Bounds;
+	return Ar;
+}
+
+FSemanticMapCapture::FSemanticMapCapture()
+	: Timestamp(0.0)
+	, CaptureTime(0.0)
+{
+}
+
+bool FSemanticMapCapture::Serialize(FArchive& Ar)
+{
+	uint32 FileMagic = Magic;
+	uint16 FileVersion = Version;
+	Ar << FileMagic;
+	Ar << FileVersion;
+	if (FileMagic != Magic || FileVersion != Version)
+	{
+		return false;
+	}
+
+	Ar << Timestamp;
+	Ar << Objects;
+	return !Ar.IsError();
+}
+
+bool FSemanticMapCapture::SaveToFile(const FString& FilePath)
+{
+	TArray<uint8> Bytes;
+	FMemoryWriter Writer(Bytes);
+	return Serialize(Writer) && FFileHelper::SaveArrayToFile(Bytes, *FilePath);
+}
+
+bool FSemanticMapCapture::LoadFromFile(const FString& FilePath, FSemanticMapCapture& OutCapture)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *FilePath, FILEREAD_Silent))
+	{
+		return false;
+	}
+	FMemoryReader Reader(Bytes);
+	return OutCapture.Serialize(Reader);
+}
+
+/*The tagged surfaces are known from the start, even with nothing on them yet; the trace adds the untagged ones the items rest on*/
+void FSemanticMapCapture::Capture(const AMyCharacter& Character)
+{
+	TSet<AActor*> Surfaces = Character.Surfaces;
+	for (const auto& Item : Character.ItemMap)
+	{
+		if (Item.Key->bHidden)
+		{
+			continue;
+		}
+		AActor* Support = Character.FindSupport(Item.Key);
+		if (Support && !Character.ItemMap.Contains(Support) && !Character.AssetStateMap.Contains(Support))
+		{
+			Surfaces.Add(Support);
+		}
+	}
+	Capture(Character.AssetStateMap, Character.ItemMap, Surfaces, Character.ActorIds);
+}
+
+void FSemanticMapCapture::Capture(const TMap<AActor*, EAssetState>& AssetStateMap, const TMap<AActor*, EItemType>& ItemMap, const TSet<AActor*>& Surfaces, const FActorIdRegistry& ActorIds)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	Objects.Reset(AssetStateMap.Num() * 2 + ItemMap.Num() + Surfaces.Num());
+
+	auto AddObject = [this, &ActorIds](const AActor* Actor, ESemanticMapObjectKind Kind, EItemType ItemType, EAssetState State)
+	{
+		FSemanticMapObject& Object = Objects[Objects.AddUninitialized()];
+		Object.Name = Actor->GetFName();
+		Object.ActorId = ActorIds.GetId(Actor);
+		Object.Kind = Kind;
+		Object.bDoor = Kind == ESemanticMapObjectKind::Articulated && Actor->ActorHasTag(FName(TEXT("Door")));
+		Object.ItemType = ItemType;
+		Object.State = State;
+		Object.Location = Actor->GetActorLocation();
+		Object.Rotation = Actor->GetActorQuat();
+		Object.Bounds = Actor->GetComponentsBoundingBox();
+	};
+
+	TSet<const AActor*> Furniture;
+	for (const auto& Asset : AssetStateMap)
+	{
+		if (!Asset.Key)
+		{
+			continue;
+		}
+		AddObject(Asset.Key, ESemanticMapObjectKind::Articulated, EItemType::GeneralItem, Asset.Value);
+
+		//The drawers are attached to the furniture they slide in, which is where the items are put on
+		const AActor* Parent = Asset.Key->GetAttachParentActor();
+		if (Parent && !AssetStateMap.Contains(const_cast<AActor*>(Parent)) && !Furniture.Contains(Parent))
+		{
+			Furniture.Add(Parent);
+			AddObject(Parent, ESemanticMapObjectKind::Furniture, EItemType::GeneralItem, EAssetState::Unkown);
+		}
+	}
+	for (const auto& Item : ItemMap)
+	{
+		//Pooled items waiting for a layout are not part of the kitchen
+		if (!Item.Key->bHidden)
+		{
+			AddObject(Item.Key, ESemanticMapObjectKind::Item, Item.Value, EAssetState::Unkown);
+		}
+	}
+	for (const AActor* Surface : Surfaces)
+	{
+		//A counter holding drawers is already there as their furniture
+		if (Surface && !Furniture.Contains(Surface))
+		{
+			AddObject(Surface, ESemanticMapObjectKind::Surface, EItemType::GeneralItem, EAssetState::Unkown);
+		}
+	}
+
+	CaptureTime = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+}
+
+bool FSemanticMapCapture::IsSurface(const AActor* Actor)
+{
+	return Actor->ActorHasTag(FName(TEXT("Table"))) || Actor->ActorHasTag(FName(TEXT("Counter"))) || Actor->ActorHasTag(FName(TEXT("Sink")));
+}
+
+FSpatialRelationSearch::FSpatialRelationSearch(const FSemanticMapObject& InItem)
+	: Support(nullptr)
+	, Container(nullptr)
+	, Item(InItem)
+	, Center(InItem.Bounds.GetCenter())
+{
+}
+
+void FSpatialRelationSearch::Consider(const FSemanticMapObject& Other)
+{
+	if (&Other == &Item || (Other.ActorId && Other.ActorId == Item.ActorId))
+	{
+		return;
+	}
+
+	const bool bCoversCenter = Center.X >= Other.Bounds.Min.X && Center.X <= Other.Bounds.Max.X &&
+		Center.Y >= Other.Bounds.Min.Y && Center.Y <= Other.Bounds.Max.Y;
+	if (!bCoversCenter)
+	{
+		return;
+	}
+
+	//Highest surface below the item wins, so stacked items rest on each other rather than on the table
+	if (FMath::Abs(Item.Bounds.Min.Z - Other.Bounds.Max.Z) <= FSemanticMapExporter::SupportTolerance &&
+		(!Support || Other.Bounds.Max.Z > Support->Bounds.Max.Z))
+	{
+		Support = &Other;
+	}
+
+	//Smallest container holding the item, a drawer rather than the cupboard around it, the sink rather than the counter
+	if (Other.Kind != ESemanticMapObjectKind::Item && Other.Bounds.IsInside(Center) &&
+		(!Container || Other.Bounds.GetVolume() < Container->Bounds.GetVolume()))
+	{
+		Container = &Other;
+	}
+}
+
+FSemanticMapExporter::FSemanticMapExporter(const FString& InFilePath, const FString& InMapName, const FSemanticMapCapture& InCapture)
+	: FilePath(InFilePath)
+	, MapName(InMapName)
+	, Capture(InCapture)
+{
+	Thread = FRunnableThread::Create(this, TEXT("SemanticMapExporter"), 0, TPri_BelowNormal);
+}
+
+FSemanticMapExporter::~FSemanticMapExporter()
+{
+	if (Thread)
+	{
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+}
+
+uint32 FSemanticMapExporter::Run()
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	std::string Buffer;
+	Export(Capture, MapName, Buffer);
+
+	TUniquePtr<FArchive> File(IFileManager::Get().CreateFileWriter(*FilePath));
+	if (!File)
+	{
+		UE_LOG(LogRobCogWeb, Warning, TEXT("Could not create semantic map %s"), *FilePath);
+		return 1;
+	}
+	File->Serialize((void*)Buffer.data(), Buffer.size());
+	File->Close();
+
+	if (!Capture.SaveToFile(FPaths::ChangeExtension(FilePath, TEXT("bin"))))
+	{
+		UE_LOG(LogRobCogWeb, Warning, TEXT("Could not save the capture of semantic map %s"), *MapName);
+	}
+
+	UE_LOG(LogRobCogWeb, Log, TEXT("Semantic map %s: %d objects, %u bytes, captured in %.3f ms, exported in %.2f ms"),
+		*MapName, Capture.Objects.Num(), (uint32)Buffer.size(), Capture.CaptureTime, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+	return 0;
+}
+
+/*The relations of each item are found by FSpatialRelationSearch.
+@param const FSemanticMapCapture& Capture  -->  Objects to export
+@param const FString& MapName  -->  Name of the semantic map individual
+@param std::string& OutBuffer  -->  Receives the UTF-8 document*/
+void FSemanticMapExporter::Export(const FSemanticMapCapture& Capture, const FString& MapName, std::string& OutBuffer)
+{
+	using namespace RapidXmlHelpers;
+
+	FXmlDocument Doc;
+	FXmlNode* Declaration = Doc.allocate_node(rapidxml::node_declaration);
+	Declaration->append_attribute(Doc.allocate_attribute("version", "1.0"));
+	Declaration->append_attribute(Doc.allocate_attribute("encoding", "utf-8"));
+	Doc.append_node(Declaration);
+
+	FXmlNode* Root = AddElement(Doc, &Doc, "rdf:RDF");
+	AddAttribute(Doc, Root, "xmlns:rdf", TEXT("http://www.w3.org/1999/02/22-rdf-syntax-ns#"));
+	AddAttribute(Doc, Root, "xmlns:rdfs", TEXT("http://www.w3.org/2000/01/rdf-schema#"));
+	AddAttribute(Doc, Root, "xmlns:owl", TEXT("http://www.w3.org/2002/07/owl#"));
+	AddAttribute(Doc, Root, "xmlns:knowrob", KnowRobNs);
+	AddAttribute(Doc, Root, "xmlns:u-map", MapNs);
+
+	auto AddResource = [&Doc](FXmlNode* Parent, const char* Property, const FString& Iri)
+	{
+		FXmlNode* Node = AddElement(Doc, Parent, Property);
+		AddAttribute(Doc, Node, "rdf:resource", Iri);
+	};
+
+	const FString MapIri = MapNs + MapName;
+	FXmlNode* Map = AddElement(Doc, Root, "owl:NamedIndividual");
+	AddAttribute(Doc, Map, "rdf:about", MapIri);
+	AddResource(Map, "rdf:type", FString(KnowRobNs) + TEXT("SemanticEnvironmentMap"));
+
+	const TArray<FSemanticMapObject>& Objects = Capture.Objects;
+	for (const FSemanticMapObject& Object : Objects)
+	{
+		const FString ObjectIri = MapNs + Object.Name.ToString();
+		FXmlNode* Individual = AddElement(Doc, Root, "owl:NamedIndividual");
+		AddAttribute(Doc, Individual, "rdf:about", ObjectIri);
+		AddResource(Individual, "rdf:type", FString(KnowRobNs) + GetObjectClass(Object));
+		AddResource(Individual, "knowrob:describedInMap", MapIri);
+
+		//Poses in meters, as expected by KnowRob
+		const FVector Translation = Object.Location / 100.f;
+		FXmlNode* Pose = AddElement(Doc, Individual, "knowrob:translation", FString::Printf(TEXT("%f %f %f"), Translation.X, Translation.Y, Translation.Z));
+		AddAttribute(Doc, Pose, "rdf:datatype", TEXT("http://www.w3.org/2001/XMLSchema#string"));
+		FXmlNode* Rotation = AddElement(Doc, Individual, "knowrob:quaternion", FString::Printf(TEXT("%f %f %f %f"), Object.Rotation.W, Object.Rotation.X, Object.Rotation.Y, Object.Rotation.Z));
+		AddAttribute(Doc, Rotation, "rdf:datatype", TEXT("http://www.w3.org/2001/XMLSchema#string"));
+
+		if (Object.Kind == ESemanticMapObjectKind::Articulated)
+		{
+			AddResource(Individual, "knowrob:stateOfObject", FString(KnowRobNs) + (Object.State == EAssetState::Open ? TEXT("ObjectStateOpen") : TEXT("ObjectStateClosed")));
+		}
+
+		if (Object.Kind != ESemanticMapObjectKind::Item)
+		{
+			continue;
+		}
+
+		//Only a few dozen objects, the quadratic search is cheaper than building an index
+		FSpatialRelationSearch Search(Object);
+		for (const FSemanticMapObject& Other : Objects)
+		{
+			Search.Consider(Other);
+		}
+
+		if (Search.Support)
+		{
+			AddResource(Individual, "knowrob:on-Physical", MapNs + Search.Support->Name.ToString());
+		}
+		if (Search.Container)
+		{
+			AddResource(Individual, "knowrob:in-ContGeneric", MapNs + Search.Container->Name.ToString());
+		}
+	}
+
+	OutBuffer.clear();
+	rapidxml::print(std::back_inserter(OutBuffer), Doc);
+}
@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "MyCharacter.h"
+#include "RapidXmlHelpers.h"
+
+//Kind of object found in the semantic map
+enum class ESemanticMapObjectKind : uint8
+{
+	//Drawers and doors, with an open/closed state
+	Articulated,
+	//Cabinets and islands holding the drawers and doors
+	Furniture,
+	//Items from the ItemMap
+	Item,
+	//Tables, counters and the sink the items rest on
+	Surface
+};
+
+//Copy of what the exporter needs to know about one actor, taken on the game thread
+struct FSemanticMapObject
+{
+	FName Name;
+	uint32 ActorId;
+	ESemanticMapObjectKind Kind;
+
+	//Articulated objects tagged 'Door' (see AMyCharacter::BeginPlay()), the others are drawers
+	bool bDoor;
+	EItemType ItemType;
+	EAssetState State;
+	FVector Location;
+	FQuat Rotation;
+	FBox Bounds;
+
+	friend FArchive& operator<<(FArchive& Ar, FSemanticMapObject& Object);
+};
+
+/*State of the kitchen at one moment, only plain data so that it can be handed to another thread.
+The exporter writes it next to the OWL file, so that the tools reading an episode get the start state without parsing the OWL.
+*/
+struct FSemanticMapCapture
+{
+	//Identifies the file format, bumped whenever the layout changes
+	static const uint32 Magic = 0x4D574352; // 'RCWM'
+	static const uint16 Version = 1;
+
+	TArray<FSemanticMapObject> Objects;
+
+	//World time of the capture, in seconds
+	double Timestamp;
+
+	//Time spent capturing it on the game thread, in milliseconds
+	double CaptureTime;
+
+	FSemanticMapCapture();
+
+	//Copies the poses and states of the drawers, doors, items and surfaces known by the character, with the actors right below the items
+	void Capture(const AMyCharacter& Character);
+
+	//Same from the maps of the character, eg: filled by a commandlet from a loaded map
+	void Capture(const TMap<AActor*, EAssetState>& AssetStateMap, const TMap<AActor*, EItemType>& ItemMap, const TSet<AActor*>& Surfaces, const FActorIdRegistry& ActorIds);
+
+	//True for the static actors the items are put on, tagged 'Table', 'Counter' or 'Sink' in the level
+	static bool IsSurface(const AActor* Actor);
+
+	//Serialize to or from a byte buffer, returns false if the data is not a valid capture
+	bool Serialize(FArchive& Ar);
+
+	//Helpers for reading and writing capture files
+	bool SaveToFile(const FString& FilePath);
+	static bool LoadFromFile(const FString& FilePath, FSemanticMapCapture& OutCapture);
+};
+
+/*Support and container of an item, found among the objects fed to Consider() with the rules of the exported relations:
+the item rests on the object whose top is right below its bottom and which covers its center, and is contained in the
+drawer, cupboard or sink whose bounds hold its center.
+*/
+struct FSpatialRelationSearch
+{
+	const FSemanticMapObject* Support;
+	const FSemanticMapObject* Container;
+
+	explicit FSpatialRelationSearch(const FSemanticMapObject& InItem);
+
+	void Consider(const FSemanticMapObject& Other);
+
+private:
+	const FSemanticMapObject& Item;
+	FVector Center;
+};
+
+/*Writes the kitchen as a KnowRob semantic map (OWL): every drawer and door with its state,
+every item with its type and pose, the surfaces they rest on, and the support (on-Physical) and containment (in-ContGeneric) relations between them.
+The relations are computed from the captured bounds on a background thread, the game thread only pays for the capture.
+The capture itself is saved next to the OWL file, with the .bin extension.
+*/
+class FSemanticMapExporter : public FRunnable
+{
+public:
+	//Starts exporting the capture to the file on a background thread
+	FSemanticMapExporter(const FString& InFilePath, const FString& InMapName, const FSemanticMapCapture& InCapture);
+
+	//Waits for the export to be written
+	virtual ~FSemanticMapExporter();
+
+	//FRunnable interface
+	virtual uint32 Run() override;
+
+	//Builds the OWL document of the capture into the buffer, can be called from any thread
+	static void Export(const FSemanticMapCapture& Capture, const FString& MapName, std::string& OutBuffer);
+
+	//Distance in cm under which an item is considered resting on a surface
+	static const float SupportTolerance;
+
+private:
+	FString FilePath;
+	FString MapName;
+	FSemanticMapCapture Capture;
+
+	FRunnableThread* Thread;
+};
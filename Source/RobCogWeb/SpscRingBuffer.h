@@ -0,0 +1,77 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <atomic>
+
+/*Fixed-size, lock-free ring buffer for exactly one producer thread and one consumer thread.
+Push and Pop never allocate nor block: a full buffer makes Push fail and an empty one makes Pop fail.
+Each side keeps a cached copy of the other side's index, so the shared indices are only read
+when the cached value says the buffer looks full (or empty).
+*/
+template<typename ElementType, uint32 Capacity>
+class TSpscRingBuffer
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity needs to be a power of two");
+
+public:
+	TSpscRingBuffer()
+		: WriteIndex(0)
+		, CachedReadIndex(0)
+		, ReadIndex(0)
+		, CachedWriteIndex(0)
+	{
+	}
+
+	//Producer side, returns false if the buffer is full
+	FORCEINLINE bool Push(const ElementType& Element)
+	{
+		const uint32 Head = WriteIndex.load(std::memory_order_relaxed);
+		if (Head - CachedReadIndex == Capacity)
+		{
+			CachedReadIndex = ReadIndex.load(std::memory_order_acquire);
+			if (Head - CachedReadIndex == Capacity)
+			{
+				return false;
+			}
+		}
+		Buffer[Head & (Capacity - 1)] = Element;
+		WriteIndex.store(Head + 1, std::memory_order_release);
+		return true;
+	}
+
+	//Consumer side, returns false if the buffer is empty
+	FORCEINLINE bool Pop(ElementType& OutElement)
+	{
+		const uint32 Tail = ReadIndex.load(std::memory_order_relaxed);
+		if (Tail == CachedWriteIndex)
+		{
+			CachedWriteIndex = WriteIndex.load(std::memory_order_acquire);
+			if (Tail == CachedWriteIndex)
+			{
+				return false;
+			}
+		}
+		OutElement = Buffer[Tail & (Capacity - 1)];
+		ReadIndex.store(Tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	//Approximate number of elements, exact only when called from one of the two sides while the other is idle
+	uint32 Num() const
+	{
+		return WriteIndex.load(std::memory_order_acquire) - ReadIndex.load(std::memory_order_acquire);
+	}
+
+private:
+	//Producer and consumer data live on separate cache lines so the two threads do not invalidate each other
+	std::atomic<uint32> WriteIndex;
+	uint32 CachedReadIndex;
+	uint8 ProducerPadding[PLATFORM_CACHE_LINE_SIZE - sizeof(std::atomic<uint32>) - sizeof(uint32)];
+
+	std::atomic<uint32> ReadIndex;
+	uint32 CachedWriteIndex;
+	uint8 ConsumerPadding[PLATFORM_CACHE_LINE_SIZE - sizeof(std::atomic<uint32>) - sizeof(uint32)];
+
+	ElementType Buffer[Capacity];
+};
@@ -0,0 +1,34 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "StackingRules.h"
+
+const float FStackingRules::SurfaceGap = 0.2f;
+const float FStackingRules::OnTopTolerance = 15.f;
+
+bool FStackingRules::CanStack(bool bStackable, bool bSameKind)
+{
+	return bStackable && bSameKind;
+}
+
+FVector FStackingRules::GetStackedLocation(const FVector& BelowLocation, float BelowMaxZ, float MinZ)
+{
+	return BelowLocation + FVector(0.f, 0.f, BelowMaxZ - MinZ);
+}
+
+float FStackingRules::GetRestingZ(float SurfaceZ, float MinZ)
+{
+	return SurfaceZ + SurfaceGap - MinZ;
+}
+
+/*The location of the other item has to be within the bounds of the one below, up to the tolerance above them,
+and its bottom above the bottom of the one below (eg: not an item the one below rests on)*/
+bool FStackingRules::IsOnTop(const FVector& BelowLocation, const FVector& BelowMin, const FVector& BelowMax, const FVector& Location, float MinZ)
+{
+	const FVector LowBound = BelowLocation + BelowMin;
+	const FVector HighBound = BelowLocation + BelowMax;
+	return LowBound.X < Location.X && HighBound.X > Location.X &&
+		LowBound.Y < Location.Y && HighBound.Y > Location.Y &&
+		LowBound.Z < Location.Z && HighBound.Z + OnTopTolerance > Location.Z &&
+		Location.Z + MinZ > LowBound.Z;
+}
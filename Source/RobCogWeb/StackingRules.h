@@ -0,0 +1,38 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/*Rules by which the items rest on the surfaces and on each other. The character follows them when it places the items
+it holds (AMyCharacter::PlaceOnTop, HasAnyOnTop) and the layout generator when it places the pooled items (FLayoutGenerator),
+so that a generated layout is one the player could have built.
+*/
+struct FStackingRules
+{
+	//Gap left between an item and the static surface it is placed on, so that they do not collide, in cm
+	static const float SurfaceGap;
+
+	//Height above the top of an item's bounds within which another item still counts as resting on it, in cm
+	static const float OnTopTolerance;
+
+	//Stackable items of the same kind are placed right on top of each other
+	static bool CanStack(bool bStackable, bool bSameKind);
+
+	/*Location of an item stacked on another one, which keeps the rotation of the one below
+	@param const FVector& BelowLocation  -->  Location of the item below
+	@param float BelowMaxZ  -->  Top of the local bounds of the item below
+	@param float MinZ  -->  Bottom of the local bounds of the stacked item*/
+	static FVector GetStackedLocation(const FVector& BelowLocation, float BelowMaxZ, float MinZ);
+
+	/*Height of the location of an item resting on a static surface
+	@param float SurfaceZ  -->  Height of the surface
+	@param float MinZ  -->  Bottom of the local bounds of the item*/
+	static float GetRestingZ(float SurfaceZ, float MinZ);
+
+	/*Whether an item rests on top of another one, which can then not be picked
+	@param const FVector& BelowLocation  -->  Location of the item below
+	@param const FVector& BelowMin  -->  Local bounds of the item below
+	@param const FVector& BelowMax
+	@param const FVector& Location  -->  Location of the other item
+	@param float MinZ  -->  Bottom of the local bounds of the other item*/
+	static bool IsOnTop(const FVector& BelowLocation, const FVector& BelowMin, const FVector& BelowMax, const FVector& Location, float MinZ);
+};
@@ -0,0 +1,109 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "StartupBenchmark.h"
+
+bool FStartupBenchmark::bEnabled = false;
+double FStartupBenchmark::EngineInitEnd = 0.0;
+double FStartupBenchmark::Timestamps[(int32)EStartupMilestone::Count] = {};
+FString FStartupBenchmark::LoadedMap;
+
+void FStartupBenchmark::Startup()
+{
+	bEnabled = FParse::Param(FCommandLine::Get(), TEXT("StartupBenchmark"));
+	if (bEnabled)
+	{
+		FCoreUObjectDelegates::PreLoadMap.AddStatic(&FStartupBenchmark::OnPreLoadMap);
+		FCoreUObjectDelegates::PostLoadMap.AddStatic(&FStartupBenchmark::OnPostLoadMap);
+	}
+}
+
+bool FStartupBenchmark::IsEnabled()
+{
+	return bEnabled;
+}
+
+void FStartupBenchmark::OnPreLoadMap(const FString& MapName)
+{
+	//Engine initialization ends with the first map load, every later load restarts the measurement
+	if (EngineInitEnd == 0.0)
+	{
+		EngineInitEnd = FPlatformTime::Seconds();
+	}
+	for (double& Timestamp : Timestamps)
+	{
+		Timestamp = 0.0;
+	}
+	LoadedMap = FPackageName::GetShortName(MapName);
+	Mark(EStartupMilestone::MapLoadStart);
+}
+
+void FStartupBenchmark::OnPostLoadMap()
+{
+	Mark(EStartupMilestone::MapLoadEnd);
+}
+
+void FStartupBenchmark::Mark(EStartupMilestone Milestone)
+{
+	if (!bEnabled || Timestamps[(int32)Milestone] != 0.0)
+	{
+		return;
+	}
+	Timestamps[(int32)Milestone] = FPlatformTime::Seconds();
+
+	if (Milestone == EStartupMilestone::FirstInteractiveFrame)
+	{
+		WriteResults();
+		FPlatformMisc::RequestExit(false);
+	}
+}
+
+bool FStartupBenchmark::WriteResults()
+{
+	//Duration in ms between two milestones, -1 if one of them was not reached
+	auto Span = [](EStartupMilestone From, EStartupMilestone To)
+	{
+		const double Start = Timestamps[(int32)From];
+		const double End = Timestamps[(int32)To];
+		return (Start != 0.0 && End != 0.0) ? (End - Start) * 1000.0 : -1.0;
+	};
+
+	const double EngineInitMs = (EngineInitEnd - GStartTime) * 1000.0;
+	const double TimeToInteractiveMs = (Timestamps[(int32)EStartupMilestone::FirstInteractiveFrame] - GStartTime) * 1000.0;
+
+	//Threshold from the command line (-StartupThreshold=ms) or from the [StartupBenchmark] section of the game config
+	float ThresholdMs = 0.f;
+	if (!FParse::Value(FCommandLine::Get(), TEXT("StartupThreshold="), ThresholdMs))
+	{
+		GConfig->GetFloat(TEXT("StartupBenchmark"), TEXT("TimeToInteractiveThresholdMs"), ThresholdMs, GGameIni);
+	}
+	const bool bPassed = ThresholdMs <= 0.f || TimeToInteractiveMs <= ThresholdMs;
+
+	const FString CsvPath = FPaths::Combine(*FPaths::GameSavedDir(), TEXT("Benchmarks"), TEXT("StartupBenchmark.csv"));
+	FString Row;
+	if (!IFileManager::Get().FileExists(*CsvPath))
+	{
+		Row += TEXT("Date,Map,EngineInitMs,MapLoadMs,CharacterBeginPlayMs,GameModeBeginPlayMs,TimeToInteractiveMs,ThresholdMs,Result\n");
+	}
+	Row += FString::Printf(TEXT("%s,%s,%.1f,%.1f,%.2f,%.2f,%.1f,%.1f,%s\n"),
+		*FDateTime::Now().ToString(),
+		*LoadedMap,
+		EngineInitMs,
+		Span(EStartupMilestone::MapLoadStart, EStartupMilestone::MapLoadEnd),
+		Span(EStartupMilestone::CharacterBeginPlayStart, EStartupMilestone::CharacterBeginPlayEnd),
+		Span(EStartupMilestone::GameModeBeginPlayStart, EStartupMilestone::GameModeBeginPlayEnd),
+		TimeToInteractiveMs,
+		ThresholdMs,
+		bPassed ? TEXT("PASS") : TEXT("REGRESSION"));
+	FFileHelper::SaveStringToFile(Row, *CsvPath, FFileHelper::EEncodingOptions::AutoDetect, &IFileManager::Get(), FILEWRITE_Append);
+
+	if (bPassed)
+	{
+		UE_LOG(LogRobCogWeb, Log, TEXT("Startup benchmark %s: interactive after %.1f ms"), *LoadedMap, TimeToInteractiveMs);
+	}
+	else
+	{
+		UE_LOG(LogRobCogWeb, Error, TEXT("Startup benchmark %s: interactive after %.1f ms, above the %.1f ms threshold"), *LoadedMap, TimeToInteractiveMs, ThresholdMs);
+	}
+	return bPassed;
+}
@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+//Milestones measured by the startup benchmark, in the order they are reached
+enum class EStartupMilestone : uint8
+{
+	MapLoadStart,
+	MapLoadEnd,
+	CharacterBeginPlayStart,
+	CharacterBeginPlayEnd,
+	GameModeBeginPlayStart,
+	GameModeBeginPlayEnd,
+	FirstInteractiveFrame,
+	Count
+};
+
+/*Measures the time from launch until the participant can interact with the kitchen.
+Enabled with -StartupBenchmark on the command line (usually together with -nullrhi, see Scripts/StartupBenchmark.sh).
+When the first interactive frame is reached the timings are appended to Saved/Benchmarks/StartupBenchmark.csv,
+compared against the regression threshold and the game exits.
+*/
+class FStartupBenchmark
+{
+public:
+	//Registers the map load callbacks, called when the game module starts
+	static void Startup();
+
+	//Records the time a milestone is reached, only the first call for each milestone after a map load counts
+	static void Mark(EStartupMilestone Milestone);
+
+	//Whether this run is a startup benchmark, which records and uploads nothing
+	static bool IsEnabled();
+
+private:
+	static void OnPreLoadMap(const FString& MapName);
+	static void OnPostLoadMap();
+
+	//Appends the result row to the CSV and returns true if the time to interactive is within the threshold
+	static bool WriteResults();
+
+	static bool bEnabled;
+	static double EngineInitEnd;
+	static double Timestamps[(int32)EStartupMilestone::Count];
+	static FString LoadedMap;
+};
@@ -0,0 +1,312 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "TaskEvaluator.h"
+
+const float FTaskEvaluator::SupportTraceDepth = 10.f;
+
+bool FTaskWorld::IsOn(const AActor* Item, FName Tag) const
+{
+	const AActor* Current = Item;
+	for (int32 Depth = 0; Depth < MaxStackDepth; Depth++)
+	{
+		const AActor* const* Support = Supports.Find(Current);
+		if (!Support || !*Support)
+		{
+			return false;
+		}
+		if ((*Support)->ActorHasTag(Tag))
+		{
+			return true;
+		}
+		//Only items rest on other things, a surface without the tag ends the walk
+		if (!FindType(*Support))
+		{
+			return false;
+		}
+		Current = *Support;
+	}
+	return false;
+}
+
+FBreakfastRule::FBreakfastRule(FName InTableTag, int32 InRequiredPlates, float InPlaceRadius)
+	: TableTag(InTableTag)
+	, RequiredPlates(InRequiredPlates)
+	, PlaceRadius(InPlaceRadius)
+	, Satisfied(0)
+	, Required(0)
+{
+}
+
+void FBreakfastRule::Reset(const FTaskWorld& World)
+{
+	Plates.Reset();
+	Mugs.Reset();
+	Spoons.Reset();
+
+	int32 NumPlates = 0;
+	int32 NumMugs = 0;
+	int32 NumSpoons = 0;
+	for (const auto& Item : *World.Items)
+	{
+		//Pooled items left out of the layout cannot be used
+		if (Item.Key->bHidden)
+		{
+			continue;
+		}
+		NumPlates += Item.Value == EItemType::Plate;
+		NumMugs += Item.Value == EItemType::Mug;
+		NumSpoons += Item.Value == EItemType::Spoon;
+		UpdateTableItem(World, Item.Key);
+	}
+	Required = RequiredPlates > 0 ? RequiredPlates : FMath::Min3(NumPlates, NumMugs, NumSpoons);
+
+	CountPlaces(World);
+}
+
+void FBreakfastRule::OnChanged(const FTaskWorld& World, const AActor* Actor)
+{
+	if (UpdateTableItem(World, Actor))
+	{
+		CountPlaces(World);
+	}
+}
+
+bool FBreakfastRule::UpdateTableItem(const FTaskWorld& World, const AActor* Actor)
+{
+	const EItemType* Type = World.FindType(Actor);
+	TSet<const AActor*>* Set = nullptr;
+	if (Type && *Type == EItemType::Plate)
+	{
+		Set = &Plates;
+	}
+	else if (Type && *Type == EItemType::Mug)
+	{
+		Set = &Mugs;
+	}
+	else if (Type && *Type == EItemType::Spoon)
+	{
+		Set = &Spoons;
+	}
+	if (!Set)
+	{
+		return false;
+	}
+
+	if (World.IsOn(Actor, TableTag))
+	{
+		Set->Add(Actor);
+	}
+	else
+	{
+		Set->Remove(Actor);
+	}
+	return true;
+}
+
+/*The items on the table are a handful, the places are matched again from scratch each time one of them changes*/
+void FBreakfastRule::CountPlaces(const FTaskWorld& World)
+{
+	Satisfied = 0;
+	Claimed.Reset();
+	for (const AActor* Plate : Plates)
+	{
+		const AActor* Mug = FindForPlace(World, Plate, Mugs);
+		const AActor* Spoon = FindForPlace(World, Plate, Spoons);
+		if (Mug && Spoon)
+		{
+			Claimed.Add(Mug);
+			Claimed.Add(Spoon);
+			Satisfied++;
+		}
+	}
+}
+
+const AActor* FBreakfastRule::FindForPlace(const FTaskWorld& World, const AActor* Plate, const TSet<const AActor*>& Candidates) const
+{
+	const FVector PlateLocation = Plate->GetActorLocation();
+	const AActor* Closest = nullptr;
+	float ClosestDistSquared = FMath::Square(PlaceRadius);
+	for (const AActor* Candidate : Candidates)
+	{
+		if (Claimed.Contains(Candidate))
+		{
+			continue;
+		}
+		if (World.Supports.FindRef(Candidate) == Plate)
+		{
+			return Candidate;
+		}
+		const float DistSquared = FVector::DistSquaredXY(PlateLocation, Candidate->GetActorLocation());
+		if (DistSquared <= ClosestDistSquared)
+		{
+			Closest = Candidate;
+			ClosestDistSquared = DistSquared;
+		}
+	}
+	return Closest;
+}
+
+FString FBreakfastRule::GetStatus() const
+{
+	return FString::Printf(TEXT("%d/%d places set"), FMath::Min(Satisfied, Required), Required);
+}
+
+FCleaningRule::FCleaningRule(FName InSinkTag, FName InDirtyTag)
+	: SinkTag(InSinkTag)
+	, DirtyTag(InDirtyTag)
+{
+}
+
+void FCleaningRule::Reset(const FTaskWorld& World)
+{
+	DirtyItems.Reset();
+	Outside.Reset();
+	for (const auto& Item : *World.Items)
+	{
+		if (!Item.Key->bHidden && Item.Key->ActorHasTag(DirtyTag))
+		{
+			DirtyItems.Add(Item.Key);
+			OnChanged(World, Item.Key);
+		}
+	}
+}
+
+void FCleaningRule::OnChanged(const FTaskWorld& World, const AActor* Actor)
+{
+	if (!DirtyItems.Contains(Actor))
+	{
+		return;
+	}
+
+	if (World.IsOn(Actor, SinkTag))
+	{
+		Outside.Remove(Actor);
+	}
+	else
+	{
+		Outside.Add(Actor);
+	}
+}
+
+FString FCleaningRule::GetStatus() const
+{
+	return FString::Printf(TEXT("%d dirty items outside the sink"), Outside.Num());
+}
+
+FTaskEvaluator::FTaskEvaluator(ITaskRule* InRule)
+	: Rule(InRule)
+{
+	FMemory::Memzero(Stats);
+}
+
+FTaskEvaluator::~FTaskEvaluator()
+{
+	delete Rule;
+}
+
+/*Items rest on what is right below their bounds; the held items and the pooled items left out of the layout rest on nothing
+@param const AMyCharacter& Character  -->  Character holding the items and the content of the hands
+@param float Timestamp  -->  Time of the world, in seconds*/
+void FTaskEvaluator::Begin(const AMyCharacter& Character, float Timestamp)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	World.Items = &Character.ItemMap;
+	World.Supports.Reset();
+	for (const auto& Item : Character.ItemMap)
+	{
+		AActor* Actor = Item.Key;
+		if (Actor->bHidden || Actor == Character.RightHandSlot || Actor == Character.LeftHandSlot || Character.TwoHandSlot.Contains(Actor))
+		{
+			continue;
+		}
+
+		if (const AActor* Support = Character.FindSupport(Actor))
+		{
+			World.Supports.Add(Actor, Support);
+		}
+	}
+
+	Rule->Reset(World);
+
+	Progress.Reset();
+	RecordProgress(Timestamp);
+	Stats.BeginTimeMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+}
+
+/*Drawers and doors carry the items in them, an open or a close changes no support but is still handed to the rule
+@param ESemanticEventKind Kind  -->  Action of the character
+@param const AActor* Actor  -->  Item picked or dropped, or drawer or door opened or closed
+@param const AActor* Surface  -->  Actor an item was dropped on
+@param float Timestamp  -->  Time of the world, in seconds*/
+void FTaskEvaluator::OnEvent(ESemanticEventKind Kind, const AActor* Actor, const AActor* Surface, float Timestamp)
+{
+	if (!Actor || !World.Items)
+	{
+		return;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	if (Kind == ESemanticEventKind::Pick)
+	{
+		World.Supports.Remove(Actor);
+	}
+	else if (Kind == ESemanticEventKind::Drop && Surface)
+	{
+		World.Supports.Add(Actor, Surface);
+	}
+	Rule->OnChanged(World, Actor);
+	RecordProgress(Timestamp);
+
+	const double Cost = (FPlatformTime::Seconds() - StartTime) * 1000000.0;
+	Stats.NumEvents++;
+	Stats.LastCostUs = Cost;
+	Stats.AverageCostUs += (Cost - Stats.AverageCostUs) / Stats.NumEvents;
+	Stats.MaxCostUs = FMath::Max(Stats.MaxCostUs, Cost);
+}
+
+float FTaskEvaluator::GetProgress() const
+{
+	const int32 Required = Rule->GetRequired();
+	return Required > 0 ? FMath::Min(1.f, (float)Rule->GetSatisfied() / Required) : 0.f;
+}
+
+void FTaskEvaluator::RecordProgress(float Timestamp)
+{
+	const int32 Satisfied = Rule->GetSatisfied();
+	const int32 Required = Rule->GetRequired();
+	if (Progress.Num() && Progress.Last().Satisfied == Satisfied && Progress.Last().Required == Required)
+	{
+		return;
+	}
+
+	FTaskProgress& Entry = Progress[Progress.AddUninitialized()];
+	Entry.Timestamp = Timestamp;
+	Entry.Satisfied = Satisfied;
+	Entry.Required = Required;
+}
+
+bool FTaskEvaluator::SaveToFile(const FString& FilePath) const
+{
+	TArray<uint8> Bytes;
+	FMemoryWriter Writer(Bytes);
+
+	uint32 FileMagic = Magic;
+	uint16 FileVersion = Version;
+	FString RuleName = Rule->GetName();
+	TArray<FTaskProgress> Entries = Progress;
+	int32 NumEvents = Stats.NumEvents;
+	double AverageCostUs = Stats.AverageCostUs;
+	double MaxCostUs = Stats.MaxCostUs;
+	Writer << FileMagic;
+	Writer << FileVersion;
+	Writer << RuleName;
+	Writer << Entries;
+	Writer << NumEvents;
+	Writer << AverageCostUs;
+	Writer << MaxCostUs;
+
+	return !Writer.IsError() && FFileHelper::SaveArrayToFile(Bytes, *FilePath);
+}
@@ -0,0 +1,209 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "MyCharacter.h"
+
+//What the rules see of the kitchen, kept up to date by the evaluator from the events of the character
+struct FTaskWorld
+{
+	//Item or surface each item rests on, missing while the item is held
+	TMap<const AActor*, const AActor*> Supports;
+
+	//Interactive items of the level and their type, owned by the character
+	const TMap<AActor*, EItemType>* Items;
+
+	//Stacks are never higher than this, it also stops the walk on a cycle of supports
+	static const int32 MaxStackDepth = 8;
+
+	FTaskWorld()
+		: Items(nullptr)
+	{
+	}
+
+	//Type of an item, null if the actor is not an item
+	const EItemType* FindType(const AActor* Actor) const
+	{
+		return Items->Find(const_cast<AActor*>(Actor));
+	}
+
+	//Whether an item rests on an actor with the tag, directly or through the items below it
+	bool IsOn(const AActor* Item, FName Tag) const;
+};
+
+/*Rule deciding whether the task of a level is done. The rule is told about each item or asset an event changed,
+and only looks again at the few items related to it.
+*/
+class ITaskRule
+{
+public:
+	virtual ~ITaskRule() {}
+
+	//Name stored with the evaluation
+	virtual const TCHAR* GetName() const = 0;
+
+	//Starts again from the supports traced at the start of the episode
+	virtual void Reset(const FTaskWorld& World) = 0;
+
+	//Called after an item was picked or dropped, or a drawer or door opened or closed
+	virtual void OnChanged(const FTaskWorld& World, const AActor* Actor) = 0;
+
+	//Parts of the task done and parts required, the task is complete when all of them are done
+	virtual int32 GetSatisfied() const = 0;
+	virtual int32 GetRequired() const = 0;
+
+	//Short text for the HUD
+	virtual FString GetStatus() const = 0;
+};
+
+/*Breakfast: a number of places are set on the table, each a plate resting on it with a mug and a spoon.
+The mug and the spoon of a place rest on its plate, or on the table within PlaceRadius of it.
+*/
+class FBreakfastRule : public ITaskRule
+{
+public:
+	//0 plates requires as many places as the plates, mugs and spoons of the level can set
+	FBreakfastRule(FName InTableTag, int32 InRequiredPlates, float InPlaceRadius);
+
+	virtual const TCHAR* GetName() const override { return TEXT("Breakfast"); }
+	virtual void Reset(const FTaskWorld& World) override;
+	virtual void OnChanged(const FTaskWorld& World, const AActor* Actor) override;
+	virtual int32 GetSatisfied() const override { return Satisfied; }
+	virtual int32 GetRequired() const override { return Required; }
+	virtual FString GetStatus() const override;
+
+private:
+	//Adds the item to the set of its type if it is on the table or removes it, returns false if it is not part of the task
+	bool UpdateTableItem(const FTaskWorld& World, const AActor* Actor);
+
+	//Matches the mugs and spoons on the table to the plates on it
+	void CountPlaces(const FTaskWorld& World);
+
+	//Unclaimed item of the set resting on the plate, or else the closest one within the radius
+	const AActor* FindForPlace(const FTaskWorld& World, const AActor* Plate, const TSet<const AActor*>& Candidates) const;
+
+	FName TableTag;
+	int32 RequiredPlates;
+	float PlaceRadius;
+
+	//Items of the task currently on the table
+	TSet<const AActor*> Plates;
+	TSet<const AActor*> Mugs;
+	TSet<const AActor*> Spoons;
+
+	//Mugs and spoons given to a place, reused between counts
+	TSet<const AActor*> Claimed;
+
+	int32 Satisfied;
+	int32 Required;
+};
+
+/*Cleaning: every item with the dirty tag ends in the sink, resting on it or on the items stacked in it*/
+class FCleaningRule : public ITaskRule
+{
+public:
+	FCleaningRule(FName InSinkTag, FName InDirtyTag);
+
+	virtual const TCHAR* GetName() const override { return TEXT("Cleaning"); }
+	virtual void Reset(const FTaskWorld& World) override;
+	virtual void OnChanged(const FTaskWorld& World, const AActor* Actor) override;
+	virtual int32 GetSatisfied() const override { return DirtyItems.Num() - Outside.Num(); }
+	virtual int32 GetRequired() const override { return DirtyItems.Num(); }
+	virtual FString GetStatus() const override;
+
+private:
+	FName SinkTag;
+	FName DirtyTag;
+
+	TSet<const AActor*> DirtyItems;
+
+	//Dirty items held or resting outside the sink
+	TSet<const AActor*> Outside;
+};
+
+//Cost of the evaluation on the game thread, copied out for the HUD and the logs
+struct FTaskEvaluationStats
+{
+	int32 NumEvents;
+
+	//Time spent in OnEvent(), in microseconds
+	double LastCostUs;
+	double AverageCostUs;
+	double MaxCostUs;
+
+	//Time spent tracing the supports in Begin(), in milliseconds
+	double BeginTimeMs;
+};
+
+//Point of the episode at which the number of parts done changed
+struct FTaskProgress
+{
+	float Timestamp;
+	int32 Satisfied;
+	int32 Required;
+
+	friend FArchive& operator<<(FArchive& Ar, FTaskProgress& Progress)
+	{
+		Ar << Progress.Timestamp;
+		Ar << Progress.Satisfied;
+		Ar << Progress.Required;
+		return Ar;
+	}
+};
+
+/*Evaluates the task of the level while it is played, from the events of the character (see AMyCharacter::LogEvent).
+Begin() traces once below every item to find what it rests on; after that a pick removes the support of the item and a drop
+sets it to the surface of the event, so the kitchen is never searched again. Each event is handed to the rule, which only
+updates the parts of the task the changed actor belongs to. Replays drive the same handlers, so they are evaluated the same way.
+The changes of the progress are kept with their time and written with the cost of the evaluation to TaskEvaluation.bin.
+*/
+class FTaskEvaluator
+{
+public:
+	//Identifies the file format, bumped whenever the layout changes
+	static const uint32 Magic = 0x45544352; // 'RCTE'
+	static const uint16 Version = 1;
+
+	//The evaluator takes ownership of the rule
+	explicit FTaskEvaluator(ITaskRule* InRule);
+	~FTaskEvaluator();
+
+	//Traces the supports of the items and resets the rule, called again when a snapshot moved the actors without events
+	void Begin(const AMyCharacter& Character, float Timestamp);
+
+	//Updates the supports and the rule after an event of the character
+	void OnEvent(ESemanticEventKind Kind, const AActor* Actor, const AActor* Surface, float Timestamp);
+
+	bool IsComplete() const
+	{
+		return Rule->GetRequired() > 0 && Rule->GetSatisfied() >= Rule->GetRequired();
+	}
+
+	//Share of the task done, between 0 and 1
+	float GetProgress() const;
+
+	FString GetStatus() const
+	{
+		return Rule->GetStatus();
+	}
+
+	const FTaskEvaluationStats& GetStats() const
+	{
+		return Stats;
+	}
+
+	//Writes the rule, the changes of the progress and the cost of the evaluation
+	bool SaveToFile(const FString& FilePath) const;
+
+	//Depth traced below the bounds of an item for its support, in cm
+	static const float SupportTraceDepth;
+
+private:
+	//Appends the progress if it changed since the last entry
+	void RecordProgress(float Timestamp);
+
+	ITaskRule* Rule;
+	FTaskWorld World;
+	TArray<FTaskProgress> Progress;
+	FTaskEvaluationStats Stats;
+};
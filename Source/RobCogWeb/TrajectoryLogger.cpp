@@ -0,0 +1,222 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "TrajectoryLogger.h"
+#include "SegmentedFileWriter.h"
+#include "LogEncoding.h"
+
+FTrajectoryLogger::FTrajectoryLogger(const FString& InFilePath, const FString& LevelName, float InSampleInterval, const TFunction<void(const FString&)>& OnSegmentWritten)
+	: SampleInterval(InSampleInterval)
+	, NextSampleTime(0.0)
+	, DroppedSamples(0)
+	, FirstTimestamp(-1.0)
+	, LastTimestamp(0.0)
+	, BytesWritten(0)
+{
+	//Every chunk is allocated up front, recording never allocates afterwards
+	Chunks.SetNumUninitialized(NumChunks);
+	for (int32 i = 1; i < NumChunks; i++)
+	{
+		FreeChunks.Push(i);
+	}
+	CurrentChunk = 0;
+	Chunks[CurrentChunk].NumSamples = 0;
+
+	FSegmentedFileWriter* SegmentWriter = new FSegmentedFileWriter(InFilePath);
+	SegmentWriter->OnSegmentWritten = OnSegmentWritten;
+	File = SegmentWriter;
+	uint32 FileMagic = Magic;
+	uint16 FileVersion = Version;
+	FString FileLevelName = LevelName;
+	float FileSampleInterval = SampleInterval;
+	float FilePositionUnit = LogEncoding::PositionUnit;
+	*File << FileMagic;
+	*File << FileVersion;
+	*File << FileLevelName;
+	*File << FileSampleInterval;
+	*File << FilePositionUnit;
+	//The header is a record of its own, the first segment starts with it
+	File->Flush();
+
+	WriteBuffer.Reserve(sizeof(FChunk));
+	Thread = FRunnableThread::Create(this, TEXT("TrajectoryLogger"), 0, TPri_BelowNormal);
+}
+
+FTrajectoryLogger::~FTrajectoryLogger()
+{
+	//The partially filled chunk is written with the others
+	if (CurrentChunk != INDEX_NONE && Chunks[CurrentChunk].NumSamples)
+	{
+		FilledChunks.Push(CurrentChunk);
+		CurrentChunk = INDEX_NONE;
+	}
+
+	if (Thread)
+	{
+		Stop();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	if (File)
+	{
+		File->Close();
+		delete File;
+		File = nullptr;
+	}
+
+	const double Minutes = (LastTimestamp - FirstTimestamp) / 60.0;
+	UE_LOG(LogRobCogWeb, Log, TEXT("Trajectories: %llu bytes written, %.1f KB per minute, %u samples dropped"),
+		BytesWritten, Minutes > 0.0 ? BytesWritten / 1024.0 / Minutes : 0.0, DroppedSamples);
+	Stats.Report(TEXT("Trajectories"));
+}
+
+FTrajectorySample* FTrajectoryLogger::BeginSample(double Timestamp)
+{
+	if (Timestamp < NextSampleTime)
+	{
+		return nullptr;
+	}
+	NextSampleTime = Timestamp + SampleInterval;
+
+	//A full chunk is handed over once its last sample has been filled, that is at the next call
+	if (CurrentChunk != INDEX_NONE && Chunks[CurrentChunk].NumSamples == SamplesPerChunk)
+	{
+		FilledChunks.Push(CurrentChunk);
+		CurrentChunk = INDEX_NONE;
+	}
+
+	if (CurrentChunk == INDEX_NONE)
+	{
+		if (!FreeChunks.Pop(CurrentChunk))
+		{
+			CurrentChunk = INDEX_NONE;
+			DroppedSamples++;
+			return nullptr;
+		}
+		Chunks[CurrentChunk].NumSamples = 0;
+	}
+
+	FChunk& Chunk = Chunks[CurrentChunk];
+	FTrajectorySample& Sample = Chunk.Samples[Chunk.NumSamples++];
+	Sample.Timestamp = Timestamp;
+	Sample.NumItems = 0;
+	return &Sample;
+}
+
+uint32 FTrajectoryLogger::Run()
+{
+	while (!bStopping)
+	{
+		if (!Drain())
+		{
+			if (File)
+			{
+				File->Flush();
+			}
+			FPlatformProcess::Sleep(0.05f);
+		}
+	}
+	Drain();
+	return 0;
+}
+
+void FTrajectoryLogger::Stop()
+{
+	bStopping = true;
+}
+
+/*Layout of a chunk: tag, sample count, timestamp of the first sample, then for each sample
+the time since the previous one in ms, the number of items and their actor ids, and for every body and item
+its position as a delta to the same slot in the previous sample and its compressed rotation.
+Positions restart from zero at the start of a chunk and when a slot holds another item, so each chunk decodes on its own.
+@param const FChunk& Chunk  -->  Chunk filled by the game thread
+@param FArchive& Ar  -->  Write buffer*/
+void FTrajectoryLogger::EncodeChunk(const FChunk& Chunk, FArchive& Ar)
+{
+	const int32 MaxSlots = FTrajectorySample::NumBodies + FTrajectorySample::MaxItems;
+
+	//Previous quantized position of each slot, and the item it belonged to
+	FIntVector Previous[MaxSlots];
+	uint32 PreviousIds[MaxSlots];
+	FMemory::Memzero(Previous);
+	FMemory::Memzero(PreviousIds);
+
+	uint8 Tag = ChunkTag;
+	uint16 NumSamples = Chunk.NumSamples;
+	double BaseTime = Chunk.Samples[0].Timestamp;
+	Ar << Tag;
+	Ar << NumSamples;
+	Ar << BaseTime;
+
+	double PreviousTime = BaseTime;
+	for (int32 SampleIndex = 0; SampleIndex < Chunk.NumSamples; SampleIndex++)
+	{
+		const FTrajectorySample& Sample = Chunk.Samples[SampleIndex];
+		const int32 NumItems = FMath::Min(Sample.NumItems, (int32)FTrajectorySample::MaxItems);
+		const int32 NumSlots = FTrajectorySample::NumBodies + NumItems;
+
+		LogEncoding::WriteTimeDelta(Ar, Sample.Timestamp, PreviousTime);
+		uint8 ItemCount = NumItems;
+		Ar << ItemCount;
+
+		uint32 Ids[MaxSlots];
+		for (int32 Slot = 0; Slot < NumSlots; Slot++)
+		{
+			Ids[Slot] = Slot < FTrajectorySample::NumBodies ? 0 : Sample.ItemIds[Slot - FTrajectorySample::NumBodies];
+		}
+		for (int32 Item = 0; Item < NumItems; Item++)
+		{
+			LogEncoding::WriteVarint(Ar, Ids[FTrajectorySample::NumBodies + Item]);
+		}
+
+		for (int32 Slot = 0; Slot < NumSlots; Slot++)
+		{
+			const FTrajectoryPose& Pose = Slot < FTrajectorySample::NumBodies ? Sample.Bodies[Slot] : Sample.Items[Slot - FTrajectorySample::NumBodies];
+			if (Ids[Slot] != PreviousIds[Slot])
+			{
+				Previous[Slot] = FIntVector::ZeroValue;
+				PreviousIds[Slot] = Ids[Slot];
+			}
+			LogEncoding::WriteLocationDelta(Ar, LogEncoding::QuantizeLocation(Pose.Location), Previous[Slot]);
+			LogEncoding::WriteQuat(Ar, Pose.Rotation);
+		}
+
+		Stats.RawBytes += 8 + 1 + NumItems * sizeof(uint32) + NumSlots * (sizeof(FVector) + sizeof(FQuat));
+	}
+
+	if (FirstTimestamp < 0.0)
+	{
+		FirstTimestamp = BaseTime;
+	}
+	LastTimestamp = Chunk.Samples[Chunk.NumSamples - 1].Timestamp;
+}
+
+bool FTrajectoryLogger::Drain()
+{
+	int32 ChunkIndex;
+	if (!FilledChunks.Pop(ChunkIndex))
+	{
+		return false;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	WriteBuffer.Reset();
+	FMemoryWriter Writer(WriteBuffer);
+	do
+	{
+		EncodeChunk(Chunks[ChunkIndex], Writer);
+		FreeChunks.Push(ChunkIndex);
+	} while (FilledChunks.Pop(ChunkIndex));
+	Stats.EncodedBytes += WriteBuffer.Num();
+	Stats.EncodeTime += FPlatformTime::Seconds() - StartTime;
+
+	if (File)
+	{
+		File->Serialize(WriteBuffer.GetData(), WriteBuffer.Num());
+		File->Flush();
+	}
+	BytesWritten += WriteBuffer.Num();
+	return true;
+}
@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "SpscRingBuffer.h"
+#include "LogEncoding.h"
+
+//Pose of one tracked body, as sampled on the game thread
+struct FTrajectoryPose
+{
+	FVector Location;
+	FQuat Rotation;
+};
+
+/*One sample of the trajectories: the camera, both hands and the items they hold.
+Fixed size, so that the chunks can be allocated once for the whole episode.
+*/
+struct FTrajectorySample
+{
+	//Most items held at once (two hands plus the largest stack)
+	static const int32 MaxItems = 8;
+
+	//Bodies always present in a sample
+	enum
+	{
+		Camera,
+		RightHand,
+		LeftHand,
+		NumBodies
+	};
+
+	double Timestamp;
+
+	FTrajectoryPose Bodies[NumBodies];
+
+	//Held items, right hand first, then left hand, then the stack from bottom to top
+	int32 NumItems;
+	uint32 ItemIds[MaxItems];
+	FTrajectoryPose Items[MaxItems];
+};
+
+/*Records the trajectories of the character and the held items at a high rate with a bounded cost.
+Samples are written by the game thread into preallocated chunks; full chunks go to a background thread
+which quantizes them (positions in 0.1 mm, rotations as 48-bit smallest-three quaternions),
+writes the positions as varint deltas against the previous sample and appends them to the trajectory file.
+Only the game thread may call the sampling methods.
+*/
+class FTrajectoryLogger : public FRunnable
+{
+public:
+	//Opens the trajectory file and starts the writer thread, OnSegmentWritten is called on it with each segment of the file once it is in place
+	FTrajectoryLogger(const FString& InFilePath, const FString& LevelName, float InSampleInterval, const TFunction<void(const FString&)>& OnSegmentWritten = nullptr);
+
+	//Writes the remaining samples and closes the file
+	virtual ~FTrajectoryLogger();
+
+	//Returns the sample to fill for this frame, or null if it is not yet time to sample or no chunk is free
+	FTrajectorySample* BeginSample(double Timestamp);
+
+	//Seconds between two samples, 0 samples every frame
+	const float SampleInterval;
+
+	//FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+	//Identifies the file format, bumped whenever the layout changes. 3 references the actors by id, 2 defined their names in
+	//the log; the logs of the few builds which took the names from the episode name table also say 2 and cannot be read
+	static const uint32 Magic = 0x54574352; // 'RCWT'
+	static const uint16 Version = 3;
+
+	//Record tag of the chunks
+	static const uint8 ChunkTag = 'C';
+
+	//Samples per chunk and chunks allocated for the episode
+	static const int32 SamplesPerChunk = 128;
+	static const int32 NumChunks = 16;
+
+private:
+	struct FChunk
+	{
+		int32 NumSamples;
+		FTrajectorySample Samples[SamplesPerChunk];
+	};
+
+	//Quantizes and appends a chunk to the write buffer
+	void EncodeChunk(const FChunk& Chunk, FArchive& Ar);
+
+	//Writes the filled chunks and gives them back to the game thread, returns false if there was nothing to write
+	bool Drain();
+
+	//Chunks allocated once, owned by the game thread while free and by the writer thread once filled
+	TArray<FChunk> Chunks;
+	TSpscRingBuffer<int32, NumChunks> FilledChunks;
+	TSpscRingBuffer<int32, NumChunks> FreeChunks;
+
+	//Chunk being filled by the game thread, INDEX_NONE if none was free
+	int32 CurrentChunk;
+
+	double NextSampleTime;
+
+	//Samples lost because every chunk was waiting to be written, only touched by the game thread
+	uint32 DroppedSamples;
+
+	//Episode duration and bytes written, to report the rate at close
+	double FirstTimestamp;
+	double LastTimestamp;
+	uint64 BytesWritten;
+	FLogEncodingStats Stats;
+
+	FArchive* File;
+
+	//Serialization buffer reused between drains
+	TArray<uint8> WriteBuffer;
+
+	FThreadSafeBool bStopping;
+
+	FRunnableThread* Thread;
+};
@@ -0,0 +1,232 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "WorldPoseLogger.h"
+#include "SegmentedFileWriter.h"
+#include "LogEncoding.h"
+
+FWorldPoseLogger::FWorldPoseLogger(const FString& InFilePath, const FString& LevelName, UWorld* InWorld, const TFunction<void(const FString&)>& OnSegmentWritten)
+	: World(InWorld)
+	, NextKeyframeTime(0.0)
+	, Frames(0)
+	, DroppedRecords(0)
+	, CurrentKeyframeTime(-1.0)
+	, PreviousTimestamp(0.0)
+{
+	PositionEpsilon = 0.1f;
+	RotationEpsilon = 0.5f;
+	KeyframeInterval = 2.f;
+	RotationThreshold = FMath::Cos(FMath::DegreesToRadians(RotationEpsilon) * 0.5f);
+
+	FSegmentedFileWriter* SegmentWriter = new FSegmentedFileWriter(InFilePath);
+	SegmentWriter->OnSegmentWritten = OnSegmentWritten;
+	File = SegmentWriter;
+	uint32 FileMagic = Magic;
+	uint16 FileVersion = Version;
+	FString FileLevelName = LevelName;
+	*File << FileMagic;
+	*File << FileVersion;
+	*File << FileLevelName;
+	//The header is a record of its own, the first segment starts with it
+	File->Flush();
+
+	WriteBuffer.Reserve(64 * 1024);
+	Thread = FRunnableThread::Create(this, TEXT("WorldPoseLogger"), 0, TPri_BelowNormal);
+}
+
+FWorldPoseLogger::~FWorldPoseLogger()
+{
+	for (const auto& Pose : Tracked)
+	{
+		if (Pose.Value.Component.IsValid())
+		{
+			Pose.Value.Component->TransformUpdated.RemoveAll(this);
+		}
+	}
+
+	if (Thread)
+	{
+		Stop();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	uint64 BytesWritten = 0;
+	if (File)
+	{
+		//Index of the keyframes, followed by its offset so that readers can find it from the end of the file
+		int64 IndexOffset = File->Tell();
+		int32 NumKeyframes = KeyframeTimes.Num();
+		*File << NumKeyframes;
+		for (int32 i = 0; i < NumKeyframes; i++)
+		{
+			*File << KeyframeTimes[i];
+			*File << KeyframeOffsets[i];
+		}
+		*File << IndexOffset;
+
+		BytesWritten = File->Tell();
+		File->Close();
+		delete File;
+		File = nullptr;
+	}
+
+	//Same records written for every tracked actor on every frame
+	const uint64 NaiveBytes = Frames * Tracked.Num() * PoseRecordSize;
+	UE_LOG(LogRobCogWeb, Log, TEXT("World poses: %llu bytes written for %d actors over %llu frames, a per-frame dump would take %llu bytes (%.1fx), %u records dropped"),
+		BytesWritten, Tracked.Num(), Frames, NaiveBytes, BytesWritten ? (double)NaiveBytes / BytesWritten : 0.0, DroppedRecords);
+	Stats.Report(TEXT("World poses"));
+}
+
+void FWorldPoseLogger::Track(AActor* Actor, uint32 ActorId)
+{
+	USceneComponent* Component = Actor ? Actor->GetRootComponent() : nullptr;
+	if (!Component || Tracked.Contains(Component))
+	{
+		return;
+	}
+
+	FTrackedPose& Pose = Tracked.Add(Component);
+	Pose.Component = Component;
+	Pose.ActorId = ActorId;
+	Pose.Location = Component->GetComponentLocation();
+	Pose.Rotation = Component->GetComponentQuat();
+	Component->TransformUpdated.AddRaw(this, &FWorldPoseLogger::OnTransformUpdated);
+}
+
+void FWorldPoseLogger::Tick()
+{
+	Frames++;
+
+	const double Time = World->GetTimeSeconds();
+	if (Time < NextKeyframeTime)
+	{
+		return;
+	}
+	NextKeyframeTime = Time + KeyframeInterval;
+	RotationThreshold = FMath::Cos(FMath::DegreesToRadians(RotationEpsilon) * 0.5f);
+
+	for (auto& Pose : Tracked)
+	{
+		if (!Pose.Value.Component.IsValid())
+		{
+			continue;
+		}
+		Pose.Value.Location = Pose.Key->GetComponentLocation();
+		Pose.Value.Rotation = Pose.Key->GetComponentQuat();
+		Push(Pose.Value.ActorId, Pose.Value.Location, Pose.Value.Rotation, true);
+	}
+}
+
+void FWorldPoseLogger::OnTransformUpdated(USceneComponent* Component, EUpdateTransformFlags UpdateFlags, ETeleportType Teleport)
+{
+	FTrackedPose* Pose = Tracked.Find(Component);
+	if (!Pose)
+	{
+		return;
+	}
+
+	const FVector Location = Component->GetComponentLocation();
+	const FQuat Rotation = Component->GetComponentQuat();
+	if (FVector::DistSquared(Location, Pose->Location) < FMath::Square(PositionEpsilon) &&
+		FMath::Abs(Rotation | Pose->Rotation) > RotationThreshold)
+	{
+		return;
+	}
+
+	Pose->Location = Location;
+	Pose->Rotation = Rotation;
+	Push(Pose->ActorId, Location, Rotation, false);
+}
+
+void FWorldPoseLogger::Push(uint32 ActorId, const FVector& Location, const FQuat& Rotation, bool bKeyframe)
+{
+	FWorldPoseRecord Record;
+	Record.Timestamp = World->GetTimeSeconds();
+	Record.ActorId = ActorId;
+	Record.Location = Location;
+	Record.Rotation = Rotation;
+	Record.bKeyframe = bKeyframe;
+
+	if (!Records.Push(Record))
+	{
+		DroppedRecords++;
+	}
+}
+
+uint32 FWorldPoseLogger::Run()
+{
+	while (!bStopping)
+	{
+		if (!Drain())
+		{
+			if (File)
+			{
+				File->Flush();
+			}
+			FPlatformProcess::Sleep(0.01f);
+		}
+	}
+	Drain();
+	return 0;
+}
+
+void FWorldPoseLogger::Stop()
+{
+	bStopping = true;
+}
+
+/*Records are a tag, the time since the previous record in ms, the actor id, the position and the compressed rotation.
+Keyframe poses store the full position so that reading can start at any keyframe, the other poses store
+the difference to the previous position of the actor. All integers are zig-zag varints.*/
+bool FWorldPoseLogger::Drain()
+{
+	FWorldPoseRecord Record;
+	if (!Records.Pop(Record))
+	{
+		return false;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	const int64 BaseOffset = File ? File->Tell() : 0;
+	WriteBuffer.Reset();
+	FMemoryWriter Writer(WriteBuffer);
+	do
+	{
+		//The records of a keyframe are pushed together, a new timestamp starts a new keyframe
+		if (Record.bKeyframe && Record.Timestamp != CurrentKeyframeTime)
+		{
+			CurrentKeyframeTime = Record.Timestamp;
+			KeyframeTimes.Add(Record.Timestamp);
+			KeyframeOffsets.Add(BaseOffset + WriteBuffer.Num());
+
+			uint8 Tag = KeyframeTag;
+			Writer << Tag;
+			Writer << Record.Timestamp;
+			PreviousTimestamp = Record.Timestamp;
+		}
+
+		FIntVector& LastLocation = LastLocations.FindOrAdd(Record.ActorId);
+		uint8 Tag = Record.bKeyframe ? KeyPoseTag : PoseTag;
+		Writer << Tag;
+		LogEncoding::WriteTimeDelta(Writer, Record.Timestamp, PreviousTimestamp);
+		LogEncoding::WriteVarint(Writer, Record.ActorId);
+		if (Record.bKeyframe)
+		{
+			LastLocation = FIntVector::ZeroValue;
+		}
+		LogEncoding::WriteLocationDelta(Writer, LogEncoding::QuantizeLocation(Record.Location), LastLocation);
+		LogEncoding::WriteQuat(Writer, Record.Rotation);
+		Stats.RawBytes += PoseRecordSize;
+	} while (Records.Pop(Record));
+	Stats.EncodedBytes += WriteBuffer.Num();
+	Stats.EncodeTime += FPlatformTime::Seconds() - StartTime;
+
+	if (File)
+	{
+		File->Serialize(WriteBuffer.GetData(), WriteBuffer.Num());
+		File->Flush();
+	}
+	return true;
+}
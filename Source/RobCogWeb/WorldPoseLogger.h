@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "SpscRingBuffer.h"
+#include "LogEncoding.h"
+
+//Pose of one actor at one moment, as recorded in the world pose log
+struct FWorldPoseRecord
+{
+	double Timestamp;
+	uint32 ActorId;
+	FVector Location;
+	FQuat Rotation;
+
+	//Part of a keyframe (every tracked actor is written, changed or not)
+	bool bKeyframe;
+};
+
+/*Logs the poses of the movable actors of the kitchen only when they change.
+Nothing is polled: each tracked component reports its moves through its TransformUpdated delegate,
+which the physics scene only fires for awake bodies and the character for the items it moves,
+so the ~40 items resting on the tables cost nothing. A move is recorded when it exceeds the position
+or rotation epsilon; every few seconds a keyframe with all the poses allows seeking in the log.
+The records are written by a background thread, the keyframe offsets are indexed at the end of the file.
+*/
+class FWorldPoseLogger : public FRunnable
+{
+public:
+	//Opens the pose file and starts the writer thread, OnSegmentWritten is called on it with each segment of the file once it is in place
+	FWorldPoseLogger(const FString& InFilePath, const FString& LevelName, UWorld* InWorld, const TFunction<void(const FString&)>& OnSegmentWritten = nullptr);
+
+	//Stops listening to the tracked actors, writes the remaining records and the keyframe index
+	virtual ~FWorldPoseLogger();
+
+	//Starts listening to the moves of the root component of the actor, recorded under its stable id
+	void Track(AActor* Actor, uint32 ActorId);
+
+	//Writes the keyframes when they are due and counts the frames for the size report, called every frame
+	void Tick();
+
+	//Moves smaller than these are not recorded (cm and degrees)
+	float PositionEpsilon;
+	float RotationEpsilon;
+
+	//Seconds between two keyframes
+	float KeyframeInterval;
+
+	//FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+	//Identifies the file format, bumped whenever the layout changes. 3 references the actors by id, 2 defined their names in
+	//the log; the logs of the few builds which took the names from the episode name table also say 2 and cannot be read
+	static const uint32 Magic = 0x50574352; // 'RCWP'
+	static const uint16 Version = 3;
+
+	//Record tags of the file
+	static const uint8 PoseTag = 'P';
+	static const uint8 KeyPoseTag = 'A';
+	static const uint8 KeyframeTag = 'K';
+
+	//Bytes of a pose record with a fixed-size layout, used to estimate the size of a per-frame dump
+	static const int32 PoseRecordSize = 1 + 8 + 4 + 12 + 16;
+
+private:
+	//Last pose recorded for a tracked component
+	struct FTrackedPose
+	{
+		TWeakObjectPtr<USceneComponent> Component;
+		uint32 ActorId;
+		FVector Location;
+		FQuat Rotation;
+	};
+
+	//Called by the tracked components whenever their transform changes
+	void OnTransformUpdated(USceneComponent* Component, EUpdateTransformFlags UpdateFlags, ETeleportType Teleport);
+
+	//Pushes a pose to the writer thread
+	void Push(uint32 ActorId, const FVector& Location, const FQuat& Rotation, bool bKeyframe);
+
+	//Moves the buffered records to the file, returns false if there was nothing to write
+	bool Drain();
+
+	UWorld* World;
+
+	//Tracked components and the last pose recorded for each, only used by the game thread
+	TMap<USceneComponent*, FTrackedPose> Tracked;
+
+	//Cosine of half the rotation epsilon, compared with the dot product of the quaternions
+	float RotationThreshold;
+
+	double NextKeyframeTime;
+
+	//Frames seen and records lost because the writer could not keep up, only touched by the game thread
+	uint64 Frames;
+	uint32 DroppedRecords;
+
+	TSpscRingBuffer<FWorldPoseRecord, 8192> Records;
+
+	//Time and file offset of each keyframe, only used by the writer thread
+	TArray<double> KeyframeTimes;
+	TArray<int64> KeyframeOffsets;
+	double CurrentKeyframeTime;
+
+	//Delta encoding state: time of the last record and quantized location of the last record of each actor
+	double PreviousTimestamp;
+	TMap<uint32, FIntVector> LastLocations;
+	FLogEncodingStats Stats;
+
+	FArchive* File;
+
+	//Serialization buffer reused between drains
+	TArray<uint8> WriteBuffer;
+
+	FThreadSafeBool bStopping;
+
+	FRunnableThread* Thread;
+};
@@ -0,0 +1,232 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RobCogWeb.h"
+#include "WorldStateDiff.h"
+
+const float FWorldStateTracker::CellSize = 50.f;
+const float FWorldStateTracker::MoveTolerance = 1.f;
+const float FWorldStateTracker::RotationTolerance = 0.05f;
+
+FArchive& operator<<(FArchive& Ar, FItemChange& Change)
+{
+	Ar << Change.ActorId;
+	Ar << Change.InitialLocation;
+	Ar << Change.FinalLocation;
+	Ar << Change.InitialRotation;
+	Ar << Change.FinalRotation;
+	Ar << Change.InitialSupport;
+	Ar << Change.FinalSupport;
+	Ar << Change.InitialContainer;
+	Ar << Change.FinalContainer;
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FAssetChange& Change)
+{
+	Ar << Change.ActorId;
+	Ar << Change.InitialState;
+	Ar << Change.FinalState;
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FSpatialRelation& Relation)
+{
+	Ar << Relation.Kind;
+	Ar << Relation.ActorId;
+	Ar << Relation.OtherId;
+	return Ar;
+}
+
+FWorldStateDiff::FWorldStateDiff()
+	: NumChanged(0)
+	, ComputeTime(0.0)
+{
+}
+
+bool FWorldStateDiff::Serialize(FArchive& Ar)
+{
+	uint32 FileMagic = Magic;
+	uint16 FileVersion = Version;
+	Ar << FileMagic;
+	Ar << FileVersion;
+	if (FileMagic != Magic || FileVersion != Version)
+	{
+		return false;
+	}
+
+	Ar << MovedItems;
+	Ar << ChangedAssets;
+	Ar << NewRelations;
+	Ar << NumChanged;
+	return !Ar.IsError();
+}
+
+bool FWorldStateDiff::SaveToFile(const FString& FilePath)
+{
+	TArray<uint8> Bytes;
+	FMemoryWriter Writer(Bytes);
+	return Serialize(Writer) && FFileHelper::SaveArrayToFile(Bytes, *FilePath);
+}
+
+bool FWorldStateDiff::LoadFromFile(const FString& FilePath, FWorldStateDiff& OutDiff)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *FilePath, FILEREAD_Silent))
+	{
+		return false;
+	}
+	FMemoryReader Reader(Bytes);
+	return OutDiff.Serialize(Reader);
+}
+
+FIntPoint FWorldStateTracker::GetCell(const FVector& Location)
+{
+	return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+}
+
+/*Each object goes in every cell its bounds overlap, so the cell of a point lists every object which may cover it*/
+void FWorldStateTracker::Begin(const AMyCharacter& Character)
+{
+	Initial.Capture(Character);
+	ObjectIndex.Empty(Initial.Objects.Num());
+	Cells.Reset();
+	for (int32 i = 0; i < Initial.Objects.Num(); i++)
+	{
+		const FSemanticMapObject& Object = Initial.Objects[i];
+		if (Object.ActorId)
+		{
+			ObjectIndex.Add(Object.ActorId, i);
+		}
+
+		const FIntPoint Min = GetCell(Object.Bounds.Min);
+		const FIntPoint Max = GetCell(Object.Bounds.Max);
+		for (int32 X = Min.X; X <= Max.X; X++)
+		{
+			for (int32 Y = Min.Y; Y <= Max.Y; Y++)
+			{
+				Cells.FindOrAdd(FIntPoint(X, Y)).Add(i);
+			}
+		}
+	}
+}
+
+/*Only the objects which changed can have new relations: an item cannot be picked from under another one,
+and the items in a drawer keep resting in it while it slides.
+@param const AMyCharacter& Character  -->  Character holding the changed actors and the states of the drawers and doors
+@param FWorldStateDiff& OutDiff  -->  Receives the diff*/
+void FWorldStateTracker::Compute(const AMyCharacter& Character, FWorldStateDiff& OutDiff)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	OutDiff.MovedItems.Reset();
+	OutDiff.ChangedAssets.Reset();
+	OutDiff.NewRelations.Reset();
+
+	Changed.Reset();
+	ChangedIndices.Reset();
+	ChangedSet.Reset();
+	for (const AActor* Actor : Character.ChangedActors)
+	{
+		//Actors added after the start (eg: spawned at runtime) have no start state to compare with
+		const int32* Index = Actor ? ObjectIndex.Find(Character.ActorIds.GetId(Actor)) : nullptr;
+		if (!Index)
+		{
+			continue;
+		}
+		FSemanticMapObject& Final = Changed[Changed.Add(Initial.Objects[*Index])];
+		Final.Location = Actor->GetActorLocation();
+		Final.Rotation = Actor->GetActorQuat();
+		Final.Bounds = Actor->GetComponentsBoundingBox();
+		if (Final.Kind == ESemanticMapObjectKind::Articulated)
+		{
+			Final.State = Character.AssetStateMap.FindRef(const_cast<AActor*>(Actor));
+		}
+		ChangedIndices.Add(*Index);
+		ChangedSet.Add(*Index);
+	}
+
+	for (int32 i = 0; i < Changed.Num(); i++)
+	{
+		const FSemanticMapObject& Start = Initial.Objects[ChangedIndices[i]];
+		const FSemanticMapObject& Final = Changed[i];
+		if (Final.Kind == ESemanticMapObjectKind::Articulated)
+		{
+			if (Final.State != Start.State)
+			{
+				FAssetChange& Change = OutDiff.ChangedAssets[OutDiff.ChangedAssets.AddUninitialized()];
+				Change.ActorId = Final.ActorId;
+				Change.InitialState = Start.State;
+				Change.FinalState = Final.State;
+			}
+			continue;
+		}
+		if (Final.Kind != ESemanticMapObjectKind::Item)
+		{
+			continue;
+		}
+
+		//Everything was at its start pose at the start
+		FSpatialRelationSearch Before(Start);
+		if (const TArray<int32>* Cell = Cells.Find(GetCell(Start.Bounds.GetCenter())))
+		{
+			for (const int32 Other : *Cell)
+			{
+				Before.Consider(Initial.Objects[Other]);
+			}
+		}
+
+		//The objects which did not change are still where they started
+		FSpatialRelationSearch After(Final);
+		if (const TArray<int32>* Cell = Cells.Find(GetCell(Final.Bounds.GetCenter())))
+		{
+			for (const int32 Other : *Cell)
+			{
+				if (!ChangedSet.Contains(Other))
+				{
+					After.Consider(Initial.Objects[Other]);
+				}
+			}
+		}
+		for (const FSemanticMapObject& Other : Changed)
+		{
+			After.Consider(Other);
+		}
+
+		FItemChange Change;
+		Change.ActorId = Final.ActorId;
+		Change.InitialLocation = Start.Location;
+		Change.FinalLocation = Final.Location;
+		Change.InitialRotation = Start.Rotation;
+		Change.FinalRotation = Final.Rotation;
+		Change.InitialSupport = Before.Support ? Before.Support->ActorId : 0;
+		Change.FinalSupport = After.Support ? After.Support->ActorId : 0;
+		Change.InitialContainer = Before.Container ? Before.Container->ActorId : 0;
+		Change.FinalContainer = After.Container ? After.Container->ActorId : 0;
+
+		//Picked and put back where it was
+		const bool bMoved = FVector::Dist(Start.Location, Final.Location) > MoveTolerance || Start.Rotation.AngularDistance(Final.Rotation) > RotationTolerance;
+		if (!bMoved && Change.InitialSupport == Change.FinalSupport && Change.InitialContainer == Change.FinalContainer)
+		{
+			continue;
+		}
+		OutDiff.MovedItems.Add(Change);
+
+		if (Change.FinalSupport && Change.FinalSupport != Change.InitialSupport)
+		{
+			FSpatialRelation& Relation = OutDiff.NewRelations[OutDiff.NewRelations.AddUninitialized()];
+			Relation.Kind = ESpatialRelation::Support;
+			Relation.ActorId = Change.ActorId;
+			Relation.OtherId = Change.FinalSupport;
+		}
+		if (Change.FinalContainer && Change.FinalContainer != Change.InitialContainer)
+		{
+			FSpatialRelation& Relation = OutDiff.NewRelations[OutDiff.NewRelations.AddUninitialized()];
+			Relation.Kind = ESpatialRelation::Containment;
+			Relation.ActorId = Change.ActorId;
+			Relation.OtherId = Change.FinalContainer;
+		}
+	}
+
+	OutDiff.NumChanged = Changed.Num();
+	OutDiff.ComputeTime = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+}
@@ -0,0 +1,118 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "SemanticMapExporter.h"
+
+//Relations tracked by the diff, the ones of the semantic map (knowrob:on-Physical and knowrob:in-ContGeneric)
+enum class ESpatialRelation : uint8
+{
+	Support,
+	Containment
+};
+
+//Item changed during the episode, with what it rested on and was inside of at both ends (0 for nothing)
+struct FItemChange
+{
+	uint32 ActorId;
+	FVector InitialLocation;
+	FVector FinalLocation;
+	FQuat InitialRotation;
+	FQuat FinalRotation;
+	uint32 InitialSupport;
+	uint32 FinalSupport;
+	uint32 InitialContainer;
+	uint32 FinalContainer;
+
+	friend FArchive& operator<<(FArchive& Ar, FItemChange& Change);
+};
+
+//Drawer or door which ended in another state than it started in
+struct FAssetChange
+{
+	uint32 ActorId;
+	EAssetState InitialState;
+	EAssetState FinalState;
+
+	friend FArchive& operator<<(FArchive& Ar, FAssetChange& Change);
+};
+
+//Relation between an item and another object
+struct FSpatialRelation
+{
+	ESpatialRelation Kind;
+	uint32 ActorId;
+	uint32 OtherId;
+
+	friend FArchive& operator<<(FArchive& Ar, FSpatialRelation& Relation);
+};
+
+/*Difference between the kitchen at the start of the episode and when the task is finished, for the task evaluators and
+the knowledge base. Actors are referred to by their stable id (see FActorIdRegistry, Actors.bin maps them to names).
+*/
+struct FWorldStateDiff
+{
+	//Identifies the file format, bumped whenever the layout changes
+	static const uint32 Magic = 0x44574352; // 'RCWD'
+	static const uint16 Version = 1;
+
+	//Items which moved, or rest on or in something else than at the start
+	TArray<FItemChange> MovedItems;
+
+	TArray<FAssetChange> ChangedAssets;
+
+	//Relations holding at the end which did not hold at the start
+	TArray<FSpatialRelation> NewRelations;
+
+	//Actors changed during the episode, the ones the diff was computed from
+	int32 NumChanged;
+
+	//Time spent computing it on the game thread, in milliseconds
+	double ComputeTime;
+
+	FWorldStateDiff();
+
+	//Serialize to or from a byte buffer, returns false if the data is not a valid diff
+	bool Serialize(FArchive& Ar);
+
+	//Helpers for reading and writing diff files
+	bool SaveToFile(const FString& FilePath);
+	static bool LoadFromFile(const FString& FilePath, FWorldStateDiff& OutDiff);
+};
+
+/*Keeps the start state of the kitchen so that the diff at the end only looks at the actors changed during play.
+Begin() captures the kitchen once and buckets the objects in a grid over the floor plan by their bounds;
+Compute() reads back the actors in the character's ChangedActors, and searches the support and container of each changed
+item among the objects of its grid cell (at their start pose) and the other changed actors (at their final pose).
+The cost of Compute() grows with the number of changed actors, not with the size of the kitchen.
+*/
+class FWorldStateTracker
+{
+public:
+	//Captures the start state, the game mode resets the changed actors of the character at the same time
+	void Begin(const AMyCharacter& Character);
+
+	//Diffs the changed actors against the start state, can be called again after a resume
+	void Compute(const AMyCharacter& Character, FWorldStateDiff& OutDiff);
+
+	//Side of the grid cells, in cm
+	static const float CellSize;
+
+	//An item closer than this to its start pose, in cm and radians, has not moved
+	static const float MoveTolerance;
+	static const float RotationTolerance;
+
+private:
+	//Grid cell holding a point
+	static FIntPoint GetCell(const FVector& Location);
+
+	//Start state
+	FSemanticMapCapture Initial;
+	TMap<uint32, int32> ObjectIndex;
+	TMap<FIntPoint, TArray<int32>> Cells;
+
+	//Final state of the changed objects and their index in the start state, reused between calls
+	TArray<FSemanticMapObject> Changed;
+	TArray<int32> ChangedIndices;
+	TSet<int32> ChangedSet;
+};